@@ -0,0 +1,72 @@
+#ifndef BENCHAPP_HPP
+#define BENCHAPP_HPP
+
+#include <chrono>
+#include <string>
+
+#include "PotentialApp.hpp"
+#include "CameraPath.hpp"
+#include "FrameStats.hpp"
+
+
+// Replays the camera path of a scene config with a fixed timestep and collects frame timings
+class BenchApp : public PotentialApp {
+public:
+    struct BenchInfo {
+        std::string sceneName;
+        std::string configPath;
+        std::string outputPath = "bench_output.json";
+        std::string capturePath = "";
+        uint64_t frames = 300;
+        uint64_t warmupFrames = 30;
+        float timestep = 1.0f / 60.0f;
+        // Loads the scene models this many times to see how the import time scales with the primitive count
+        uint32_t modelCopies = 1;
+        bool keepCpuCopies = false;
+        // Issue every bind and state change to compare against the render context cache
+        bool disableStateCache = false;
+        // Draw every primitive with its own call instead of multi-draw-indirect
+        bool directSubmission = false;
+        // Draw every item to compare against frustum culling
+        bool disableCulling = false;
+        // Skip the CPU occlusion buffer and only cull against the frustum
+        bool disableOcclusionCulling = false;
+        // Draw the full resolution index buffers regardless of the screen size
+        bool disableLod = false;
+        // Upload vertices in GeometryArena::QuantizedVertex instead of full floats
+        bool quantizeVertices = false;
+    };
+
+    BenchApp(const BenchInfo& info);
+
+    void OnRenderingStart() override;
+    void OnRenderFrame() override;
+    void OnRenderingEnd() override;
+
+    inline const Utils::FrameStats& getFrameStats() const { return frameStats_; }
+
+private:
+    BenchInfo info_;
+
+    GeneralApp::CameraPath cameraPath_;
+    Utils::FrameStats frameStats_;
+
+    uint64_t benchFrame_ = 0;
+    double loadTimeMs_ = 0.0;
+    size_t loadResidentBytes_ = 0;
+    // Vertex and index bytes of the loaded models in the geometry arena
+    size_t loadGeometryBytes_ = 0;
+    std::chrono::steady_clock::time_point benchStartTime_;
+    std::string renderer_;
+
+    uint64_t firstMeasuredGpuFrame_ = UINT64_MAX;
+
+    void loadCameraPath();
+    void collectGpuTimings();
+    nlohmann::json getModelInitResults() const;
+    void writeResults() const;
+    void captureFrame() const;
+};
+
+
+#endif
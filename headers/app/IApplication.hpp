@@ -5,6 +5,7 @@
 #include <string>
 #include <algorithm>
 #include <sstream>
+#include <chrono>
 
 #ifdef __ANDROID__
 #include <EGL/egl.h>
@@ -15,6 +16,11 @@
 #else
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
+#ifdef ENABLE_HEADLESS
+#define EGL_NO_X11
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
 #endif
 
 
@@ -26,7 +32,11 @@ struct WindowCreateInfo {
 #else
     unsigned winWidth;
     unsigned winHeight;
+    // Render into an offscreen DEFAULT_FRAMEBUFFER of a surfaceless EGL context instead of a GLFW window
+    bool headless = false;
 #endif
+    // Stop rendering after this many frames, 0 means run until the window is closed
+    uint64_t maxFrames = 0;
     std::string name;
 };
 
@@ -52,9 +62,16 @@ protected:
 
     bool needToRender_ = true;
 
+    uint64_t maxFrames_ = 0;
+    uint64_t renderedFrames_ = 0;
+    bool closeRequested_ = false;
+
     static IApplication* m_Application;
     
     void showFPS();
+    float getTime() const;
+    bool shouldClose() const;
+    void requestClose() { closeRequested_ = true; }
 
     virtual void OnInit() = 0;
     virtual void OnWindowCreate() = 0;
@@ -72,7 +89,22 @@ protected:
     virtual void handleCmdCallback(android_app* app, int32_t cmd);
     virtual int32_t handleInputCallback(android_app* app, AInputEvent* event) = 0;
 #else
-    GLFWwindow* window_;
+    GLFWwindow* window_ = nullptr;
+
+    bool isHeadless_ = false;
+    std::chrono::steady_clock::time_point startTime_ = std::chrono::steady_clock::now();
+
+#ifdef ENABLE_HEADLESS
+    EGLDisplay headlessDisplay_ = EGL_NO_DISPLAY;
+    EGLContext headlessContext_ = EGL_NO_CONTEXT;
+    GLuint headlessFramebuffer_ = 0;
+    GLuint headlessColorRenderbuffer_ = 0;
+    GLuint headlessDepthRenderbuffer_ = 0;
+
+    bool createHeadlessContext();
+    void destroyHeadlessContext();
+#endif
+
     virtual void framebufferSizeCallback(GLFWwindow* window, int width, int height) = 0;
     virtual void cursorCallback(GLFWwindow* window, double xpos, double ypos) = 0;
     virtual void mouseCallback(GLFWwindow* window, int button, int action, int mods) = 0;
@@ -126,6 +158,10 @@ public:
     void createWindow(const WindowCreateInfo& winInfo);
     void renderToWindow();
     void terminateWindow();
+
+    // GL name of the framebuffer presented to the user: 0 for a window, the offscreen one in headless mode
+    unsigned getDefaultFramebufferId() const;
+    bool isHeadless() const;
 };
 
 }
@@ -5,6 +5,7 @@
 #include <vector>
 #include <algorithm>
 #include <chrono>
+#include <future>
 
 #define GLM_FORCE_SWIZZLE
 #include <glm/glm.hpp>
@@ -14,26 +15,29 @@
 #include "IApplication.hpp"
 #include "Shader.hpp"
 #include "Camera.hpp"
+#include "CameraPath.hpp"
 #include "Cube.hpp"
 #include "GLTFLoader.hpp"
 #include "Model.hpp"
 #include "Mesh.hpp"
+#include "RenderQueue.hpp"
 
 #include <tinygltf/tiny_gltf.h>
 
 #define BUFFER_OFFSET(i) ((char *)NULL + (i))
 
 static inline constexpr const char* CONFIG_PATH = "configs://models.json";
+static inline constexpr const char* RECORDED_CAMERA_PATH = "configs://camera_path.json";
 static inline constexpr const char* MODEL_SHADER_NAME = "Model_Shader";
+static inline constexpr const char* MODEL_INDIRECT_SHADER_NAME = "Model_Indirect_Shader";
 static inline constexpr const char* MODEL_FRAMEBUFFER_NAME = "MODEL_FRAMEBUFFER";
 static inline constexpr const char* MODEL_FRAMEBUFFER_TEXTURE_NAME = "MODEL_FRAMEBUFFER_TEXTURE";
 
 class PotentialApp : public GeneralApp::IApplication {
-private:
+protected:
     struct Matrices {
         glm::mat4 view;
         glm::mat4 proj;
-        glm::mat4 model;
     };
 
     GeneralApp::Camera Camera_{glm::vec3(4.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f)};
@@ -47,11 +51,29 @@ private:
     bool NeedInit_ = false;
     Resources::ResourceHandle previewTextureHandle_;
     uint64_t frameAfterInit_ = 0;
+    uint64_t previewFadeFrames_ = 100;
 
+    std::string basedir_ = "";
+    std::string configPath_ = CONFIG_PATH;
+
+    GeneralApp::CameraPath recordedCameraPath_;
+    bool isRecordingCameraPath_ = false;
+    float recordingStartTime_ = 0.0f;
 
     std::vector<Geometry::Model> Models_;
+    std::vector<std::future<bool>> modelsLoading_;
+    // Every model of the config is loaded this many times, copies share resources and only add primitives
+    uint32_t modelCopies_ = 1;
+    // Duration of Model::init of each element of Models_
+    std::vector<double> modelInitMs_;
+
+    // Primitives of all models, sorted by state and drawn in one pass
+    SceneResources::RenderQueue renderQueue_;
+    // Falls back to direct draws where multi-draw-indirect is not supported
+    bool multiDrawIndirect_ = true;
 
     Resources::ResourceHandle modelShaderHandle_;
+    Resources::ResourceHandle modelIndirectShaderHandle_;
     Resources::ResourceHandle modelFramebufferHandle_;
     Resources::ResourceHandle modelFramebufferTextureHandle_;
 
@@ -61,10 +83,14 @@ private:
     bool keyPressedD_ = false;
 
     void processMovement();
+    void toggleCameraPathRecording();
 
 public:
     PotentialApp();
 
+    inline void setBasedir(const std::string& basedir) { basedir_ = basedir; }
+    inline void setConfigPath(const std::string& configPath) { configPath_ = configPath; }
+
     void OnInit() override;
     void OnWindowCreate() override;
     void OnRenderingStart() override;
@@ -82,6 +108,7 @@ public:
     void keyboardCallback(GLFWwindow* window, int key, int scancode, int action, int mods) override;
 #endif
 
+    void loadModelsAsync();
     void initModels();
     void initLights();
     void initRender();
@@ -33,6 +33,10 @@ namespace FileSystem {
         void registerProtocol(const std::string& name, const std::string& dirpath);
         const std::string getAbsolutePath(const std::string& filename) const;
         const std::string getCurrentDirectory() const;
+        // Creates the directory and all missing parents, true if it exists afterwards
+        bool createDirectories(const std::string& dirpath) const;
+        // Moves a fully written temporary file over the destination, readers never see a partial file
+        bool replaceFile(const std::string& tempPath, const std::string& path) const;
     };
 }
 
@@ -1,6 +1,8 @@
 #ifndef GLTFLOADER_HPP
 #define GLTFLOADER_HPP
 
+#include <mutex>
+
 #include <tinygltf/tiny_gltf.h>
 
 #include <Model.hpp>
@@ -9,7 +11,7 @@ namespace GLTF {
 
 class GLTFLoader final {
 private:
-    tinygltf::TinyGLTF loader_;
+    std::mutex loadedModelsMutex_;
 
     static GLTFLoader* instancePtr;
 
@@ -28,7 +30,13 @@ public:
         return instancePtr;
     }
 
+    // Safe to call from worker threads for different models. The loaded model is prepared as well
     bool load(Geometry::Model& model, const std::string& filename);
+
+    // Identifies an image in TextureCache, embedded images are told apart by their index
+    static std::string getImageCacheUri(const std::string& imageUri, const std::string& baseDir, const int imageIdx);
+    // Images sampled as base color or emissive, their mips are averaged in linear space
+    static std::vector<bool> findSrgbImages(const tinygltf::Model& model);
 };
 
 }
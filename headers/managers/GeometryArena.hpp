@@ -0,0 +1,101 @@
+#ifndef GEOMETRY_ARENA_HPP
+#define GEOMETRY_ARENA_HPP
+
+#include <map>
+#include <vector>
+
+#include "RenderResource.hpp"
+
+
+namespace Resources {
+
+// Vertex and index data of all models sub-allocated from a few large GL buffers. Primitives reference
+// ranges of these buffers instead of owning buffer objects and share a VAO per pair of blocks
+class GeometryArena final {
+public:
+    struct Allocation {
+        unsigned GL_id = 0;
+        uint32_t block = UINT32_MAX;
+        size_t offset = 0;
+        size_t size = 0;
+
+        inline bool isValid() const { return block != UINT32_MAX; }
+    };
+
+    // Layout every primitive is packed into, so all of them in a block can share one VAO and one indirect draw
+    struct Vertex {
+        float position[3];
+        float normal[3];
+        float uv[2];
+    };
+
+    // Half the size of Vertex. Positions are unsigned normalized within the bounds of their mesh, normals are
+    // octahedral signed normalized and texture coordinates are half floats
+    struct QuantizedVertex {
+        uint16_t position[4];
+        int16_t normal[2];
+        uint16_t uv[2];
+    };
+
+    enum class VertexFormat : uint32_t {
+        FLOAT = 0,
+        QUANTIZED = 1
+    };
+
+    static constexpr size_t DEFAULT_BLOCK_SIZE = 32ull * 1024 * 1024;
+    // Covers every index and attribute component type and std430 vec4 alignment
+    static constexpr size_t DEFAULT_ALIGNMENT = 16;
+
+    GeometryArena(const GeometryArena& obj) = delete;
+
+    static GeometryArena* getInstance() {
+        if (!instancePtr)
+            instancePtr = new GeometryArena();
+
+        return instancePtr;
+    }
+
+    // Must be called on the context thread. Allocations larger than a block get a block of their own
+    Allocation allocate(const size_t size, const size_t alignment = DEFAULT_ALIGNMENT);
+    void upload(const Allocation& allocation, const void* data, const size_t size, const size_t offset = 0);
+    void free(Allocation& allocation);
+    // VAO with the Vertex layout over the blocks of the given vertex and index allocations, created on the first use
+    unsigned getVertexArray(const Allocation& vertices, const Allocation& indices);
+
+    // Every model is packed in the same format, so it can only be chosen before the first allocation
+    void setVertexFormat(const VertexFormat format);
+    inline VertexFormat getVertexFormat() const { return vertexFormat_; }
+    inline size_t getVertexSize() const { return vertexFormat_ == VertexFormat::QUANTIZED ? sizeof(QuantizedVertex) : sizeof(Vertex); }
+
+    inline size_t getReservedBytes() const { return reservedBytes_; }
+    inline size_t getUsedBytes() const { return usedBytes_; }
+
+    void cleanUp();
+
+    ~GeometryArena() { cleanUp(); }
+
+private:
+    static GeometryArena* instancePtr;
+    GeometryArena() {};
+
+    struct Block {
+        unsigned GL_id = 0;
+        size_t size = 0;
+        // Free ranges by offset, neighbours are merged on free
+        std::map<size_t, size_t> freeRanges;
+    };
+
+    std::vector<Block> blocks_;
+    // (vertex block, index block) -> VAO
+    std::map<std::pair<uint32_t, uint32_t>, unsigned> vertexArrays_;
+    size_t reservedBytes_ = 0;
+    size_t usedBytes_ = 0;
+    VertexFormat vertexFormat_ = VertexFormat::FLOAT;
+
+    bool allocateFromBlock(const uint32_t blockIdx, const size_t size, const size_t alignment, Allocation& allocation);
+    uint32_t createBlock(const size_t size);
+};
+
+}
+
+#endif
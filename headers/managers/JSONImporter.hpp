@@ -26,6 +26,14 @@ namespace JsonUtil {
             glm::vec3 scale;
         };
 
+        struct CameraKeyframeInfo {
+            float time;
+            glm::vec3 position;
+            float yaw;
+            float pitch;
+            float fov;
+        };
+
         JSONImpoter(const JSONImpoter& obj) = delete;
 
         static JSONImpoter* getInstance() {
@@ -36,6 +44,9 @@ namespace JsonUtil {
         }
 
         void loadModelsInfo(const nlohmann::json& cfg, std::vector<ModelImportInfo>& modelInfos);
+
+        void loadCameraPath(const nlohmann::json& cfg, std::vector<CameraKeyframeInfo>& keyframes);
+        void dumpCameraPath(const std::vector<CameraKeyframeInfo>& keyframes, nlohmann::json& cfg);
     };
 }
 
@@ -0,0 +1,51 @@
+#ifndef MESH_CACHE_HPP
+#define MESH_CACHE_HPP
+
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ImageDecoder.hpp"
+#include "MappedFile.hpp"
+
+#include <Model.hpp>
+
+namespace GLTF {
+
+// On-disk cache of loaded glTF models in cache://meshes. An entry is named after the content hash of the glTF file
+// and also checks the hash of every external buffer. It holds the model description in MessagePack and one blob
+// with the images and the geometry packed by Model::prepare(), so a hit needs neither tinygltf, the source buffers
+// nor the geometry optimization
+class MeshCache final {
+public:
+    using PendingImages = std::vector<std::pair<int, std::future<Utils::ImageDecoder::DecodedImage>>>;
+    using Dependencies = std::vector<std::pair<std::string, std::shared_ptr<Utils::MappedFile>>>;
+
+    MeshCache(const MeshCache& obj) = delete;
+
+    // GLTFLoader::load reaches it on several workers at once, so it is a function-local static
+    static MeshCache* getInstance() {
+        static MeshCache* instance = new MeshCache();
+        return instance;
+    }
+
+    inline void setEnabled(const bool enabled) { enabled_ = enabled; }
+    inline bool isEnabled() const { return enabled_; }
+
+    // Fills the model from the cache entry, images are only scheduled for decoding into pendingImages
+    bool load(Geometry::Model& model, const uint64_t fileHash, const std::string& baseDir, PendingImages& pendingImages);
+    // The model must be prepared. dependencies are external buffers of the model by their URI relative to the glTF file
+    void store(const Geometry::Model& model, const uint64_t fileHash, const Dependencies& dependencies);
+
+private:
+    MeshCache() {};
+
+    bool enabled_ = true;
+
+    std::string getEntryPath(const uint64_t fileHash) const;
+};
+
+}
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <unordered_map>
 #include <array>
+#include <future>
 
 #include "Image.hpp"
 #include "Sampler.hpp"
@@ -11,6 +12,7 @@
 #include "Buffer.hpp"
 #include "Shader.hpp"
 #include "Framebuffer.hpp"
+#include "TextureCache.hpp"
 
 namespace Resources {
 
@@ -23,6 +25,10 @@ struct ImageDesc : RenderResourceDesc {
 	int format = GL_RGBA;
 
 	const unsigned char* p_data;
+	// p_data holds this many mip levels, packed as in MipChain.hpp
+	int levels = 1;
+	// Keeps the pixels after releaseCpuCopies, for readback or re-upload
+	bool keepCpuCopy = false;
 };
 
 struct SamplerDesc : RenderResourceDesc {
@@ -33,6 +39,9 @@ struct SamplerDesc : RenderResourceDesc {
 	uint32_t wrapS = Sampler::WrapMode::REPEAT;
 	uint32_t wrapT = Sampler::WrapMode::REPEAT;
 	uint32_t wrapR = Sampler::WrapMode::REPEAT;
+
+	// Clamped to the limit of the driver, 1 disables anisotropic filtering
+	float maxAnisotropy = 1.0f;
 };
 
 struct TextureDesc : RenderResourceDesc {
@@ -55,12 +64,16 @@ struct BufferDesc : RenderResourceDesc {
 
 	const unsigned char* p_data;
 	size_t bytesize;
+	// Keeps a shadow copy of the contents, otherwise it is dropped right after the upload unless all copies are kept
+	bool keepCpuCopy = false;
 };
 
 struct ShaderDesc : RenderResourceDesc {
 
 	std::string vertFilename;
 	std::string fragFilename;
+	// Defined in both stages right after the version directive
+	std::vector<std::string> defines;
 };
 
 struct FramebufferDesc : RenderResourceDesc {
@@ -72,6 +85,14 @@ struct FramebufferDesc : RenderResourceDesc {
 
 
 class ResourceManager final {
+public:
+	enum ResidencyPolicy : uint32_t {
+		// Every image and buffer keeps its CPU copy for the whole lifetime
+		KEEP_CPU_COPIES = 0,
+		// CPU copies are released once uploaded, except for resources created with keepCpuCopy
+		RELEASE_AFTER_UPLOAD = 1
+	};
+
 private:
 	std::unordered_map<std::string, Image*> images_;
 	std::unordered_map<std::string, Sampler*> samplers_;
@@ -82,18 +103,36 @@ private:
 	std::unordered_map<std::string, Framebuffer*> framebuffers_;
 
 	std::unordered_map<ResourceHandle, RenderResource*> allResources_;
+	// Resources are unique by (type, name, URI), the name maps above only hold the latest one of each name.
+	// glTF images and textures often come without names, so their URIs tell them apart
+	std::unordered_multimap<uint64_t, RenderResource*> resourceIndex_;
+
+	// Files being decoded on workers, createImage(filename) picks them up
+	std::unordered_map<std::string, std::future<TextureCache::DecodedImage>> pendingImages_;
 
 	std::array<Image*, Image::DefaultImages::COUNT> defaultImages_;
 	std::array<Sampler*, Sampler::DefaultSamplers::COUNT> defaultSamplers_;
 	std::array<Texture*, Texture::DefaultTextures::COUNT> defaultTextures_;
 	std::array<Material*, Material::DefaultMaterials::COUNT> defaultMaterials_;
-	std::array<Framebuffer*, Framebuffer::DefaultFramebuffers::COUNT> defaultFramebuffers_;
+	std::array<Framebuffer*, Framebuffer::DefaultFramebuffers::COUNT> defaultFramebuffers_ = {};
+
+	ResidencyPolicy residencyPolicy_ = ResidencyPolicy::RELEASE_AFTER_UPLOAD;
+
+	// Queried on first use, it needs the context
+	float maxSupportedAnisotropy_ = -1.0f;
+	float getMaxSupportedAnisotropy();
+
+	static uint64_t getResourceKey(const RenderResource::ResourceType type, const std::string& name, const std::string& uri);
+	RenderResource* findResource(const RenderResource::ResourceType type, const std::string& name, const std::string& uri) const;
+	void registerResource(RenderResource* resource);
+	// Deletes GL objects of the resource and drops it from the indices, name maps are left to the caller
+	void releaseResource(RenderResource* resource);
 
 	void createDefaultImages();
 	void createDefaultSamplers();
 	void createDefaultTextures();
 	void createDefaultMaterials();
-	void createDefaultFramebuffer();
+	void createDefaultFramebuffer(const unsigned GL_id);
 
 	static ResourceManager* instancePtr;
 	ResourceManager();
@@ -109,11 +148,20 @@ public:
 		return instancePtr;
 	}
 
-	void Init();
+	// defaultFramebufferId is the GL name backing DEFAULT_FRAMEBUFFER, non-zero when rendering offscreen
+	void Init(const unsigned defaultFramebufferId = 0);
+
+	inline void setResidencyPolicy(const ResidencyPolicy policy) { residencyPolicy_ = policy; }
+	inline ResidencyPolicy getResidencyPolicy() const { return residencyPolicy_; }
+	// Images may be shared by several textures, so their pixels are only released here, once the scene is uploaded.
+	// Textures created afterwards from released images get undefined contents
+	void releaseCpuCopies();
 
 	Image& createImage(const ImageDesc& imageDesc);
 	Image& createImage(const char* filename, bool isHdr = false);
 	Image& createImage(const std::string& filename, bool isHdr = false);
+	// Starts decoding of image files on the thread pool ahead of createImage
+	void prefetchImages(const std::vector<std::string>& filenames, bool isHdr = false);
 
 	Sampler& createSampler(const SamplerDesc& samplerDesc);
 	
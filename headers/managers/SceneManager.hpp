@@ -6,6 +6,7 @@
 #include "SceneNode.hpp"
 #include "Cube.hpp"
 #include "Light.hpp"
+#include "BoundingVolumeHierarchy.hpp"
 
 #include <freetype/ft2build.h>
 #include <freetype/freetype.h>
@@ -48,6 +49,17 @@ public:
 		COUNT
 	};
 
+	// Primitive of a node mesh, the unit the scene queries work with
+	struct ScenePrimitive {
+		SceneNode* node = nullptr;
+		uint32_t primitive = 0;
+	};
+
+	struct RaycastHit {
+		ScenePrimitive primitive;
+		float distance = 0.0f;
+	};
+
 	struct PostProcessInfo {
 		bool enableBlur;
 		bool enableBloom;
@@ -81,6 +93,23 @@ public:
 	bool hasSceneNode(const std::string& name);
 	bool hasSceneLight(const std::string& name);
 
+	// Bumped whenever nodes are created, deleted, moved in the hierarchy or toggled
+	inline void markSceneChanged() { ++sceneVersion_; }
+	inline uint64_t getSceneVersion() const { return sceneVersion_; }
+
+	// Flattens the node tree again after structural changes and recomputes the world matrices of moved nodes
+	// together with the world space bounds of every subtree
+	void updateTransforms();
+	inline TransformHierarchy& getTransforms() { return transforms_; }
+	inline const TransformHierarchy& getTransforms() const { return transforms_; }
+
+	// Queries against the world space bounds of the primitives as of the last updateTransforms()
+	bool raycast(const glm::vec3& origin, const glm::vec3& direction, const float maxDistance, RaycastHit& hit) const;
+	bool raycastAny(const glm::vec3& origin, const glm::vec3& direction, const float maxDistance) const;
+	void queryFrustum(const GeneralApp::Frustum& frustum, std::vector<ScenePrimitive>& result) const;
+	void querySphere(const glm::vec3& center, const float radius, std::vector<ScenePrimitive>& result) const;
+	inline const BoundingVolumeHierarchy& getBoundingVolumeHierarchy() const { return bvh_; }
+
 	void updateLights();
 	inline const LightData& getLightData() const { return lightData_; }
 
@@ -145,6 +174,17 @@ private:
 	std::unordered_map<SceneHandle, ISceneObject*> sceneObjects_;
 
 	SceneNode* rootNode_ = nullptr;
+	uint64_t sceneVersion_ = 0;
+
+	TransformHierarchy transforms_;
+	uint64_t transformsSceneVersion_ = UINT64_MAX;
+	// Nodes in the order of the transform hierarchy
+	std::vector<SceneNode*> flatNodes_;
+
+	// Rebuilt after structural changes and refitted when only transforms change
+	BoundingVolumeHierarchy bvh_;
+	std::vector<ScenePrimitive> bvhPrimitives_;
+	std::vector<AABB> bvhBounds_;
 
 	unsigned VAOFullscreenQuad_ = 0;
 	unsigned VBOFullscreenQuad_ = 0;
@@ -201,6 +241,8 @@ private:
 	Resources::ResourceHandle textRenderingShaderHandle_;
 	Resources::ResourceHandle previewScreenShaderHandle_;
 
+	void updateBoundingVolumeHierarchy(const bool structureChanged);
+
 	void initializeDefaultCube();
 	void drawDefaultCube();
 
@@ -0,0 +1,48 @@
+#ifndef TEXTURE_CACHE_HPP
+#define TEXTURE_CACHE_HPP
+
+#include <future>
+#include <string>
+
+#include "ImageDecoder.hpp"
+
+
+namespace Resources {
+
+// On-disk cache of decoded images with their complete mip chains in cache://textures. Entries are keyed by
+// the source URI, the hash of the encoded bytes and the decoding options, so a hit skips both stb_image and
+// mip generation. Every image decoded through it gets a mip chain, whether the cache is enabled or not
+class TextureCache final {
+public:
+    using DecodedImage = Utils::ImageDecoder::DecodedImage;
+
+    TextureCache(const TextureCache& obj) = delete;
+
+    // Decode tasks on workers and prefetches on the context thread may both come first, hence the function-local static
+    static TextureCache* getInstance() {
+        static TextureCache* instance = new TextureCache();
+        return instance;
+    }
+
+    inline void setEnabled(const bool enabled) { enabled_ = enabled; }
+    inline bool isEnabled() const { return enabled_; }
+
+    // isSrgb tells how color channels of 8 bit images are averaged into mips
+    std::future<DecodedImage> decodeFileAsync(const std::string& filename, const bool isHdr, const bool isSrgb);
+    DecodedImage decodeFile(const std::string& filename, const bool isHdr, const bool isSrgb);
+    // uri identifies the encoded bytes in the cache, it is never read
+    DecodedImage decodeMemory(const unsigned char* bytes, const size_t size, const std::string& uri, const int requiredComponents, const bool isSrgb);
+
+private:
+    TextureCache() {};
+
+    bool enabled_ = true;
+
+    std::string getEntryPath(const uint64_t key) const;
+    bool load(const uint64_t key, DecodedImage& image) const;
+    void store(const uint64_t key, const DecodedImage& image) const;
+};
+
+}
+
+#endif
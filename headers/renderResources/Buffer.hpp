@@ -13,7 +13,10 @@ struct Buffer : RenderResource {
 	unsigned int GL_id;
 	unsigned int target;
 
+	size_t bytesize = 0;
+	// Shadow copy of the contents, empty unless kept by the residency policy or keepCpuCopy
 	std::vector<unsigned char> data;
+	bool keepCpuCopy = false;
 
 	Buffer() {};
 };
@@ -15,8 +15,12 @@ struct Image : RenderResource {
 	int components = -1;
 	int bits = -1;
 	int format = -1;
+	// Mip levels stored in image after level 0
+	int levels = 1;
 
+	// Empty once released by ResourceManager::releaseCpuCopies, unless keepCpuCopy is set
 	std::vector<unsigned char> image;
+	bool keepCpuCopy = false;
 
 	Image() {};
 
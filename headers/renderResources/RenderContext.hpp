@@ -0,0 +1,118 @@
+#ifndef RENDER_CONTEXT_HPP
+#define RENDER_CONTEXT_HPP
+
+#include <cstdint>
+
+#include "RenderResource.hpp"
+
+
+namespace Resources {
+
+// Shadow of the GL bindings and fixed-function state. Calls which would not change anything are skipped,
+// so all of them must go through here. Code which touches the state behind its back calls invalidate()
+class RenderContext final {
+public:
+    struct Stats {
+        uint64_t issuedCalls = 0;
+        uint64_t elidedCalls = 0;
+    };
+
+    static constexpr uint32_t MAX_TEXTURE_UNITS = 16;
+
+    RenderContext(const RenderContext& obj) = delete;
+
+    static RenderContext* getInstance() {
+        if (!instancePtr)
+            instancePtr = new RenderContext();
+
+        return instancePtr;
+    }
+
+    inline void useProgram(const GLuint program) { if (update(program_, program)) glUseProgram(program); }
+    inline void bindVertexArray(const GLuint vao) { if (update(vertexArray_, vao)) glBindVertexArray(vao); }
+    inline void bindFramebuffer(const GLuint framebuffer) { if (update(framebuffer_, framebuffer)) glBindFramebuffer(GL_FRAMEBUFFER, framebuffer); }
+
+    inline void activeTexture(const unsigned unit) { if (update(activeUnit_, unit)) glActiveTexture(GL_TEXTURE0 + unit); }
+    // Binds to the active unit, e.g. to upload or to attach the texture
+    void bindTexture(const GLenum target, const GLuint texture);
+    void bindTexture(const unsigned unit, const GLenum target, const GLuint texture);
+    void bindSampler(const unsigned unit, const GLuint sampler);
+
+    void setEnabled(const GLenum capability, const bool enabled);
+    inline void enable(const GLenum capability) { setEnabled(capability, true); }
+    inline void disable(const GLenum capability) { setEnabled(capability, false); }
+
+    inline void cullFace(const GLenum mode) { if (update(cullFace_, mode)) glCullFace(mode); }
+    inline void frontFace(const GLenum mode) { if (update(frontFace_, mode)) glFrontFace(mode); }
+    inline void depthFunc(const GLenum func) { if (update(depthFunc_, func)) glDepthFunc(func); }
+    void blendFunc(const GLenum sfactor, const GLenum dfactor);
+
+    // Forgets everything, the next call of each kind goes to GL
+    void invalidate();
+    // Deleted objects are unbound by GL, their names may come back from the next glGen*
+    void onTextureDeleted(const GLuint texture);
+    void onSamplerDeleted(const GLuint sampler);
+    inline void onProgramDeleted(const GLuint program) { if (program_ == program) program_ = UNKNOWN; }
+    inline void onVertexArrayDeleted(const GLuint vao) { if (vertexArray_ == vao) vertexArray_ = UNKNOWN; }
+    inline void onFramebufferDeleted(const GLuint framebuffer) { if (framebuffer_ == framebuffer) framebuffer_ = UNKNOWN; }
+
+    // Every call is issued while disabled, which gives the baseline to compare against
+    inline void setCachingEnabled(const bool enabled) { cachingEnabled_ = enabled; invalidate(); }
+    inline bool isCachingEnabled() const { return cachingEnabled_; }
+
+    inline const Stats& getStats() const { return stats_; }
+    inline void resetStats() { stats_ = Stats(); }
+
+private:
+    static RenderContext* instancePtr;
+    RenderContext() { invalidate(); };
+
+    static constexpr uint32_t UNKNOWN = UINT32_MAX;
+
+    enum TextureTarget : uint32_t {
+        TARGET_2D = 0,
+        TARGET_CUBE_MAP = 1,
+        TARGET_COUNT = 2
+    };
+
+    enum Capability : uint32_t {
+        CAP_DEPTH_TEST = 0,
+        CAP_CULL_FACE = 1,
+        CAP_BLEND = 2,
+        CAP_COUNT = 3
+    };
+
+    uint32_t program_;
+    uint32_t vertexArray_;
+    uint32_t framebuffer_;
+    uint32_t activeUnit_;
+    uint32_t textures_[MAX_TEXTURE_UNITS][TARGET_COUNT];
+    uint32_t samplers_[MAX_TEXTURE_UNITS];
+    uint32_t capabilities_[CAP_COUNT];
+    uint32_t cullFace_;
+    uint32_t frontFace_;
+    uint32_t depthFunc_;
+    uint32_t blendSrc_;
+    uint32_t blendDst_;
+
+    bool cachingEnabled_ = true;
+    Stats stats_;
+
+    // Returns whether the call has to be issued
+    inline bool update(uint32_t& shadow, const uint32_t value) {
+        if (cachingEnabled_ && shadow == value) {
+            ++stats_.elidedCalls;
+            return false;
+        }
+        shadow = value;
+        ++stats_.issuedCalls;
+        return true;
+    }
+
+    static uint32_t getTargetIndex(const GLenum target);
+    static uint32_t getCapabilityIndex(const GLenum capability);
+};
+
+}
+
+#endif
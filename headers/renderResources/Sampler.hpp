@@ -36,12 +36,15 @@ struct Sampler : RenderResource {
 	uint32_t wrapT = WrapMode::REPEAT;
 	uint32_t wrapR = WrapMode::REPEAT;
 
+	float maxAnisotropy = 1.0f;
+
 	enum DefaultSamplers : uint32_t {
 		DEFAULT_SAMPLER_NEAREST_CLAMP  = 0,
 		DEFAULT_SAMPLER_NEAREST_REPEAT = 1,
 		DEFAULT_SAMPLER_LINEAR_REPEAT  = 2,
 		DEFAULT_SAMPLER_LINEAR_CLAMP   = 3,
 		DEFAULT_SAMPLER_LINEAR_MIPMAP_LINEAR_CLAMP = 4,
+		DEFAULT_SAMPLER_TRILINEAR_ANISOTROPIC_REPEAT = 5,
 
 		COUNT
 	};
@@ -4,48 +4,102 @@
 #include <glm/glm.hpp>
 
 #include <string>
+#include <vector>
 #include <fstream>
 #include <iostream>
+#include <unordered_map>
 
 #include <RenderResource.hpp>
+#include "RenderContext.hpp"
+#include "Hash.hpp"
 
 namespace Resources {
 
+// Uniform name with its hash. Literals are hashed at compile time when the name is a constexpr variable
+struct UniformName {
+    uint64_t hash = 0;
+    const char* str = "";
+
+    template<size_t N>
+    constexpr UniformName(const char (&name)[N]) : hash{ Utils::hashString(name, N - 1) }, str{ name } {}
+    UniformName(const std::string& name) : hash{ Utils::hashString(name.data(), name.size()) }, str{ name.c_str() } {}
+};
+
+struct UniformLocation {
+    GLint value = -1;
+
+    inline bool isValid() const { return value >= 0; }
+};
+
 class Shader : public RenderResource {
 
 private:
     void checkCompileErrors(const GLuint& shader, const std::string& type);
     std::string PreprocessIncludes(const std::string& source, const std::string& filename, int level = 0);
+    static std::string insertDefines(const std::string& source, const std::vector<std::string>& defines);
+
+    // Uniform name hash -> location, arrays are found both with and without their [0] suffix
+    mutable std::unordered_map<uint64_t, GLint> uniformLocations_;
+    std::unordered_map<uint64_t, GLuint> uniformBlocks_;
+
+    void reflect();
+    UniformLocation queryUniformLocation(const UniformName& name) const;
 
 public:
     unsigned GL_id;
 
-    Shader(const char* vertexPath, const char* fragmentPath);
+    Shader(const char* vertexPath, const char* fragmentPath, const std::vector<std::string>& defines = {});
     Shader() {};
     ~Shader() {};
 
-    inline void use() const { glUseProgram(GL_id); }
+    inline void use() const { RenderContext::getInstance()->useProgram(GL_id); }
     inline unsigned getID() const { return GL_id; }
 
-    inline void setBool(const std::string& name, const bool value) const { glUniform1i(glGetUniformLocation(GL_id, name.c_str()), (int)value); }
-    inline void setInt(const std::string& name, const int value) const { glUniform1i(glGetUniformLocation(GL_id, name.c_str()), value); }
-    inline void setUint(const std::string& name, const uint32_t value) const { glUniform1ui(glGetUniformLocation(GL_id, name.c_str()), value); }
-    inline void setFloat(const std::string& name, const float value) const { glUniform1f(glGetUniformLocation(GL_id, name.c_str()), value); }
-    inline void setVec2(const std::string& name, const glm::vec2 value) const { glUniform2fv(glGetUniformLocation(GL_id, name.c_str()), 1, &value[0]); }
-    inline void setVec2(const std::string& name, const float x, const float y) const { glUniform2f(glGetUniformLocation(GL_id, name.c_str()), x, y); }
-    inline void setVec3(const std::string& name, const glm::vec3 value) const { glUniform3fv(glGetUniformLocation(GL_id, name.c_str()), 1, &value[0]); }
-    inline void setVec3(const std::string& name, const float x, const float y, const float z) const { glUniform3f(glGetUniformLocation(GL_id, name.c_str()), x, y, z); }
-    inline void setVec4(const std::string& name, const glm::vec4& value) const { glUniform4fv(glGetUniformLocation(GL_id, name.c_str()), 1, &value[0]); }
-    inline void setVec4(const std::string& name, const float x, const float y, const float z, const float w) const { glUniform4f(glGetUniformLocation(GL_id, name.c_str()), x, y, z, w); }
-    inline void setMat2(const std::string& name, const glm::mat2& mat) const { glUniformMatrix2fv(glGetUniformLocation(GL_id, name.c_str()), 1, GL_FALSE, &mat[0][0]); }
-    inline void setMat3(const std::string& name, const glm::mat3& mat) const { glUniformMatrix3fv(glGetUniformLocation(GL_id, name.c_str()), 1, GL_FALSE, &mat[0][0]); }
-    inline void setMat4(const std::string& name, const glm::mat4& mat) const { glUniformMatrix4fv(glGetUniformLocation(GL_id, name.c_str()), 1, GL_FALSE, &mat[0][0]); }
-    inline void setIntArray(const std::string& name, const int* data, const size_t size) const { glUniform1iv(glGetUniformLocation(GL_id, name.c_str()), size, data); }
-    inline void setUintArray(const std::string& name, const uint32_t* data, const size_t size) const { glUniform1uiv(glGetUniformLocation(GL_id, name.c_str()), size, data); }
-    inline void setFloatArray(const std::string& name, const float* data, const size_t size) const { glUniform1fv(glGetUniformLocation(GL_id, name.c_str()), size, data); }
-    inline void setVec2Array(const std::string& name, const float* data, const size_t size) const { glUniform2fv(glGetUniformLocation(GL_id, name.c_str()), size, data); }
-    inline void setVec3Array(const std::string& name, const float* data, const size_t size) const { glUniform3fv(glGetUniformLocation(GL_id, name.c_str()), size, data); }
-    inline void setVec4Array(const std::string& name, const float* data, const size_t size) const { glUniform4fv(glGetUniformLocation(GL_id, name.c_str()), size, data); }
+    // Locations of active uniforms are reflected at link time, names which are not there are queried once and cached
+    inline UniformLocation getUniformLocation(const UniformName& name) const {
+        auto it = uniformLocations_.find(name.hash);
+        return it != uniformLocations_.end() ? UniformLocation{ it->second } : queryUniformLocation(name);
+    }
+    GLuint getUniformBlockIndex(const UniformName& name) const;
+
+    inline void setBool(const UniformLocation location, const bool value) const { glUniform1i(location.value, (int)value); }
+    inline void setInt(const UniformLocation location, const int value) const { glUniform1i(location.value, value); }
+    inline void setUint(const UniformLocation location, const uint32_t value) const { glUniform1ui(location.value, value); }
+    inline void setFloat(const UniformLocation location, const float value) const { glUniform1f(location.value, value); }
+    inline void setVec2(const UniformLocation location, const glm::vec2 value) const { glUniform2fv(location.value, 1, &value[0]); }
+    inline void setVec2(const UniformLocation location, const float x, const float y) const { glUniform2f(location.value, x, y); }
+    inline void setVec3(const UniformLocation location, const glm::vec3 value) const { glUniform3fv(location.value, 1, &value[0]); }
+    inline void setVec3(const UniformLocation location, const float x, const float y, const float z) const { glUniform3f(location.value, x, y, z); }
+    inline void setVec4(const UniformLocation location, const glm::vec4& value) const { glUniform4fv(location.value, 1, &value[0]); }
+    inline void setVec4(const UniformLocation location, const float x, const float y, const float z, const float w) const { glUniform4f(location.value, x, y, z, w); }
+    inline void setMat2(const UniformLocation location, const glm::mat2& mat) const { glUniformMatrix2fv(location.value, 1, GL_FALSE, &mat[0][0]); }
+    inline void setMat3(const UniformLocation location, const glm::mat3& mat) const { glUniformMatrix3fv(location.value, 1, GL_FALSE, &mat[0][0]); }
+    inline void setMat4(const UniformLocation location, const glm::mat4& mat) const { glUniformMatrix4fv(location.value, 1, GL_FALSE, &mat[0][0]); }
+    inline void setIntArray(const UniformLocation location, const int* data, const size_t size) const { glUniform1iv(location.value, size, data); }
+    inline void setUintArray(const UniformLocation location, const uint32_t* data, const size_t size) const { glUniform1uiv(location.value, size, data); }
+    inline void setFloatArray(const UniformLocation location, const float* data, const size_t size) const { glUniform1fv(location.value, size, data); }
+    inline void setVec2Array(const UniformLocation location, const float* data, const size_t size) const { glUniform2fv(location.value, size, data); }
+    inline void setVec3Array(const UniformLocation location, const float* data, const size_t size) const { glUniform3fv(location.value, size, data); }
+    inline void setVec4Array(const UniformLocation location, const float* data, const size_t size) const { glUniform4fv(location.value, size, data); }
+    inline void setBool(const UniformName& name, const bool value) const { setBool(getUniformLocation(name), value); }
+    inline void setInt(const UniformName& name, const int value) const { setInt(getUniformLocation(name), value); }
+    inline void setUint(const UniformName& name, const uint32_t value) const { setUint(getUniformLocation(name), value); }
+    inline void setFloat(const UniformName& name, const float value) const { setFloat(getUniformLocation(name), value); }
+    inline void setVec2(const UniformName& name, const glm::vec2 value) const { setVec2(getUniformLocation(name), value); }
+    inline void setVec2(const UniformName& name, const float x, const float y) const { setVec2(getUniformLocation(name), x, y); }
+    inline void setVec3(const UniformName& name, const glm::vec3 value) const { setVec3(getUniformLocation(name), value); }
+    inline void setVec3(const UniformName& name, const float x, const float y, const float z) const { setVec3(getUniformLocation(name), x, y, z); }
+    inline void setVec4(const UniformName& name, const glm::vec4& value) const { setVec4(getUniformLocation(name), value); }
+    inline void setVec4(const UniformName& name, const float x, const float y, const float z, const float w) const { setVec4(getUniformLocation(name), x, y, z, w); }
+    inline void setMat2(const UniformName& name, const glm::mat2& mat) const { setMat2(getUniformLocation(name), mat); }
+    inline void setMat3(const UniformName& name, const glm::mat3& mat) const { setMat3(getUniformLocation(name), mat); }
+    inline void setMat4(const UniformName& name, const glm::mat4& mat) const { setMat4(getUniformLocation(name), mat); }
+    inline void setIntArray(const UniformName& name, const int* data, const size_t size) const { setIntArray(getUniformLocation(name), data, size); }
+    inline void setUintArray(const UniformName& name, const uint32_t* data, const size_t size) const { setUintArray(getUniformLocation(name), data, size); }
+    inline void setFloatArray(const UniformName& name, const float* data, const size_t size) const { setFloatArray(getUniformLocation(name), data, size); }
+    inline void setVec2Array(const UniformName& name, const float* data, const size_t size) const { setVec2Array(getUniformLocation(name), data, size); }
+    inline void setVec3Array(const UniformName& name, const float* data, const size_t size) const { setVec3Array(getUniformLocation(name), data, size); }
+    inline void setVec4Array(const UniformName& name, const float* data, const size_t size) const { setVec4Array(getUniformLocation(name), data, size); }
 };
 
 }
@@ -0,0 +1,71 @@
+#ifndef BOUNDING_VOLUME_HIERARCHY_HPP
+#define BOUNDING_VOLUME_HIERARCHY_HPP
+
+#include <vector>
+
+#include "ISceneObject.hpp"
+#include "Camera.hpp"
+
+
+namespace SceneResources {
+
+// Binary tree over a set of boxes, split by the surface area heuristic. Primitives are referenced by their index
+// in the bounds given to build(). Queries test the boxes only, whatever is inside them is up to the caller
+class BoundingVolumeHierarchy final {
+public:
+    struct Node {
+        AABB bounds;
+        // First primitive of a leaf or left child of an inner node, the right child always follows the left one
+        uint32_t leftOrFirst = 0;
+        // Zero for inner nodes
+        uint32_t count = 0;
+
+        inline bool isLeaf() const { return count > 0; }
+    };
+
+    struct RayHit {
+        uint32_t primitive = UINT32_MAX;
+        // Along the ray direction, the direction does not need to be normalized
+        float distance = 0.0f;
+    };
+
+    static constexpr uint32_t MAX_LEAF_SIZE = 4;
+    static constexpr uint32_t BIN_COUNT = 16;
+    // Queries traverse with a fixed size stack, deeper nodes are not split further
+    static constexpr uint32_t MAX_DEPTH = 64;
+
+    void build(const std::vector<AABB>& bounds);
+    // Keeps the topology and recomputes the node bounds, the tree degrades when primitives move far
+    void refit(const std::vector<AABB>& bounds);
+    void clear();
+
+    // Entry distance of the closest box along the ray
+    bool raycastClosest(const glm::vec3& origin, const glm::vec3& direction, const float maxDistance, RayHit& hit) const;
+    // Stops at the first box on the ray
+    bool raycastAny(const glm::vec3& origin, const glm::vec3& direction, const float maxDistance) const;
+    // Appends the primitives whose boxes overlap
+    void queryFrustum(const GeneralApp::Frustum& frustum, std::vector<uint32_t>& result) const;
+    void querySphere(const glm::vec3& center, const float radius, std::vector<uint32_t>& result) const;
+
+    inline bool isEmpty() const { return nodes_.empty(); }
+    inline const std::vector<Node>& getNodes() const { return nodes_; }
+    inline size_t getPrimitiveCount() const { return primitives_.size(); }
+    uint32_t getDepth() const;
+
+private:
+    std::vector<Node> nodes_;
+    // Primitive indices and their bounds in the same order, leaves reference consecutive ranges of them
+    std::vector<uint32_t> primitives_;
+    std::vector<AABB> primitiveBounds_;
+
+    static constexpr uint32_t TRAVERSAL_STACK_SIZE = MAX_DEPTH + 1;
+
+    struct BuildPrimitive;
+    // Returns whether the node was split, its children are the last two nodes then
+    bool subdivide(const uint32_t nodeIdx, const uint32_t depth, std::vector<BuildPrimitive>& buildPrimitives);
+    void appendSubtree(const uint32_t nodeIdx, std::vector<uint32_t>& result) const;
+};
+
+}
+
+#endif
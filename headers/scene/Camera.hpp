@@ -8,6 +8,21 @@
 
 namespace GeneralApp {
 
+// Planes point inwards, a point p is inside when dot(plane.xyz, p) + plane.w >= 0 for all of them
+struct Frustum {
+    enum Plane : uint32_t {
+        PLANE_LEFT = 0,
+        PLANE_RIGHT = 1,
+        PLANE_BOTTOM = 2,
+        PLANE_TOP = 3,
+        PLANE_NEAR = 4,
+        PLANE_FAR = 5,
+        PLANE_COUNT = 6
+    };
+
+    glm::vec4 planes[PLANE_COUNT];
+};
+
 class Camera  { 
 private:
     glm::vec3 Position_;
@@ -31,6 +46,7 @@ private:
     glm::mat4 View_;
     glm::mat4 Proj_;
     glm::mat4 Model_;
+    Frustum Frustum_;
 
 public:
     Camera(const glm::vec3& pos, const glm::vec3& dir, const glm::vec3& u, const glm::vec3& r) :
@@ -72,6 +88,8 @@ public:
     inline glm::mat4 getView() const { return View_; }
     inline glm::mat4 getProj() const { return Proj_; }
     inline glm::mat4 getModel() const { return Model_; }
+    // World space frustum of the matrices from the last updateMatrices()
+    inline const Frustum& getFrustum() const { return Frustum_; }
 
     inline void setDirSpeed(const float new_speed) { DirSpeedFactor_ = new_speed; }
     inline void setRightSpeed(const float new_speed) { RightSpeedFactor_ = new_speed; }
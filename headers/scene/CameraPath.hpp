@@ -0,0 +1,41 @@
+#ifndef CAMERA_PATH_HPP
+#define CAMERA_PATH_HPP
+
+#include <vector>
+
+#include "Camera.hpp"
+
+
+namespace GeneralApp {
+
+class CameraPath {
+public:
+    struct Keyframe {
+        float time;
+        glm::vec3 position;
+        float yaw;
+        float pitch;
+        float fov;
+    };
+
+    CameraPath() {};
+    ~CameraPath() {};
+
+    // Keyframes are expected to be added in increasing time order
+    void addKeyframe(const Keyframe& keyframe);
+    void addKeyframe(const Camera& camera, const float time);
+    inline void clear() { keyframes_.clear(); }
+
+    inline bool empty() const { return keyframes_.empty(); }
+    inline const std::vector<Keyframe>& getKeyframes() const { return keyframes_; }
+    float getDuration() const;
+
+    // Poses the camera at the given time, the path is looped once it is over
+    void apply(Camera& camera, float time) const;
+
+private:
+    std::vector<Keyframe> keyframes_;
+};
+
+}
+#endif
@@ -0,0 +1,37 @@
+#ifndef CULLING_HPP
+#define CULLING_HPP
+
+#include <vector>
+
+#include "ISceneObject.hpp"
+#include "Camera.hpp"
+
+
+namespace SceneResources {
+
+// World space boxes as centers and extents with one array per component, padded to whole SIMD groups
+class BoundsSoA {
+public:
+    static constexpr size_t GROUP_SIZE = 4;
+
+    void resize(const size_t count);
+    // Invalid boxes are never culled
+    void set(const size_t index, const AABB& box);
+
+    inline size_t size() const { return count_; }
+    inline size_t paddedSize() const { return centerX_.size(); }
+
+private:
+    friend void cullBoxes(const GeneralApp::Frustum& frustum, const BoundsSoA& bounds, std::vector<uint8_t>& visible);
+
+    size_t count_ = 0;
+    std::vector<float> centerX_, centerY_, centerZ_;
+    std::vector<float> extentX_, extentY_, extentZ_;
+};
+
+// Visibility of every box, a box is culled only when it is completely behind one of the planes
+void cullBoxes(const GeneralApp::Frustum& frustum, const BoundsSoA& bounds, std::vector<uint8_t>& visible);
+
+}
+
+#endif
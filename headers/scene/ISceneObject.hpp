@@ -4,6 +4,7 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <cfloat>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -15,9 +16,20 @@
 
 namespace SceneResources {
 
+// Empty until something is added to it
 struct AABB {
-	glm::vec3 minCorner;
-	glm::vec3 maxCorner;
+	glm::vec3 minCorner = glm::vec3(FLT_MAX);
+	glm::vec3 maxCorner = glm::vec3(-FLT_MAX);
+
+	inline bool isValid() const { return minCorner.x <= maxCorner.x && minCorner.y <= maxCorner.y && minCorner.z <= maxCorner.z; }
+	inline glm::vec3 getCenter() const { return 0.5f * (minCorner + maxCorner); }
+	inline glm::vec3 getExtent() const { return 0.5f * (maxCorner - minCorner); }
+
+	inline void expand(const glm::vec3& point) { minCorner = glm::min(minCorner, point); maxCorner = glm::max(maxCorner, point); }
+	inline void expand(const AABB& other) { minCorner = glm::min(minCorner, other.minCorner); maxCorner = glm::max(maxCorner, other.maxCorner); }
+
+	// Bounds of the transformed box, not of the transformed contents
+	AABB transformed(const glm::mat4& matrix) const;
 };
 
 struct SceneHandle {
@@ -56,7 +68,8 @@ public:
 	void setScale(glm::vec3 scl) { Scale_ = scl; }
 	void setVisibility(bool vis) { isVisible_ = vis; }
 	bool getVisibility() { return isVisible_; }
-	AABB getAABB() { return boundingBox_; }
+	// Scene nodes keep the world space bounds of their whole subtree here
+	const AABB& getAABB() const { return boundingBox_; }
 	glm::mat4 getLocalModelMatrix() { return modelMatrix_; }
 };
 
@@ -3,6 +3,8 @@
 
 #include "Shader.hpp"
 #include "Texture.hpp"
+#include "ISceneObject.hpp"
+#include "OcclusionCulling.hpp"
 
 #include <vector>
 #include <unordered_map>
@@ -14,6 +16,38 @@
 
 namespace Geometry {
 
+// Packed geometry of a primitive in the geometry arena, indices are relative to baseVertex
+struct PrimitiveRange {
+    static constexpr uint32_t MAX_LODS = 4;
+    // Smaller primitives are drawn at full detail only
+    static constexpr uint32_t MIN_LOD_TRIANGLES = 256;
+    // Largest simplification error relative to the bounding sphere radius
+    static constexpr float MAX_LOD_ERROR_FRACTION = 0.1f;
+
+    // Index range of a level of detail, the error is the object space distance the surface may have moved by
+    struct Lod {
+        uint32_t indexCount = 0;
+        uint32_t firstIndex = 0;
+        float error = 0.0f;
+    };
+
+    GLenum mode = GL_TRIANGLES;
+    // 16 bit wherever the vertices of the primitive allow it once uploaded, firstIndex counts in this type
+    GLenum indexType = GL_UNSIGNED_INT;
+    uint32_t indexCount = 0;
+    uint32_t firstIndex = 0;
+    int32_t baseVertex = 0;
+    uint32_t vertexCount = 0;
+    unsigned vertexArray = 0;
+    // Object space bounds of the positions
+    SceneResources::AABB bounds;
+    // Owned by the model, only large triangle primitives have one
+    const SceneResources::OccluderMesh* occluder = nullptr;
+    // Level 0 is the full index range, the others are simplified versions of it sharing its vertices
+    Lod lods[MAX_LODS];
+    uint32_t lodCount = 0;
+};
+
 
 class Mesh {
 public:
@@ -23,7 +57,24 @@ public:
     ~Mesh() {}
 
     void init();
-    void draw(Resources::Shader& shader);
+
+    // Sampler uniforms are a part of the program state, they only need to be set once per program
+    static void setTextureUnits(Resources::Shader& shader);
+    // Binds the IBL textures of the current environment, they are the same for every primitive of a frame
+    static void bindEnvironment(Resources::Shader& shader);
+
+    // Primitives are drawn one by one by the render queue, which binds their VAO itself
+    inline size_t getPrimitiveCount() const { return primitiveRanges_.size(); }
+    inline const PrimitiveRange& getPrimitiveRange(const size_t primitiveIdx) const { return primitiveRanges_[primitiveIdx]; }
+    // Union of the primitive bounds
+    inline const SceneResources::AABB& getBounds() const { return bounds_; }
+    // Maps the uploaded positions to object space, identity unless the vertices are quantized
+    inline const glm::mat4& getPositionTransform() const { return positionTransform_; }
+    inline unsigned getVertexArray(const size_t primitiveIdx) const { return primitiveRanges_[primitiveIdx].vertexArray; }
+    inline Resources::ResourceHandle getMaterial(const size_t primitiveIdx) const { return primitiveMaterial_[primitiveIdx]; }
+    void bindMaterialTextures(const size_t primitiveIdx) const;
+    void bindMaterial(Resources::Shader& shader, const size_t primitiveIdx) const;
+    void drawPrimitive(const size_t primitiveIdx, const uint32_t lod = 0) const;
 
     std::string name;
 
@@ -31,10 +82,12 @@ private:
     const tinygltf::Model* modelPtr_ = nullptr;
     const tinygltf::Mesh* meshPtr_ = nullptr;
 
-    std::unordered_map<int, unsigned int> VBOs_;
-    std::unordered_map<int, unsigned int> VAOs_;
+    // Indexed by primitive, empty until init() succeeds
+    std::vector<PrimitiveRange> primitiveRanges_;
+    SceneResources::AABB bounds_;
+    glm::mat4 positionTransform_ = glm::mat4(1.0f);
 
-    std::unordered_map<int, Resources::ResourceHandle> primitiveMaterial_; // primitive index, material
+    std::vector<Resources::ResourceHandle> primitiveMaterial_;
 };
 
 }
@@ -0,0 +1,56 @@
+#ifndef MESH_OPTIMIZER_HPP
+#define MESH_OPTIMIZER_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+
+namespace SceneResources {
+
+// Quadric error metric edge collapse over a triangle list, vertices are only removed from the index list so the
+// result still indexes the same vertex buffer. Vertices on attribute seams and borders only slide along them, those
+// on non-manifold edges stay in place. Stops at the target index count or before exceeding the target error, which
+// is in position units. Returns the largest error of the collapses made
+float simplifyMesh(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, const size_t targetIndexCount,
+                   const float targetError, std::vector<uint32_t>& result);
+
+
+// Post-transform vertex cache behaviour of a triangle list on a FIFO cache, the counts of several lists add up
+struct VertexCacheStatistics {
+    // Size of the simulated cache, also the size the triangle order is optimized for
+    static constexpr uint32_t CACHE_SIZE = 16;
+
+    size_t transformedVertices = 0;
+    size_t triangles = 0;
+    size_t vertices = 0;
+
+    // Average cache miss ratio, vertices shaded per triangle. About 0.5 is the best a regular grid can do
+    inline float getAcmr() const { return triangles ? static_cast<float>(transformedVertices) / triangles : 0.0f; }
+    // Average transform to vertex ratio, 1 when every vertex is shaded only once
+    inline float getAtvr() const { return vertices ? static_cast<float>(transformedVertices) / vertices : 0.0f; }
+
+    inline void add(const VertexCacheStatistics& other) {
+        transformedVertices += other.transformedVertices;
+        triangles += other.triangles;
+        vertices += other.vertices;
+    }
+};
+
+VertexCacheStatistics analyzeVertexCache(const std::vector<uint32_t>& indices, const size_t vertexCount, const uint32_t cacheSize = VertexCacheStatistics::CACHE_SIZE);
+
+// Maps every vertex to the first vertex with the same bytes, new indices are dense in the order of first occurrence.
+// Returns the number of unique vertices
+size_t generateVertexRemap(const void* vertices, const size_t vertexCount, const size_t vertexSize, std::vector<uint32_t>& remap);
+
+// Reorders the triangles for the post-transform cache with Tipsify, fanning around recently shaded vertices
+void optimizeVertexCache(std::vector<uint32_t>& indices, const size_t vertexCount, const uint32_t cacheSize = VertexCacheStatistics::CACHE_SIZE);
+
+// Numbers the vertices in the order the indices first use them so that fetches walk the vertex buffer forward.
+// Unreferenced vertices map to UINT32_MAX. Returns the number of referenced vertices
+size_t optimizeVertexFetchRemap(const std::vector<uint32_t>& indices, const size_t vertexCount, std::vector<uint32_t>& remap);
+
+}
+
+#endif
@@ -1,9 +1,14 @@
 #ifndef MODEL_HPP
 #define MODEL_HPP
 
+#include <memory>
+
 #include <tinygltf/tiny_gltf.h>
 
+#include "GeometryArena.hpp"
 #include "ISceneObject.hpp"
+#include "MappedFile.hpp"
+#include "MeshOptimizer.hpp"
 #include "SceneNode.hpp"
 #include "Texture.hpp"
 
@@ -17,20 +22,89 @@ private:
 
 	std::string name_;
 
+	std::vector<int> rootNodesIndices_;
+	bool prepared_ = false;
+	// Set when the packed geometry comes from the mesh cache, prepare() neither packs it again nor simplifies it
+	bool geometryRestored_ = false;
+
+	struct MappedBuffer {
+		const unsigned char* data = nullptr;
+		size_t size = 0;
+	};
+
+	// Buffers read straight from memory mapped files, their tinygltf::Buffer::data only holds a stub
+	std::vector<std::shared_ptr<Utils::MappedFile>> mappedFiles_;
+	std::vector<MappedBuffer> mappedBuffers_;
+
+	// Vertices and indices of all primitives in the GeometryArena::Vertex layout, built by prepare() and freed once uploaded
+	std::vector<Resources::GeometryArena::Vertex> packedVertices_;
+	std::vector<uint32_t> packedIndices_;
+	// By mesh and primitive, offsets are relative to the packed arrays until uploadGeometry() makes them absolute
+	std::vector<std::vector<PrimitiveRange>> primitiveRanges_;
+	// By mesh, dequantization of the uploaded positions
+	std::vector<glm::mat4> positionTransforms_;
+	// Referenced by the primitive ranges, kept for the whole lifetime of the model
+	std::vector<SceneResources::OccluderMesh> occluders_;
+	// Post-transform cache behaviour of the triangle primitives as authored and after optimizePrimitive()
+	SceneResources::VertexCacheStatistics authoredCacheStatistics_;
+	SceneResources::VertexCacheStatistics optimizedCacheStatistics_;
+
+	Resources::GeometryArena::Allocation vertexRange_;
+	Resources::GeometryArena::Allocation indexRange_;
+
+	void packGeometry();
+	void optimizePrimitive(PrimitiveRange& range);
+	void createLods();
+	void createOccluders();
+	void uploadGeometry();
+	void quantizeVertices(std::vector<Resources::GeometryArena::QuantizedVertex>& vertices);
+	void packIndices(std::vector<uint8_t>& indices);
+
 public:
+	// What packGeometry() derives from the glTF buffers, in the layout of the members below
+	struct PackedGeometry {
+		std::vector<Resources::GeometryArena::Vertex> vertices;
+		std::vector<uint32_t> indices;
+		std::vector<std::vector<PrimitiveRange>> primitiveRanges;
+		// Moving the vector keeps the occluder pointers of the ranges valid
+		std::vector<SceneResources::OccluderMesh> occluders;
+		SceneResources::VertexCacheStatistics authoredCacheStatistics;
+		SceneResources::VertexCacheStatistics optimizedCacheStatistics;
+	};
+
 	Model(const std::string& name, const std::string& filename) : name_{ name }, filename_{ filename } {};
 	Model() {};
 	~Model() {};
 
 	inline tinygltf::Model& getModelRef() { return model_; }
+	inline const tinygltf::Model& getModelRef() const { return model_; }
 	inline const std::string& getFilename() const { return filename_; }
 	inline void setFilename(const std::string& filename) { filename_ = filename; }
 	inline const std::string& getName() const { return name_; }
 	inline void setName(const std::string& name) { name_ = name; }
 	inline SceneResources::SceneNode* getModelRootNode() { return rootNode_; }
 
+	void addMappedBuffer(const int bufferIdx, const std::shared_ptr<Utils::MappedFile>& file, const size_t offset, const size_t size);
+	// Use these instead of tinygltf::Buffer::data, which is empty for mapped buffers
+	const unsigned char* getBufferData(const int bufferIdx) const;
+	size_t getBufferSize(const int bufferIdx) const;
+	// Empty range for primitives without positions
+	const PrimitiveRange& getPrimitiveRange(const int meshIdx, const int primitiveIdx) const;
+	const glm::mat4& getPositionTransform(const int meshIdx) const;
+	inline const SceneResources::VertexCacheStatistics& getAuthoredCacheStatistics() const { return authoredCacheStatistics_; }
+	inline const SceneResources::VertexCacheStatistics& getOptimizedCacheStatistics() const { return optimizedCacheStatistics_; }
+	// Packed data of prepare(), offsets of the ranges are relative to the packed arrays until the model is initialized
+	inline const std::vector<Resources::GeometryArena::Vertex>& getPackedVertices() const { return packedVertices_; }
+	inline const std::vector<uint32_t>& getPackedIndices() const { return packedIndices_; }
+	inline const std::vector<std::vector<PrimitiveRange>>& getPrimitiveRanges() const { return primitiveRanges_; }
+	inline const std::vector<SceneResources::OccluderMesh>& getOccluders() const { return occluders_; }
+	// Geometry packed by an earlier run, must be set before prepare()
+	void restorePackedGeometry(PackedGeometry&& geometry);
+
+	// CPU-only part of the initialization, done by GLTFLoader::load on the loading thread
+	void prepare();
+	// Creates scene nodes and GL objects, must run on the context thread
 	void init();
-	void draw(Resources::Shader& shader);
 };
 
 }
@@ -0,0 +1,63 @@
+#ifndef OCCLUSION_CULLING_HPP
+#define OCCLUSION_CULLING_HPP
+
+#include <vector>
+
+#include "ISceneObject.hpp"
+
+
+namespace SceneResources {
+
+// Coarse copy of a primitive for the occlusion buffer, in object space like the primitive itself
+struct OccluderMesh {
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+
+    // Primitives smaller than this part of their model are not worth rasterizing
+    static constexpr float MIN_SIZE_FRACTION = 0.1f;
+    static constexpr uint32_t MAX_TRIANGLES = 1024;
+    // Relative to the squared diagonal of the primitive bounds
+    static constexpr float MIN_TRIANGLE_AREA_FRACTION = 1.0e-4f;
+
+    inline uint32_t getTriangleCount() const { return static_cast<uint32_t>(indices.size() / 3); }
+    inline bool isEmpty() const { return indices.empty(); }
+};
+
+// Keeps the largest triangles of a triangle list. Dropping triangles only makes an occluder weaker, never wrong
+OccluderMesh createOccluderMesh(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, const uint32_t maxTriangles, const float minTriangleArea);
+
+
+// Low resolution depth buffer filled with occluders on the CPU. Every pixel keeps the reciprocal clip w of the nearest
+// occluder, which is linear in screen space, and every tile keeps the farthest of its pixels, so most boxes are
+// rejected or accepted per tile. Pixels are covered when their center is, as with the GL rasterization rules
+class OcclusionBuffer {
+public:
+    static constexpr uint32_t WIDTH = 256;
+    static constexpr uint32_t HEIGHT = 128;
+    static constexpr uint32_t TILE_SIZE = 8;
+    static constexpr uint32_t TILES_X = WIDTH / TILE_SIZE;
+    static constexpr uint32_t TILES_Y = HEIGHT / TILE_SIZE;
+
+    void clear(const glm::mat4& viewProjection);
+    void rasterize(const OccluderMesh& occluder, const glm::mat4& modelMatrix);
+    // Must be called after the last occluder and before the first visibility test
+    void updateHierarchy();
+    // World space box against the occluders, boxes crossing the near plane are always visible
+    bool isVisible(const AABB& box) const;
+
+    inline uint32_t getTriangleCount() const { return triangleCount_; }
+    inline const std::vector<float>& getDepth() const { return depth_; }
+
+private:
+    glm::mat4 viewProjection_ = glm::mat4(1.0f);
+    std::vector<float> depth_;
+    std::vector<float> tileDepth_;
+    std::vector<glm::vec4> clipPositions_;
+    uint32_t triangleCount_ = 0;
+
+    void rasterizeTriangle(const glm::vec4& clip0, const glm::vec4& clip1, const glm::vec4& clip2);
+};
+
+}
+
+#endif
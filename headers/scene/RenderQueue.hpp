@@ -0,0 +1,197 @@
+#ifndef RENDER_QUEUE_HPP
+#define RENDER_QUEUE_HPP
+
+#include <vector>
+
+#include "SceneNode.hpp"
+#include "Shader.hpp"
+#include "Material.hpp"
+#include "Culling.hpp"
+#include "OcclusionCulling.hpp"
+
+
+namespace SceneResources {
+
+// Primitives of the scene graph flattened into draw items. The list is kept between frames and only rebuilt
+// when the scene changes, items are sorted by their state so that consecutive draws share as much as possible.
+// With multi-draw-indirect submission every run of items with the same state becomes a single draw call
+class RenderQueue final {
+public:
+    enum SubmissionMode : uint32_t {
+        DIRECT = 0,
+        MULTI_DRAW_INDIRECT = 1
+    };
+
+    struct DrawItem {
+        // Program, material, VAO and depth from the most to the least significant bits
+        uint64_t sortKey = 0;
+        Resources::Shader* shader = nullptr;
+        const Geometry::Mesh* mesh = nullptr;
+        const SceneNode* node = nullptr;
+        uint32_t primitive = 0;
+        // Index of the node transform in the object data
+        uint32_t objectIndex = 0;
+        Resources::ResourceHandle material;
+        // Index into the material data of indirect draws
+        uint32_t materialIndex = 0;
+        unsigned vertexArray = 0;
+        GLenum mode = GL_TRIANGLES;
+        GLenum indexType = GL_UNSIGNED_INT;
+    };
+
+    struct Stats {
+        // Items drawn and GL draw calls issued for them
+        uint32_t draws = 0;
+        uint32_t drawCalls = 0;
+        // Triangles of the drawn items at their selected level of detail
+        uint32_t triangles = 0;
+        // Items outside of the frustum or hidden, the latter are also counted as occluded
+        uint32_t culled = 0;
+        uint32_t occluded = 0;
+        // Items rasterized into the occlusion buffer
+        uint32_t occluders = 0;
+        uint32_t programChanges = 0;
+        uint32_t materialChanges = 0;
+        uint32_t vertexArrayChanges = 0;
+        uint32_t transformChanges = 0;
+    };
+
+    static constexpr uint32_t PROGRAM_BITS = 8;
+    static constexpr uint32_t MATERIAL_BITS = 20;
+    static constexpr uint32_t VERTEX_ARRAY_BITS = 20;
+    static constexpr uint32_t DEPTH_BITS = 16;
+    // Occluders are rasterized from the largest on screen until this many triangles have been drawn
+    static constexpr uint32_t OCCLUDER_TRIANGLE_BUDGET = 8192;
+    // Coarsest level of detail whose error stays below this many pixels on screen is drawn
+    static constexpr float LOD_PIXEL_ERROR = 1.0f;
+
+    // Every primitive under the root is drawn with the given shader
+    void update(SceneNode& root, Resources::Shader& shader);
+    // Indirect draws are made with their own shader, which reads transforms and materials by gl_DrawID
+    void setSubmissionMode(const SubmissionMode mode, Resources::Shader* indirectShader = nullptr);
+    inline SubmissionMode getSubmissionMode() const { return submissionMode_; }
+
+    inline void setCullingEnabled(const bool enabled) { cullingEnabled_ = enabled; }
+    inline bool isCullingEnabled() const { return cullingEnabled_; }
+    inline void setOcclusionCullingEnabled(const bool enabled) { occlusionCullingEnabled_ = enabled; }
+    inline bool isOcclusionCullingEnabled() const { return occlusionCullingEnabled_; }
+    inline void setLodEnabled(const bool enabled) { lodEnabled_ = enabled; }
+    inline bool isLodEnabled() const { return lodEnabled_; }
+    static bool isMultiDrawIndirectSupported();
+    // GLES 3.1 and 3.2 allow zero storage blocks in vertex shaders, the model shader needs OBJECT_UNIFORMS then
+    static bool isVertexStorageSupported();
+    // Only the depth bits follow the camera, sorting is skipped while it stands still
+    void sort(const glm::vec3& cameraPosition);
+    // Items whose world space bounds are outside of the frustum are skipped by the next draw()
+    void cull(const GeneralApp::Frustum& frustum);
+    // Items left by cull() which are hidden behind the occluders in front of the camera are skipped as well
+    void cullOccluded(const glm::mat4& viewProjection, const glm::vec3& cameraPosition);
+    // Picks the level of detail of every item from the size of its bounding sphere on a viewport of the given height
+    void selectLods(const GeneralApp::Camera& camera, const float viewportHeight);
+    void draw();
+    // Releases the indirect buffers as well, must be called on the context thread
+    void clear();
+
+    inline const std::vector<DrawItem>& getItems() const { return items_; }
+    inline const Stats& getStats() const { return stats_; }
+    inline const OcclusionBuffer& getOcclusionBuffer() const { return occlusionBuffer_; }
+
+private:
+    // Layouts of ObjectData.h, DrawData.h and of the GL indirect command. Columns of a std430 mat3 are padded to vec4
+    struct ObjectData {
+        glm::mat4 model;
+        glm::mat3x4 normalMatrix;
+    };
+
+    struct DrawData {
+        uint32_t objectIndex;
+        uint32_t materialIndex;
+    };
+
+    struct MaterialData {
+        glm::vec4 texturesFactors[Resources::Material::TextureIdx::IDX_COUNT];
+        uint32_t flags;
+        uint32_t pad[3];
+    };
+
+    struct DrawElementsIndirectCommand {
+        uint32_t count;
+        uint32_t instanceCount;
+        uint32_t firstIndex;
+        int32_t baseVertex;
+        uint32_t baseInstance;
+    };
+
+    // Consecutive items which are drawn by one glMultiDrawElementsIndirect
+    struct Batch {
+        uint32_t firstItem = 0;
+        uint32_t itemCount = 0;
+    };
+
+    std::vector<DrawItem> items_;
+    Stats stats_;
+
+    SubmissionMode submissionMode_ = DIRECT;
+    Resources::Shader* indirectShader_ = nullptr;
+
+    // Nodes referenced by the items, their transforms are uploaded once per frame for both submission modes
+    std::vector<const SceneNode*> objectNodes_;
+    std::vector<ObjectData> objectData_;
+    // Object data is only written again when the items or the transforms have changed
+    uint64_t uploadedTransformsVersion_ = UINT64_MAX;
+
+    std::vector<Batch> batches_;
+    // Culled items keep their command with no instances, so gl_DrawID still indexes the draw data
+    std::vector<DrawElementsIndirectCommand> commands_;
+    std::vector<DrawData> drawData_;
+    std::vector<MaterialData> materialData_;
+    // Commands follow the item order, they are rebuilt after sorting
+    bool commandsDirty_ = true;
+
+    unsigned objectBuffer_ = 0;
+    unsigned commandBuffer_ = 0;
+    unsigned drawDataBuffer_ = 0;
+    unsigned materialBuffer_ = 0;
+    size_t objectBufferSize_ = 0;
+    size_t commandBufferSize_ = 0;
+    size_t drawDataBufferSize_ = 0;
+    size_t materialBufferSize_ = 0;
+
+    Resources::Shader* builtShader_ = nullptr;
+    uint64_t builtSceneVersion_ = UINT64_MAX;
+
+    glm::vec3 sortedCameraPosition_ = glm::vec3(0.0f);
+    bool isSorted_ = false;
+
+    // World space bounds in the item order, recomputed when the order or the transforms change
+    BoundsSoA bounds_;
+    std::vector<AABB> worldBounds_;
+    std::vector<uint8_t> visible_;
+    uint64_t boundsTransformsVersion_ = UINT64_MAX;
+    bool boundsDirty_ = true;
+    bool cullingEnabled_ = true;
+
+    OcclusionBuffer occlusionBuffer_;
+    // Screen size estimate and item index of the visible items with an occluder
+    std::vector<std::pair<float, uint32_t>> occluderCandidates_;
+    bool occlusionCullingEnabled_ = true;
+    uint32_t occludedCount_ = 0;
+    uint32_t occluderCount_ = 0;
+
+    // Level of detail of every item, all items are drawn at full detail until selectLods() follows the item order
+    std::vector<uint8_t> lods_;
+    bool lodsValid_ = false;
+    bool lodEnabled_ = true;
+
+    void build(SceneNode& root, Resources::Shader& shader);
+    void collectItems(const SceneNode& node, Resources::Shader& shader);
+    void updateObjects();
+    void updateBounds();
+    void drawDirect();
+    void drawIndirect();
+    void buildCommands();
+};
+
+}
+
+#endif
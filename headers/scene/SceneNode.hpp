@@ -2,17 +2,20 @@
 #define SCENENODE_HPP
 
 #include "ISceneObject.hpp"
+#include "TransformHierarchy.hpp"
 #include "Mesh.hpp"
 
 namespace SceneResources {
 
 class SceneNode : public ISceneObject {
+	friend class SceneManager;
 
 private:
 	Geometry::Mesh mesh_;
 	bool isEnabled_ = true;
 
-	glm::mat4 globalMatrix_ = glm::mat4(1.0f);
+	// Slot in the transform hierarchy of the scene manager, assigned once the node is reachable from the root
+	uint32_t transformIndex_ = TransformHierarchy::INVALID_INDEX;
 
 public:
 	std::string name;
@@ -22,14 +25,23 @@ public:
 	bool isLeaf() { return children.empty(); }
 	bool isRoot() { return !parent; }
 
-	void setEnabled(bool value = true) { isEnabled_ = value; }
+	// Both change the structure of the scene, render queues are rebuilt after them
+	void setEnabled(bool value = true);
 	void setParent(SceneNode* par);
+	bool isEnabled() const { return isEnabled_; }
+
+	const Geometry::Mesh& getMesh() const { return mesh_; }
 
 	void init(const tinygltf::Model& model, const tinygltf::Node& node);
-	void draw(Resources::Shader& shader);
 
-	void calculateGlobalModelMatrix();
-	glm::mat4 getGlobalModelMatrix() { return globalMatrix_; };
+	// Hide the ones of ISceneObject to mark the transform dirty
+	void setPosition(glm::vec3 pos);
+	void setRotation(glm::quat rot);
+	void setScale(glm::vec3 scl);
+
+	// Valid after SceneManager::updateTransforms()
+	const glm::mat4& getGlobalModelMatrix() const;
+	inline uint32_t getTransformIndex() const { return transformIndex_; }
 
 	void printNode(const int level = 0);
 };
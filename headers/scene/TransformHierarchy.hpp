@@ -0,0 +1,66 @@
+#ifndef TRANSFORM_HIERARCHY_HPP
+#define TRANSFORM_HIERARCHY_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+
+namespace SceneResources {
+
+// Local and world transforms of a node tree flattened into arrays, every parent comes before its children.
+// Changed nodes are marked dirty and update() recomputes only them and their subtrees in one forward pass
+class TransformHierarchy final {
+public:
+    static constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+
+    void clear();
+    void reserve(const size_t count);
+    // The parent must have been added before, INVALID_INDEX makes a root
+    uint32_t add(const uint32_t parent, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+
+    void setPosition(const uint32_t index, const glm::vec3& position);
+    void setRotation(const uint32_t index, const glm::quat& rotation);
+    void setScale(const uint32_t index, const glm::vec3& scale);
+
+    // Returns whether any world matrix has changed
+    bool update();
+
+    inline size_t size() const { return parents_.size(); }
+    inline uint32_t getParent(const uint32_t index) const { return parents_[index]; }
+    // Identity for INVALID_INDEX
+    const glm::mat4& getWorldMatrix(const uint32_t index) const;
+    inline const glm::mat4& getLocalMatrix(const uint32_t index) const { return localMatrices_[index]; }
+
+    // Changes with every update() which has moved something
+    inline uint64_t getVersion() const { return version_; }
+    // Nodes recomputed by the last update()
+    inline uint32_t getUpdatedCount() const { return updatedCount_; }
+
+private:
+    enum Flags : uint8_t {
+        LOCAL_DIRTY = 1 << 0,
+        WORLD_CHANGED = 1 << 1
+    };
+
+    std::vector<uint32_t> parents_;
+    std::vector<glm::vec3> positions_;
+    std::vector<glm::quat> rotations_;
+    std::vector<glm::vec3> scales_;
+    std::vector<glm::mat4> localMatrices_;
+    std::vector<glm::mat4> worldMatrices_;
+    std::vector<uint8_t> flags_;
+
+    // Nodes before the first dirty one cannot change, the pass starts here
+    uint32_t firstDirty_ = INVALID_INDEX;
+    uint64_t version_ = 0;
+    uint32_t updatedCount_ = 0;
+
+    void markDirty(const uint32_t index);
+};
+
+}
+
+#endif
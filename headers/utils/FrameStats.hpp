@@ -0,0 +1,42 @@
+#ifndef FRAME_STATS_HPP
+#define FRAME_STATS_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+
+namespace Utils {
+
+// Collects per-frame samples (milliseconds, counters, ...) grouped in named series
+class FrameStats {
+public:
+    struct Summary {
+        size_t count = 0;
+        double mean = 0.0;
+        double p50 = 0.0;
+        double p95 = 0.0;
+        double p99 = 0.0;
+        double max = 0.0;
+    };
+
+    void addSample(const std::string& series, const double value);
+    void clear() { series_.clear(); }
+
+    bool hasSeries(const std::string& series) const;
+    std::vector<std::string> getSeriesNames() const;
+    const std::vector<double>& getSamples(const std::string& series) const;
+    Summary getSummary(const std::string& series) const;
+
+    // { "<series>": { "count", "mean", "p50", "p95", "p99", "max", ["samples"] }, ... }
+    nlohmann::json toJson(const bool withSamples = false) const;
+
+private:
+    std::map<std::string, std::vector<double>> series_;
+};
+
+}
+
+#endif
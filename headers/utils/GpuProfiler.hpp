@@ -0,0 +1,125 @@
+#ifndef GPU_PROFILER_HPP
+#define GPU_PROFILER_HPP
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <utility>
+#include <vector>
+
+#ifdef __ANDROID__
+#include <EGL/egl.h>
+#include <GLES3/gl32.h>
+#include <GLES3/gl3ext.h>
+#else
+#include <glad/glad.h>
+#endif
+
+
+namespace Utils {
+
+// Times GPU passes with GL_TIMESTAMP queries. Every frame owns a set of queries in a ring of FRAME_LATENCY
+// frames, which are read back only once they are available, so the CPU never waits for the GPU
+class GpuProfiler final {
+public:
+    static constexpr unsigned FRAME_LATENCY = 4;
+    static constexpr unsigned MAX_RESOLVED_FRAMES = 64;
+
+    struct FrameResult {
+        uint64_t frameIndex = 0;
+        double frameMs = 0.0;
+        // Milliseconds of every pass summed over the frame, in order of the first appearance
+        std::vector<std::pair<const char*, double>> passMs;
+    };
+
+    GpuProfiler(const GpuProfiler& obj) = delete;
+
+    static GpuProfiler* getInstance() {
+        if (!instancePtr)
+            instancePtr = new GpuProfiler();
+
+        return instancePtr;
+    }
+
+    // Timer queries are not a part of GLES 3.2 core, the profiler stays disabled on Android
+    void setEnabled(const bool enabled);
+    inline bool isEnabled() const { return enabled_; }
+
+    void beginFrame();
+    void endFrame();
+
+    void beginScope(const char* name);
+    void endScope();
+
+    // Index the next beginFrame() will assign
+    inline uint64_t getNextFrameIndex() const { return frameIndex_; }
+    inline uint64_t getDroppedFrames() const { return droppedFrames_; }
+
+    // Pops the oldest read back frame, only MAX_RESOLVED_FRAMES last frames are kept
+    bool popFrameResult(FrameResult& result);
+
+    // Waits for every frame in flight, meant for the end of a run
+    void flush();
+    // Must be called while the context is still alive
+    void release();
+
+private:
+    struct Scope {
+        const char* name;       // Must outlive the profiler, string literals are expected
+        uint32_t beginQuery;
+        uint32_t endQuery;
+    };
+
+    struct FrameSlot {
+        std::vector<GLuint> queries;
+        uint32_t usedQueries = 0;
+        std::vector<Scope> scopes;
+        uint64_t frameIndex = 0;
+        bool pending = false;
+    };
+
+    static GpuProfiler* instancePtr;
+    GpuProfiler() = default;
+
+    bool enabled_ = false;
+    bool frameOpen_ = false;
+    uint64_t frameIndex_ = 0;
+    uint64_t droppedFrames_ = 0;
+
+    std::array<FrameSlot, FRAME_LATENCY> slots_;
+    std::vector<uint32_t> scopeStack_;
+    std::deque<FrameResult> resolved_;
+
+    // GPU timestamps are shifted by this to land on the CPU trace timeline
+    bool calibrated_ = false;
+    double gpuToCpuOffsetUs_ = 0.0;
+    bool hasGpuTrack_ = false;
+    uint32_t gpuTrack_ = 0;
+
+    uint32_t writeTimestamp(FrameSlot& slot);
+    void resolvePending(const bool wait);
+    bool resolveSlot(FrameSlot& slot, const bool wait);
+};
+
+
+class GpuScopedTimer final {
+public:
+    explicit GpuScopedTimer(const char* name) { GpuProfiler::getInstance()->beginScope(name); }
+    ~GpuScopedTimer() { GpuProfiler::getInstance()->endScope(); }
+
+    GpuScopedTimer(const GpuScopedTimer&) = delete;
+    GpuScopedTimer& operator=(const GpuScopedTimer&) = delete;
+};
+
+}
+
+
+#ifdef ENABLE_PROFILING
+#define PROFILE_GPU_CONCAT_IMPL(a, b) a##b
+#define PROFILE_GPU_CONCAT(a, b) PROFILE_GPU_CONCAT_IMPL(a, b)
+#define PROFILE_GPU_SCOPE(name) Utils::GpuScopedTimer PROFILE_GPU_CONCAT(profileGpuScope_, __LINE__)(name)
+#else
+#define PROFILE_GPU_SCOPE(name)
+#endif
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef HASH_HPP
+#define HASH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+
+namespace Utils {
+
+inline uint64_t mixHash(uint64_t value) {
+    // splitmix64 finalizer
+    value ^= value >> 30;
+    value *= 0xBF58476D1CE4E5B9ull;
+    value ^= value >> 27;
+    value *= 0x94D049BB133111EBull;
+    value ^= value >> 31;
+    return value;
+}
+
+
+// Content hash for files, consumes 8 bytes per step so hashing a model is much cheaper than parsing it
+inline uint64_t hashBytes(const void* data, const size_t size, const uint64_t seed = 0) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t hash = mixHash(seed ^ (size * 0x9E3779B97F4A7C15ull));
+
+    size_t offset = 0;
+    for (; offset + sizeof(uint64_t) <= size; offset += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, bytes + offset, sizeof(word));
+        hash = (hash ^ (word * 0x9E3779B97F4A7C15ull)) * 0xFF51AFD7ED558CCDull;
+        hash ^= hash >> 29;
+    }
+
+    if (offset < size) {
+        uint64_t tail = 0;
+        std::memcpy(&tail, bytes + offset, size - offset);
+        hash = (hash ^ (tail * 0x9E3779B97F4A7C15ull)) * 0xFF51AFD7ED558CCDull;
+    }
+
+    return mixHash(hash);
+}
+
+
+inline uint64_t combineHash(const uint64_t hash, const uint64_t value) {
+    return mixHash(hash ^ (value + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2)));
+}
+
+
+// FNV-1a of short strings such as identifiers, usable in constant expressions
+constexpr uint64_t hashString(const char* str, const size_t length) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= static_cast<unsigned char>(str[i]);
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+}
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef IMAGE_DECODER_HPP
+#define IMAGE_DECODER_HPP
+
+#include <string>
+#include <vector>
+
+
+namespace Utils {
+
+// Decodes images with stb_image, safe to call from several worker threads at once
+class ImageDecoder final {
+public:
+    struct DecodedImage {
+        std::vector<unsigned char> pixels;
+        int width = 0;
+        int height = 0;
+        int components = 0;
+        int bits = 8;
+        // Levels stored in pixels, see MipChain.hpp
+        int levels = 1;
+
+        inline bool isValid() const { return !pixels.empty(); }
+    };
+
+    ImageDecoder(const ImageDecoder& obj) = delete;
+
+    // The first call usually comes from a loading task, a function-local static is initialized exactly once
+    static ImageDecoder* getInstance() {
+        static ImageDecoder* instance = new ImageDecoder();
+        return instance;
+    }
+
+    DecodedImage decodeFile(const std::string& filename, const bool isHdr) const;
+    // requiredComponents of 0 keeps the channels stored in the image
+    DecodedImage decodeMemory(const unsigned char* bytes, const size_t size, const int requiredComponents) const;
+
+private:
+    ImageDecoder();
+};
+
+}
+
+#endif
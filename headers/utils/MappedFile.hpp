@@ -0,0 +1,40 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <string>
+
+
+namespace Utils {
+
+// Read-only memory mapping of a whole file. Pages are loaded lazily and are backed by the file itself,
+// so mapped data does not count towards the heap and can be dropped by the OS under pressure
+class MappedFile final {
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string& filename) { open(filename); }
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& filename);
+    void close();
+
+    inline bool isOpen() const { return data_ != nullptr; }
+    inline const unsigned char* data() const { return data_; }
+    inline size_t size() const { return size_; }
+
+private:
+    const unsigned char* data_ = nullptr;
+    size_t size_ = 0;
+
+#ifdef _WIN32
+    void* fileHandle_ = nullptr;
+    void* mappingHandle_ = nullptr;
+#endif
+};
+
+}
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef MIP_CHAIN_HPP
+#define MIP_CHAIN_HPP
+
+#include <cstddef>
+
+#include "ImageDecoder.hpp"
+
+
+namespace Utils {
+
+// Mip chains are stored tightly packed after level 0 in the same pixel array, level i is max(1, size >> i)
+int getMipLevelCount(const int width, const int height);
+size_t getMipLevelSize(const int width, const int height, const int pixelSize, const int level);
+size_t getMipLevelOffset(const int width, const int height, const int pixelSize, const int level);
+size_t getMipChainSize(const int width, const int height, const int pixelSize, const int levels);
+
+// Appends the complete mip chain to a single level image. Color channels of sRGB images are averaged in linear space
+void generateMipChain(ImageDecoder::DecodedImage& image, const bool isSrgb);
+
+}
+
+#endif
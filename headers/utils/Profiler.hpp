@@ -0,0 +1,100 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+namespace Utils {
+
+// Collects timed events and exports them as Chrome trace JSON (chrome://tracing, Perfetto)
+class Profiler final {
+public:
+    struct Event {
+        const char* name;       // Must outlive the profiler, string literals are expected
+        const char* category;
+        double startUs;
+        double durationUs;
+        uint32_t threadId;
+    };
+
+    Profiler(const Profiler& obj) = delete;
+
+    static Profiler* getInstance() {
+        if (!instancePtr)
+            instancePtr = new Profiler();
+
+        return instancePtr;
+    }
+
+    inline void setEnabled(const bool enabled) { enabled_.store(enabled, std::memory_order_relaxed); }
+    inline bool isEnabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    // Microseconds since the profiler was created
+    inline double nowUs() const { return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - epoch_).count(); }
+
+    void addEvent(const char* name, const double startUs, const double durationUs, const char* category = "cpu");
+    void addEvent(const char* name, const double startUs, const double durationUs, const char* category, const uint32_t threadId);
+
+    // Small sequential id of the calling thread, the main thread is 0 if it is the first to ask
+    uint32_t getCurrentThreadId();
+    // Names the calling thread (or a virtual track like "GPU") in the trace
+    void setThreadName(const uint32_t threadId, const std::string& name);
+    uint32_t registerTrack(const std::string& name);
+
+    bool writeChromeTrace(const std::string& filename) const;
+    void clear();
+
+private:
+    static Profiler* instancePtr;
+    Profiler();
+
+    std::chrono::steady_clock::time_point epoch_;
+    std::atomic<bool> enabled_ = false;
+    std::atomic<uint32_t> nextThreadId_ = 0;
+
+    mutable std::mutex mutex_;
+    std::vector<Event> events_;
+    std::unordered_map<uint32_t, std::string> threadNames_;
+};
+
+
+class ScopedTimer final {
+public:
+    explicit ScopedTimer(const char* name) : name_{ name } {
+        auto profiler = Profiler::getInstance();
+        startUs_ = profiler->isEnabled() ? profiler->nowUs() : -1.0;
+    }
+
+    ~ScopedTimer() {
+        if (startUs_ >= 0.0) {
+            auto profiler = Profiler::getInstance();
+            profiler->addEvent(name_, startUs_, profiler->nowUs() - startUs_);
+        }
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    const char* name_;
+    double startUs_;
+};
+
+}
+
+
+#ifdef ENABLE_PROFILING
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+#define PROFILE_SCOPE(name) Utils::ScopedTimer PROFILE_CONCAT(profileScope_, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name)
+#endif
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+
+namespace Utils {
+
+// Fixed set of worker threads for CPU-side loading work. Tasks must not touch GL, the context lives on the main thread
+class ThreadPool final {
+public:
+    ThreadPool(const ThreadPool& obj) = delete;
+
+    static ThreadPool* getInstance() {
+        if (!instancePtr)
+            instancePtr = new ThreadPool();
+
+        return instancePtr;
+    }
+
+    template<typename F>
+    auto submit(F&& task) -> std::future<std::invoke_result_t<std::decay_t<F>>> {
+        using Result = std::invoke_result_t<std::decay_t<F>>;
+
+        auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+        std::future<Result> result = packaged->get_future();
+        bool queued = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!stop_) {
+                tasks_.emplace_back([packaged]() { (*packaged)(); });
+                queued = true;
+            }
+        }
+
+        // Nobody would pick the task up after shutdown, it runs on the calling thread instead
+        if (queued) {
+            condition_.notify_one();
+        }
+        else {
+            (*packaged)();
+        }
+
+        return result;
+    }
+
+    // Runs queued tasks while the result is not ready, so tasks can wait for the tasks they submit without a deadlock
+    template<typename T>
+    T wait(std::future<T>& result) {
+        while (result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            if (!runPendingTask()) {
+                // Everything queued is already running, running tasks may still submit more
+                result.wait_for(std::chrono::milliseconds(1));
+            }
+        }
+        return result.get();
+    }
+
+    bool runPendingTask();
+    // Workers finish the queued tasks and are joined, later tasks run on the thread which submits them
+    void shutdown();
+
+    inline size_t getWorkersCount() const { return workers_.size(); }
+
+private:
+    static ThreadPool* instancePtr;
+    ThreadPool();
+    ~ThreadPool() { shutdown(); }
+
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    bool stop_ = false;
+
+    void workerLoop(const size_t workerIdx);
+};
+
+}
+
+#endif
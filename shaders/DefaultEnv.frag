@@ -13,7 +13,6 @@ uniform sampler2D uSamplerEquirect;
 layout (std140) uniform Matrices {
     mat4 view;
     mat4 proj;
-    mat4 model;
 };
 
 uniform uint uEnvironmentType;
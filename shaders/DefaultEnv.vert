@@ -11,7 +11,6 @@ layout(location = 0) out vec3 outUv;
 layout (std140) uniform Matrices {
     mat4 view;
     mat4 proj;
-    mat4 model;
 };
 
 uniform uint uEnvironmentType;
@@ -0,0 +1,30 @@
+#ifndef DRAW_DATA_H
+#define DRAW_DATA_H
+
+#include "Constants.h"
+
+// Filled by the render queue for multi-draw-indirect submission, one element per draw command
+struct DrawData {
+    uint objectIndex;
+    uint materialIndex;
+};
+
+struct MaterialData {
+    vec4 texturesFactors[TEXTURE_INDEX_COUNT];
+    uint flags;
+    uint pad0;
+    uint pad1;
+    uint pad2;
+};
+
+layout(std430, binding = 3) readonly buffer SSBO_Draws
+{
+    DrawData draws[];
+};
+
+layout(std430, binding = 4) readonly buffer SSBO_Materials
+{
+    MaterialData materials[];
+};
+
+#endif
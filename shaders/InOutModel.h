@@ -4,7 +4,19 @@
 #include "Constants.h"
 
 uniform sampler2D uMaterialTextures[TEXTURE_INDEX_COUNT];
+
+#ifdef MULTI_DRAW_INDIRECT
+#include "DrawData.h"
+
+layout(location = 3) flat in uint inMaterialIndex;
+
+// Every draw of an indirect call reads its factors and flags from the material data
+#define uMaterialTexturesFactors materials[inMaterialIndex].texturesFactors
+#define uMaterialFlags materials[inMaterialIndex].flags
+#else
 uniform vec4 uMaterialTexturesFactors[TEXTURE_INDEX_COUNT];
+uniform uint uMaterialFlags;
+#endif
 
 uniform samplerCube uIrradianceMap;
 uniform samplerCube uPrefilterMap;
@@ -17,7 +29,6 @@ layout(location = 2) in vec2 inUv;
 layout(std140) uniform Matrices {
     mat4 view;
     mat4 proj;
-    mat4 model;
 };
 
 
@@ -28,7 +39,6 @@ layout(std430, binding = 1) buffer SSBO_Lights
 
 
 uniform vec3 uCameraWorldPos;
-uniform uint uMaterialFlags;
 uniform uint uEnvironmentType;
 
 out vec4 outColor;
@@ -0,0 +1,10 @@
+#include "GLSLversion.h"
+
+#define MULTI_DRAW_INDIRECT
+#include "InOutModel.h"
+#include "PbrFunctions.h"
+
+
+void main() {
+    outColor = pbrBasic();
+}
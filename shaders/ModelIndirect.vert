@@ -0,0 +1,30 @@
+#include "GLSLversion.h"
+#include "ObjectData.h"
+#include "DrawData.h"
+#include "VertexInput.h"
+
+layout (std140) uniform Matrices {
+    mat4 view;
+    mat4 proj;
+};
+
+// Draw data index of the first command of the current indirect draw
+uniform uint uDrawOffset;
+
+layout(location = 0) out vec3 outNormal;
+layout(location = 1) out vec3 outPosition;
+layout(location = 2) out vec2 outTexCoord;
+layout(location = 3) flat out uint outMaterialIndex;
+
+
+void main() {
+	DrawData draw = draws[uDrawOffset + uint(gl_DrawID)];
+	ObjectData object = objects[draw.objectIndex];
+	mat4 MVP = proj * view * object.model;
+
+	gl_Position = MVP * vec4(inVertex, 1);
+	outNormal = normalize(object.normalMatrix * getVertexNormal());
+	outPosition = (object.model * vec4(inVertex, 1.0f)).xyz;
+	outTexCoord = inTexCoord;
+	outMaterialIndex = draw.materialIndex;
+}
@@ -0,0 +1,20 @@
+#ifndef OBJECT_DATA_H
+#define OBJECT_DATA_H
+
+// Written by the render queue once per frame, one element per scene node with a mesh
+struct ObjectData {
+    // Includes the dequantization of the mesh positions with quantized vertices
+    mat4 model;
+    // Inverse transpose of the upper 3x3 of the model matrix, computed on the CPU
+    mat3 normalMatrix;
+};
+
+// Model.vert is built with OBJECT_UNIFORMS where vertex shaders have no storage blocks
+#ifndef OBJECT_UNIFORMS
+layout(std430, binding = 2) readonly buffer SSBO_Objects
+{
+    ObjectData objects[];
+};
+#endif
+
+#endif
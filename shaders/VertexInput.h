@@ -0,0 +1,29 @@
+#ifndef VERTEX_INPUT_H
+#define VERTEX_INPUT_H
+
+// Attributes of GeometryArena::Vertex, or of GeometryArena::QuantizedVertex when QUANTIZED_VERTICES is defined.
+// Quantized positions are dequantized by the model matrix of the object, half float texture coordinates by the fetch
+#ifdef QUANTIZED_VERTICES
+layout(location = 0) in vec3 inVertex;
+layout(location = 1) in vec2 inOctNormal;
+layout(location = 2) in vec2 inTexCoord;
+
+vec3 decodeOctahedral(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    // The lower hemisphere is folded over the diagonals
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return n;
+}
+
+#define getVertexNormal() decodeOctahedral(inOctNormal)
+#else
+layout(location = 0) in vec3 inVertex;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec2 inTexCoord;
+
+#define getVertexNormal() inNormal
+#endif
+
+#endif
@@ -1,7 +1,12 @@
 #include "PotentialApp.hpp"
+#include "Profiler.hpp"
+#include "GpuProfiler.hpp"
+#include "Logger.hpp"
 
+#include <cstring>
 
-int main() {
+
+int main(int argc, char** argv) {
     
     PotentialApp app;
     GeneralApp::WindowCreateInfo wci;
@@ -9,9 +14,37 @@ int main() {
     wci.winHeight = 900;
     wci.name = "OpenGL";
 
+    std::string tracePath = "";
+
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--headless")) {
+            wci.headless = true;
+        }
+        else if (!strcmp(argv[i], "--frames") && i + 1 < argc) {
+            wci.maxFrames = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (!strcmp(argv[i], "--trace") && i + 1 < argc) {
+            tracePath = argv[++i];
+        }
+    }
+
+    auto profiler = Utils::Profiler::getInstance();
+    if (!tracePath.empty()) {
+#ifndef ENABLE_PROFILING
+        LOG_W("Built without ENABLE_PROFILING, the trace will be empty");
+#endif
+        profiler->setThreadName(profiler->getCurrentThreadId(), "Main");
+        profiler->setEnabled(true);
+        Utils::GpuProfiler::getInstance()->setEnabled(true);
+    }
+
     app.createWindow(wci);
     app.renderToWindow();
     app.terminateWindow();
 
+    if (!tracePath.empty()) {
+        profiler->writeChromeTrace(tracePath);
+    }
+
     return 0;
-}
\ No newline at end of file
+}
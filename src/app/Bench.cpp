@@ -0,0 +1,152 @@
+#include "BenchApp.hpp"
+#include "Logger.hpp"
+#include "Profiler.hpp"
+
+#include <cstring>
+
+
+static void printUsage() {
+    printf("Usage: bench [options]\n"
+           "  --scene <name>       Scene config from configs/scenes: DamagedHelmet, Sponza, ABeautifulGame, ToyCar\n"
+           "  --config <path>      Explicit scene config, e.g. configs://scenes/Sponza.json\n"
+           "  --frames <N>         Measured frames (default 300)\n"
+           "  --warmup <N>         Frames rendered before measuring (default 30)\n"
+           "  --timestep <sec>     Fixed camera path timestep (default 1/60)\n"
+           "  --model-copies <N>   Load every model of the scene N times, the copies share their resources (default 1)\n"
+           "  --width <px>         Framebuffer width (default 1280)\n"
+           "  --height <px>        Framebuffer height (default 720)\n"
+           "  --output <file>      Results JSON (default bench_output.json)\n"
+           "  --capture <file>     Save the last frame as PNG\n"
+           "  --keep-cpu-copies    Keep CPU copies of uploaded images and buffers\n"
+           "  --no-state-cache     Issue every GL bind and state change, even redundant ones\n"
+           "  --direct-submission  Draw primitives one by one instead of with multi-draw-indirect\n"
+           "  --no-culling         Draw every primitive, also those outside of the view frustum\n"
+           "  --no-occlusion       Cull against the view frustum only, without the occlusion buffer\n"
+           "  --no-lod             Draw every primitive at full detail\n"
+           "  --quantize-vertices  Pack vertices into 16 bytes: 16 bit positions, octahedral normals, half float UVs\n"
+           "  --trace <file>       Write Chrome trace JSON of the whole run (needs ENABLE_PROFILING)\n"
+           "  --basedir <dir>      Directory with configs, models, shaders, textures and fonts\n"
+           "  --windowed           Render to a GLFW window instead of the headless context\n"
+           "  --verbose            Keep informational logging\n");
+}
+
+
+int main(int argc, char** argv) {
+
+    BenchApp::BenchInfo benchInfo;
+    benchInfo.sceneName = "DamagedHelmet";
+
+    GeneralApp::WindowCreateInfo wci;
+    wci.winWidth = 1280;
+    wci.winHeight = 720;
+    wci.name = "Bench";
+#ifdef ENABLE_HEADLESS
+    wci.headless = true;
+#endif
+
+    std::string basedir = "";
+    std::string tracePath = "";
+    bool verbose = false;
+
+    for (int i = 1; i < argc; ++i) {
+        const bool hasValue = i + 1 < argc;
+
+        if (!strcmp(argv[i], "--scene") && hasValue) {
+            benchInfo.sceneName = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--config") && hasValue) {
+            benchInfo.configPath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--frames") && hasValue) {
+            benchInfo.frames = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (!strcmp(argv[i], "--warmup") && hasValue) {
+            benchInfo.warmupFrames = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (!strcmp(argv[i], "--timestep") && hasValue) {
+            benchInfo.timestep = std::strtof(argv[++i], nullptr);
+        }
+        else if (!strcmp(argv[i], "--model-copies") && hasValue) {
+            benchInfo.modelCopies = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (!strcmp(argv[i], "--width") && hasValue) {
+            wci.winWidth = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (!strcmp(argv[i], "--height") && hasValue) {
+            wci.winHeight = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (!strcmp(argv[i], "--output") && hasValue) {
+            benchInfo.outputPath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--trace") && hasValue) {
+            tracePath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--capture") && hasValue) {
+            benchInfo.capturePath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--basedir") && hasValue) {
+            basedir = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--windowed")) {
+            wci.headless = false;
+        }
+        else if (!strcmp(argv[i], "--keep-cpu-copies")) {
+            benchInfo.keepCpuCopies = true;
+        }
+        else if (!strcmp(argv[i], "--no-state-cache")) {
+            benchInfo.disableStateCache = true;
+        }
+        else if (!strcmp(argv[i], "--direct-submission")) {
+            benchInfo.directSubmission = true;
+        }
+        else if (!strcmp(argv[i], "--no-culling")) {
+            benchInfo.disableCulling = true;
+        }
+        else if (!strcmp(argv[i], "--no-occlusion")) {
+            benchInfo.disableOcclusionCulling = true;
+        }
+        else if (!strcmp(argv[i], "--no-lod")) {
+            benchInfo.disableLod = true;
+        }
+        else if (!strcmp(argv[i], "--quantize-vertices")) {
+            benchInfo.quantizeVertices = true;
+        }
+        else if (!strcmp(argv[i], "--verbose")) {
+            verbose = true;
+        }
+        else {
+            printUsage();
+            return strcmp(argv[i], "--help") ? 1 : 0;
+        }
+    }
+
+    if (benchInfo.configPath.empty()) {
+        benchInfo.configPath = "configs://scenes/" + benchInfo.sceneName + ".json";
+    }
+
+    if (!verbose) {
+        Utils::Logger::setLogLevel(Utils::LogLevel::LOG_LEVEL_WARN_ERROR);
+    }
+
+    auto profiler = Utils::Profiler::getInstance();
+    if (!tracePath.empty()) {
+#ifndef ENABLE_PROFILING
+        LOG_W("Built without ENABLE_PROFILING, the trace will be empty");
+#endif
+        profiler->setThreadName(profiler->getCurrentThreadId(), "Main");
+        profiler->setEnabled(true);
+    }
+
+    BenchApp app(benchInfo);
+    app.setBasedir(basedir);
+
+    app.createWindow(wci);
+    app.renderToWindow();
+    app.terminateWindow();
+
+    if (!tracePath.empty()) {
+        profiler->writeChromeTrace(tracePath);
+    }
+
+    return 0;
+}
@@ -0,0 +1,259 @@
+#include "BenchApp.hpp"
+#include "JSONImporter.hpp"
+#include "FileManager.hpp"
+#include "ResourceManager.hpp"
+#include "RenderContext.hpp"
+#include "GeometryArena.hpp"
+#include "Logger.hpp"
+#include "GpuProfiler.hpp"
+
+#include <cstdio>
+#include <fstream>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+#include <tinygltf/stb_image_write.h>
+
+
+static size_t getResidentSetBytes() {
+#ifdef __linux__
+    // The second field of statm is the resident set in pages
+    std::ifstream statm { "/proc/self/statm" };
+    size_t totalPages = 0;
+    size_t residentPages = 0;
+    if (statm >> totalPages >> residentPages) {
+        return residentPages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+#endif
+    return 0;
+}
+
+
+BenchApp::BenchApp(const BenchInfo& info) : info_{ info } {
+    configPath_ = info_.configPath;
+
+    // The fade-in of the preview screen would be measured as a part of the first frames
+    previewFadeFrames_ = 0;
+    modelCopies_ = std::max(1u, info_.modelCopies);
+    multiDrawIndirect_ = !info_.directSubmission;
+    renderQueue_.setCullingEnabled(!info_.disableCulling);
+    renderQueue_.setOcclusionCullingEnabled(!info_.disableOcclusionCulling);
+    renderQueue_.setLodEnabled(!info_.disableLod);
+}
+
+
+void BenchApp::OnRenderingStart() {
+    benchStartTime_ = std::chrono::steady_clock::now();
+
+    if (info_.keepCpuCopies) {
+        Resources::ResourceManager::getInstance()->setResidencyPolicy(Resources::ResourceManager::ResidencyPolicy::KEEP_CPU_COPIES);
+    }
+    Resources::RenderContext::getInstance()->setCachingEnabled(!info_.disableStateCache);
+    Resources::GeometryArena::getInstance()->setVertexFormat(info_.quantizeVertices ? Resources::GeometryArena::VertexFormat::QUANTIZED
+                                                                                    : Resources::GeometryArena::VertexFormat::FLOAT);
+    PotentialApp::OnRenderingStart();
+
+    renderer_ = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+    Utils::GpuProfiler::getInstance()->setEnabled(true);
+}
+
+
+void BenchApp::OnRenderFrame() {
+    if (!ReadyForRender_) {
+        PotentialApp::OnRenderFrame();
+
+        if (ReadyForRender_) {
+            glFinish();
+            loadTimeMs_ = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - benchStartTime_).count();
+            loadResidentBytes_ = getResidentSetBytes();
+            loadGeometryBytes_ = Resources::GeometryArena::getInstance()->getUsedBytes();
+            loadCameraPath();
+        }
+        return;
+    }
+
+    cameraPath_.apply(Camera_, benchFrame_ * info_.timestep);
+
+    const bool measured = benchFrame_ >= info_.warmupFrames;
+    if (benchFrame_ == info_.warmupFrames) {
+        firstMeasuredGpuFrame_ = Utils::GpuProfiler::getInstance()->getNextFrameIndex();
+    }
+
+    auto renderContext = Resources::RenderContext::getInstance();
+    renderContext->resetStats();
+
+    auto cpuStart = std::chrono::steady_clock::now();
+    PotentialApp::OnRenderFrame();
+    auto cpuEnd = std::chrono::steady_clock::now();
+
+    if (measured) {
+        frameStats_.addSample("cpu_ms", std::chrono::duration<double, std::milli>(cpuEnd - cpuStart).count());
+        frameStats_.addSample("gl_state_calls_issued", static_cast<double>(renderContext->getStats().issuedCalls));
+        frameStats_.addSample("gl_state_calls_elided", static_cast<double>(renderContext->getStats().elidedCalls));
+        frameStats_.addSample("draw_items", renderQueue_.getStats().draws);
+        frameStats_.addSample("draw_calls", renderQueue_.getStats().drawCalls);
+        frameStats_.addSample("triangles", renderQueue_.getStats().triangles);
+        frameStats_.addSample("culled_items", renderQueue_.getStats().culled);
+        frameStats_.addSample("occluded_items", renderQueue_.getStats().occluded);
+        frameStats_.addSample("occluders", renderQueue_.getStats().occluders);
+        frameStats_.addSample("material_binds", renderQueue_.getStats().materialChanges);
+    }
+    collectGpuTimings();
+
+    ++benchFrame_;
+    if (benchFrame_ >= info_.warmupFrames + info_.frames) {
+        requestClose();
+    }
+}
+
+
+void BenchApp::OnRenderingEnd() {
+    auto gpuProfiler = Utils::GpuProfiler::getInstance();
+    gpuProfiler->flush();
+    collectGpuTimings();
+
+    if (gpuProfiler->getDroppedFrames() > 0) {
+        LOG_W("GPU timings of %llu frames are dropped, the GPU was too far behind", static_cast<unsigned long long>(gpuProfiler->getDroppedFrames()));
+    }
+
+    writeResults();
+    if (!info_.capturePath.empty()) {
+        captureFrame();
+    }
+
+    PotentialApp::OnRenderingEnd();
+}
+
+
+void BenchApp::loadCameraPath() {
+    auto fileManager = FileSystem::FileManager::getInstance();
+    auto jsonImporter = JsonUtil::JSONImpoter::getInstance();
+
+    std::ifstream sceneConfig { fileManager->getAbsolutePath(configPath_) };
+    nlohmann::json cfg;
+    sceneConfig >> cfg;
+
+    std::vector<JsonUtil::JSONImpoter::CameraKeyframeInfo> keyframes;
+    jsonImporter->loadCameraPath(cfg, keyframes);
+
+    for (const auto& keyframe : keyframes) {
+        cameraPath_.addKeyframe({ keyframe.time, keyframe.position, keyframe.yaw, keyframe.pitch, keyframe.fov });
+    }
+
+    if (cameraPath_.empty()) {
+        LOG_W("Scene config \'%s\' has no camera path, the camera stays still", configPath_.c_str());
+    }
+}
+
+
+void BenchApp::collectGpuTimings() {
+    // Results arrive a few frames late, the ones of warmup frames are skipped here
+    Utils::GpuProfiler::FrameResult result;
+    while (Utils::GpuProfiler::getInstance()->popFrameResult(result)) {
+        if (result.frameIndex < firstMeasuredGpuFrame_) {
+            continue;
+        }
+
+        frameStats_.addSample("gpu_ms", result.frameMs);
+        for (const auto& [pass, ms] : result.passMs) {
+            frameStats_.addSample(std::string("gpu_ms:") + pass, ms);
+        }
+    }
+}
+
+
+nlohmann::json BenchApp::getModelInitResults() const {
+    // Cumulative primitives against cumulative init time, a straight line means every primitive costs the same
+    nlohmann::json results = nlohmann::json::array();
+    size_t totalPrimitives = 0;
+    double totalMs = 0.0;
+
+    for (size_t i = 0; i < Models_.size() && i < modelInitMs_.size(); ++i) {
+        size_t primitives = 0;
+        for (const auto& mesh : Models_[i].getModelRef().meshes) {
+            primitives += mesh.primitives.size();
+        }
+        totalPrimitives += primitives;
+        totalMs += modelInitMs_[i];
+
+        const auto& authored = Models_[i].getAuthoredCacheStatistics();
+        const auto& optimized = Models_[i].getOptimizedCacheStatistics();
+        results.push_back({
+            { "model", Models_[i].getName() },
+            { "primitives", primitives },
+            { "ms", modelInitMs_[i] },
+            { "totalPrimitives", totalPrimitives },
+            { "totalMs", totalMs },
+            { "acmr", { { "authored", authored.getAcmr() }, { "optimized", optimized.getAcmr() } } },
+            { "atvr", { { "authored", authored.getAtvr() }, { "optimized", optimized.getAtvr() } } },
+            { "vertices", { { "authored", authored.vertices }, { "optimized", optimized.vertices } } }
+        });
+    }
+    return results;
+}
+
+
+void BenchApp::writeResults() const {
+    nlohmann::json result;
+    result["scene"] = info_.sceneName;
+    result["config"] = info_.configPath;
+    result["renderer"] = renderer_;
+    result["resolution"] = { windowWidth_, windowHeight_ };
+    result["frames"] = info_.frames;
+    result["warmupFrames"] = info_.warmupFrames;
+    result["timestep"] = info_.timestep;
+    result["cameraPathDuration"] = cameraPath_.getDuration();
+    result["loadTimeMs"] = loadTimeMs_;
+    result["keepCpuCopies"] = info_.keepCpuCopies;
+    result["stateCache"] = !info_.disableStateCache;
+    result["culling"] = !info_.disableCulling;
+    result["occlusionCulling"] = !info_.disableCulling && !info_.disableOcclusionCulling;
+    result["lod"] = !info_.disableLod;
+    result["vertexFormat"] = info_.quantizeVertices ? "quantized" : "float";
+    result["geometryMB"] = loadGeometryBytes_ / (1024.0 * 1024.0);
+    result["submission"] = renderQueue_.getSubmissionMode() == SceneResources::RenderQueue::MULTI_DRAW_INDIRECT ? "indirect" : "direct";
+    result["loadResidentMB"] = loadResidentBytes_ / (1024.0 * 1024.0);
+    result["modelCopies"] = modelCopies_;
+    result["modelInit"] = getModelInitResults();
+    result["stats"] = frameStats_.toJson(true);
+
+    std::ofstream output { info_.outputPath };
+    if (!output) {
+        LOG_E("Failed to write bench results to \'%s\'", info_.outputPath.c_str());
+        return;
+    }
+    output << result.dump(4);
+
+    printf("%s: %llu frames at %ux%u on %s, loaded in %.1f ms, %.1f MB resident\n", info_.sceneName.c_str(),
+           static_cast<unsigned long long>(info_.frames), windowWidth_, windowHeight_, renderer_.c_str(), loadTimeMs_,
+           loadResidentBytes_ / (1024.0 * 1024.0));
+    for (const auto& model : result["modelInit"]) {
+        const size_t primitives = model["primitives"];
+        const double ms = model["ms"];
+        printf("  %-36s %6zu primitives  init %9.3f ms  %8.3f us per primitive\n", model["model"].get<std::string>().c_str(),
+               primitives, ms, primitives ? ms * 1000.0 / primitives : 0.0);
+        printf("  %-36s ACMR %.3f -> %.3f  ATVR %.3f -> %.3f\n", "", model["acmr"]["authored"].get<double>(),
+               model["acmr"]["optimized"].get<double>(), model["atvr"]["authored"].get<double>(), model["atvr"]["optimized"].get<double>());
+    }
+    for (const auto& series : frameStats_.getSeriesNames()) {
+        auto summary = frameStats_.getSummary(series);
+        printf("  %-36s p50 %8.3f  p95 %8.3f  p99 %8.3f  max %8.3f\n", series.c_str(), summary.p50, summary.p95, summary.p99, summary.max);
+    }
+    printf("Results are written to %s\n", info_.outputPath.c_str());
+}
+
+
+void BenchApp::captureFrame() const {
+    std::vector<unsigned char> pixels(windowWidth_ * windowHeight_ * 4);
+
+    Resources::RenderContext::getInstance()->bindFramebuffer(getDefaultFramebufferId());
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, windowWidth_, windowHeight_, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+    stbi_flip_vertically_on_write(1);
+    if (!stbi_write_png(info_.capturePath.c_str(), windowWidth_, windowHeight_, 4, pixels.data(), windowWidth_ * 4)) {
+        LOG_E("Failed to write captured frame to \'%s\'", info_.capturePath.c_str());
+    }
+}
@@ -0,0 +1,336 @@
+#include "BoundingVolumeHierarchy.hpp"
+#include "FrameStats.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <random>
+
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+
+using SceneResources::AABB;
+using SceneResources::BoundingVolumeHierarchy;
+
+
+static void printUsage() {
+    printf("Usage: bvh-bench [options]\n"
+           "  --gltf <file>        World space primitive bounds of a glTF scene, only the accessor bounds are read\n"
+           "  --instances <N>      Boxes of the synthetic scene used without --gltf (default 1000000)\n"
+           "  --iterations <N>     Measured builds, refits and query batches (default 10)\n"
+           "  --queries <N>        Rays, frusta and spheres per batch (default 100000 rays, a hundredth of it for the others)\n"
+           "  --output <file>      Results JSON (default bvh_bench_output.json)\n");
+}
+
+
+static glm::mat4 getNodeMatrix(const nlohmann::json& node) {
+    if (node.contains("matrix")) {
+        glm::mat4 matrix;
+        for (int i = 0; i < 16; ++i)
+            matrix[i / 4][i % 4] = node["matrix"][i].get<float>();
+        return matrix;
+    }
+
+    glm::mat4 matrix = glm::mat4(1.0f);
+    if (node.contains("translation"))
+        matrix = glm::translate(matrix, glm::vec3(node["translation"][0], node["translation"][1], node["translation"][2]));
+    if (node.contains("rotation"))
+        matrix *= glm::mat4_cast(glm::quat(node["rotation"][3], node["rotation"][0], node["rotation"][1], node["rotation"][2]));
+    if (node.contains("scale"))
+        matrix = glm::scale(matrix, glm::vec3(node["scale"][0], node["scale"][1], node["scale"][2]));
+    return matrix;
+}
+
+
+// Reads the bounds from the glTF JSON only, so the scene does not need its buffers
+static bool loadGltfBounds(const std::string& path, std::vector<AABB>& bounds) {
+    std::ifstream file { path };
+    if (!file) {
+        fprintf(stderr, "Failed to open \'%s\'\n", path.c_str());
+        return false;
+    }
+
+    const nlohmann::json gltf = nlohmann::json::parse(file, nullptr, false);
+    if (gltf.is_discarded() || !gltf.contains("nodes")) {
+        fprintf(stderr, "\'%s\' is not a glTF scene\n", path.c_str());
+        return false;
+    }
+
+    std::vector<std::pair<int, glm::mat4>> stack;
+    const int sceneIdx = gltf.value("scene", 0);
+    if (gltf.contains("scenes")) {
+        for (const auto& nodeIdx : gltf["scenes"][sceneIdx]["nodes"])
+            stack.push_back({ nodeIdx.get<int>(), glm::mat4(1.0f) });
+    }
+    else {
+        for (int i = 0; i < static_cast<int>(gltf["nodes"].size()); ++i)
+            stack.push_back({ i, glm::mat4(1.0f) });
+    }
+
+    while (!stack.empty()) {
+        const auto [nodeIdx, parentMatrix] = stack.back();
+        stack.pop_back();
+
+        const auto& node = gltf["nodes"][nodeIdx];
+        const glm::mat4 matrix = parentMatrix * getNodeMatrix(node);
+
+        if (node.contains("mesh")) {
+            for (const auto& primitive : gltf["meshes"][node["mesh"].get<int>()]["primitives"]) {
+                const auto& accessor = gltf["accessors"][primitive["attributes"]["POSITION"].get<int>()];
+                if (!accessor.contains("min") || !accessor.contains("max"))
+                    continue;
+
+                AABB box;
+                box.expand(glm::vec3(accessor["min"][0], accessor["min"][1], accessor["min"][2]));
+                box.expand(glm::vec3(accessor["max"][0], accessor["max"][1], accessor["max"][2]));
+                bounds.push_back(box.transformed(matrix));
+            }
+        }
+
+        if (node.contains("children")) {
+            for (const auto& childIdx : node["children"])
+                stack.push_back({ childIdx.get<int>(), matrix });
+        }
+    }
+
+    return true;
+}
+
+
+int main(int argc, char** argv) {
+    std::string gltfPath;
+    uint32_t instanceCount = 1000000;
+    uint32_t iterations = 10;
+    uint32_t rayCount = 100000;
+    std::string outputPath = "bvh_bench_output.json";
+
+    for (int i = 1; i < argc; ++i) {
+        const bool hasValue = i + 1 < argc;
+
+        if (!strcmp(argv[i], "--gltf") && hasValue) {
+            gltfPath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--instances") && hasValue) {
+            instanceCount = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (!strcmp(argv[i], "--iterations") && hasValue) {
+            iterations = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (!strcmp(argv[i], "--queries") && hasValue) {
+            rayCount = std::max(100ul, std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (!strcmp(argv[i], "--output") && hasValue) {
+            outputPath = argv[++i];
+        }
+        else {
+            printUsage();
+            return strcmp(argv[i], "--help") ? 1 : 0;
+        }
+    }
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    std::vector<AABB> bounds;
+    if (!gltfPath.empty()) {
+        if (!loadGltfBounds(gltfPath, bounds))
+            return 1;
+    }
+    else {
+        // Boxes of varying size spread over a cube, roughly as dense as a large city block
+        const float sceneSize = 10.0f * std::cbrt(static_cast<float>(instanceCount));
+        bounds.resize(instanceCount);
+        for (auto& box : bounds) {
+            const glm::vec3 center = glm::vec3(unit(rng), unit(rng), unit(rng)) * sceneSize;
+            const glm::vec3 extent = glm::vec3(0.5f + 2.0f * unit(rng), 0.5f + 2.0f * unit(rng), 0.5f + 2.0f * unit(rng));
+            box.expand(center - extent);
+            box.expand(center + extent);
+        }
+    }
+
+    if (bounds.empty()) {
+        fprintf(stderr, "The scene has no primitives with bounds\n");
+        return 1;
+    }
+
+    AABB sceneBounds;
+    for (const auto& box : bounds)
+        sceneBounds.expand(box);
+    const glm::vec3 sceneExtent = sceneBounds.maxCorner - sceneBounds.minCorner;
+    const float sceneDiagonal = glm::length(sceneExtent);
+
+    auto randomPoint = [&]() { return sceneBounds.minCorner + glm::vec3(unit(rng), unit(rng), unit(rng)) * sceneExtent; };
+    auto randomDirection = [&]() {
+        const float z = 2.0f * unit(rng) - 1.0f;
+        const float angle = 2.0f * glm::pi<float>() * unit(rng);
+        const float r = std::sqrt(1.0f - z * z);
+        return glm::vec3(r * std::cos(angle), r * std::sin(angle), z);
+    };
+
+    const uint32_t volumeQueryCount = std::max(1u, rayCount / 100);
+    std::vector<glm::vec3> rayOrigins(rayCount), rayDirections(rayCount);
+    for (uint32_t i = 0; i < rayCount; ++i) {
+        rayOrigins[i] = randomPoint();
+        rayDirections[i] = randomDirection();
+    }
+
+    std::vector<GeneralApp::Frustum> frusta(volumeQueryCount);
+    for (auto& frustum : frusta) {
+        GeneralApp::Camera camera;
+        camera.setPosition(randomPoint());
+        camera.setYaw(360.0f * unit(rng));
+        camera.setPitch(60.0f * unit(rng) - 30.0f);
+        camera.setFov(60.0f);
+        camera.setAspect(16.0f / 9.0f);
+        camera.setZNear(0.1f);
+        camera.setZFar(0.25f * sceneDiagonal);
+        camera.updateVectors();
+        camera.updateMatrices();
+        frustum = camera.getFrustum();
+    }
+
+    std::vector<glm::vec3> sphereCenters(volumeQueryCount);
+    for (auto& center : sphereCenters)
+        center = randomPoint();
+    const float sphereRadius = 0.05f * sceneDiagonal;
+
+    Utils::FrameStats stats;
+    using Clock = std::chrono::steady_clock;
+    auto measure = [&](const std::string& series, auto&& function) {
+        const auto start = Clock::now();
+        function();
+        const double milliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        stats.addSample(series, milliseconds);
+        return milliseconds;
+    };
+
+    BoundingVolumeHierarchy bvh;
+    std::vector<AABB> movedBounds = bounds;
+    std::vector<uint32_t> primitives;
+    size_t hitCount = 0, anyHitCount = 0, frustumCount = 0, sphereCount = 0;
+
+    for (uint32_t iteration = 0; iteration < iterations; ++iteration) {
+        measure("build_ms", [&]() { bvh.build(bounds); });
+
+        // Every box moves a little, as if the whole scene was animated
+        for (size_t i = 0; i < bounds.size(); ++i) {
+            const glm::vec3 offset = (glm::vec3(unit(rng), unit(rng), unit(rng)) - 0.5f) * 0.01f * sceneDiagonal / std::cbrt(static_cast<float>(bounds.size()));
+            movedBounds[i] = { bounds[i].minCorner + offset, bounds[i].maxCorner + offset };
+        }
+        measure("refit_ms", [&]() { bvh.refit(movedBounds); });
+        bvh.refit(bounds);
+
+        hitCount = 0;
+        double milliseconds = measure("raycast_closest_ms", [&]() {
+            BoundingVolumeHierarchy::RayHit hit;
+            for (uint32_t i = 0; i < rayCount; ++i)
+                hitCount += bvh.raycastClosest(rayOrigins[i], rayDirections[i], sceneDiagonal, hit);
+        });
+        stats.addSample("raycast_closest_mrays_per_s", rayCount / milliseconds * 1e-3);
+
+        anyHitCount = 0;
+        milliseconds = measure("raycast_any_ms", [&]() {
+            for (uint32_t i = 0; i < rayCount; ++i)
+                anyHitCount += bvh.raycastAny(rayOrigins[i], rayDirections[i], sceneDiagonal);
+        });
+        stats.addSample("raycast_any_mrays_per_s", rayCount / milliseconds * 1e-3);
+
+        frustumCount = 0;
+        milliseconds = measure("frustum_ms", [&]() {
+            for (const auto& frustum : frusta) {
+                primitives.clear();
+                bvh.queryFrustum(frustum, primitives);
+                frustumCount += primitives.size();
+            }
+        });
+        stats.addSample("frustum_queries_per_ms", volumeQueryCount / milliseconds);
+
+        sphereCount = 0;
+        milliseconds = measure("sphere_ms", [&]() {
+            for (const auto& center : sphereCenters) {
+                primitives.clear();
+                bvh.querySphere(center, sphereRadius, primitives);
+                sphereCount += primitives.size();
+            }
+        });
+        stats.addSample("sphere_queries_per_ms", volumeQueryCount / milliseconds);
+    }
+
+    // Brute force over a few queries of each kind, the hits must match exactly
+    uint32_t mismatches = 0;
+    const uint32_t checkCount = std::min(volumeQueryCount, 100u);
+    for (uint32_t q = 0; q < checkCount; ++q) {
+        const glm::vec3 invDirection = 1.0f / rayDirections[q];
+        float closest = sceneDiagonal;
+        bool expectedHit = false;
+        for (const auto& box : bounds) {
+            const glm::vec3 t0 = (box.minCorner - rayOrigins[q]) * invDirection;
+            const glm::vec3 t1 = (box.maxCorner - rayOrigins[q]) * invDirection;
+            const glm::vec3 tNear = glm::min(t0, t1), tFar = glm::max(t0, t1);
+            const float entry = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+            const float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, sceneDiagonal));
+            if (entry <= exit && entry <= closest) {
+                closest = entry;
+                expectedHit = true;
+            }
+        }
+
+        BoundingVolumeHierarchy::RayHit hit;
+        const bool actualHit = bvh.raycastClosest(rayOrigins[q], rayDirections[q], sceneDiagonal, hit);
+        if (actualHit != expectedHit || (actualHit && hit.distance != closest) || actualHit != bvh.raycastAny(rayOrigins[q], rayDirections[q], sceneDiagonal))
+            ++mismatches;
+
+        size_t expectedSphere = 0;
+        for (const auto& box : bounds) {
+            const glm::vec3 delta = glm::max(glm::max(box.minCorner - sphereCenters[q], sphereCenters[q] - box.maxCorner), glm::vec3(0.0f));
+            expectedSphere += glm::dot(delta, delta) <= sphereRadius * sphereRadius;
+        }
+        primitives.clear();
+        bvh.querySphere(sphereCenters[q], sphereRadius, primitives);
+        mismatches += primitives.size() != expectedSphere;
+
+        size_t expectedFrustum = 0;
+        for (const auto& box : bounds) {
+            bool inside = true;
+            for (const auto& plane : frusta[q].planes) {
+                const glm::vec3 normal = glm::vec3(plane);
+                const glm::vec3 furthest = glm::mix(box.minCorner, box.maxCorner, glm::greaterThanEqual(normal, glm::vec3(0.0f)));
+                inside &= glm::dot(normal, furthest) + plane.w >= 0.0f;
+            }
+            expectedFrustum += inside;
+        }
+        primitives.clear();
+        bvh.queryFrustum(frusta[q], primitives);
+        mismatches += primitives.size() != expectedFrustum;
+    }
+
+    printf("%zu primitives, %zu nodes, depth %u, %u iterations, %u brute force mismatches\n",
+           bounds.size(), bvh.getNodes().size(), bvh.getDepth(), iterations, mismatches);
+    printf("  %u rays: %zu closest hits, %zu any hits; %u frusta: %zu primitives; %u spheres: %zu primitives\n",
+           rayCount, hitCount, anyHitCount, volumeQueryCount, frustumCount, volumeQueryCount, sphereCount);
+    for (const auto& series : stats.getSeriesNames()) {
+        const auto summary = stats.getSummary(series);
+        printf("  %-28s mean %12.3f  p50 %12.3f  p95 %12.3f\n", series.c_str(), summary.mean, summary.p50, summary.p95);
+    }
+
+    nlohmann::json result;
+    result["scene"] = gltfPath.empty() ? "synthetic" : gltfPath;
+    result["primitives"] = bounds.size();
+    result["nodes"] = bvh.getNodes().size();
+    result["depth"] = bvh.getDepth();
+    result["iterations"] = iterations;
+    result["rays"] = rayCount;
+    result["volumeQueries"] = volumeQueryCount;
+    result["mismatches"] = mismatches;
+    result["stats"] = stats.toJson();
+
+    std::ofstream output { outputPath };
+    if (!output) {
+        fprintf(stderr, "Failed to write results to \'%s\'\n", outputPath.c_str());
+        return 1;
+    }
+    output << result.dump(4) << std::endl;
+
+    return mismatches ? 1 : 0;
+}
@@ -1,5 +1,6 @@
 #include "IApplication.hpp"
 #include "Logger.hpp"
+#include "RenderContext.hpp"
 
 
 namespace GeneralApp {
@@ -17,6 +18,7 @@ void IApplication::createWindow(const WindowCreateInfo& winInfo) {
     OnInit();
 
     windowName_ = winInfo.name;
+    maxFrames_ = winInfo.maxFrames;
 
 #ifdef __ANDROID__
     android_app_ = winInfo.app;
@@ -38,35 +40,53 @@ void IApplication::createWindow(const WindowCreateInfo& winInfo) {
 #else
     windowWidth_ = winInfo.winWidth;
     windowHeight_ = winInfo.winHeight;
+    isHeadless_ = winInfo.headless;
+
+    if (isHeadless_) {
+#ifdef ENABLE_HEADLESS
+        if (!createHeadlessContext()) {
+            LOG_E("Failed to create headless context");
+            destroyHeadlessContext();
+            requestClose();
+            return;
+        }
+#else
+        LOG_E("Headless rendering is not enabled in this build");
+        requestClose();
+        return;
+#endif
+    }
+    else {
+        glfwInit();
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+        if(enableDefaultMSAA_) {
+            glfwWindowHint(GLFW_SAMPLES, samples_);
+        }
 
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        window_ = glfwCreateWindow(windowWidth_, windowHeight_, windowName_.c_str(), NULL, NULL);
+        if (!window_) {
+            LOG_E("Failed to create window");
+            glfwTerminate();
+            requestClose();
+            return;
+        }
+        glfwMakeContextCurrent(window_);
 
-    if(enableDefaultMSAA_) {
-        glfwWindowHint(GLFW_SAMPLES, samples_);
-    }
+        glfwSetFramebufferSizeCallback(window_, framebufferSizeCallbackStatic);
+        glfwSetMouseButtonCallback(window_, mouseCallbackStatic);
+        glfwSetCursorPosCallback(window_, cursorCallbackStatic);
+        glfwSetScrollCallback(window_, scrollCallbackStatic);
+        glfwSetKeyCallback(window_, keyboardCallbackStatic);
 
-    window_ = glfwCreateWindow(windowWidth_, windowHeight_, windowName_.c_str(), NULL, NULL);
-    if (!window_) {
-        LOG_E("Failed to create window");
-        glfwTerminate();
-        return;
-    }
-    glfwMakeContextCurrent(window_);
-    
-    glfwSetFramebufferSizeCallback(window_, framebufferSizeCallbackStatic);
-    glfwSetMouseButtonCallback(window_, mouseCallbackStatic);
-    glfwSetCursorPosCallback(window_, cursorCallbackStatic);
-    glfwSetScrollCallback(window_, scrollCallbackStatic);
-    glfwSetKeyCallback(window_, keyboardCallbackStatic);
-
-    glfwSetInputMode(window_, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-    gladLoadGL();
-
-    if(enableDefaultMSAA_) {
-        glEnable(GL_MULTISAMPLE);
+        glfwSetInputMode(window_, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+        gladLoadGL();
+
+        if(enableDefaultMSAA_) {
+            glEnable(GL_MULTISAMPLE);
+        }
     }
 #endif
 
@@ -77,6 +97,10 @@ void IApplication::createWindow(const WindowCreateInfo& winInfo) {
 
 void IApplication::renderToWindow() {
 
+    if (shouldClose()) {
+        return;
+    }
+
     OnRenderingStart();
 
 #ifdef __ANDROID__
@@ -91,6 +115,11 @@ void IApplication::renderToWindow() {
         if (needToRender_) {
             OnRenderFrame();
             eglSwapBuffers(display_, surface_);
+            ++renderedFrames_;
+        }
+
+        if (shouldClose()) {
+            break;
         }
 
         while ((ident = ALooper_pollAll(0, nullptr, &events,(void**)&source)) >= 0) {
@@ -106,13 +135,22 @@ void IApplication::renderToWindow() {
         }
     }
 #else
-    while (!glfwWindowShouldClose(window_)) {
+    while (!shouldClose()) {
 
         if (needToRender_) {
             OnRenderFrame();
-            glfwSwapBuffers(window_);
+            if (isHeadless_) {
+                glFlush();
+            }
+            else {
+                glfwSwapBuffers(window_);
+            }
+            ++renderedFrames_;
+        }
+
+        if (!isHeadless_) {
+            glfwPollEvents();
         }
-        glfwPollEvents();
     }
 #endif
 
@@ -122,7 +160,7 @@ void IApplication::renderToWindow() {
 
 void IApplication::showFPS() {
 #ifndef __ANDROID__
-    float currentFrame = glfwGetTime();
+    float currentFrame = getTime();
     deltaTime_ = currentFrame - lastFrame_;
     lastFrame_ = currentFrame;
     ++nbFrames_;
@@ -130,7 +168,12 @@ void IApplication::showFPS() {
     if (currentFrame - lastFrameFPS_ >= 1.0f) {
         std::stringstream ss;
         ss << windowName_ + " [" << static_cast<int>(static_cast<float>(nbFrames_) / (currentFrame - lastFrameFPS_)) << " FPS ]";
-        glfwSetWindowTitle(window_, ss.str().c_str());
+        if (isHeadless_) {
+            LOG_I("%s", ss.str().c_str());
+        }
+        else {
+            glfwSetWindowTitle(window_, ss.str().c_str());
+        }
 
         lastFrameFPS_ = currentFrame;
         nbFrames_ = 0;
@@ -139,6 +182,49 @@ void IApplication::showFPS() {
 }
 
 
+float IApplication::getTime() const {
+#ifndef __ANDROID__
+    if (!isHeadless_) {
+        return glfwGetTime();
+    }
+    return std::chrono::duration<float>(std::chrono::steady_clock::now() - startTime_).count();
+#else
+    return 0.0f;
+#endif
+}
+
+
+bool IApplication::shouldClose() const {
+    if (closeRequested_ || (maxFrames_ != 0 && renderedFrames_ >= maxFrames_)) {
+        return true;
+    }
+#ifndef __ANDROID__
+    if (!isHeadless_) {
+        return glfwWindowShouldClose(window_);
+    }
+#endif
+    return false;
+}
+
+
+unsigned IApplication::getDefaultFramebufferId() const {
+#ifdef ENABLE_HEADLESS
+    return headlessFramebuffer_;
+#else
+    return 0;
+#endif
+}
+
+
+bool IApplication::isHeadless() const {
+#ifdef __ANDROID__
+    return false;
+#else
+    return isHeadless_;
+#endif
+}
+
+
 void IApplication::terminateWindow() {
     if (!isTerminated_) {
         isTerminated_ = true;
@@ -154,7 +240,14 @@ void IApplication::terminateWindow() {
         }
         surface_ = EGL_NO_SURFACE;
 #else
-        glfwTerminate();
+        if (isHeadless_) {
+#ifdef ENABLE_HEADLESS
+            destroyHeadlessContext();
+#endif
+        }
+        else {
+            glfwTerminate();
+        }
 #endif
 
         OnWindowDestroy();
@@ -272,4 +365,128 @@ void IApplication::handleCmdCallback(android_app* app, int32_t cmd) {
 }
 #endif
 
-}
\ No newline at end of file
+#if defined(ENABLE_HEADLESS) && !defined(__ANDROID__)
+bool IApplication::createHeadlessContext() {
+    // Prefer Mesa's surfaceless platform, so no display server or GPU is required (llvmpipe works)
+    auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (getPlatformDisplay) {
+        headlessDisplay_ = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    }
+    if (headlessDisplay_ == EGL_NO_DISPLAY) {
+        headlessDisplay_ = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+
+    EGLint major = 0, minor = 0;
+    if (headlessDisplay_ == EGL_NO_DISPLAY || eglInitialize(headlessDisplay_, &major, &minor) == EGL_FALSE) {
+        LOG_E("Failed to initialize EGL display: 0x%x", eglGetError());
+        return false;
+    }
+    LOG_I("Initialized EGL %d.%d (%s)", major, minor, eglQueryString(headlessDisplay_, EGL_VENDOR));
+
+    const std::string extensions = eglQueryString(headlessDisplay_, EGL_EXTENSIONS);
+    if (extensions.find("EGL_KHR_surfaceless_context") == std::string::npos) {
+        LOG_E("EGL_KHR_surfaceless_context is not supported");
+        return false;
+    }
+
+    if (eglBindAPI(EGL_OPENGL_API) == EGL_FALSE) {
+        LOG_E("Failed to bind OpenGL API: 0x%x", eglGetError());
+        return false;
+    }
+
+    EGLConfig config = EGL_NO_CONFIG_KHR;
+    if (extensions.find("EGL_KHR_no_config_context") == std::string::npos) {
+        const EGLint attribs[] = {EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+                                  EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                                  EGL_RED_SIZE, 8,
+                                  EGL_GREEN_SIZE, 8,
+                                  EGL_BLUE_SIZE, 8,
+                                  EGL_NONE};
+        EGLint numConfigs = 0;
+        if (eglChooseConfig(headlessDisplay_, attribs, &config, 1, &numConfigs) == EGL_FALSE || numConfigs == 0) {
+            LOG_E("Failed to choose EGLConfig");
+            return false;
+        }
+    }
+
+    // Shaders target the newest core profile, so try it first and step down if the driver refuses
+    static constexpr EGLint contextVersions[][2] = {{4, 6}, {4, 5}, {4, 3}, {3, 3}};
+    for (const auto& version : contextVersions) {
+        const EGLint ctxAttribs[] = {EGL_CONTEXT_MAJOR_VERSION, version[0],
+                                     EGL_CONTEXT_MINOR_VERSION, version[1],
+                                     EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                                     EGL_NONE};
+        headlessContext_ = eglCreateContext(headlessDisplay_, config, EGL_NO_CONTEXT, ctxAttribs);
+        if (headlessContext_ != EGL_NO_CONTEXT) {
+            LOG_I("Created OpenGL %d.%d core context %p", version[0], version[1], headlessContext_);
+            break;
+        }
+    }
+    if (headlessContext_ == EGL_NO_CONTEXT) {
+        LOG_E("Failed to create OpenGL context: 0x%x", eglGetError());
+        return false;
+    }
+
+    if (eglMakeCurrent(headlessDisplay_, EGL_NO_SURFACE, EGL_NO_SURFACE, headlessContext_) == EGL_FALSE) {
+        LOG_E("Failed to eglMakeCurrent: 0x%x", eglGetError());
+        return false;
+    }
+
+    if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(eglGetProcAddress))) {
+        LOG_E("Failed to load OpenGL functions");
+        return false;
+    }
+    LOG_I("OpenGL renderer: %s, version: %s", glGetString(GL_RENDERER), glGetString(GL_VERSION));
+
+    // There is no window surface, so the offscreen framebuffer plays the role of DEFAULT_FRAMEBUFFER
+    glGenRenderbuffers(1, &headlessColorRenderbuffer_);
+    glBindRenderbuffer(GL_RENDERBUFFER, headlessColorRenderbuffer_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, windowWidth_, windowHeight_);
+
+    glGenRenderbuffers(1, &headlessDepthRenderbuffer_);
+    glBindRenderbuffer(GL_RENDERBUFFER, headlessDepthRenderbuffer_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, windowWidth_, windowHeight_);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &headlessFramebuffer_);
+    Resources::RenderContext::getInstance()->bindFramebuffer(headlessFramebuffer_);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, headlessColorRenderbuffer_);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, headlessDepthRenderbuffer_);
+
+    auto status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        LOG_E("Headless framebuffer is not complete: %d", status);
+        return false;
+    }
+
+    return true;
+}
+
+
+void IApplication::destroyHeadlessContext() {
+    if (headlessContext_ != EGL_NO_CONTEXT) {
+        if (headlessFramebuffer_ != 0) {
+            Resources::RenderContext::getInstance()->bindFramebuffer(0);
+            glDeleteFramebuffers(1, &headlessFramebuffer_);
+            glDeleteRenderbuffers(1, &headlessColorRenderbuffer_);
+            glDeleteRenderbuffers(1, &headlessDepthRenderbuffer_);
+            headlessFramebuffer_ = 0;
+            headlessColorRenderbuffer_ = 0;
+            headlessDepthRenderbuffer_ = 0;
+        }
+
+        eglMakeCurrent(headlessDisplay_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(headlessDisplay_, headlessContext_);
+        headlessContext_ = EGL_NO_CONTEXT;
+        // Another context starts with the default state
+        Resources::RenderContext::getInstance()->invalidate();
+    }
+
+    if (headlessDisplay_ != EGL_NO_DISPLAY) {
+        eglTerminate(headlessDisplay_);
+        headlessDisplay_ = EGL_NO_DISPLAY;
+    }
+}
+#endif
+
+}
@@ -1,10 +1,16 @@
 #include "PotentialApp.hpp"
 #include "ResourceManager.hpp"
+#include "GeometryArena.hpp"
+#include "RenderContext.hpp"
+#include "Mesh.hpp"
 #include "SceneManager.hpp"
 #include "JSONImporter.hpp"
 #include "FileManager.hpp"
 #include "Light.hpp"
 #include "Logger.hpp"
+#include "Profiler.hpp"
+#include "GpuProfiler.hpp"
+#include "ThreadPool.hpp"
 
 
 #define TINYGLTF_IMPLEMENTATION
@@ -20,7 +26,11 @@ void PotentialApp::OnInit() {
 #else
     std::string basedir = fileManager->getAbsolutePath(fileManager->getCurrentDirectory() + "/../../../..");
 #endif
+    if (!basedir_.empty()) {
+        basedir = fileManager->getAbsolutePath(basedir_);
+    }
     fileManager->setBasedir(basedir);
+    fileManager->registerProtocol("cache", basedir + "/cache");
     fileManager->registerProtocol("configs", basedir + "/configs");
     fileManager->registerProtocol("fonts", basedir + "/fonts");
     fileManager->registerProtocol("models", basedir + "/models");
@@ -41,11 +51,12 @@ void PotentialApp::OnWindowCreate() {
 }
 
 void PotentialApp::OnRenderingStart() {
+    PROFILE_SCOPE("PotentialApp::OnRenderingStart");
     auto resourceManager = Resources::ResourceManager::getInstance();
     auto sceneManager = SceneResources::SceneManager::getInstance();
     auto fileManager = FileSystem::FileManager::getInstance();
 
-    resourceManager->Init();
+    resourceManager->Init(getDefaultFramebufferId());
     auto& previewTexture = resourceManager->createTexture(fileManager->getAbsolutePath("textures://PreviewScreen.jpg"));
     previewTextureHandle_ = previewTexture.handle;
 
@@ -53,10 +64,14 @@ void PotentialApp::OnRenderingStart() {
 }
 
 void PotentialApp::OnRenderFrame() {
+    PROFILE_SCOPE("PotentialApp::OnRenderFrame");
     processMovement();
 
     auto resourceManager = Resources::ResourceManager::getInstance();
     auto sceneManager = SceneResources::SceneManager::getInstance();
+    auto gpuProfiler = Utils::GpuProfiler::getInstance();
+
+    gpuProfiler->beginFrame();
 
     if (ReadyForRender_) {
         ++frameAfterInit_;
@@ -74,58 +89,94 @@ void PotentialApp::OnRenderFrame() {
         glClearDepth(1.0);
 #endif
 
-        Camera_.updateMatrices();
+        {
+            PROFILE_SCOPE("Frame::UpdateCamera");
+            Camera_.updateMatrices();
+
+            if (isRecordingCameraPath_) {
+                recordedCameraPath_.addKeyframe(Camera_, getTime() - recordingStartTime_);
+            }
 
-        Matrices ubo;
-        ubo.view = Camera_.getView();
-        ubo.proj = Camera_.getProj();
-        ubo.model = glm::mat4(1.0f);
+            Matrices ubo;
+            ubo.view = Camera_.getView();
+            ubo.proj = Camera_.getProj();
 
-        resourceManager->updateBuffer("Matrices", (const unsigned char*)&ubo, sizeof(ubo));
+            resourceManager->updateBuffer("Matrices", (const unsigned char*)&ubo, sizeof(ubo));
+        }
 
-        modelShader.use();
-        modelShader.setVec3("uCameraWorldPos", Camera_.getPosition());
+        {
+            PROFILE_SCOPE("Frame::DrawModels");
+            PROFILE_GPU_SCOPE("Frame::DrawModels");
+            modelShader.use();
+            modelShader.setVec3("uCameraWorldPos", Camera_.getPosition());
+            if (modelIndirectShaderHandle_.isValid()) {
+                auto& modelIndirectShader = resourceManager->getShader(modelIndirectShaderHandle_);
+                modelIndirectShader.use();
+                modelIndirectShader.setVec3("uCameraWorldPos", Camera_.getPosition());
+            }
 
 #ifndef __ANDROID__
-        glPolygonMode(GL_FRONT_AND_BACK, IsWireframe_ ? GL_LINE : GL_FILL);
+            glPolygonMode(GL_FRONT_AND_BACK, IsWireframe_ ? GL_LINE : GL_FILL);
 #endif
-        for (auto& model : Models_) {
-            model.draw(modelShader);
-        }
+            sceneManager->updateTransforms();
+            renderQueue_.update(sceneManager->getRootNode(), modelShader);
+            renderQueue_.sort(Camera_.getPosition());
+            renderQueue_.cull(Camera_.getFrustum());
+            renderQueue_.cullOccluded(Camera_.getProj() * Camera_.getView(), Camera_.getPosition());
+            renderQueue_.selectLods(Camera_, static_cast<float>(windowHeight_));
+            renderQueue_.draw();
 #ifndef __ANDROID__
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 #endif
+        }
 
         sceneManager->drawEnvironment();
         sceneManager->performPostProcess(modelFramebufferTextureHandle_);
         sceneManager->drawToDefaultFramebuffer(sceneManager->getPostProcessTextureHandle());
         sceneManager->drawText("Damaged Helmet", 10.0f, windowHeight_ - 30.0f, 0.7f, glm::vec3(1.0f, 0.0f, 0.0f));
 
-        if (frameAfterInit_ < 100) {
-            glEnable(GL_BLEND);
-            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-            sceneManager->drawPreviewScreen(previewTextureHandle_, 1.0f - frameAfterInit_ / 100.0f);
+        if (frameAfterInit_ < previewFadeFrames_) {
+            auto renderContext = Resources::RenderContext::getInstance();
+            renderContext->enable(GL_BLEND);
+            renderContext->blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            sceneManager->drawPreviewScreen(previewTextureHandle_, 1.0f - static_cast<float>(frameAfterInit_) / previewFadeFrames_);
         }
     }
     else {
         sceneManager->drawPreviewScreen(previewTextureHandle_);
         if (NeedInit_) {
-            this->initModels();
+            PROFILE_SCOPE("PotentialApp::init");
+            // Environment and IBL baking on the context thread overlap with models loading on workers
+            this->loadModelsAsync();
             this->initLights();
             this->initRender();
+            this->initModels();
             this->initCamera();
+            // Everything of the scene is uploaded by now
+            resourceManager->releaseCpuCopies();
             ReadyForRender_ = true;
         }
         NeedInit_ = true;
     }
+
+    gpuProfiler->endFrame();
 }
 
 void PotentialApp::OnRenderingEnd() {
     auto resourceManager = Resources::ResourceManager::getInstance();
     auto sceneManager = SceneResources::SceneManager::getInstance();
 
+    auto gpuProfiler = Utils::GpuProfiler::getInstance();
+    gpuProfiler->flush();
+    gpuProfiler->release();
+
+    renderQueue_.clear();
     resourceManager->cleanUp();
     sceneManager->cleanUp();
+    Resources::GeometryArena::getInstance()->cleanUp();
+
+    // Nothing is loaded after the last frame, workers are joined instead of being left to the process exit
+    Utils::ThreadPool::getInstance()->shutdown();
 }
 
 void PotentialApp::OnWindowDestroy() {
@@ -342,6 +393,12 @@ void PotentialApp::keyboardCallback(GLFWwindow* window, int key, int scancode, i
                 sceneManager->setEnableBloom(!sceneManager->getEnableBloom());
             }
             break;
+
+        case GLFW_KEY_R:
+            if (action == GLFW_PRESS) {
+                toggleCameraPathRecording();
+            }
+            break;
     }
 
 }
@@ -356,42 +413,72 @@ PotentialApp::PotentialApp() {
 }
 
 
-void PotentialApp::initModels() {
+void PotentialApp::loadModelsAsync() {
+    PROFILE_SCOPE("PotentialApp::loadModelsAsync");
     auto fileManager = FileSystem::FileManager::getInstance();
     auto GLTFloader = GLTF::GLTFLoader::getInstance();
     auto jsonImporter = JsonUtil::JSONImpoter::getInstance();
-    auto sceneManager = SceneResources::SceneManager::getInstance();
-    auto resourceManager = Resources::ResourceManager::getInstance();
+    auto threadPool = Utils::ThreadPool::getInstance();
 
-    std::ifstream modelsConfig { fileManager->getAbsolutePath(CONFIG_PATH) };
+    std::ifstream modelsConfig { fileManager->getAbsolutePath(configPath_) };
     nlohmann::json cfg;
     modelsConfig >> cfg;
 
     std::vector<JsonUtil::JSONImpoter::ModelImportInfo> modelsInfo;
     jsonImporter->loadModelsInfo(cfg, modelsInfo);
 
-    auto& rootNode = sceneManager->createRootNode();
-
-    Models_.resize(modelsInfo.size());
+    // Models_ must not be resized until every loading task is done, tasks keep references to its elements
+    Models_.resize(modelsInfo.size() * modelCopies_);
+    modelsLoading_.clear();
     for (int i = 0; i < Models_.size(); ++i) {
-        auto& modelInfo = modelsInfo[i];
+        auto& modelInfo = modelsInfo[i % modelsInfo.size()];
         auto& newModel = Models_[i];
 
-        newModel.setName(modelInfo.name);
+        const size_t copy = i / modelsInfo.size();
+        newModel.setName(copy == 0 ? modelInfo.name : modelInfo.name + "#" + std::to_string(copy));
         newModel.setFilename(modelInfo.filename);
         newModel.setPosition(modelInfo.position);
         newModel.setRotation(modelInfo.rotation);
         newModel.setScale(modelInfo.scale);
 
-        GLTFloader->load(newModel, newModel.getFilename());
-        newModel.init();
-        newModel.getModelRootNode()->setParent(&rootNode);
+        // glTF parsing, image decoding and geometry preparation do not need the context
+        modelsLoading_.push_back(threadPool->submit([GLTFloader, &newModel]() {
+            return GLTFloader->load(newModel, newModel.getFilename());
+        }));
+    }
+}
+
+
+void PotentialApp::initModels() {
+    PROFILE_SCOPE("PotentialApp::initModels");
+    auto sceneManager = SceneResources::SceneManager::getInstance();
+
+    {
+        PROFILE_SCOPE("PotentialApp::waitModels");
+        // The context thread helps with queued decoding instead of idling
+        auto threadPool = Utils::ThreadPool::getInstance();
+        for (auto& loading : modelsLoading_) {
+            threadPool->wait(loading);
+        }
+    }
+    modelsLoading_.clear();
+
+    auto& rootNode = sceneManager->createRootNode();
+
+    modelInitMs_.clear();
+    for (auto& model : Models_) {
+        auto initStart = std::chrono::steady_clock::now();
+        model.init();
+        modelInitMs_.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - initStart).count());
+
+        model.getModelRootNode()->setParent(&rootNode);
     }
     rootNode.printNode();
 }
 
 
 void PotentialApp::initLights() {
+    PROFILE_SCOPE("PotentialApp::initLights");
     auto sceneManager = SceneResources::SceneManager::getInstance();
     auto resourceManager = Resources::ResourceManager::getInstance();
 
@@ -460,6 +547,7 @@ void PotentialApp::initLights() {
 
 
 void PotentialApp::initRender() {
+    PROFILE_SCOPE("PotentialApp::initRender");
     auto sceneManager = SceneResources::SceneManager::getInstance();
     auto resourceManager = Resources::ResourceManager::getInstance();
     auto fileManager = FileSystem::FileManager::getInstance();
@@ -469,9 +557,17 @@ void PotentialApp::initRender() {
     shaderDesc.uri = "";
     shaderDesc.vertFilename = fileManager->getAbsolutePath("shaders://Model.vert");
     shaderDesc.fragFilename = fileManager->getAbsolutePath("shaders://Model.frag");
+    // Models are packed in the vertex format of the arena, the vertex shaders decode it
+    if (Resources::GeometryArena::getInstance()->getVertexFormat() == Resources::GeometryArena::VertexFormat::QUANTIZED)
+        shaderDesc.defines.push_back("QUANTIZED_VERTICES");
+    if (!SceneResources::RenderQueue::isVertexStorageSupported()) {
+        LOG_W("Vertex shaders have no storage blocks, object transforms are set as uniforms");
+        shaderDesc.defines.push_back("OBJECT_UNIFORMS");
+    }
 
     auto& modelShader = resourceManager->createShader(shaderDesc);
     modelShaderHandle_ = modelShader.handle;
+    Geometry::Mesh::setTextureUnits(modelShader);
 
     const std::vector<std::string> background2DTexturesNames = {
         fileManager->getAbsolutePath("textures://city.jpg")
@@ -490,6 +586,11 @@ void PotentialApp::initRender() {
         fileManager->getAbsolutePath("textures://bethnal_green_entrance_4k.hdr")
     };
 
+    // Environment images decode on workers while the environment shader is compiled and the previous ones are uploaded
+    resourceManager->prefetchImages(background2DTexturesNames);
+    resourceManager->prefetchImages(skyboxTexturesNames);
+    resourceManager->prefetchImages(equirectTexturesNames, true);
+
     sceneManager->createEnvironment(SceneResources::SceneManager::EnvironmentType::BACKGROUND_IMAGE_2D, background2DTexturesNames);
     sceneManager->createEnvironment(SceneResources::SceneManager::EnvironmentType::SKYBOX, skyboxTexturesNames);
     sceneManager->createEnvironment(SceneResources::SceneManager::EnvironmentType::EQUIRECTANGULAR, equirectTexturesNames, true);
@@ -513,6 +614,24 @@ void PotentialApp::initRender() {
 
     resourceManager->bindBufferShader("Lights", 1, modelShader);
 
+    // Static models are submitted with one indirect draw per run of primitives with the same state
+    if (multiDrawIndirect_ && SceneResources::RenderQueue::isMultiDrawIndirectSupported()) {
+        shaderDesc.name = MODEL_INDIRECT_SHADER_NAME;
+        shaderDesc.vertFilename = fileManager->getAbsolutePath("shaders://ModelIndirect.vert");
+        shaderDesc.fragFilename = fileManager->getAbsolutePath("shaders://ModelIndirect.frag");
+
+        auto& modelIndirectShader = resourceManager->createShader(shaderDesc);
+        modelIndirectShaderHandle_ = modelIndirectShader.handle;
+        Geometry::Mesh::setTextureUnits(modelIndirectShader);
+
+        resourceManager->bindBufferShader("Matrices", 0, modelIndirectShader);
+        resourceManager->bindBufferShader("Lights", 1, modelIndirectShader);
+        renderQueue_.setSubmissionMode(SceneResources::RenderQueue::MULTI_DRAW_INDIRECT, &modelIndirectShader);
+    }
+    else {
+        renderQueue_.setSubmissionMode(SceneResources::RenderQueue::DIRECT);
+    }
+
 
     Resources::ImageDesc fbImageDesc;
     fbImageDesc.name = MODEL_FRAMEBUFFER_NAME + std::string("_IMAGE");
@@ -589,3 +708,35 @@ void PotentialApp::processMovement() {
     }
 #endif
 }
+
+
+void PotentialApp::toggleCameraPathRecording() {
+    isRecordingCameraPath_ = !isRecordingCameraPath_;
+
+    if (isRecordingCameraPath_) {
+        LOG_I("Started recording camera path");
+        recordedCameraPath_.clear();
+        recordingStartTime_ = getTime();
+        return;
+    }
+
+    auto fileManager = FileSystem::FileManager::getInstance();
+    auto jsonImporter = JsonUtil::JSONImpoter::getInstance();
+
+    std::vector<JsonUtil::JSONImpoter::CameraKeyframeInfo> keyframes;
+    for (const auto& keyframe : recordedCameraPath_.getKeyframes()) {
+        keyframes.push_back({ keyframe.time, keyframe.position, keyframe.yaw, keyframe.pitch, keyframe.fov });
+    }
+
+    nlohmann::json cfg;
+    jsonImporter->dumpCameraPath(keyframes, cfg);
+
+    const std::string filename = fileManager->getAbsolutePath(RECORDED_CAMERA_PATH);
+    std::ofstream pathFile { filename };
+    if (!pathFile) {
+        LOG_E("Failed to write camera path to \'%s\'", filename.c_str());
+        return;
+    }
+    pathFile << cfg.dump(4);
+    LOG_I("Recorded %zu camera keyframes to \'%s\'", keyframes.size(), filename.c_str());
+}
@@ -0,0 +1,162 @@
+#include "ResourceManager.hpp"
+#include "FrameStats.hpp"
+#include "Logger.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <memory>
+
+// Linked in through the image decoder of ResourceManager, the application which defines it otherwise is not linked
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+
+// Material lookup as ResourceManager did it before the resource index, every create walked the whole name map
+class ScanRegistry {
+    std::unordered_map<std::string, std::unique_ptr<Resources::Material>> materials_;
+
+public:
+    bool hasMaterial(const std::string& name, const std::string& uri) const {
+        if (materials_.find(name) == materials_.end())
+            return false;
+
+        for (const auto& material : materials_) {
+            if (material.first != name)
+                continue;
+
+            if (material.second->uri == uri)
+                return true;
+        }
+        return false;
+    }
+
+    Resources::Material& createMaterial(const Resources::MaterialDesc& matDesc) {
+        if (hasMaterial(matDesc.name, matDesc.uri))
+            return *materials_[matDesc.name];
+
+        auto& newMaterial = materials_[matDesc.name] = std::make_unique<Resources::Material>();
+        newMaterial->name = matDesc.name;
+        newMaterial->uri = matDesc.uri;
+        newMaterial->type = Resources::RenderResource::ResourceType::MATERIAL;
+        return *newMaterial;
+    }
+};
+
+
+static void printUsage() {
+    printf("Usage: resource-bench [options]\n"
+           "  --min-resources <N>  Materials of the smallest synthetic scene (default 1000)\n"
+           "  --max-resources <N>  The count is doubled up to this one (default 8000)\n"
+           "  --lookups <N>        Creates of every material, the ones after the first are lookups of shared materials (default 4)\n"
+           "  --iterations <N>     Measured imports of every count (default 3)\n"
+           "  --output <file>      Results JSON (default resource_bench_output.json)\n");
+}
+
+
+int main(int argc, char** argv) {
+    uint32_t minResources = 1000;
+    uint32_t maxResources = 8000;
+    uint32_t lookups = 4;
+    uint32_t iterations = 3;
+    std::string outputPath = "resource_bench_output.json";
+
+    for (int i = 1; i < argc; ++i) {
+        const bool hasValue = i + 1 < argc;
+
+        if (!strcmp(argv[i], "--min-resources") && hasValue) {
+            minResources = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (!strcmp(argv[i], "--max-resources") && hasValue) {
+            maxResources = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (!strcmp(argv[i], "--lookups") && hasValue) {
+            lookups = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (!strcmp(argv[i], "--iterations") && hasValue) {
+            iterations = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (!strcmp(argv[i], "--output") && hasValue) {
+            outputPath = argv[++i];
+        }
+        else {
+            printUsage();
+            return strcmp(argv[i], "--help") ? 1 : 0;
+        }
+    }
+
+    // Every create logs, which would dominate the measurement
+    Utils::Logger::setLogLevel(Utils::LogLevel::LOG_LEVEL_WARN_ERROR);
+    auto resourceManager = Resources::ResourceManager::getInstance();
+
+    using Clock = std::chrono::steady_clock;
+    auto measure = [](auto&& function) {
+        const auto start = Clock::now();
+        function();
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    };
+
+    printf("%10s %14s %14s %16s %18s %10s\n", "resources", "scan ms", "indexed ms", "scan us/create", "indexed us/create", "speedup");
+
+    nlohmann::json counts = nlohmann::json::array();
+    bool isConsistent = true;
+    for (uint32_t count = minResources; count <= maxResources; count *= 2) {
+        std::vector<Resources::MaterialDesc> descs(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            descs[i].name = "material_" + std::to_string(i);
+            descs[i].uri = "synthetic://scene/materials/" + std::to_string(i);
+            std::fill(std::begin(descs[i].p_TexArray), std::end(descs[i].p_TexArray), nullptr);
+        }
+
+        Utils::FrameStats stats;
+        for (uint32_t iteration = 0; iteration < iterations; ++iteration) {
+            ScanRegistry scanRegistry;
+            stats.addSample("scan_ms", measure([&]() {
+                for (uint32_t lookup = 0; lookup < lookups; ++lookup) {
+                    for (const auto& desc : descs)
+                        scanRegistry.createMaterial(desc);
+                }
+            }));
+
+            std::vector<Resources::Material*> created(count);
+            stats.addSample("indexed_ms", measure([&]() {
+                for (uint32_t lookup = 0; lookup < lookups; ++lookup) {
+                    for (uint32_t i = 0; i < count; ++i)
+                        created[i] = &resourceManager->createMaterial(descs[i]);
+                }
+            }));
+
+            for (uint32_t i = 0; i < count; ++i)
+                isConsistent &= created[i]->uri == descs[i].uri;
+            resourceManager->cleanUp();
+        }
+
+        const double scanMs = stats.getSummary("scan_ms").p50;
+        const double indexedMs = stats.getSummary("indexed_ms").p50;
+        const double creates = static_cast<double>(count) * lookups;
+        printf("%10u %14.3f %14.3f %16.4f %18.4f %9.1fx\n", count, scanMs, indexedMs, 1000.0 * scanMs / creates,
+               1000.0 * indexedMs / creates, scanMs / indexedMs);
+
+        nlohmann::json item = stats.toJson();
+        item["resources"] = count;
+        counts.push_back(std::move(item));
+    }
+
+    if (!isConsistent)
+        printf("The resource index returned a material with another URI\n");
+
+    nlohmann::json result;
+    result["lookups"] = lookups;
+    result["iterations"] = iterations;
+    result["counts"] = std::move(counts);
+    result["consistent"] = isConsistent;
+
+    std::ofstream output { outputPath };
+    if (!output) {
+        fprintf(stderr, "Failed to write results to \'%s\'\n", outputPath.c_str());
+        return 1;
+    }
+    output << result.dump(4) << std::endl;
+
+    return isConsistent ? 0 : 1;
+}
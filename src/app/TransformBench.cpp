@@ -0,0 +1,154 @@
+#include "TransformHierarchy.hpp"
+#include "FrameStats.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <random>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/quaternion.hpp>
+
+
+// Node of the pointer based tree with the old update, every node recomputes its whole parent chain
+struct RecursiveNode {
+    RecursiveNode* parent = nullptr;
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    glm::vec3 scale = glm::vec3(1.0f);
+    glm::mat4 globalMatrix = glm::mat4(1.0f);
+
+    void calculateGlobalModelMatrix() {
+        globalMatrix = glm::translate(glm::mat4(1.0f), position) * glm::toMat4(rotation) * glm::scale(glm::mat4(1.0f), scale);
+        if (parent) {
+            parent->calculateGlobalModelMatrix();
+            globalMatrix = parent->globalMatrix * globalMatrix;
+        }
+    }
+};
+
+
+static void printUsage() {
+    printf("Usage: transform-bench [options]\n"
+           "  --nodes <N>          Nodes of the synthetic hierarchy (default 100000)\n"
+           "  --branching <N>      Children per node, the tree is filled level by level (default 4)\n"
+           "  --iterations <N>     Measured updates of every case (default 50)\n"
+           "  --moved <fraction>   Part of the nodes moved before each partial update (default 0.01)\n"
+           "  --output <file>      Results JSON (default transform_bench_output.json)\n");
+}
+
+
+int main(int argc, char** argv) {
+    uint32_t nodeCount = 100000;
+    uint32_t branching = 4;
+    uint32_t iterations = 50;
+    float movedFraction = 0.01f;
+    std::string outputPath = "transform_bench_output.json";
+
+    for (int i = 1; i < argc; ++i) {
+        const bool hasValue = i + 1 < argc;
+
+        if (!strcmp(argv[i], "--nodes") && hasValue) {
+            nodeCount = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (!strcmp(argv[i], "--branching") && hasValue) {
+            branching = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (!strcmp(argv[i], "--iterations") && hasValue) {
+            iterations = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (!strcmp(argv[i], "--moved") && hasValue) {
+            movedFraction = std::strtof(argv[++i], nullptr);
+        }
+        else if (!strcmp(argv[i], "--output") && hasValue) {
+            outputPath = argv[++i];
+        }
+        else {
+            printUsage();
+            return strcmp(argv[i], "--help") ? 1 : 0;
+        }
+    }
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+    std::uniform_int_distribution<uint32_t> anyNode(0, nodeCount - 1);
+
+    auto randomPosition = [&]() { return glm::vec3(offset(rng), offset(rng), offset(rng)); };
+    auto randomRotation = [&]() { return glm::angleAxis(offset(rng), glm::normalize(glm::vec3(offset(rng), offset(rng), 1.0f))); };
+
+    std::vector<RecursiveNode> recursiveNodes(nodeCount);
+    SceneResources::TransformHierarchy hierarchy;
+    hierarchy.reserve(nodeCount);
+
+    for (uint32_t i = 0; i < nodeCount; ++i) {
+        const uint32_t parent = i > 0 ? (i - 1) / branching : SceneResources::TransformHierarchy::INVALID_INDEX;
+        auto& node = recursiveNodes[i];
+        node.parent = i > 0 ? &recursiveNodes[parent] : nullptr;
+        node.position = randomPosition();
+        node.rotation = randomRotation();
+        node.scale = glm::vec3(1.0f + 0.01f * offset(rng));
+
+        hierarchy.add(parent, node.position, node.rotation, node.scale);
+    }
+
+    Utils::FrameStats stats;
+    using Clock = std::chrono::steady_clock;
+    auto measure = [&](const std::string& series, auto&& function) {
+        const auto start = Clock::now();
+        function();
+        stats.addSample(series, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+    };
+
+    for (uint32_t iteration = 0; iteration < iterations; ++iteration) {
+        measure("recursive_ms", [&]() {
+            for (auto& node : recursiveNodes)
+                node.calculateGlobalModelMatrix();
+        });
+
+        // Moving the root dirties the whole tree
+        hierarchy.setPosition(0, recursiveNodes[0].position);
+        measure("full_ms", [&]() { hierarchy.update(); });
+        stats.addSample("full_updated_nodes", hierarchy.getUpdatedCount());
+
+        const uint32_t movedCount = static_cast<uint32_t>(nodeCount * movedFraction);
+        for (uint32_t i = 0; i < movedCount; ++i) {
+            const uint32_t index = anyNode(rng);
+            hierarchy.setPosition(index, recursiveNodes[index].position);
+        }
+        measure("partial_ms", [&]() { hierarchy.update(); });
+        stats.addSample("partial_updated_nodes", hierarchy.getUpdatedCount());
+
+        measure("static_ms", [&]() { hierarchy.update(); });
+    }
+
+    float maxError = 0.0f;
+    for (uint32_t i = 0; i < nodeCount; ++i) {
+        const auto& expected = recursiveNodes[i].globalMatrix;
+        const auto& actual = hierarchy.getWorldMatrix(i);
+        for (int c = 0; c < 4; ++c)
+            maxError = std::max(maxError, glm::length(expected[c] - actual[c]));
+    }
+
+    printf("%u nodes, branching %u, %u iterations, max difference to the recursive update %g\n", nodeCount, branching, iterations, maxError);
+    for (const auto& series : stats.getSeriesNames()) {
+        const auto summary = stats.getSummary(series);
+        printf("  %-24s mean %10.3f  p50 %10.3f  p95 %10.3f\n", series.c_str(), summary.mean, summary.p50, summary.p95);
+    }
+
+    nlohmann::json result;
+    result["nodes"] = nodeCount;
+    result["branching"] = branching;
+    result["iterations"] = iterations;
+    result["movedFraction"] = movedFraction;
+    result["maxDifference"] = maxError;
+    result["stats"] = stats.toJson();
+
+    std::ofstream output { outputPath };
+    if (!output) {
+        fprintf(stderr, "Failed to write results to \'%s\'\n", outputPath.c_str());
+        return 1;
+    }
+    output << result.dump(4) << std::endl;
+
+    return 0;
+}
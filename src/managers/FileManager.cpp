@@ -1,8 +1,10 @@
+#include <cstdio>
 #include <iostream>
 
 #include "FileManager.hpp"
 
 #ifdef __ANDROID__
+#include <sys/stat.h>
 #include <unistd.h>
 #else
 #include <filesystem>
@@ -56,4 +58,35 @@ const std::string FileManager::getCurrentDirectory() const {
 #endif
 }
 
-}
\ No newline at end of file
+bool FileManager::createDirectories(const std::string& dirpath) const {
+#ifdef __ANDROID__
+    struct stat dirStat;
+    for (size_t pos = dirpath.find('/', 1); ; pos = dirpath.find('/', pos + 1)) {
+        std::string subpath = dirpath.substr(0, pos);
+        if (!subpath.empty() && stat(subpath.c_str(), &dirStat) != 0 && mkdir(subpath.c_str(), 0775) != 0)
+            return false;
+
+        if (pos == std::string::npos)
+            break;
+    }
+    return true;
+#else
+    std::error_code error;
+    std::filesystem::create_directories(dirpath, error);
+    return std::filesystem::is_directory(dirpath, error);
+#endif
+}
+
+bool FileManager::replaceFile(const std::string& tempPath, const std::string& path) const {
+    // rename does not replace existing files on Windows
+    if (std::rename(tempPath.c_str(), path.c_str()) != 0) {
+        std::remove(path.c_str());
+        if (std::rename(tempPath.c_str(), path.c_str()) != 0) {
+            std::remove(tempPath.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+}
@@ -1,22 +1,395 @@
 #include <iostream>
+#include <algorithm>
+#include <cstring>
 
 #include "GLTFLoader.hpp"
 #include "FileManager.hpp"
 #include "Logger.hpp"
+#include "Profiler.hpp"
+#include "ImageDecoder.hpp"
+#include "ThreadPool.hpp"
+#include "MappedFile.hpp"
+#include "MeshCache.hpp"
+#include "TextureCache.hpp"
+#include "Hash.hpp"
+
+#include <nlohmann/json.hpp>
 
 namespace GLTF {
 
 GLTFLoader* GLTFLoader::instancePtr = nullptr;
 
+static constexpr uint32_t GLB_MAGIC = 0x46546C67;          // "glTF"
+static constexpr uint32_t GLB_CHUNK_JSON = 0x4E4F534A;     // "JSON"
+static constexpr uint32_t GLB_CHUNK_BIN = 0x004E4942;      // "BIN\0"
+static constexpr size_t GLB_HEADER_SIZE = 12;
+static constexpr size_t GLB_CHUNK_HEADER_SIZE = 8;
+
+// One byte buffer which replaces mapped buffers in the JSON given to tinygltf, so it never copies them
+static constexpr const char* STUB_BUFFER_URI = "data:application/octet-stream;base64,AA==";
+
+using PendingImages = MeshCache::PendingImages;
+
+struct MappedBufferSource {
+    std::string uri;
+    std::shared_ptr<Utils::MappedFile> file;
+    size_t offset = 0;
+    size_t size = 0;
+};
+
+struct ImageLoadContext {
+    PendingImages pendingImages;
+    // Images stored in buffer views of mapped buffers, tinygltf only sees a stub for them
+    std::unordered_map<int, MappedBufferSource> mappedImages;
+    std::vector<std::string> cacheUris;
+    std::vector<bool> srgbImages;
+};
+
+// Replaces the stb_image callback of tinygltf: encoded bytes are sent to the decoder as soon as they are read,
+// so images decode on workers while the rest of the file is parsed
+static bool deferImageDecode(tinygltf::Image* image, const int imageIdx, std::string* err, std::string* warn,
+                             int reqWidth, int reqHeight, const unsigned char* bytes, int size, void* userData) {
+    auto context = reinterpret_cast<ImageLoadContext*>(userData);
+
+    const std::string cacheUri = imageIdx < context->cacheUris.size() ? context->cacheUris[imageIdx] : "";
+    const bool isSrgb = imageIdx < context->srgbImages.size() && context->srgbImages[imageIdx];
+
+    // 4 components, same as the default loader of tinygltf, which does not preserve image channels
+    auto threadPool = Utils::ThreadPool::getInstance();
+    if (auto it = context->mappedImages.find(imageIdx); it != context->mappedImages.end()) {
+        // The task holds the mapped file, so its bytes are decoded in place
+        const auto file = it->second.file;
+        const unsigned char* mappedBytes = file->data() + it->second.offset;
+        const size_t mappedSize = it->second.size;
+        context->pendingImages.emplace_back(imageIdx, threadPool->submit([file, mappedBytes, mappedSize, cacheUri, isSrgb]() {
+            return Resources::TextureCache::getInstance()->decodeMemory(mappedBytes, mappedSize, cacheUri, 4, isSrgb);
+        }));
+        return true;
+    }
+
+    // Bytes of data URIs and external files belong to tinygltf and are freed once the image is loaded
+    auto encoded = std::make_shared<std::vector<unsigned char>>(bytes, bytes + size);
+    context->pendingImages.emplace_back(imageIdx, threadPool->submit([encoded, cacheUri, isSrgb]() {
+        return Resources::TextureCache::getInstance()->decodeMemory(encoded->data(), encoded->size(), cacheUri, 4, isSrgb);
+    }));
+    return true;
+}
+
+
+static void markSrgbImage(std::vector<bool>& srgbImages, const int textureSource) {
+    if (textureSource >= 0 && textureSource < srgbImages.size())
+        srgbImages[textureSource] = true;
+}
+
+
+std::string GLTFLoader::getImageCacheUri(const std::string& imageUri, const std::string& baseDir, const int imageIdx) {
+    if (imageUri.empty() || tinygltf::IsDataURI(imageUri)) {
+        return baseDir + "#" + std::to_string(imageIdx);
+    }
+
+    std::string decodedUri;
+    tinygltf::URIDecode(imageUri, &decodedUri, nullptr);
+    return baseDir + decodedUri;
+}
+
+
+std::vector<bool> GLTFLoader::findSrgbImages(const tinygltf::Model& model) {
+    std::vector<bool> srgbImages(model.images.size(), false);
+    for (const auto& material : model.materials) {
+        for (int texIdx : { material.pbrMetallicRoughness.baseColorTexture.index, material.emissiveTexture.index }) {
+            if (texIdx >= 0 && texIdx < model.textures.size())
+                markSrgbImage(srgbImages, model.textures[texIdx].source);
+        }
+    }
+    return srgbImages;
+}
+
+
+// Same as GLTFLoader::findSrgbImages, but runs on the JSON before tinygltf starts decoding images
+static std::vector<bool> findSrgbImagesInJson(const nlohmann::json& gltfJson) {
+    const auto& images = gltfJson.value("images", nlohmann::json::array());
+    const auto& textures = gltfJson.value("textures", nlohmann::json::array());
+    const auto& materials = gltfJson.value("materials", nlohmann::json::array());
+
+    std::vector<bool> srgbImages(images.is_array() ? images.size() : 0, false);
+    if (!textures.is_array() || !materials.is_array()) {
+        return srgbImages;
+    }
+
+    for (const auto& material : materials) {
+        const auto pbr = material.value("pbrMetallicRoughness", nlohmann::json::object());
+        const auto baseColor = pbr.value("baseColorTexture", nlohmann::json::object());
+        const auto emissive = material.value("emissiveTexture", nlohmann::json::object());
+
+        for (int texIdx : { baseColor.value("index", -1), emissive.value("index", -1) }) {
+            if (texIdx >= 0 && texIdx < textures.size())
+                markSrgbImage(srgbImages, textures[texIdx].value("source", -1));
+        }
+    }
+    return srgbImages;
+}
+
+
+// Waits for the decoding tasks and moves the pixels into the model. Tasks are finished even if loading
+// failed, they reference nothing but their own bytes
+static bool resolveImages(tinygltf::Model& gltfModel, PendingImages& pendingImages, bool res) {
+    auto threadPool = Utils::ThreadPool::getInstance();
+    for (auto& [imageIdx, pending] : pendingImages) {
+        auto decoded = threadPool->wait(pending);
+        if (!res || imageIdx >= gltfModel.images.size()) {
+            continue;
+        }
+
+        auto& image = gltfModel.images[imageIdx];
+        if (!decoded.isValid()) {
+            LOG_E("Failed to decode image[%d] \'%s\'", imageIdx, image.uri.c_str());
+            res = false;
+            continue;
+        }
+
+        image.width = decoded.width;
+        image.height = decoded.height;
+        image.component = decoded.components;
+        image.bits = decoded.bits;
+        image.pixel_type = decoded.bits == 16 ? TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT : TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+        image.image = std::move(decoded.pixels);
+    }
+
+    return res;
+}
+
+
+static inline uint32_t readU32(const unsigned char* data) {
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+
+// Finds JSON and BIN chunks of a binary glTF, both point into the mapping
+static bool parseGLB(const Utils::MappedFile& file, const char*& json, size_t& jsonSize, const unsigned char*& bin, size_t& binSize) {
+    const unsigned char* data = file.data();
+    const size_t size = file.size();
+
+    if (size < GLB_HEADER_SIZE + GLB_CHUNK_HEADER_SIZE || readU32(data + 4) != 2 || readU32(data + 8) > size) {
+        return false;
+    }
+
+    const size_t length = readU32(data + 8);
+    size_t offset = GLB_HEADER_SIZE;
+    json = nullptr;
+    bin = nullptr;
+
+    while (offset + GLB_CHUNK_HEADER_SIZE <= length) {
+        const size_t chunkSize = readU32(data + offset);
+        const uint32_t chunkType = readU32(data + offset + 4);
+        const size_t chunkOffset = offset + GLB_CHUNK_HEADER_SIZE;
+        if (chunkOffset + chunkSize > length) {
+            return false;
+        }
+
+        if (chunkType == GLB_CHUNK_JSON && !json) {
+            json = reinterpret_cast<const char*>(data + chunkOffset);
+            jsonSize = chunkSize;
+        }
+        else if (chunkType == GLB_CHUNK_BIN && !bin) {
+            bin = data + chunkOffset;
+            binSize = chunkSize;
+        }
+
+        // Chunks are 4 byte aligned
+        offset = chunkOffset + ((chunkSize + 3) & ~size_t(3));
+    }
+
+    return json != nullptr;
+}
+
 
 bool GLTFLoader::load(Geometry::Model& model, const std::string& filename) {
+    PROFILE_SCOPE("GLTFLoader::load");
     auto fileManager = FileSystem::FileManager::getInstance();
     std::string absPath = fileManager->getAbsolutePath(filename);
+    std::string baseDir = Utils::fileBaseDir(absPath);
+
+    auto file = std::make_shared<Utils::MappedFile>();
+    if (!file->open(absPath)) {
+        LOG_E("Failed to load glTF: %s", filename.c_str());
+        return false;
+    }
+
+    auto meshCache = MeshCache::getInstance();
+    const uint64_t fileHash = meshCache->isEnabled() ? Utils::hashBytes(file->data(), file->size()) : 0;
+
+    PendingImages cachedImages;
+    if (meshCache->load(model, fileHash, baseDir, cachedImages)) {
+        if (!resolveImages(model.getModelRef(), cachedImages, true)) {
+            LOG_E("Failed to load glTF: %s", filename.c_str());
+            return false;
+        }
+        model.prepare();
+
+        std::lock_guard<std::mutex> lock(loadedModelsMutex_);
+        loadedModels[model.getName()] = &model;
+        LOG_I("Loaded glTF: %s", filename.c_str());
+        return true;
+    }
+
+    // .glb and .gltf are told apart by the magic, not by the extension
+    const char* jsonText = reinterpret_cast<const char*>(file->data());
+    size_t jsonSize = file->size();
+    const unsigned char* binChunk = nullptr;
+    size_t binSize = 0;
+
+    const bool isBinary = file->size() >= sizeof(uint32_t) && readU32(file->data()) == GLB_MAGIC;
+    if (isBinary && !parseGLB(*file, jsonText, jsonSize, binChunk, binSize)) {
+        LOG_E("Invalid binary glTF: %s", filename.c_str());
+        return false;
+    }
+
+    nlohmann::json gltfJson = nlohmann::json::parse(jsonText, jsonText + jsonSize, nullptr, false);
+    if (gltfJson.is_discarded() || !gltfJson.is_object()) {
+        LOG_E("Failed to parse glTF JSON: %s", filename.c_str());
+        return false;
+    }
+
+    // Every buffer except data URIs is mapped and replaced with a stub before tinygltf sees it
+    std::unordered_map<int, MappedBufferSource> mappedBuffers;
+    std::unordered_map<std::string, std::shared_ptr<Utils::MappedFile>> externalFiles;
+    ImageLoadContext imageContext;
+
+    if (gltfJson.contains("buffers") && gltfJson["buffers"].is_array()) {
+        auto& buffers = gltfJson["buffers"];
+        for (int i = 0; i < buffers.size(); ++i) {
+            auto& buffer = buffers[i];
+            const size_t byteLength = buffer.value("byteLength", size_t(0));
+
+            MappedBufferSource source;
+            if (!buffer.contains("uri")) {
+                if (!binChunk || byteLength > binSize) {
+                    LOG_E("Buffer %d of %s has no data", i, filename.c_str());
+                    return false;
+                }
+                source = { "", file, static_cast<size_t>(binChunk - file->data()), byteLength };
+            }
+            else {
+                const std::string uri = buffer["uri"].get<std::string>();
+                if (uri.rfind("data:", 0) == 0) {
+                    continue;
+                }
+
+                std::string decodedUri;
+                tinygltf::URIDecode(uri, &decodedUri, nullptr);
+
+                auto& externalFile = externalFiles[decodedUri];
+                if (!externalFile) {
+                    externalFile = std::make_shared<Utils::MappedFile>();
+                    if (!externalFile->open(baseDir + decodedUri)) {
+                        LOG_E("Failed to load glTF: %s", filename.c_str());
+                        return false;
+                    }
+                }
+
+                if (byteLength > externalFile->size()) {
+                    LOG_E("Buffer \'%s\' of %s is shorter than its byteLength", uri.c_str(), filename.c_str());
+                    return false;
+                }
+                source = { uri, externalFile, 0, byteLength };
+            }
+
+            mappedBuffers[i] = source;
+            buffer["uri"] = STUB_BUFFER_URI;
+            buffer["byteLength"] = 1;
+        }
+    }
+
+    if (gltfJson.contains("images") && gltfJson["images"].is_array()) {
+        for (int i = 0; i < gltfJson["images"].size(); ++i)
+            imageContext.cacheUris.push_back(getImageCacheUri(gltfJson["images"][i].value("uri", ""), baseDir, i));
+    }
+    imageContext.srgbImages = findSrgbImagesInJson(gltfJson);
+
+    // tinygltf would read images in buffer views from the stubs, they are pointed at a one byte stub view
+    // and their bytes are taken from the mapping in deferImageDecode
+    std::unordered_map<int, int> imagesBufferViews;
+
+    if (gltfJson.contains("images") && gltfJson["images"].is_array() && gltfJson.contains("bufferViews")) {
+        auto& images = gltfJson["images"];
+        auto& bufferViews = gltfJson["bufferViews"];
+        const int stubView = static_cast<int>(bufferViews.size());
+
+        for (int i = 0; i < images.size(); ++i) {
+            auto& image = images[i];
+            if (!image.contains("bufferView")) {
+                continue;
+            }
+
+            const int viewIdx = image["bufferView"].get<int>();
+            if (viewIdx < 0 || viewIdx >= stubView) {
+                continue;
+            }
+
+            const auto& view = bufferViews[viewIdx];
+            auto it = mappedBuffers.find(view.value("buffer", -1));
+            if (it == mappedBuffers.end()) {
+                continue;
+            }
+
+            const size_t viewOffset = view.value("byteOffset", size_t(0));
+            const size_t viewLength = view.value("byteLength", size_t(0));
+            if (viewOffset + viewLength > it->second.size) {
+                continue;
+            }
+
+            imageContext.mappedImages[i] = { it->second.uri, it->second.file, it->second.offset + viewOffset, viewLength };
+            imagesBufferViews[i] = viewIdx;
+            image["bufferView"] = stubView;
+        }
+
+        if (!imagesBufferViews.empty()) {
+            int stubBuffer = bufferViews[imagesBufferViews.begin()->second].value("buffer", 0);
+            bufferViews.push_back({ { "buffer", stubBuffer }, { "byteOffset", 0 }, { "byteLength", 1 } });
+        }
+    }
+
+    const std::string patchedJson = gltfJson.dump();
+    gltfJson = nlohmann::json();
 
     std::string err;
     std::string warn;
 
-    bool res = loader_.LoadASCIIFromFile(&model.getModelRef(), &err, &warn, absPath.c_str());
+    tinygltf::TinyGLTF loader;
+    loader.SetImageLoader(deferImageDecode, &imageContext);
+    bool res = loader.LoadASCIIFromString(&model.getModelRef(), &err, &warn, patchedJson.c_str(), static_cast<unsigned>(patchedJson.size()), baseDir);
+
+    auto& gltfModel = model.getModelRef();
+    res = resolveImages(gltfModel, imageContext.pendingImages, res);
+
+    if (res) {
+        // Undo the stubs, so the model describes the source file again
+        for (const auto& [imageIdx, viewIdx] : imagesBufferViews) {
+            gltfModel.images[imageIdx].bufferView = viewIdx;
+        }
+        if (!imagesBufferViews.empty()) {
+            gltfModel.bufferViews.pop_back();
+        }
+
+        for (const auto& [bufferIdx, source] : mappedBuffers) {
+            auto& buffer = gltfModel.buffers[bufferIdx];
+            buffer.data.clear();
+            buffer.data.shrink_to_fit();
+            buffer.uri = source.uri;
+            model.addMappedBuffer(bufferIdx, source.file, source.offset, source.size);
+        }
+
+        // Packing the geometry and simplifying it are the expensive parts of preparing, the entry stores their result
+        model.prepare();
+
+        // Sorted by URI, so the hash of the entry does not depend on the order of the map
+        MeshCache::Dependencies dependencies(externalFiles.begin(), externalFiles.end());
+        std::sort(dependencies.begin(), dependencies.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+        meshCache->store(model, fileHash, dependencies);
+    }
+
     if (!warn.empty()) {
         LOG_W("%s", warn.c_str());
     }
@@ -29,10 +402,11 @@ bool GLTFLoader::load(Geometry::Model& model, const std::string& filename) {
         LOG_E("Failed to load glTF: %s", filename.c_str());
     }
     else {
+        std::lock_guard<std::mutex> lock(loadedModelsMutex_);
         loadedModels[model.getName()] = &model;
         LOG_I("Loaded glTF: %s", filename.c_str());
     }
     return res;
 }
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,196 @@
+#include <algorithm>
+#include <cstddef>
+
+#include "GeometryArena.hpp"
+#include "RenderContext.hpp"
+#include "Logger.hpp"
+
+
+namespace Resources {
+
+GeometryArena* GeometryArena::instancePtr = nullptr;
+
+static inline size_t alignUp(const size_t value, const size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+
+GeometryArena::Allocation GeometryArena::allocate(const size_t size, const size_t alignment) {
+    Allocation allocation;
+    if (size == 0) {
+        return allocation;
+    }
+
+    for (uint32_t i = 0; i < blocks_.size(); ++i) {
+        if (allocateFromBlock(i, size, alignment, allocation))
+            return allocation;
+    }
+
+    const uint32_t newBlock = createBlock(std::max(DEFAULT_BLOCK_SIZE, alignUp(size, alignment)));
+    if (newBlock == UINT32_MAX || !allocateFromBlock(newBlock, size, alignment, allocation)) {
+        LOG_E("Failed to allocate %zu bytes of geometry", size);
+    }
+    return allocation;
+}
+
+
+void GeometryArena::upload(const Allocation& allocation, const void* data, const size_t size, const size_t offset) {
+    if (!allocation.isValid() || offset + size > allocation.size) {
+        LOG_E("Geometry upload of %zu bytes at %zu is out of its allocation", size, offset);
+        return;
+    }
+
+    // The copy target does not disturb the array and element bindings of the current VAO
+    glBindBuffer(GL_COPY_WRITE_BUFFER, allocation.GL_id);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.offset + offset, size, data);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+
+void GeometryArena::free(Allocation& allocation) {
+    if (!allocation.isValid() || allocation.block >= blocks_.size()) {
+        return;
+    }
+
+    auto& freeRanges = blocks_[allocation.block].freeRanges;
+    size_t offset = allocation.offset;
+    size_t size = allocation.size;
+
+    auto next = freeRanges.lower_bound(offset);
+    if (next != freeRanges.end() && offset + size == next->first) {
+        size += next->second;
+        next = freeRanges.erase(next);
+    }
+    if (next != freeRanges.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset) {
+            offset = prev->first;
+            size += prev->second;
+            freeRanges.erase(prev);
+        }
+    }
+    freeRanges[offset] = size;
+
+    usedBytes_ -= allocation.size;
+    allocation = Allocation();
+}
+
+
+unsigned GeometryArena::getVertexArray(const Allocation& vertices, const Allocation& indices) {
+    if (!vertices.isValid() || !indices.isValid()) {
+        return 0;
+    }
+
+    const auto key = std::make_pair(vertices.block, indices.block);
+    if (auto it = vertexArrays_.find(key); it != vertexArrays_.end()) {
+        return it->second;
+    }
+
+    auto renderContext = RenderContext::getInstance();
+    unsigned vao = 0;
+    glGenVertexArrays(1, &vao);
+    renderContext->bindVertexArray(vao);
+
+    glBindBuffer(GL_ARRAY_BUFFER, vertices.GL_id);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+    if (vertexFormat_ == VertexFormat::QUANTIZED) {
+        // Decoded by VertexInput.h with QUANTIZED_VERTICES defined
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(QuantizedVertex), (void*)offsetof(QuantizedVertex, position));
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(QuantizedVertex), (void*)offsetof(QuantizedVertex, normal));
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(QuantizedVertex), (void*)offsetof(QuantizedVertex, uv));
+    }
+    else {
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, uv));
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices.GL_id);
+
+    renderContext->bindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    vertexArrays_[key] = vao;
+    return vao;
+}
+
+
+void GeometryArena::setVertexFormat(const VertexFormat format) {
+    if (format != vertexFormat_ && !blocks_.empty()) {
+        LOG_W("Vertex format cannot change once geometry has been allocated");
+        return;
+    }
+    vertexFormat_ = format;
+}
+
+
+bool GeometryArena::allocateFromBlock(const uint32_t blockIdx, const size_t size, const size_t alignment, Allocation& allocation) {
+    auto& block = blocks_[blockIdx];
+    const size_t alignedSize = alignUp(size, alignment);
+
+    // First fit, the padding in front of an aligned range stays free
+    for (auto it = block.freeRanges.begin(); it != block.freeRanges.end(); ++it) {
+        const size_t rangeOffset = it->first;
+        const size_t rangeEnd = it->first + it->second;
+        const size_t offset = alignUp(rangeOffset, alignment);
+        if (offset + alignedSize > rangeEnd)
+            continue;
+
+        block.freeRanges.erase(it);
+        if (offset > rangeOffset)
+            block.freeRanges[rangeOffset] = offset - rangeOffset;
+        if (offset + alignedSize < rangeEnd)
+            block.freeRanges[offset + alignedSize] = rangeEnd - offset - alignedSize;
+
+        allocation.GL_id = block.GL_id;
+        allocation.block = blockIdx;
+        allocation.offset = offset;
+        allocation.size = alignedSize;
+
+        usedBytes_ += alignedSize;
+        return true;
+    }
+    return false;
+}
+
+
+uint32_t GeometryArena::createBlock(const size_t size) {
+    Block block;
+    block.size = size;
+    block.freeRanges[0] = size;
+
+    glGenBuffers(1, &block.GL_id);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, block.GL_id);
+    glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    if (glGetError() == GL_OUT_OF_MEMORY) {
+        glDeleteBuffers(1, &block.GL_id);
+        return UINT32_MAX;
+    }
+
+    reservedBytes_ += size;
+    LOG_I("Created geometry block of %.1f MB, %.1f MB reserved in total", size / (1024.0 * 1024.0), reservedBytes_ / (1024.0 * 1024.0));
+
+    blocks_.push_back(std::move(block));
+    return static_cast<uint32_t>(blocks_.size() - 1);
+}
+
+
+void GeometryArena::cleanUp() {
+    for (auto& [blocks, vao] : vertexArrays_) {
+        RenderContext::getInstance()->onVertexArrayDeleted(vao);
+        glDeleteVertexArrays(1, &vao);
+    }
+    vertexArrays_.clear();
+
+    for (auto& block : blocks_) {
+        glDeleteBuffers(1, &block.GL_id);
+    }
+    blocks_.clear();
+    reservedBytes_ = 0;
+    usedBytes_ = 0;
+}
+
+}
@@ -57,4 +57,55 @@ void JSONImpoter::loadModelsInfo(const nlohmann::json& cfg, std::vector<ModelImp
     }
 }
 
+
+void JSONImpoter::loadCameraPath(const nlohmann::json& cfg, std::vector<CameraKeyframeInfo>& keyframes) {
+    const auto& path = cfg.find("cameraPath");
+    if (path != cfg.end() && path->is_array()) {
+        for (auto keyIt = path->begin(); keyIt != path->end(); ++keyIt) {
+            float time = 0.0f;
+            if (auto keyTime = keyIt->find("time"); keyTime != keyIt->end() && keyTime->is_number())
+                time = *keyTime;
+
+            glm::vec3 position = glm::vec3(0.0);
+            if (auto keyPosition = keyIt->find("position"); keyPosition != keyIt->end() && keyPosition->is_array()) {
+                unsigned i = 0;
+                for (auto posIt = keyPosition->begin(); posIt != keyPosition->end() && i < 3; ++posIt, ++i) {
+                    if (!posIt->is_number())
+                        continue;
+
+                    position[i] = *posIt;
+                }
+            }
+
+            float yaw = -90.0f;
+            if (auto keyYaw = keyIt->find("yaw"); keyYaw != keyIt->end() && keyYaw->is_number())
+                yaw = *keyYaw;
+
+            float pitch = 0.0f;
+            if (auto keyPitch = keyIt->find("pitch"); keyPitch != keyIt->end() && keyPitch->is_number())
+                pitch = *keyPitch;
+
+            float fov = 90.0f;
+            if (auto keyFov = keyIt->find("fov"); keyFov != keyIt->end() && keyFov->is_number())
+                fov = *keyFov;
+
+            keyframes.push_back({ time, position, yaw, pitch, fov });
+        }
+    }
+}
+
+void JSONImpoter::dumpCameraPath(const std::vector<CameraKeyframeInfo>& keyframes, nlohmann::json& cfg) {
+    auto& path = cfg["cameraPath"];
+    path = nlohmann::json::array();
+    for (const auto& keyframe : keyframes) {
+        path.push_back({
+            { "time", keyframe.time },
+            { "position", { keyframe.position.x, keyframe.position.y, keyframe.position.z } },
+            { "yaw", keyframe.yaw },
+            { "pitch", keyframe.pitch },
+            { "fov", keyframe.fov }
+        });
+    }
+}
+
 }
\ No newline at end of file
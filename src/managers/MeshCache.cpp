@@ -0,0 +1,680 @@
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "MeshCache.hpp"
+#include "FileManager.hpp"
+#include "Logger.hpp"
+#include "Profiler.hpp"
+#include "ThreadPool.hpp"
+#include "Hash.hpp"
+#include "GLTFLoader.hpp"
+#include "TextureCache.hpp"
+
+#include <nlohmann/json.hpp>
+
+namespace GLTF {
+
+static constexpr uint32_t MESH_CACHE_MAGIC = 0x4853454D;      // "MESH"
+// Bump whenever the layout or the stored description changes
+static constexpr uint32_t MESH_CACHE_VERSION = 4;
+static constexpr size_t BLOB_ALIGNMENT = 64;
+static constexpr size_t BUFFER_VIEW_ALIGNMENT = 16;
+
+struct MeshCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sourceHash;            // glTF file and all of its external buffers
+    uint64_t metadataOffset;
+    uint64_t metadataSize;
+    uint64_t blobOffset;
+    uint64_t blobSize;
+};
+
+// Part of the blob written by store()
+struct BlobChunk {
+    size_t offset;
+    const void* data;
+    size_t size;
+};
+
+static inline size_t alignUp(const size_t value, const size_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+
+static nlohmann::json textureInfoToJson(const int index, const int texCoord) {
+    return { { "index", index }, { "texCoord", texCoord } };
+}
+
+
+static nlohmann::json materialToJson(const tinygltf::Material& material) {
+    const auto& pbr = material.pbrMetallicRoughness;
+    return {
+        { "name", material.name },
+        { "baseColorFactor", pbr.baseColorFactor },
+        { "baseColorTexture", textureInfoToJson(pbr.baseColorTexture.index, pbr.baseColorTexture.texCoord) },
+        { "metallicFactor", pbr.metallicFactor },
+        { "roughnessFactor", pbr.roughnessFactor },
+        { "metallicRoughnessTexture", textureInfoToJson(pbr.metallicRoughnessTexture.index, pbr.metallicRoughnessTexture.texCoord) },
+        { "normalTexture", textureInfoToJson(material.normalTexture.index, material.normalTexture.texCoord) },
+        { "normalScale", material.normalTexture.scale },
+        { "occlusionTexture", textureInfoToJson(material.occlusionTexture.index, material.occlusionTexture.texCoord) },
+        { "occlusionStrength", material.occlusionTexture.strength },
+        { "emissiveTexture", textureInfoToJson(material.emissiveTexture.index, material.emissiveTexture.texCoord) },
+        { "emissiveFactor", material.emissiveFactor },
+        { "alphaMode", material.alphaMode },
+        { "alphaCutoff", material.alphaCutoff },
+        { "doubleSided", material.doubleSided }
+    };
+}
+
+
+static void materialFromJson(const nlohmann::json& json, tinygltf::Material& material) {
+    auto& pbr = material.pbrMetallicRoughness;
+    material.name = json.at("name").get<std::string>();
+    pbr.baseColorFactor = json.at("baseColorFactor").get<std::vector<double>>();
+    pbr.baseColorTexture.index = json.at("baseColorTexture").at("index").get<int>();
+    pbr.baseColorTexture.texCoord = json.at("baseColorTexture").at("texCoord").get<int>();
+    pbr.metallicFactor = json.at("metallicFactor").get<double>();
+    pbr.roughnessFactor = json.at("roughnessFactor").get<double>();
+    pbr.metallicRoughnessTexture.index = json.at("metallicRoughnessTexture").at("index").get<int>();
+    pbr.metallicRoughnessTexture.texCoord = json.at("metallicRoughnessTexture").at("texCoord").get<int>();
+    material.normalTexture.index = json.at("normalTexture").at("index").get<int>();
+    material.normalTexture.texCoord = json.at("normalTexture").at("texCoord").get<int>();
+    material.normalTexture.scale = json.at("normalScale").get<double>();
+    material.occlusionTexture.index = json.at("occlusionTexture").at("index").get<int>();
+    material.occlusionTexture.texCoord = json.at("occlusionTexture").at("texCoord").get<int>();
+    material.occlusionTexture.strength = json.at("occlusionStrength").get<double>();
+    material.emissiveTexture.index = json.at("emissiveTexture").at("index").get<int>();
+    material.emissiveTexture.texCoord = json.at("emissiveTexture").at("texCoord").get<int>();
+    material.emissiveFactor = json.at("emissiveFactor").get<std::vector<double>>();
+    material.alphaMode = json.at("alphaMode").get<std::string>();
+    material.alphaCutoff = json.at("alphaCutoff").get<double>();
+    material.doubleSided = json.at("doubleSided").get<bool>();
+}
+
+
+// Describes everything Model and Mesh read, buffer views already point into the blob of the entry
+static nlohmann::json modelToJson(const tinygltf::Model& model, const std::vector<BlobChunk>& viewChunks) {
+    nlohmann::json json;
+
+    auto& bufferViews = json["bufferViews"] = nlohmann::json::array();
+    for (size_t i = 0; i < model.bufferViews.size(); ++i) {
+        const auto& view = model.bufferViews[i];
+        bufferViews.push_back({
+            { "byteOffset", viewChunks[i].offset },
+            { "byteLength", viewChunks[i].size },
+            { "byteStride", view.byteStride },
+            { "target", view.target }
+        });
+    }
+
+    auto& accessors = json["accessors"] = nlohmann::json::array();
+    for (const auto& accessor : model.accessors) {
+        accessors.push_back({
+            { "bufferView", accessor.bufferView },
+            { "byteOffset", accessor.byteOffset },
+            { "normalized", accessor.normalized },
+            { "componentType", accessor.componentType },
+            { "count", accessor.count },
+            { "type", accessor.type },
+            { "min", accessor.minValues },
+            { "max", accessor.maxValues }
+        });
+    }
+
+    auto& meshes = json["meshes"] = nlohmann::json::array();
+    for (const auto& mesh : model.meshes) {
+        nlohmann::json primitives = nlohmann::json::array();
+        for (const auto& primitive : mesh.primitives) {
+            primitives.push_back({
+                { "attributes", primitive.attributes },
+                { "indices", primitive.indices },
+                { "material", primitive.material },
+                { "mode", primitive.mode }
+            });
+        }
+        meshes.push_back({ { "name", mesh.name }, { "primitives", std::move(primitives) } });
+    }
+
+    auto& nodes = json["nodes"] = nlohmann::json::array();
+    for (const auto& node : model.nodes) {
+        nodes.push_back({
+            { "name", node.name },
+            { "mesh", node.mesh },
+            { "children", node.children },
+            { "translation", node.translation },
+            { "rotation", node.rotation },
+            { "scale", node.scale },
+            { "matrix", node.matrix }
+        });
+    }
+
+    auto& scenes = json["scenes"] = nlohmann::json::array();
+    for (const auto& scene : model.scenes) {
+        scenes.push_back({ { "name", scene.name }, { "nodes", scene.nodes } });
+    }
+    json["defaultScene"] = model.defaultScene;
+
+    auto& materials = json["materials"] = nlohmann::json::array();
+    for (const auto& material : model.materials) {
+        materials.push_back(materialToJson(material));
+    }
+
+    auto& textures = json["textures"] = nlohmann::json::array();
+    for (const auto& texture : model.textures) {
+        textures.push_back({ { "name", texture.name }, { "source", texture.source }, { "sampler", texture.sampler } });
+    }
+
+    auto& samplers = json["samplers"] = nlohmann::json::array();
+    for (const auto& sampler : model.samplers) {
+        samplers.push_back({
+            { "name", sampler.name },
+            { "minFilter", sampler.minFilter },
+            { "magFilter", sampler.magFilter },
+            { "wrapS", sampler.wrapS },
+            { "wrapT", sampler.wrapT }
+        });
+    }
+
+    auto& images = json["images"] = nlohmann::json::array();
+    for (const auto& image : model.images) {
+        images.push_back({
+            { "name", image.name },
+            { "uri", image.uri },
+            { "mimeType", image.mimeType },
+            { "bufferView", image.bufferView }
+        });
+    }
+
+    return json;
+}
+
+
+static void modelFromJson(const nlohmann::json& json, tinygltf::Model& model) {
+    for (const auto& item : json.at("bufferViews")) {
+        auto& view = model.bufferViews.emplace_back();
+        view.buffer = 0;
+        view.byteOffset = item.at("byteOffset").get<size_t>();
+        view.byteLength = item.at("byteLength").get<size_t>();
+        view.byteStride = item.at("byteStride").get<size_t>();
+        view.target = item.at("target").get<int>();
+    }
+
+    for (const auto& item : json.at("accessors")) {
+        auto& accessor = model.accessors.emplace_back();
+        accessor.bufferView = item.at("bufferView").get<int>();
+        accessor.byteOffset = item.at("byteOffset").get<size_t>();
+        accessor.normalized = item.at("normalized").get<bool>();
+        accessor.componentType = item.at("componentType").get<int>();
+        accessor.count = item.at("count").get<size_t>();
+        accessor.type = item.at("type").get<int>();
+        accessor.minValues = item.at("min").get<std::vector<double>>();
+        accessor.maxValues = item.at("max").get<std::vector<double>>();
+    }
+
+    for (const auto& item : json.at("meshes")) {
+        auto& mesh = model.meshes.emplace_back();
+        mesh.name = item.at("name").get<std::string>();
+        for (const auto& primitiveItem : item.at("primitives")) {
+            auto& primitive = mesh.primitives.emplace_back();
+            primitive.attributes = primitiveItem.at("attributes").get<std::map<std::string, int>>();
+            primitive.indices = primitiveItem.at("indices").get<int>();
+            primitive.material = primitiveItem.at("material").get<int>();
+            primitive.mode = primitiveItem.at("mode").get<int>();
+        }
+    }
+
+    for (const auto& item : json.at("nodes")) {
+        auto& node = model.nodes.emplace_back();
+        node.name = item.at("name").get<std::string>();
+        node.mesh = item.at("mesh").get<int>();
+        node.children = item.at("children").get<std::vector<int>>();
+        node.translation = item.at("translation").get<std::vector<double>>();
+        node.rotation = item.at("rotation").get<std::vector<double>>();
+        node.scale = item.at("scale").get<std::vector<double>>();
+        node.matrix = item.at("matrix").get<std::vector<double>>();
+    }
+
+    for (const auto& item : json.at("scenes")) {
+        auto& scene = model.scenes.emplace_back();
+        scene.name = item.at("name").get<std::string>();
+        scene.nodes = item.at("nodes").get<std::vector<int>>();
+    }
+    model.defaultScene = json.at("defaultScene").get<int>();
+
+    for (const auto& item : json.at("materials")) {
+        materialFromJson(item, model.materials.emplace_back());
+    }
+
+    for (const auto& item : json.at("textures")) {
+        auto& texture = model.textures.emplace_back();
+        texture.name = item.at("name").get<std::string>();
+        texture.source = item.at("source").get<int>();
+        texture.sampler = item.at("sampler").get<int>();
+    }
+
+    for (const auto& item : json.at("samplers")) {
+        auto& sampler = model.samplers.emplace_back();
+        sampler.name = item.at("name").get<std::string>();
+        sampler.minFilter = item.at("minFilter").get<int>();
+        sampler.magFilter = item.at("magFilter").get<int>();
+        sampler.wrapS = item.at("wrapS").get<int>();
+        sampler.wrapT = item.at("wrapT").get<int>();
+    }
+
+    for (const auto& item : json.at("images")) {
+        auto& image = model.images.emplace_back();
+        image.name = item.at("name").get<std::string>();
+        image.uri = item.at("uri").get<std::string>();
+        image.mimeType = item.at("mimeType").get<std::string>();
+        image.bufferView = item.at("bufferView").get<int>();
+    }
+}
+
+
+static nlohmann::json cacheStatisticsToJson(const SceneResources::VertexCacheStatistics& statistics) {
+    return { statistics.transformedVertices, statistics.triangles, statistics.vertices };
+}
+
+
+static SceneResources::VertexCacheStatistics cacheStatisticsFromJson(const nlohmann::json& json) {
+    SceneResources::VertexCacheStatistics statistics;
+    statistics.transformedVertices = json.at(0).get<size_t>();
+    statistics.triangles = json.at(1).get<size_t>();
+    statistics.vertices = json.at(2).get<size_t>();
+    return statistics;
+}
+
+
+// Packed geometry of the model with its levels of detail and occluders. Vertices and indices are stored in the blob
+// as they are in memory, occluders are concatenated in two more chunks
+static nlohmann::json geometryToJson(const Geometry::Model& model, const BlobChunk& vertexChunk, const BlobChunk& indexChunk,
+                                     const BlobChunk& occluderPositionChunk, const BlobChunk& occluderIndexChunk) {
+    nlohmann::json json;
+    json["vertexOffset"] = vertexChunk.offset;
+    json["vertexCount"] = vertexChunk.size / sizeof(Resources::GeometryArena::Vertex);
+    json["indexOffset"] = indexChunk.offset;
+    json["indexCount"] = indexChunk.size / sizeof(uint32_t);
+    json["occluderPositionOffset"] = occluderPositionChunk.offset;
+    json["occluderIndexOffset"] = occluderIndexChunk.offset;
+
+    const auto& occluders = model.getOccluders();
+    auto& meshes = json["meshes"] = nlohmann::json::array();
+    for (const auto& meshRanges : model.getPrimitiveRanges()) {
+        nlohmann::json primitives = nlohmann::json::array();
+        for (const auto& range : meshRanges) {
+            nlohmann::json lods = nlohmann::json::array();
+            for (uint32_t lod = 0; lod < range.lodCount; ++lod) {
+                lods.push_back({ range.lods[lod].indexCount, range.lods[lod].firstIndex, range.lods[lod].error });
+            }
+
+            const auto& bounds = range.bounds;
+            primitives.push_back({
+                { "mode", range.mode },
+                { "indexCount", range.indexCount },
+                { "firstIndex", range.firstIndex },
+                { "baseVertex", range.baseVertex },
+                { "vertexCount", range.vertexCount },
+                { "min", { bounds.minCorner.x, bounds.minCorner.y, bounds.minCorner.z } },
+                { "max", { bounds.maxCorner.x, bounds.maxCorner.y, bounds.maxCorner.z } },
+                { "lods", std::move(lods) },
+                { "occluder", range.occluder ? range.occluder - occluders.data() : -1 }
+            });
+        }
+        meshes.push_back(std::move(primitives));
+    }
+
+    auto& occluderItems = json["occluders"] = nlohmann::json::array();
+    for (const auto& occluder : occluders) {
+        occluderItems.push_back({ occluder.positions.size(), occluder.indices.size() });
+    }
+
+    json["authoredCacheStatistics"] = cacheStatisticsToJson(model.getAuthoredCacheStatistics());
+    json["optimizedCacheStatistics"] = cacheStatisticsToJson(model.getOptimizedCacheStatistics());
+    return json;
+}
+
+
+static bool geometryFromJson(const nlohmann::json& json, const unsigned char* blob, const size_t blobSize, Geometry::Model::PackedGeometry& geometry) {
+    const size_t vertexOffset = json.at("vertexOffset").get<size_t>();
+    const size_t vertexCount = json.at("vertexCount").get<size_t>();
+    const size_t indexOffset = json.at("indexOffset").get<size_t>();
+    const size_t indexCount = json.at("indexCount").get<size_t>();
+    if (vertexOffset + vertexCount * sizeof(Resources::GeometryArena::Vertex) > blobSize || indexOffset + indexCount * sizeof(uint32_t) > blobSize)
+        return false;
+
+    geometry.vertices.resize(vertexCount);
+    std::memcpy(geometry.vertices.data(), blob + vertexOffset, vertexCount * sizeof(Resources::GeometryArena::Vertex));
+    geometry.indices.resize(indexCount);
+    std::memcpy(geometry.indices.data(), blob + indexOffset, indexCount * sizeof(uint32_t));
+
+    // Occluders are read first, so the ranges can point to them
+    size_t occluderPositionOffset = json.at("occluderPositionOffset").get<size_t>();
+    size_t occluderIndexOffset = json.at("occluderIndexOffset").get<size_t>();
+    for (const auto& item : json.at("occluders")) {
+        const size_t positionCount = item.at(0).get<size_t>();
+        const size_t occluderIndexCount = item.at(1).get<size_t>();
+        if (occluderPositionOffset + positionCount * sizeof(glm::vec3) > blobSize || occluderIndexOffset + occluderIndexCount * sizeof(uint32_t) > blobSize)
+            return false;
+
+        auto& occluder = geometry.occluders.emplace_back();
+        occluder.positions.resize(positionCount);
+        std::memcpy(occluder.positions.data(), blob + occluderPositionOffset, positionCount * sizeof(glm::vec3));
+        occluder.indices.resize(occluderIndexCount);
+        std::memcpy(occluder.indices.data(), blob + occluderIndexOffset, occluderIndexCount * sizeof(uint32_t));
+        occluderPositionOffset += positionCount * sizeof(glm::vec3);
+        occluderIndexOffset += occluderIndexCount * sizeof(uint32_t);
+
+        // The occlusion buffer does not check the indices it rasterizes
+        for (const uint32_t index : occluder.indices) {
+            if (index >= positionCount)
+                return false;
+        }
+    }
+
+    for (const auto& meshItem : json.at("meshes")) {
+        auto& meshRanges = geometry.primitiveRanges.emplace_back();
+        for (const auto& item : meshItem) {
+            auto& range = meshRanges.emplace_back();
+            range.mode = item.at("mode").get<GLenum>();
+            range.indexCount = item.at("indexCount").get<uint32_t>();
+            range.firstIndex = item.at("firstIndex").get<uint32_t>();
+            range.baseVertex = item.at("baseVertex").get<int32_t>();
+            range.vertexCount = item.at("vertexCount").get<uint32_t>();
+            const auto minCorner = item.at("min").get<std::vector<float>>();
+            const auto maxCorner = item.at("max").get<std::vector<float>>();
+            if (minCorner.size() != 3 || maxCorner.size() != 3)
+                return false;
+            range.bounds.minCorner = glm::vec3(minCorner[0], minCorner[1], minCorner[2]);
+            range.bounds.maxCorner = glm::vec3(maxCorner[0], maxCorner[1], maxCorner[2]);
+
+            const int occluder = item.at("occluder").get<int>();
+            if (occluder >= static_cast<int>(geometry.occluders.size()))
+                return false;
+            range.occluder = occluder >= 0 ? &geometry.occluders[occluder] : nullptr;
+
+            const auto& lods = item.at("lods");
+            if (lods.size() > Geometry::PrimitiveRange::MAX_LODS)
+                return false;
+            for (const auto& lodItem : lods) {
+                auto& lod = range.lods[range.lodCount++];
+                lod.indexCount = lodItem.at(0).get<uint32_t>();
+                lod.firstIndex = lodItem.at(1).get<uint32_t>();
+                lod.error = lodItem.at(2).get<float>();
+                if (lod.firstIndex + static_cast<size_t>(lod.indexCount) > indexCount)
+                    return false;
+            }
+
+            if (range.indexCount > 0 && (range.firstIndex + static_cast<size_t>(range.indexCount) > indexCount || range.baseVertex < 0 ||
+                                         range.baseVertex + static_cast<size_t>(range.vertexCount) > vertexCount))
+                return false;
+        }
+    }
+
+    geometry.authoredCacheStatistics = cacheStatisticsFromJson(json.at("authoredCacheStatistics"));
+    geometry.optimizedCacheStatistics = cacheStatisticsFromJson(json.at("optimizedCacheStatistics"));
+    return true;
+}
+
+
+std::string MeshCache::getEntryPath(const uint64_t fileHash) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.mesh", static_cast<unsigned long long>(fileHash));
+    return FileSystem::FileManager::getInstance()->getAbsolutePath("cache://meshes/") + name;
+}
+
+
+bool MeshCache::load(Geometry::Model& model, const uint64_t fileHash, const std::string& baseDir, PendingImages& pendingImages) {
+    if (!enabled_) {
+        return false;
+    }
+
+    PROFILE_SCOPE("MeshCache::load");
+    const std::string entryPath = getEntryPath(fileHash);
+
+    // A missing entry is the usual cold start, it is not worth a log
+    std::ifstream probe(entryPath, std::ios::binary);
+    if (!probe.is_open()) {
+        return false;
+    }
+    probe.close();
+
+    auto entry = std::make_shared<Utils::MappedFile>();
+    if (!entry->open(entryPath)) {
+        return false;
+    }
+
+    MeshCacheHeader header;
+    if (entry->size() < sizeof(header)) {
+        LOG_W("Mesh cache entry %s is truncated", entryPath.c_str());
+        return false;
+    }
+
+    std::memcpy(&header, entry->data(), sizeof(header));
+    if (header.magic != MESH_CACHE_MAGIC || header.version != MESH_CACHE_VERSION ||
+        header.metadataOffset + header.metadataSize > entry->size() || header.blobOffset + header.blobSize > entry->size()) {
+        LOG_W("Mesh cache entry %s is outdated or corrupted", entryPath.c_str());
+        return false;
+    }
+
+    const unsigned char* metadataBegin = entry->data() + header.metadataOffset;
+    nlohmann::json metadata = nlohmann::json::from_msgpack(metadataBegin, metadataBegin + header.metadataSize, true, false);
+    if (metadata.is_discarded() || !metadata.is_object()) {
+        LOG_W("Mesh cache entry %s is corrupted", entryPath.c_str());
+        return false;
+    }
+
+    // Only the name of the entry depends on the glTF file, external buffers are verified here
+    uint64_t sourceHash = fileHash;
+    Geometry::Model::PackedGeometry geometry;
+    bool isValid = false;
+    try {
+        for (const auto& uri : metadata.at("dependencies")) {
+            Utils::MappedFile dependency;
+            if (!dependency.open(baseDir + uri.get<std::string>())) {
+                return false;
+            }
+            sourceHash = Utils::combineHash(sourceHash, Utils::hashBytes(dependency.data(), dependency.size()));
+        }
+
+        if (sourceHash != header.sourceHash) {
+            LOG_I("Mesh cache entry %s is stale", entryPath.c_str());
+            return false;
+        }
+
+        modelFromJson(metadata.at("model"), model.getModelRef());
+        isValid = geometryFromJson(metadata.at("geometry"), entry->data() + header.blobOffset, header.blobSize, geometry);
+    }
+    catch (const nlohmann::json::exception& e) {
+        LOG_W("Mesh cache entry %s is corrupted: %s", entryPath.c_str(), e.what());
+        model.getModelRef() = tinygltf::Model();
+        return false;
+    }
+
+    auto& gltfModel = model.getModelRef();
+    for (const auto& view : gltfModel.bufferViews) {
+        isValid = isValid && view.byteOffset + view.byteLength <= header.blobSize;
+    }
+    if (!isValid) {
+        LOG_W("Mesh cache entry %s is corrupted", entryPath.c_str());
+        gltfModel = tinygltf::Model();
+        return false;
+    }
+
+    gltfModel.buffers.emplace_back();
+    model.addMappedBuffer(0, entry, header.blobOffset, header.blobSize);
+    model.restorePackedGeometry(std::move(geometry));
+
+    // Encoded images are decoded the same way as by GLTFLoader, either from the blob or from their own files
+    auto threadPool = Utils::ThreadPool::getInstance();
+    auto textureCache = Resources::TextureCache::getInstance();
+    const std::vector<bool> srgbImages = GLTFLoader::findSrgbImages(gltfModel);
+
+    for (int i = 0; i < gltfModel.images.size(); ++i) {
+        const auto& image = gltfModel.images[i];
+        const std::string cacheUri = GLTFLoader::getImageCacheUri(image.uri, baseDir, i);
+        const bool isSrgb = srgbImages[i];
+
+        if (image.bufferView >= 0 && image.bufferView < gltfModel.bufferViews.size()) {
+            const auto& view = gltfModel.bufferViews[image.bufferView];
+            const unsigned char* bytes = entry->data() + header.blobOffset + view.byteOffset;
+            const size_t size = view.byteLength;
+            pendingImages.emplace_back(i, threadPool->submit([textureCache, entry, bytes, size, cacheUri, isSrgb]() {
+                return textureCache->decodeMemory(bytes, size, cacheUri, 4, isSrgb);
+            }));
+        }
+        else if (tinygltf::IsDataURI(image.uri)) {
+            auto encoded = std::make_shared<std::vector<unsigned char>>();
+            std::string mimeType;
+            tinygltf::DecodeDataURI(encoded.get(), mimeType, image.uri, 0, false);
+            pendingImages.emplace_back(i, threadPool->submit([textureCache, encoded, cacheUri, isSrgb]() {
+                return textureCache->decodeMemory(encoded->data(), encoded->size(), cacheUri, 4, isSrgb);
+            }));
+        }
+        else {
+            pendingImages.emplace_back(i, threadPool->submit([textureCache, cacheUri, isSrgb]() {
+                Utils::MappedFile file;
+                if (!file.open(cacheUri)) {
+                    return Resources::TextureCache::DecodedImage();
+                }
+                return textureCache->decodeMemory(file.data(), file.size(), cacheUri, 4, isSrgb);
+            }));
+        }
+    }
+
+    LOG_I("Loaded %s from mesh cache", model.getFilename().c_str());
+    return true;
+}
+
+
+void MeshCache::store(const Geometry::Model& model, const uint64_t fileHash, const Dependencies& dependencies) {
+    if (!enabled_) {
+        return;
+    }
+
+    PROFILE_SCOPE("MeshCache::store");
+    const auto& gltfModel = model.getModelRef();
+
+    // Once the geometry is packed only images read buffer views, the others are stored empty
+    std::vector<bool> isImageView(gltfModel.bufferViews.size(), false);
+    for (const auto& image : gltfModel.images) {
+        if (image.bufferView >= 0 && image.bufferView < isImageView.size())
+            isImageView[image.bufferView] = true;
+    }
+
+    // Buffer views are packed one after another, data between them is not used by the model
+    std::vector<BlobChunk> viewChunks(gltfModel.bufferViews.size(), { 0, nullptr, 0 });
+    size_t blobSize = 0;
+    for (size_t i = 0; i < gltfModel.bufferViews.size(); ++i) {
+        const auto& view = gltfModel.bufferViews[i];
+        if (!isImageView[i]) {
+            continue;
+        }
+
+        if (view.buffer < 0 || view.buffer >= gltfModel.buffers.size() ||
+            view.byteOffset + view.byteLength > model.getBufferSize(view.buffer)) {
+            LOG_W("Model %s is not cached: buffer view %zu is out of its buffer", model.getFilename().c_str(), i);
+            return;
+        }
+
+        viewChunks[i] = { alignUp(blobSize, BUFFER_VIEW_ALIGNMENT), model.getBufferData(view.buffer) + view.byteOffset, view.byteLength };
+        blobSize = viewChunks[i].offset + view.byteLength;
+    }
+
+    std::vector<glm::vec3> occluderPositions;
+    std::vector<uint32_t> occluderIndices;
+    for (const auto& occluder : model.getOccluders()) {
+        occluderPositions.insert(occluderPositions.end(), occluder.positions.begin(), occluder.positions.end());
+        occluderIndices.insert(occluderIndices.end(), occluder.indices.begin(), occluder.indices.end());
+    }
+
+    // Indices of the levels of detail follow the full detail ones in the same array
+    const auto& vertices = model.getPackedVertices();
+    const auto& indices = model.getPackedIndices();
+    const BlobChunk vertexChunk = { alignUp(blobSize, BUFFER_VIEW_ALIGNMENT), vertices.data(), vertices.size() * sizeof(vertices[0]) };
+    blobSize = vertexChunk.offset + vertexChunk.size;
+    const BlobChunk indexChunk = { alignUp(blobSize, BUFFER_VIEW_ALIGNMENT), indices.data(), indices.size() * sizeof(indices[0]) };
+    blobSize = indexChunk.offset + indexChunk.size;
+    const BlobChunk occluderPositionChunk = { alignUp(blobSize, BUFFER_VIEW_ALIGNMENT), occluderPositions.data(), occluderPositions.size() * sizeof(glm::vec3) };
+    blobSize = occluderPositionChunk.offset + occluderPositionChunk.size;
+    const BlobChunk occluderIndexChunk = { alignUp(blobSize, BUFFER_VIEW_ALIGNMENT), occluderIndices.data(), occluderIndices.size() * sizeof(uint32_t) };
+    blobSize = occluderIndexChunk.offset + occluderIndexChunk.size;
+
+    uint64_t sourceHash = fileHash;
+    nlohmann::json metadata;
+    auto& dependencyUris = metadata["dependencies"] = nlohmann::json::array();
+    for (const auto& [uri, file] : dependencies) {
+        sourceHash = Utils::combineHash(sourceHash, Utils::hashBytes(file->data(), file->size()));
+        dependencyUris.push_back(uri);
+    }
+    metadata["model"] = modelToJson(gltfModel, viewChunks);
+    metadata["geometry"] = geometryToJson(model, vertexChunk, indexChunk, occluderPositionChunk, occluderIndexChunk);
+
+    const std::vector<std::uint8_t> packedMetadata = nlohmann::json::to_msgpack(metadata);
+
+    MeshCacheHeader header;
+    header.magic = MESH_CACHE_MAGIC;
+    header.version = MESH_CACHE_VERSION;
+    header.sourceHash = sourceHash;
+    header.metadataOffset = sizeof(header);
+    header.metadataSize = packedMetadata.size();
+    header.blobOffset = alignUp(header.metadataOffset + header.metadataSize, BLOB_ALIGNMENT);
+    header.blobSize = blobSize;
+
+    auto fileManager = FileSystem::FileManager::getInstance();
+    if (!fileManager->createDirectories(fileManager->getAbsolutePath("cache://meshes"))) {
+        LOG_W("Model %s is not cached: failed to create the cache directory", model.getFilename().c_str());
+        return;
+    }
+
+    // Entries are written aside and renamed, so a concurrent load never maps a half written file
+    static std::atomic<uint32_t> tempCounter{ 0 };
+    const std::string entryPath = getEntryPath(fileHash);
+    const std::string tempPath = entryPath + ".tmp" + std::to_string(tempCounter++);
+
+    std::ofstream output(tempPath, std::ios::binary | std::ios::trunc);
+    if (!output.is_open()) {
+        LOG_W("Model %s is not cached: failed to write %s", model.getFilename().c_str(), tempPath.c_str());
+        return;
+    }
+
+    const char padding[BLOB_ALIGNMENT] = {};
+    output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    output.write(reinterpret_cast<const char*>(packedMetadata.data()), packedMetadata.size());
+    output.write(padding, header.blobOffset - header.metadataOffset - header.metadataSize);
+
+    std::vector<BlobChunk> chunks = viewChunks;
+    chunks.push_back(vertexChunk);
+    chunks.push_back(indexChunk);
+    chunks.push_back(occluderPositionChunk);
+    chunks.push_back(occluderIndexChunk);
+
+    size_t written = 0;
+    for (const auto& chunk : chunks) {
+        if (chunk.size == 0) {
+            continue;
+        }
+        output.write(padding, chunk.offset - written);
+        output.write(reinterpret_cast<const char*>(chunk.data), chunk.size);
+        written = chunk.offset + chunk.size;
+    }
+    output.close();
+
+    if (!output) {
+        LOG_W("Model %s is not cached: failed to write %s", model.getFilename().c_str(), tempPath.c_str());
+        std::remove(tempPath.c_str());
+        return;
+    }
+
+    if (!fileManager->replaceFile(tempPath, entryPath)) {
+        LOG_W("Model %s is not cached: failed to write %s", model.getFilename().c_str(), entryPath.c_str());
+        return;
+    }
+
+    LOG_I("Stored %s in mesh cache", model.getFilename().c_str());
+}
+
+}
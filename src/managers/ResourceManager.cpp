@@ -1,6 +1,11 @@
+#include <algorithm>
+
 #include "ResourceManager.hpp"
+#include "RenderContext.hpp"
 #include "Logger.hpp"
-#include "stb_image.h"
+#include "ThreadPool.hpp"
+#include "MipChain.hpp"
+#include "Hash.hpp"
 
 namespace Resources {
 
@@ -13,9 +18,65 @@ static inline ResourceHandle createNewResourceHandle() {
 
 ResourceManager* ResourceManager::instancePtr = nullptr;
 
+// glTexStorage2D is core since GL 4.2, older contexts leave the pointer empty
+static inline bool hasTextureStorage() {
+#ifdef __ANDROID__
+    return true;
+#else
+    return glTexStorage2D != nullptr;
+#endif
+}
+
+// Immutable storage only accepts sized formats
+static GLenum getSizedInternalFormat(const GLint internalFormat, const int bits) {
+#ifndef __ANDROID__
+    const bool isShort = bits == 16;
+#else
+    const bool isShort = false;
+#endif
+
+    switch (internalFormat) {
+    case GL_RED:
+        return isShort ? GL_R16 : GL_R8;
+    case GL_RG:
+        return isShort ? GL_RG16 : GL_RG8;
+    case GL_RGB:
+        return isShort ? GL_RGB16 : GL_RGB8;
+    case GL_RGBA:
+        return isShort ? GL_RGBA16 : GL_RGBA8;
+    default:
+        return internalFormat;
+    }
+}
+
+// Textures which bring their whole mip chain are never respecified, so they get immutable storage
+static bool allocateImmutableStorage(const GLenum target, const Image& image, const GLint internalFormat) {
+    if (image.levels <= 1 || !hasTextureStorage())
+        return false;
+
+    glTexStorage2D(target, image.levels, getSizedInternalFormat(internalFormat, image.bits), image.width, image.height);
+    return true;
+}
+
+// Uploads level 0 and the mip chain stored after it
+static void uploadImageLevels(const GLenum target, const Image& image, const GLint internalFormat, const GLenum format, const GLenum type, const bool isImmutable) {
+    const int pixelSize = image.components * (image.bits / 8);
+    for (int level = 0; level < image.levels; ++level) {
+        const int width = std::max(1, image.width >> level);
+        const int height = std::max(1, image.height >> level);
+        // Render targets and released images have no pixels, their storage is only allocated
+        const unsigned char* data = image.image.empty() ? nullptr : image.image.data() + Utils::getMipLevelOffset(image.width, image.height, pixelSize, level);
+
+        if (isImmutable)
+            glTexSubImage2D(target, level, 0, 0, width, height, format, type, data);
+        else
+            glTexImage2D(target, level, internalFormat, width, height, 0, format, type, data);
+    }
+}
+
 Image& ResourceManager::createImage(const ImageDesc& imageDesc) {
-    if (hasImage(imageDesc.name, imageDesc.uri))
-        return getImage(imageDesc.name);
+    if (auto existing = findResource(RenderResource::ResourceType::IMAGE, imageDesc.name, imageDesc.uri))
+        return *static_cast<Image*>(existing);
 
     LOG_I("Creating image '\%s\' with URI \'%s\'", imageDesc.name.c_str(), imageDesc.uri.c_str());
 
@@ -26,20 +87,25 @@ Image& ResourceManager::createImage(const ImageDesc& imageDesc) {
     newImage->width = imageDesc.width;
     newImage->height = imageDesc.height;
     newImage->format = imageDesc.format;
+    newImage->levels = imageDesc.levels;
+    newImage->keepCpuCopy = imageDesc.keepCpuCopy;
     newImage->name = imageDesc.name;
     newImage->uri = imageDesc.uri;
 
     newImage->type = RenderResource::ResourceType::IMAGE;
 
-    size_t bytesize = imageDesc.width * imageDesc.height * imageDesc.components * (imageDesc.bits / 8);
-    newImage->image.resize(bytesize);
+    // Images without data are render targets, a zeroed copy of them is only kept on request
+    size_t bytesize = Utils::getMipChainSize(imageDesc.width, imageDesc.height, imageDesc.components * (imageDesc.bits / 8), imageDesc.levels);
     if (imageDesc.p_data) {
-        std::copy(imageDesc.p_data, imageDesc.p_data + bytesize, newImage->image.begin());
+        newImage->image.assign(imageDesc.p_data, imageDesc.p_data + bytesize);
+    }
+    else if (residencyPolicy_ == ResidencyPolicy::KEEP_CPU_COPIES || imageDesc.keepCpuCopy) {
+        newImage->image.resize(bytesize);
     }
 
     newImage->handle = createNewResourceHandle();
     images_[newImage->name] = newImage;
-    allResources_[newImage->handle] = newImage;
+    registerResource(newImage);
 
     return *newImage;
 }
@@ -48,40 +114,30 @@ Image& ResourceManager::createImage(const char* filename, bool isHdr) {
     if (hasImage(filename))
         return getImage(filename);
 
-    int width, height, nrChannels;
-    unsigned char* data = nullptr;
-    if (isHdr) {
-        data = reinterpret_cast<unsigned char*>(stbi_loadf(filename, &width, &height, &nrChannels, 0));
+    TextureCache::DecodedImage decoded;
+    if (auto it = pendingImages_.find(filename); it != pendingImages_.end()) {
+        decoded = Utils::ThreadPool::getInstance()->wait(it->second);
+        pendingImages_.erase(it);
     }
     else {
-        stbi_hdr_to_ldr_gamma(1.0f);
-        data = stbi_load(filename, &width, &height, &nrChannels, 0);
+        decoded = TextureCache::getInstance()->decodeFile(filename, isHdr, false);
     }
 
-    if (data) {
+    if (decoded.isValid()) {
         ImageDesc imageDesc;
         imageDesc.name = filename;
         imageDesc.uri = filename;
-        imageDesc.width = width;
-        imageDesc.height = height;
-        imageDesc.components = nrChannels;
-        imageDesc.p_data = data;
-
-        if (isHdr) {
-            imageDesc.bits = 8 * sizeof(float);
-        }
-        else {
-            imageDesc.bits = 8;                     // stb_image automatically converts
-        }
+        imageDesc.width = decoded.width;
+        imageDesc.height = decoded.height;
+        imageDesc.components = decoded.components;
+        imageDesc.bits = decoded.bits;
+        imageDesc.levels = decoded.levels;
+        imageDesc.p_data = decoded.pixels.data();
 
-        auto& im = createImage(imageDesc);
-
-        stbi_image_free(data);
-        return im;
+        return createImage(imageDesc);
     }
     else {
         LOG_E("Failed to load image: \'%s\'", filename);
-        stbi_image_free(data);
         return getImage(Image::DefaultImages::DEFAULT_IMAGE_BLACK);
     }
 }
@@ -90,9 +146,21 @@ Image& ResourceManager::createImage(const std::string& filename, bool isHdr) {
     return createImage(filename.c_str(), isHdr);
 }
 
+void ResourceManager::prefetchImages(const std::vector<std::string>& filenames, bool isHdr) {
+    auto textureCache = TextureCache::getInstance();
+
+    for (const auto& filename : filenames) {
+        if (hasImage(filename) || pendingImages_.find(filename) != pendingImages_.end())
+            continue;
+
+        // Image files are used with linear formats, see chooseDefaultInternalFormat
+        pendingImages_[filename] = textureCache->decodeFileAsync(filename, isHdr, false);
+    }
+}
+
 Sampler& ResourceManager::createSampler(const SamplerDesc& samplerDesc) {
-    if (hasSampler(samplerDesc.name, samplerDesc.uri))
-        return getSampler(samplerDesc.name);
+    if (auto existing = findResource(RenderResource::ResourceType::SAMPLER, samplerDesc.name, samplerDesc.uri))
+        return *static_cast<Sampler*>(existing);
 
     LOG_I("Creating sampler \'%s\' with URI \'%s\'", samplerDesc.name.c_str(), samplerDesc.uri.c_str());
 
@@ -108,6 +176,7 @@ Sampler& ResourceManager::createSampler(const SamplerDesc& samplerDesc) {
     newSampler->wrapS = samplerDesc.wrapS;
     newSampler->wrapT = samplerDesc.wrapT;
     newSampler->wrapR = samplerDesc.wrapR;
+    newSampler->maxAnisotropy = 1.0f;
 
     glGenSamplers(1, &newSampler->GL_id);
     glSamplerParameteri(newSampler->GL_id, GL_TEXTURE_WRAP_S, samplerDesc.wrapS);
@@ -116,16 +185,22 @@ Sampler& ResourceManager::createSampler(const SamplerDesc& samplerDesc) {
     glSamplerParameteri(newSampler->GL_id, GL_TEXTURE_MIN_FILTER, samplerDesc.minFilter);
     glSamplerParameteri(newSampler->GL_id, GL_TEXTURE_MAG_FILTER, samplerDesc.magFilter);
 
+#ifdef GL_TEXTURE_MAX_ANISOTROPY
+    newSampler->maxAnisotropy = std::min(samplerDesc.maxAnisotropy, getMaxSupportedAnisotropy());
+    if (newSampler->maxAnisotropy > 1.0f)
+        glSamplerParameterf(newSampler->GL_id, GL_TEXTURE_MAX_ANISOTROPY, newSampler->maxAnisotropy);
+#endif
+
     newSampler->handle = createNewResourceHandle();
     samplers_[newSampler->name] = newSampler;
-    allResources_[newSampler->handle] = newSampler;
+    registerResource(newSampler);
 
     return *newSampler;
 }
 
 Texture& ResourceManager::createTexture(const TextureDesc& textureDesc) {
-    if (hasTexture(textureDesc.name, textureDesc.uri))
-        return getTexture(textureDesc.name);
+    if (auto existing = findResource(RenderResource::ResourceType::TEXTURE, textureDesc.name, textureDesc.uri))
+        return *static_cast<Texture*>(existing);
 
     LOG_I("Creating texture \'%s\' with URI \'%s\'", textureDesc.name.c_str(), textureDesc.uri.c_str());
 
@@ -152,9 +227,9 @@ Texture& ResourceManager::createTexture(const TextureDesc& textureDesc) {
     glGenTextures(1, &newTexture->GL_id);
 
     if(textureDesc.faces == 1)
-        glBindTexture(GL_TEXTURE_2D, newTexture->GL_id);
+        RenderContext::getInstance()->bindTexture(GL_TEXTURE_2D, newTexture->GL_id);
     else if(textureDesc.faces == 6)
-        glBindTexture(GL_TEXTURE_CUBE_MAP, newTexture->GL_id);
+        RenderContext::getInstance()->bindTexture(GL_TEXTURE_CUBE_MAP, newTexture->GL_id);
     else {
         LOG_E("Number of faces must be 1 or 6");
         delete newTexture;
@@ -164,7 +239,11 @@ Texture& ResourceManager::createTexture(const TextureDesc& textureDesc) {
     
     newTexture->sampler = textureDesc.p_sampler;
     if (!newTexture->sampler) {
-        newTexture->sampler = &getSampler(Sampler::DefaultSamplers::DEFAULT_SAMPLER_LINEAR_REPEAT);
+        // Mipmapped filtering needs the chain, single level textures would be incomplete with it
+        if (textureDesc.p_images[0]->levels > 1)
+            newTexture->sampler = &getSampler(Sampler::DefaultSamplers::DEFAULT_SAMPLER_TRILINEAR_ANISOTROPIC_REPEAT);
+        else
+            newTexture->sampler = &getSampler(Sampler::DefaultSamplers::DEFAULT_SAMPLER_LINEAR_REPEAT);
     }
 
     bool isFloat = false;
@@ -202,7 +281,7 @@ Texture& ResourceManager::createTexture(const TextureDesc& textureDesc) {
                 0,
                 GL_DEPTH_COMPONENT,
                 type,
-                newTexture->images[0]->image.data()
+                newTexture->images[0]->image.empty() ? nullptr : newTexture->images[0]->image.data()
             );
         }
         else {
@@ -231,21 +310,17 @@ Texture& ResourceManager::createTexture(const TextureDesc& textureDesc) {
                 type = GL_UNSIGNED_SHORT;
             }
 
-            glTexImage2D(
-                GL_TEXTURE_2D,
-                0,
-                textureDesc.format,
-                newTexture->images[0]->width,
-                newTexture->images[0]->height,
-                0,
-                format,
-                type,
-                newTexture->images[0]->image.data()
-            );
+            const bool isImmutable = allocateImmutableStorage(GL_TEXTURE_2D, *newTexture->images[0], textureDesc.format);
+            uploadImageLevels(GL_TEXTURE_2D, *newTexture->images[0], textureDesc.format, format, type, isImmutable);
         }
-        glBindTexture(GL_TEXTURE_2D, 0);
+        RenderContext::getInstance()->bindTexture(GL_TEXTURE_2D, 0);
     }
     else {
+        bool sameLevels = true;
+        for (int i = 1; i < newTexture->faces; ++i)
+            sameLevels = sameLevels && newTexture->images[i]->levels == newTexture->images[0]->levels;
+
+        const bool isImmutable = sameLevels && allocateImmutableStorage(GL_TEXTURE_CUBE_MAP, *newTexture->images[0], textureDesc.format);
         for (int i = 0; i < newTexture->faces; ++i) {
             GLenum format = GL_RGBA;
             switch (newTexture->images[i]->components) {
@@ -273,23 +348,13 @@ Texture& ResourceManager::createTexture(const TextureDesc& textureDesc) {
                 type = GL_UNSIGNED_SHORT;
             }
 
-            glTexImage2D(
-                GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
-                0,
-                textureDesc.format,
-                newTexture->images[i]->width,
-                newTexture->images[i]->height,
-                0,
-                format,
-                type,
-                newTexture->images[i]->image.data()
-            );
+            uploadImageLevels(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, *newTexture->images[i], textureDesc.format, format, type, isImmutable);
         }
-        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+        RenderContext::getInstance()->bindTexture(GL_TEXTURE_CUBE_MAP, 0);
     }
 
     newTexture->handle = createNewResourceHandle();
-    allResources_[newTexture->handle] = newTexture;
+    registerResource(newTexture);
     textures_[newTexture->name] = newTexture;
 
     return *newTexture;
@@ -320,29 +385,29 @@ Texture& ResourceManager::createTexture(const std::string& filename, bool isHdr,
 void ResourceManager::bindTexture(const std::string& name, const unsigned texUnit) {
     auto& texture = getTexture(name);
     GLenum target = texture.faces == 6 ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
-    glActiveTexture(GL_TEXTURE0 + texUnit);
-    glBindTexture(target, texture.GL_id);
-    glBindSampler(texUnit, texture.sampler->GL_id);
+    auto renderContext = RenderContext::getInstance();
+    renderContext->bindTexture(texUnit, target, texture.GL_id);
+    renderContext->bindSampler(texUnit, texture.sampler->GL_id);
 }
 
 void ResourceManager::bindTexture(const ResourceHandle handle, const unsigned texUnit) {
     auto& texture = getTexture(handle);
     GLenum target = texture.faces == 6 ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
-    glActiveTexture(GL_TEXTURE0 + texUnit);
-    glBindTexture(target, texture.GL_id);
-    glBindSampler(texUnit, texture.sampler->GL_id);
+    auto renderContext = RenderContext::getInstance();
+    renderContext->bindTexture(texUnit, target, texture.GL_id);
+    renderContext->bindSampler(texUnit, texture.sampler->GL_id);
 }
 
 void ResourceManager::unbindTexture(const GLenum target, const unsigned texUnit) {
-    glActiveTexture(GL_TEXTURE0 + texUnit);
-    glBindTexture(target, 0);
-    glBindSampler(texUnit, 0);
+    auto renderContext = RenderContext::getInstance();
+    renderContext->bindTexture(texUnit, target, 0);
+    renderContext->bindSampler(texUnit, 0);
 }
 
 
 Material& ResourceManager::createMaterial(const MaterialDesc& matDesc) {
-    if (hasMaterial(matDesc.name, matDesc.uri))
-        return getMaterial(matDesc.name);
+    if (auto existing = findResource(RenderResource::ResourceType::MATERIAL, matDesc.name, matDesc.uri))
+        return *static_cast<Material*>(existing);
 
     Material* newMaterial = new Material();
 
@@ -358,14 +423,14 @@ Material& ResourceManager::createMaterial(const MaterialDesc& matDesc) {
 
     newMaterial->handle = createNewResourceHandle();
     materials_[newMaterial->name] = newMaterial;
-    allResources_[newMaterial->handle] = newMaterial;
+    registerResource(newMaterial);
 
     return *newMaterial;
 }
 
 Buffer& ResourceManager::createBuffer(const BufferDesc& bufDesc) {
-    if (hasBuffer(bufDesc.name, bufDesc.uri))
-        return getBuffer(bufDesc.name);
+    if (auto existing = findResource(RenderResource::ResourceType::BUFFER, bufDesc.name, bufDesc.uri))
+        return *static_cast<Buffer*>(existing);
 
     Buffer* newBuffer = new Buffer();
 
@@ -375,22 +440,29 @@ Buffer& ResourceManager::createBuffer(const BufferDesc& bufDesc) {
     newBuffer->uri = bufDesc.uri;
     newBuffer->type = RenderResource::ResourceType::BUFFER;
     newBuffer->target = bufDesc.target;
+    newBuffer->bytesize = bufDesc.bytesize;
+    newBuffer->keepCpuCopy = bufDesc.keepCpuCopy;
 
-    newBuffer->data.resize(bufDesc.bytesize);
-    std::fill(newBuffer->data.begin(), newBuffer->data.end(), 0);
-    if (bufDesc.p_data) {
-        std::copy(bufDesc.p_data, bufDesc.p_data + bufDesc.bytesize, newBuffer->data.begin());
+    // Buffers are zero initialized when no data is given
+    std::vector<unsigned char> contents;
+    if (!bufDesc.p_data) {
+        contents.resize(bufDesc.bytesize, 0);
     }
+    const unsigned char* uploadData = bufDesc.p_data ? bufDesc.p_data : contents.data();
 
     glGenBuffers(1, &(newBuffer->GL_id));
 
     glBindBuffer(newBuffer->target, newBuffer->GL_id);
-    glBufferData(newBuffer->target, bufDesc.bytesize, newBuffer->data.data(), GL_STATIC_DRAW);
+    glBufferData(newBuffer->target, bufDesc.bytesize, uploadData, GL_STATIC_DRAW);
     glBindBuffer(newBuffer->target, 0);
 
+    if (residencyPolicy_ == ResidencyPolicy::KEEP_CPU_COPIES || bufDesc.keepCpuCopy) {
+        newBuffer->data.assign(uploadData, uploadData + bufDesc.bytesize);
+    }
+
     newBuffer->handle = createNewResourceHandle();
     buffers_[newBuffer->name] = newBuffer;
-    allResources_[newBuffer->handle] = newBuffer;
+    registerResource(newBuffer);
 
     return *newBuffer;
 }
@@ -403,7 +475,9 @@ void ResourceManager::updateBuffer(const std::string& name, const unsigned char*
 
     auto& buffer = getBuffer(name);
 
-    std::copy(data + byteoffset, data + byteoffset + bytesize, buffer.data.begin() + byteoffset);
+    if (!buffer.data.empty()) {
+        std::copy(data, data + bytesize, buffer.data.begin() + byteoffset);
+    }
 
     glBindBuffer(buffer.target, buffer.GL_id);
     glBufferSubData(buffer.target, byteoffset, bytesize, data);
@@ -418,37 +492,46 @@ void ResourceManager::bindBufferShader(const std::string& name, const unsigned b
 
     auto& buffer = getBuffer(name);
 
-    glBindBufferRange(buffer.target, binding, buffer.GL_id, 0, buffer.data.size());
+    glBindBufferRange(buffer.target, binding, buffer.GL_id, 0, buffer.bytesize);
 
-    unsigned int uboIndex = glGetUniformBlockIndex(shader.GL_id, name.c_str());
-    glUniformBlockBinding(shader.GL_id, uboIndex, binding);
+    unsigned int uboIndex = shader.getUniformBlockIndex(name);
+    if (uboIndex != GL_INVALID_INDEX) {
+        glUniformBlockBinding(shader.GL_id, uboIndex, binding);
+    }
 }
 
 
 void ResourceManager::generateMipMaps(const std::string& texName) {
     auto& texture = getTexture(texName);
+    if (texture.images[0] && texture.images[0]->levels > 1)
+        return;
+
     auto texType = texture.faces == 1 ? GL_TEXTURE_2D : GL_TEXTURE_CUBE_MAP;
-    glBindTexture(texType, texture.GL_id);
+    RenderContext::getInstance()->bindTexture(texType, texture.GL_id);
     glGenerateMipmap(texType);
-    glBindTexture(texType, 0);
+    RenderContext::getInstance()->bindTexture(texType, 0);
 }
 
 void ResourceManager::generateMipMaps(const ResourceHandle handle) {
     Texture& texture = getTexture(handle);
+    // Images decoded through TextureCache already brought their mip chains
+    if (texture.images[0] && texture.images[0]->levels > 1)
+        return;
+
     auto texType = texture.faces == 1 ? GL_TEXTURE_2D : GL_TEXTURE_CUBE_MAP;
-    glBindTexture(texType, texture.GL_id);
+    RenderContext::getInstance()->bindTexture(texType, texture.GL_id);
     glGenerateMipmap(texType);
-    glBindTexture(texType, 0);
+    RenderContext::getInstance()->bindTexture(texType, 0);
 }
 
 
 Shader& ResourceManager::createShader(const ShaderDesc& shaderDesc) {
-    if (hasShader(shaderDesc.name, shaderDesc.uri))
-        return getShader(shaderDesc.name);
+    if (auto existing = findResource(RenderResource::ResourceType::SHADER, shaderDesc.name, shaderDesc.uri))
+        return *static_cast<Shader*>(existing);
 
     LOG_I("Creating shader \'%s\' with URI \'%s\'", shaderDesc.name.c_str(), shaderDesc.uri.c_str());
 
-    Shader* newShader = new Shader(shaderDesc.vertFilename.c_str(), shaderDesc.fragFilename.c_str());
+    Shader* newShader = new Shader(shaderDesc.vertFilename.c_str(), shaderDesc.fragFilename.c_str(), shaderDesc.defines);
 
     newShader->name = shaderDesc.name;
     newShader->uri = shaderDesc.uri;
@@ -456,7 +539,7 @@ Shader& ResourceManager::createShader(const ShaderDesc& shaderDesc) {
 
     newShader->handle = createNewResourceHandle();
     shaders_[newShader->name] = newShader;
-    allResources_[newShader->handle] = newShader;
+    registerResource(newShader);
 
     return *newShader;
 }
@@ -501,7 +584,7 @@ Framebuffer& ResourceManager::createFramebuffer(const FramebufferDesc& framebufD
 
 
     glGenFramebuffers(1, &newFramebuffer->GL_id);
-    glBindFramebuffer(GL_FRAMEBUFFER, newFramebuffer->GL_id);
+    RenderContext::getInstance()->bindFramebuffer(newFramebuffer->GL_id);
 
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, framebufDesc.depthAttachment->GL_id, 0);
     newFramebuffer->depthAttachment = framebufDesc.depthAttachment;
@@ -525,7 +608,7 @@ Framebuffer& ResourceManager::createFramebuffer(const FramebufferDesc& framebufD
 
     newFramebuffer->handle = createNewResourceHandle();
     framebuffers_[newFramebuffer->name] = newFramebuffer;
-    allResources_[newFramebuffer->handle] = newFramebuffer;
+    registerResource(newFramebuffer);
 
     if (!framebufDesc.dependency.empty()) {
         if (hasFramebuffer(framebufDesc.dependency)) {
@@ -547,7 +630,7 @@ void ResourceManager::bindFramebuffer(const ResourceHandle handle) {
         LOG_E("No framebuffer with handle %ld is created", handle.nativeHandle);
         return;
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, static_cast<Framebuffer*>(it->second)->GL_id);
+    RenderContext::getInstance()->bindFramebuffer(static_cast<Framebuffer*>(it->second)->GL_id);
 }
 
 void ResourceManager::bindFramebuffer(const std::string& name) {
@@ -555,7 +638,7 @@ void ResourceManager::bindFramebuffer(const std::string& name) {
         LOG_E("No framebuffer named \'%s\' is created", name.c_str());
         return;
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffers_[name]->GL_id);
+    RenderContext::getInstance()->bindFramebuffer(framebuffers_[name]->GL_id);
 }
 
 
@@ -569,14 +652,14 @@ void ResourceManager::resizeFramebuffer(const ResourceHandle handle, unsigned wi
     auto framebuffer = static_cast<Framebuffer*>(it->second);
 
     // Do all this stuff only for user created framebuffers
-    if (framebuffer->GL_id != 0) {
+    if (framebuffer != defaultFramebuffers_[Framebuffer::DefaultFramebuffers::DEFAULT_FRAMEBUFFER]) {
         auto depthAttachment = framebuffer->depthAttachment;
-        glBindTexture(GL_TEXTURE_2D, depthAttachment->GL_id);
+        RenderContext::getInstance()->bindTexture(GL_TEXTURE_2D, depthAttachment->GL_id);
         glTexImage2D(GL_TEXTURE_2D, 0, depthAttachment->format, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
 
         for (int i = 0; i < framebuffer->colorAttachmentsCount; ++i) {
             auto colorAttachment = framebuffer->colorAttachments[i];
-            glBindTexture(GL_TEXTURE_2D, colorAttachment->GL_id);
+            RenderContext::getInstance()->bindTexture(GL_TEXTURE_2D, colorAttachment->GL_id);
 
             bool isFloat = false;
             if (colorAttachment->format == GL_RGB16F || colorAttachment->format == GL_RGBA16F ||
@@ -614,7 +697,7 @@ void ResourceManager::resizeFramebuffer(const ResourceHandle handle, unsigned wi
             glTexImage2D(GL_TEXTURE_2D, 0, colorAttachment->format, width, height, 0, format, type, NULL);
         }
 
-        glBindTexture(GL_TEXTURE_2D, 0);
+        RenderContext::getInstance()->bindTexture(GL_TEXTURE_2D, 0);
     }
 
     for (auto dep : framebuffer->dependants) {
@@ -634,8 +717,7 @@ void ResourceManager::resizeFramebuffer(const std::string& name, unsigned width,
 void ResourceManager::deleteImage(const std::string& name) {
     if (auto it = images_.find(name); it != images_.end()) {
         LOG_I("Deleting image \'%s\'", name.c_str());
-        allResources_.erase(it->second->handle);
-        delete images_[name];
+        releaseResource(it->second);
         images_.erase(it);
     }
 }
@@ -643,9 +725,7 @@ void ResourceManager::deleteImage(const std::string& name) {
 void ResourceManager::deleteSampler(const std::string& name) {
     if (auto it = samplers_.find(name); it != samplers_.end()) {
         LOG_I("Deleting sampler \'%s\'", name.c_str());
-        glDeleteSamplers(1, &(it->second->GL_id));
-        allResources_.erase(it->second->handle);
-        delete samplers_[name];
+        releaseResource(it->second);
         samplers_.erase(it);
     }
 }
@@ -653,9 +733,7 @@ void ResourceManager::deleteSampler(const std::string& name) {
 void ResourceManager::deleteTexture(const std::string& name) {
     if (auto it = textures_.find(name); it != textures_.end()) {
         LOG_I("Deleting texture \'%s\'", name.c_str());
-        glDeleteTextures(1, &(it->second->GL_id));
-        allResources_.erase(it->second->handle);
-        delete textures_[name];
+        releaseResource(it->second);
         textures_.erase(it);
     }
 }
@@ -663,8 +741,7 @@ void ResourceManager::deleteTexture(const std::string& name) {
 void ResourceManager::deleteMaterial(const std::string& name) {
     if (auto it = materials_.find(name); it != materials_.end()) {
         LOG_I("Deleting material \'%s\'", name.c_str());
-        allResources_.erase(it->second->handle);
-        delete materials_[name];
+        releaseResource(it->second);
         materials_.erase(it);
     }
 }
@@ -672,9 +749,7 @@ void ResourceManager::deleteMaterial(const std::string& name) {
 void ResourceManager::deleteBuffer(const std::string& name) {
     if (auto it = buffers_.find(name); it != buffers_.end()) {
         LOG_I("Deleting buffer \'%s\'", name.c_str());
-        glDeleteBuffers(1, &(it->second->GL_id));
-        allResources_.erase(it->second->handle);
-        delete buffers_[name];
+        releaseResource(it->second);
         buffers_.erase(it);
     }
 }
@@ -682,9 +757,7 @@ void ResourceManager::deleteBuffer(const std::string& name) {
 void ResourceManager::deleteShader(const std::string& name) {
     if (auto it = shaders_.find(name); it != shaders_.end()) {
         LOG_I("Deleting shader \'%s\'", name.c_str());
-        glDeleteProgram(it->second->GL_id);
-        allResources_.erase(it->second->handle);
-        delete shaders_[name];
+        releaseResource(it->second);
         shaders_.erase(it);
     }
 }
@@ -692,72 +765,77 @@ void ResourceManager::deleteShader(const std::string& name) {
 void ResourceManager::deleteFramebuffer(const std::string& name) {
     if (auto it = framebuffers_.find(name); it != framebuffers_.end()) {
         LOG_I("Deleting framebuffer \'%s\'", name.c_str());
-        glDeleteFramebuffers(1, &(it->second->GL_id));
-        allResources_.erase(it->second->handle);
-        delete framebuffers_[name];
+        releaseResource(it->second);
         framebuffers_.erase(it);
     }
 }
 
 
 Image& ResourceManager::getImage(const std::string& name) {
-    if (!hasImage(name)) {
+    auto it = images_.find(name);
+    if (it == images_.end()) {
         LOG_E("No image named \'%s\' is created", name.c_str());
         return getImage(Image::DefaultImages::DEFAULT_IMAGE_BLACK);
     }
-    return *images_[name];
+    return *it->second;
 }
 
 Sampler& ResourceManager::getSampler(const std::string& name) {
-    if (!hasSampler(name)) {
+    auto it = samplers_.find(name);
+    if (it == samplers_.end()) {
         LOG_E("No sampler named \'%s\' is created", name.c_str());
         return getSampler(Sampler::DEFAULT_SAMPLER_NEAREST_REPEAT);
     }
-    return *samplers_[name];
+    return *it->second;
 }
 
 Texture& ResourceManager::getTexture(const std::string& name) {
-    if (!hasTexture(name)) {
+    auto it = textures_.find(name);
+    if (it == textures_.end()) {
         LOG_E("No texture named \'%s\' is created", name.c_str());
         return getTexture(Texture::DefaultTextures::DEFAULT_TEXTURE_BLACK);
     }
-    return *textures_[name];
+    return *it->second;
 }
 
 Material& ResourceManager::getMaterial(const std::string& name) {
-    if (!hasMaterial(name)) {
+    auto it = materials_.find(name);
+    if (it == materials_.end()) {
         LOG_E("No material named \'%s\' is created", name.c_str());
         return getMaterial(Material::DefaultMaterials::DEFAULT_MATERIAL);
     }
-    return *materials_[name];
+    return *it->second;
 }
 
 Buffer& ResourceManager::getBuffer(const std::string& name) {
-    if (!hasBuffer(name)) {
+    auto it = buffers_.find(name);
+    if (it == buffers_.end()) {
         LOG_E("No buffer named \'%s\' is created", name.c_str());
 
         // TODO:
         std::abort();
     }
-    return *buffers_[name];
+    return *it->second;
 }
 
 Shader& ResourceManager::getShader(const std::string& name) {
-    if (!hasShader(name)) {
+    auto it = shaders_.find(name);
+    if (it == shaders_.end()) {
         LOG_E("No shader named \'%s\' is created", name.c_str());
 
         // TODO:
         std::abort();
     }
-    return *shaders_[name];
+    return *it->second;
 }
 
 Framebuffer& ResourceManager::getFramebuffer(const std::string& name) {
-    if (!hasFramebuffer(name)) {
+    auto it = framebuffers_.find(name);
+    if (it == framebuffers_.end()) {
         LOG_E("No framebuffer named \'%s\' is created", name.c_str());
         return getFramebuffer(Framebuffer::DefaultFramebuffers::DEFAULT_FRAMEBUFFER);
     }
-    return *framebuffers_[name];
+    return *it->second;
 }
 
 
@@ -870,115 +948,110 @@ bool ResourceManager::hasResource(const ResourceHandle handle) {
 
 
 bool ResourceManager::hasImage(const std::string& name, const std::string& uri) {
-    auto nameIt = images_.find(name);
-    if (nameIt == images_.end()) {
-        return false;
-    }
-
-    for (auto im : images_) {
-        if (im.first != name)
-            continue;
-
-        if (im.second->uri == uri)
-            return true;
-    }
-    return false;
+    return findResource(RenderResource::ResourceType::IMAGE, name, uri) != nullptr;
 }
 
 bool ResourceManager::hasSampler(const std::string& name, const std::string& uri) {
-    auto nameIt = samplers_.find(name);
-    if (nameIt == samplers_.end()) {
-        return false;
-    }
-
-    for (auto samp : samplers_) {
-        if (samp.first != name)
-            continue;
-
-        if (samp.second->uri == uri)
-            return true;
-    }
-    return false;
+    return findResource(RenderResource::ResourceType::SAMPLER, name, uri) != nullptr;
 }
 
 bool ResourceManager::hasTexture(const std::string& name, const std::string& uri) {
-    auto nameIt = textures_.find(name);
-    if (nameIt == textures_.end()) {
-        return false;
-    }
-
-    for (auto tex : textures_) {
-        if (tex.first != name)
-            continue;
-
-        if (tex.second->uri == uri)
-            return true;
-    }
-    return false;
+    return findResource(RenderResource::ResourceType::TEXTURE, name, uri) != nullptr;
 }
 
 bool ResourceManager::hasMaterial(const std::string& name, const std::string& uri) {
-    auto nameIt = materials_.find(name);
-    if (nameIt == materials_.end()) {
-        return false;
-    }
-
-    for (auto mat : materials_) {
-        if (mat.first != name)
-            continue;
-
-        if (mat.second->uri == uri)
-            return true;
-    }
-    return false;
+    return findResource(RenderResource::ResourceType::MATERIAL, name, uri) != nullptr;
 }
 
 bool ResourceManager::hasBuffer(const std::string& name, const std::string& uri) {
-    auto nameIt = buffers_.find(name);
-    if (nameIt == buffers_.end()) {
-        return false;
-    }
+    return findResource(RenderResource::ResourceType::BUFFER, name, uri) != nullptr;
+}
 
-    for (auto buf : buffers_) {
-        if (buf.first != name)
-            continue;
+bool ResourceManager::hasShader(const std::string& name, const std::string& uri) {
+    return findResource(RenderResource::ResourceType::SHADER, name, uri) != nullptr;
+}
 
-        if (buf.second->uri == uri)
-            return true;
-    }
-    return false;
+bool ResourceManager::hasFramebuffer(const std::string& name, const std::string& uri) {
+    return findResource(RenderResource::ResourceType::FRAMEBUFFER, name, uri) != nullptr;
 }
 
-bool ResourceManager::hasShader(const std::string& name, const std::string& uri) {
-    auto nameIt = shaders_.find(name);
-    if (nameIt == shaders_.end()) {
-        return false;
-    }
 
-    for (auto shdr : shaders_) {
-        if (shdr.first != name)
-            continue;
+uint64_t ResourceManager::getResourceKey(const RenderResource::ResourceType type, const std::string& name, const std::string& uri) {
+    const uint64_t nameHash = Utils::hashBytes(name.data(), name.size(), static_cast<uint64_t>(type));
+    return Utils::combineHash(nameHash, Utils::hashBytes(uri.data(), uri.size()));
+}
 
-        if (shdr.second->uri == uri)
-            return true;
+RenderResource* ResourceManager::findResource(const RenderResource::ResourceType type, const std::string& name, const std::string& uri) const {
+    auto range = resourceIndex_.equal_range(getResourceKey(type, name, uri));
+    for (auto it = range.first; it != range.second; ++it) {
+        const RenderResource* resource = it->second;
+        if (resource->type == type && resource->name == name && resource->uri == uri)
+            return it->second;
     }
-    return false;
+    return nullptr;
 }
 
-bool ResourceManager::hasFramebuffer(const std::string& name, const std::string& uri) {
-    auto nameIt = framebuffers_.find(name);
-    if (nameIt == framebuffers_.end()) {
-        return false;
-    }
+void ResourceManager::registerResource(RenderResource* resource) {
+    allResources_[resource->handle] = resource;
+    resourceIndex_.emplace(getResourceKey(resource->type, resource->name, resource->uri), resource);
+}
 
-    for (auto fb : framebuffers_) {
-        if (fb.first != name)
-            continue;
+void ResourceManager::releaseResource(RenderResource* resource) {
+    auto range = resourceIndex_.equal_range(getResourceKey(resource->type, resource->name, resource->uri));
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == resource) {
+            resourceIndex_.erase(it);
+            break;
+        }
+    }
+    allResources_.erase(resource->handle);
 
-        if (fb.second->uri == uri)
-            return true;
+    switch (resource->type) {
+        case RenderResource::ResourceType::IMAGE: {
+            delete static_cast<Image*>(resource);
+            break;
+        }
+        case RenderResource::ResourceType::SAMPLER: {
+            RenderContext::getInstance()->onSamplerDeleted(static_cast<Sampler*>(resource)->GL_id);
+            glDeleteSamplers(1, &static_cast<Sampler*>(resource)->GL_id);
+            delete static_cast<Sampler*>(resource);
+            break;
+        }
+        case RenderResource::ResourceType::TEXTURE: {
+            RenderContext::getInstance()->onTextureDeleted(static_cast<Texture*>(resource)->GL_id);
+            glDeleteTextures(1, &static_cast<Texture*>(resource)->GL_id);
+            delete static_cast<Texture*>(resource);
+            break;
+        }
+        case RenderResource::ResourceType::MATERIAL: {
+            delete static_cast<Material*>(resource);
+            break;
+        }
+        case RenderResource::ResourceType::BUFFER: {
+            glDeleteBuffers(1, &static_cast<Buffer*>(resource)->GL_id);
+            delete static_cast<Buffer*>(resource);
+            break;
+        }
+        case RenderResource::ResourceType::SHADER: {
+            RenderContext::getInstance()->onProgramDeleted(static_cast<Shader*>(resource)->GL_id);
+            glDeleteProgram(static_cast<Shader*>(resource)->GL_id);
+            delete static_cast<Shader*>(resource);
+            break;
+        }
+        case RenderResource::ResourceType::FRAMEBUFFER: {
+            // DEFAULT_FRAMEBUFFER belongs to the window or the headless context
+            if (resource != defaultFramebuffers_[Framebuffer::DefaultFramebuffers::DEFAULT_FRAMEBUFFER]) {
+                RenderContext::getInstance()->onFramebufferDeleted(static_cast<Framebuffer*>(resource)->GL_id);
+                glDeleteFramebuffers(1, &static_cast<Framebuffer*>(resource)->GL_id);
+            }
+            delete static_cast<Framebuffer*>(resource);
+            break;
+        }
+        default: {
+            LOG_W("Releasing resource \'%s\' of unknown type", resource->name.c_str());
+            break;
+        }
     }
-    return false;
 }
 
 
@@ -988,6 +1061,8 @@ ResourceManager::ResourceManager() {
 
 
 void ResourceManager::cleanUp() {
+    pendingImages_.clear();
+
     while (!images_.empty()) {
         auto it = images_.begin();
         deleteImage(it->first);
@@ -1022,6 +1097,11 @@ void ResourceManager::cleanUp() {
         auto it = framebuffers_.begin();
         deleteFramebuffer(it->first);
     }
+
+    // Resources whose name was taken over by a later one with another URI
+    while (!resourceIndex_.empty()) {
+        releaseResource(resourceIndex_.begin()->second);
+    }
 }
 
 
@@ -1032,6 +1112,8 @@ void ResourceManager::createDefaultImages() {
     defaultDesc.height = 1;
     defaultDesc.components = 4;
     defaultDesc.bits = 8;
+    // Default images stand in for missing textures at any time
+    defaultDesc.keepCpuCopy = true;
 
     std::vector<unsigned char> defaultValue;
     defaultValue.resize(4);
@@ -1094,6 +1176,32 @@ void ResourceManager::createDefaultSamplers() {
     defaultDesc.wrapT = Sampler::CLAMP_TO_EDGE;
     defaultDesc.wrapR = Sampler::CLAMP_TO_EDGE;
     defaultSamplers_[Sampler::DefaultSamplers::DEFAULT_SAMPLER_LINEAR_MIPMAP_LINEAR_CLAMP] = &createSampler(defaultDesc);
+
+    defaultDesc.name = defaultSamplersNames[Sampler::DefaultSamplers::DEFAULT_SAMPLER_TRILINEAR_ANISOTROPIC_REPEAT];
+    defaultDesc.minFilter = Sampler::LINEAR_MIPMAP_LINEAR;
+    defaultDesc.magFilter = Sampler::LINEAR;
+    defaultDesc.wrapS = Sampler::REPEAT;
+    defaultDesc.wrapT = Sampler::REPEAT;
+    defaultDesc.wrapR = Sampler::REPEAT;
+    defaultDesc.maxAnisotropy = 16.0f;
+    defaultSamplers_[Sampler::DefaultSamplers::DEFAULT_SAMPLER_TRILINEAR_ANISOTROPIC_REPEAT] = &createSampler(defaultDesc);
+}
+
+float ResourceManager::getMaxSupportedAnisotropy() {
+#ifdef GL_MAX_TEXTURE_MAX_ANISOTROPY
+    if (maxSupportedAnisotropy_ < 0.0f) {
+        // Core since GL 4.6, older contexts without the extension report an error and leave it at 1
+        GLfloat maxAnisotropy = 1.0f;
+        glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &maxAnisotropy);
+        while (glGetError() != GL_NO_ERROR) {}
+
+        maxSupportedAnisotropy_ = std::max(1.0f, maxAnisotropy);
+        LOG_I("Max supported anisotropy: %.1f", maxSupportedAnisotropy_);
+    }
+    return maxSupportedAnisotropy_;
+#else
+    return 1.0f;
+#endif
 }
 
 void ResourceManager::createDefaultTextures() {
@@ -1133,28 +1241,47 @@ void ResourceManager::createDefaultMaterials() {
     defaultMaterials_[Material::DefaultMaterials::DEFAULT_MATERIAL] = &createMaterial(defaultDesc);
 }
 
-void ResourceManager::createDefaultFramebuffer() {
+void ResourceManager::createDefaultFramebuffer(const unsigned GL_id) {
     Framebuffer* defaultFramebuffer = new Framebuffer();
 
     LOG_I("Creating framebuffer \'%s\' with URI \'\'", defaultFramebufferNames[Framebuffer::DefaultFramebuffers::DEFAULT_FRAMEBUFFER].c_str());
 
-    defaultFramebuffer->GL_id = 0;
+    defaultFramebuffer->GL_id = GL_id;
     defaultFramebuffer->name = defaultFramebufferNames[Framebuffer::DefaultFramebuffers::DEFAULT_FRAMEBUFFER];
     defaultFramebuffer->uri = "";
     defaultFramebuffer->type = RenderResource::ResourceType::FRAMEBUFFER;
 
     defaultFramebuffer->handle = createNewResourceHandle();
     framebuffers_[defaultFramebuffer->name] = defaultFramebuffer;
-    allResources_[defaultFramebuffer->handle] = defaultFramebuffer;
+    registerResource(defaultFramebuffer);
     defaultFramebuffers_[Framebuffer::DefaultFramebuffers::DEFAULT_FRAMEBUFFER] = defaultFramebuffer;
 }
 
-void ResourceManager::Init() {
+void ResourceManager::releaseCpuCopies() {
+    if (residencyPolicy_ != ResidencyPolicy::RELEASE_AFTER_UPLOAD)
+        return;
+
+    size_t releasedBytes = 0;
+    for (auto& [handle, resource] : allResources_) {
+        if (resource->type != RenderResource::ResourceType::IMAGE)
+            continue;
+
+        auto image = static_cast<Image*>(resource);
+        if (image->keepCpuCopy)
+            continue;
+
+        releasedBytes += image->image.capacity();
+        std::vector<unsigned char>().swap(image->image);
+    }
+    LOG_I("Released %.1f MB of image CPU copies", releasedBytes / (1024.0 * 1024.0));
+}
+
+void ResourceManager::Init(const unsigned defaultFramebufferId) {
     createDefaultImages();
     createDefaultSamplers();
     createDefaultTextures();
     createDefaultMaterials();
-    createDefaultFramebuffer();
+    createDefaultFramebuffer(defaultFramebufferId);
 }
 
 
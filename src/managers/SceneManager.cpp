@@ -1,7 +1,10 @@
 #include "SceneManager.hpp"
 #include "ResourceManager.hpp"
+#include "RenderContext.hpp"
 #include "FileManager.hpp"
 #include "Logger.hpp"
+#include "Profiler.hpp"
+#include "GpuProfiler.hpp"
 
 #include <algorithm>
 
@@ -40,6 +43,7 @@ SceneNode& SceneManager::createSceneNode(const std::string& name) {
     newNode->name = name;
     newNode->handle = createNewSceneHandle();
     sceneNodes_[newNode->handle] = newNode;
+    markSceneChanged();
 
     return *newNode;
 }
@@ -68,9 +72,115 @@ void SceneManager::deleteSceneNode(const SceneHandle handle) {
         LOG_I("Deleting scene node \'%s\'", sceneNodes_[handle]->name.c_str());
         delete sceneNodes_[handle];
         sceneNodes_.erase(it);
+        markSceneChanged();
     }
 }
 
+void SceneManager::updateTransforms() {
+    PROFILE_SCOPE("SceneManager::updateTransforms");
+    bool structureChanged = false;
+    if (transformsSceneVersion_ != sceneVersion_ && rootNode_) {
+        for (auto& [handle, node] : sceneNodes_)
+            node->transformIndex_ = TransformHierarchy::INVALID_INDEX;
+
+        transforms_.clear();
+        transforms_.reserve(sceneNodes_.size());
+        flatNodes_.clear();
+
+        // Depth first, so every parent is added before its children
+        std::vector<SceneNode*> stack = { rootNode_ };
+        while (!stack.empty()) {
+            SceneNode* node = stack.back();
+            stack.pop_back();
+
+            const uint32_t parentIndex = node->parent ? node->parent->transformIndex_ : TransformHierarchy::INVALID_INDEX;
+            node->transformIndex_ = transforms_.add(parentIndex, node->Position_, node->Rotation_, node->Scale_);
+            flatNodes_.push_back(node);
+
+            for (auto it = node->children.rbegin(); it != node->children.rend(); ++it)
+                stack.push_back(*it);
+        }
+        transformsSceneVersion_ = sceneVersion_;
+        structureChanged = true;
+    }
+
+    if (!transforms_.update() && !structureChanged)
+        return;
+
+    // Children follow their parents, so walking backwards completes every subtree before it is added to its parent
+    for (auto node : flatNodes_)
+        node->boundingBox_ = AABB();
+
+    for (auto it = flatNodes_.rbegin(); it != flatNodes_.rend(); ++it) {
+        SceneNode* node = *it;
+        node->boundingBox_.expand(node->mesh_.getBounds().transformed(transforms_.getWorldMatrix(node->transformIndex_)));
+        if (node->parent && node->parent->transformIndex_ != TransformHierarchy::INVALID_INDEX)
+            node->parent->boundingBox_.expand(node->boundingBox_);
+    }
+
+    updateBoundingVolumeHierarchy(structureChanged);
+}
+
+
+void SceneManager::updateBoundingVolumeHierarchy(const bool structureChanged) {
+    size_t primitiveCount = 0;
+    for (auto node : flatNodes_)
+        primitiveCount += node->mesh_.getPrimitiveCount();
+
+    // Meshes may finish loading without a structural change, their primitives have to be picked up too
+    const bool rebuild = structureChanged || primitiveCount != bvhPrimitives_.size();
+    if (rebuild) {
+        bvhPrimitives_.clear();
+        bvhPrimitives_.reserve(primitiveCount);
+        for (auto node : flatNodes_) {
+            for (uint32_t i = 0; i < node->mesh_.getPrimitiveCount(); ++i)
+                bvhPrimitives_.push_back({ node, i });
+        }
+    }
+
+    bvhBounds_.resize(bvhPrimitives_.size());
+    for (size_t i = 0; i < bvhPrimitives_.size(); ++i) {
+        const auto& [node, primitive] = bvhPrimitives_[i];
+        bvhBounds_[i] = node->mesh_.getPrimitiveRange(primitive).bounds.transformed(transforms_.getWorldMatrix(node->transformIndex_));
+    }
+
+    if (rebuild)
+        bvh_.build(bvhBounds_);
+    else
+        bvh_.refit(bvhBounds_);
+}
+
+
+bool SceneManager::raycast(const glm::vec3& origin, const glm::vec3& direction, const float maxDistance, RaycastHit& hit) const {
+    BoundingVolumeHierarchy::RayHit bvhHit;
+    if (!bvh_.raycastClosest(origin, direction, maxDistance, bvhHit))
+        return false;
+
+    hit = { bvhPrimitives_[bvhHit.primitive], bvhHit.distance };
+    return true;
+}
+
+
+bool SceneManager::raycastAny(const glm::vec3& origin, const glm::vec3& direction, const float maxDistance) const {
+    return bvh_.raycastAny(origin, direction, maxDistance);
+}
+
+
+void SceneManager::queryFrustum(const GeneralApp::Frustum& frustum, std::vector<ScenePrimitive>& result) const {
+    std::vector<uint32_t> primitives;
+    bvh_.queryFrustum(frustum, primitives);
+    for (const auto primitive : primitives)
+        result.push_back(bvhPrimitives_[primitive]);
+}
+
+
+void SceneManager::querySphere(const glm::vec3& center, const float radius, std::vector<ScenePrimitive>& result) const {
+    std::vector<uint32_t> primitives;
+    bvh_.querySphere(center, radius, primitives);
+    for (const auto primitive : primitives)
+        result.push_back(bvhPrimitives_[primitive]);
+}
+
 void SceneManager::deleteSceneLight(const SceneHandle handle) {
     if (auto it = sceneLights_.find(handle); it != sceneLights_.end()) {
         LOG_I("Deleting scene light \'%s\'", sceneLights_[handle]->name.c_str());
@@ -182,9 +292,10 @@ void SceneManager::createBackground2D(const std::string& textureName, bool isHdr
 
 void SceneManager::drawBackground2D() {
     auto resourceManager = Resources::ResourceManager::getInstance();
+    auto renderContext = Resources::RenderContext::getInstance();
 
-    glDepthFunc(GL_LEQUAL);
-    glFrontFace(GL_CCW);
+    renderContext->depthFunc(GL_LEQUAL);
+    renderContext->frontFace(GL_CCW);
 
     resourceManager->bindTexture(Background2DHandle_, 0);
     resourceManager->bindTexture(Resources::defaultTexturesNames[Resources::Texture::DefaultTextures::DEFAULT_TEXTURE_CUBEMAP_BLACK], 1);
@@ -192,7 +303,7 @@ void SceneManager::drawBackground2D() {
 
     drawDefaultQuad();
 
-    glDepthFunc(GL_LESS);
+    renderContext->depthFunc(GL_LESS);
 }
 
 
@@ -207,6 +318,9 @@ void SceneManager::createSkybox(const std::vector<std::string>& textureNames, bo
     texDesc.factor = glm::vec4(1.0);
     texDesc.name = SKYBOX_TEXTURE_NAME;
 
+    // All faces decode in parallel, createImage below only collects them
+    resourceManager->prefetchImages(textureNames, isHdr);
+
     int components = 0;
     for (unsigned i = 0; i < faces; ++i) {
         auto& newImage = resourceManager->createImage(textureNames[i]);
@@ -220,15 +334,16 @@ void SceneManager::createSkybox(const std::vector<std::string>& textureNames, bo
     resourceManager->generateMipMaps(SkyboxHandle_);
 
 #ifndef __ANDROID__
-    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+    Resources::RenderContext::getInstance()->enable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 #endif
 }
 
 void SceneManager::drawSkybox() {
     auto resourceManager = Resources::ResourceManager::getInstance();
+    auto renderContext = Resources::RenderContext::getInstance();
 
-    glDepthFunc(GL_LEQUAL);
-    glFrontFace(GL_CCW);
+    renderContext->depthFunc(GL_LEQUAL);
+    renderContext->frontFace(GL_CCW);
 
     resourceManager->bindTexture(Resources::defaultTexturesNames[Resources::Texture::DefaultTextures::DEFAULT_TEXTURE_BLACK], 0);
     resourceManager->bindTexture(SkyboxHandle_, 1);
@@ -236,7 +351,7 @@ void SceneManager::drawSkybox() {
 
     drawDefaultCube();
 
-    glDepthFunc(GL_LESS);
+    renderContext->depthFunc(GL_LESS);
 }
 
 
@@ -260,9 +375,10 @@ void SceneManager::createEquirectangular(const std::string& textureName, bool is
 
 void SceneManager::drawEquirectangular() {
     auto resourceManager = Resources::ResourceManager::getInstance();
+    auto renderContext = Resources::RenderContext::getInstance();
 
-    glDepthFunc(GL_LEQUAL);
-    glFrontFace(GL_CCW);
+    renderContext->depthFunc(GL_LEQUAL);
+    renderContext->frontFace(GL_CCW);
 
     resourceManager->bindTexture(Resources::defaultTexturesNames[Resources::Texture::DefaultTextures::DEFAULT_TEXTURE_BLACK], 0);
     resourceManager->bindTexture(Resources::defaultTexturesNames[Resources::Texture::DefaultTextures::DEFAULT_TEXTURE_CUBEMAP_BLACK], 1);
@@ -270,11 +386,12 @@ void SceneManager::drawEquirectangular() {
 
     drawDefaultCube();
 
-    glDepthFunc(GL_LESS);
+    renderContext->depthFunc(GL_LESS);
 }
 
 
 void SceneManager::createEnvironment(const EnvironmentType envType, const std::vector<std::string>& textureNames, bool isHdr) {
+    PROFILE_SCOPE("SceneManager::createEnvironment");
     auto resourceManager = Resources::ResourceManager::getInstance();
     auto fileManager = FileSystem::FileManager::getInstance();
 
@@ -334,6 +451,7 @@ void SceneManager::createEnvironment(const EnvironmentType envType, const std::s
 }
 
 void SceneManager::createImageBasedLightingTextures(const EnvironmentType envType) {
+    PROFILE_SCOPE("SceneManager::createImageBasedLightingTextures");
     if (envType != EnvironmentType::SKYBOX && envType != EnvironmentType::EQUIRECTANGULAR) {
         LOG_W("Irradiance map is only supported for skybox and equirectangular environments");
         return;
@@ -452,7 +570,7 @@ void SceneManager::createImageBasedLightingTextures(const EnvironmentType envTyp
 
     glGenFramebuffers(1, &framebufferIBL);
     glGenRenderbuffers(1, &renderbufferIBL);
-    glBindFramebuffer(GL_FRAMEBUFFER, framebufferIBL);
+    Resources::RenderContext::getInstance()->bindFramebuffer(framebufferIBL);
     glBindRenderbuffer(GL_RENDERBUFFER, renderbufferIBL);
     glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, irradianceMapSize_, irradianceMapSize_);
     glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbufferIBL);
@@ -484,59 +602,74 @@ void SceneManager::createImageBasedLightingTextures(const EnvironmentType envTyp
 
     GLint prevViewport[4];
     glGetIntegerv(GL_VIEWPORT, prevViewport);
-    glViewport(0, 0, irradianceMapSize_, irradianceMapSize_);
-    for (unsigned int i = 0; i < 6; ++i) {
-        irradianceMapShader.setMat4("view", captureViews[i]);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, irradianceMapTex.GL_id, 0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        drawDefaultCube();
+    {
+        PROFILE_SCOPE("IBL::Irradiance");
+        PROFILE_GPU_SCOPE("IBL::Irradiance");
+        glViewport(0, 0, irradianceMapSize_, irradianceMapSize_);
+        for (unsigned int i = 0; i < 6; ++i) {
+            irradianceMapShader.setMat4("view", captureViews[i]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, irradianceMapTex.GL_id, 0);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            drawDefaultCube();
+        }
     }
 
 
 
-    prefilterHDRShader.use();
-    prefilterHDRShader.setInt("uSamplerSkybox", 0);
-    prefilterHDRShader.setInt("uSamplerEquirect", 1);
-    prefilterHDRShader.setUint("uEnvironmentType", envType);
-    prefilterHDRShader.setMat4("proj", captureProjection);
-
-    for (unsigned int mip = 0; mip < maxMipLevelsPrefilterHDR_; ++mip) {
-        unsigned int mipWidth = prefilteredHDRMapSize_ * std::pow(0.5, mip);
-        unsigned int mipHeight = prefilteredHDRMapSize_ * std::pow(0.5, mip);
-        glBindRenderbuffer(GL_RENDERBUFFER, renderbufferIBL);
-        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, mipWidth, mipHeight);
-        glViewport(0, 0, mipWidth, mipHeight);
-
-        float roughness = (float)mip / (float)(maxMipLevelsPrefilterHDR_ - 1);
-        prefilterHDRShader.setFloat("uRoughness", roughness);
-        for (unsigned int i = 0; i < 6; ++i) {
-            prefilterHDRShader.setMat4("view", captureViews[i]);
-            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, prefilterHDRTex.GL_id, mip);
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-            drawDefaultCube();
+    {
+        PROFILE_SCOPE("IBL::Prefilter");
+        PROFILE_GPU_SCOPE("IBL::Prefilter");
+        prefilterHDRShader.use();
+        prefilterHDRShader.setInt("uSamplerSkybox", 0);
+        prefilterHDRShader.setInt("uSamplerEquirect", 1);
+        prefilterHDRShader.setUint("uEnvironmentType", envType);
+        prefilterHDRShader.setMat4("proj", captureProjection);
+
+        for (unsigned int mip = 0; mip < maxMipLevelsPrefilterHDR_; ++mip) {
+            unsigned int mipWidth = prefilteredHDRMapSize_ * std::pow(0.5, mip);
+            unsigned int mipHeight = prefilteredHDRMapSize_ * std::pow(0.5, mip);
+            glBindRenderbuffer(GL_RENDERBUFFER, renderbufferIBL);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, mipWidth, mipHeight);
+            glViewport(0, 0, mipWidth, mipHeight);
+
+            float roughness = (float)mip / (float)(maxMipLevelsPrefilterHDR_ - 1);
+            prefilterHDRShader.setFloat("uRoughness", roughness);
+            for (unsigned int i = 0; i < 6; ++i) {
+                prefilterHDRShader.setMat4("view", captureViews[i]);
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, prefilterHDRTex.GL_id, mip);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                drawDefaultCube();
+            }
         }
     }
 
 
 
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, brdfLUTSize_, brdfLUTSize_);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, brdfLUTTexture.GL_id, 0);
+    {
+        PROFILE_SCOPE("IBL::BrdfLUT");
+        PROFILE_GPU_SCOPE("IBL::BrdfLUT");
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, brdfLUTSize_, brdfLUTSize_);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, brdfLUTTexture.GL_id, 0);
 
-    brdfLUTShader.use();
-    glViewport(0, 0, brdfLUTSize_, brdfLUTSize_);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    drawDefaultQuad();
+        brdfLUTShader.use();
+        glViewport(0, 0, brdfLUTSize_, brdfLUTSize_);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        drawDefaultQuad();
 
-    resourceManager->generateMipMaps(brdfLUTTexture.handle);
+        resourceManager->generateMipMaps(brdfLUTTexture.handle);
+    }
 
 
     resourceManager->bindFramebuffer(Resources::defaultFramebufferNames[Resources::Framebuffer::DefaultFramebuffers::DEFAULT_FRAMEBUFFER]);
+    Resources::RenderContext::getInstance()->onFramebufferDeleted(framebufferIBL);
     glDeleteFramebuffers(1, &framebufferIBL);
     glDeleteRenderbuffers(1, &renderbufferIBL);
     glViewport(prevViewport[0], prevViewport[1], prevViewport[2], prevViewport[3]);
 }
 
 void SceneManager::drawEnvironment() {
+    PROFILE_SCOPE("SceneManager::drawEnvironment");
+    PROFILE_GPU_SCOPE("SceneManager::drawEnvironment");
     auto resourceManager = Resources::ResourceManager::getInstance();
     auto& envShader = resourceManager->getShader(environmentShaderHandle_);
     envShader.use();
@@ -563,6 +696,7 @@ void SceneManager::drawEnvironment() {
 
 
 void SceneManager::createPostProcess(const PostProcessInfo& ppi) {
+    PROFILE_SCOPE("SceneManager::createPostProcess");
     postProcessInfo_ = ppi;
 
     createFullscreenQuad();
@@ -727,6 +861,7 @@ void SceneManager::createPostProcess(const PostProcessInfo& ppi) {
 }
 
 void SceneManager::performPostProcess(const Resources::ResourceHandle inputTextureHandle) {
+    PROFILE_SCOPE("SceneManager::performPostProcess");
     postProcessTextureHandle_ = inputTextureHandle;
 
     auto resourceManager = Resources::ResourceManager::getInstance();
@@ -748,21 +883,37 @@ void SceneManager::performPostProcess(const Resources::ResourceHandle inputTextu
         auto* bloomFinalTexture = bloomFinalFramebuffer.colorAttachments[0];
 
 
-        resourceManager->bindFramebuffer(bloomFramebufferHandle_);
-        drawFullscreenQuad(postProcessTextureHandle_, &bloomShader);
+        {
+            PROFILE_SCOPE("PostProcess::BloomBrightPass");
+            PROFILE_GPU_SCOPE("PostProcess::BloomBrightPass");
+            resourceManager->bindFramebuffer(bloomFramebufferHandle_);
+            drawFullscreenQuad(postProcessTextureHandle_, &bloomShader);
+        }
 
-        blurShader.use();
-        resourceManager->bindFramebuffer(blurXFramebufferHandle_);
-        blurShader.setBool("uHorizontal", true);
-        drawFullscreenQuad(bloomBrightnessTexture->handle, &blurShader);
+        {
+            PROFILE_SCOPE("PostProcess::BlurX");
+            PROFILE_GPU_SCOPE("PostProcess::BlurX");
+            blurShader.use();
+            resourceManager->bindFramebuffer(blurXFramebufferHandle_);
+            blurShader.setBool("uHorizontal", true);
+            drawFullscreenQuad(bloomBrightnessTexture->handle, &blurShader);
+        }
 
-        resourceManager->bindFramebuffer(blurYFramebufferHandle_);
-        blurShader.setBool("uHorizontal", false);
-        drawFullscreenQuad(blurXTexture->handle, &blurShader);
+        {
+            PROFILE_SCOPE("PostProcess::BlurY");
+            PROFILE_GPU_SCOPE("PostProcess::BlurY");
+            resourceManager->bindFramebuffer(blurYFramebufferHandle_);
+            blurShader.setBool("uHorizontal", false);
+            drawFullscreenQuad(blurXTexture->handle, &blurShader);
+        }
 
-        resourceManager->bindFramebuffer(bloomFinalFramebufferHandle_);
-        resourceManager->bindTexture(blurYTexture->handle, 1);
-        drawFullscreenQuad(bloomColorTexture->handle, &bloomFinalShader);        // Setups only texture0
+        {
+            PROFILE_SCOPE("PostProcess::BloomComposite");
+            PROFILE_GPU_SCOPE("PostProcess::BloomComposite");
+            resourceManager->bindFramebuffer(bloomFinalFramebufferHandle_);
+            resourceManager->bindTexture(blurYTexture->handle, 1);
+            drawFullscreenQuad(bloomColorTexture->handle, &bloomFinalShader);        // Setups only texture0
+        }
 
         postProcessTextureHandle_ = bloomFinalTexture->handle;
     }
@@ -778,14 +929,22 @@ void SceneManager::performPostProcess(const Resources::ResourceHandle inputTextu
         auto* blurYTexture = blurYFramebuffer.colorAttachments[0];
 
 
-        blurShader.use();
-        resourceManager->bindFramebuffer(blurXFramebufferHandle_);
-        blurShader.setBool("uHorizontal", true);
-        drawFullscreenQuad(postProcessTextureHandle_, &blurShader);
+        {
+            PROFILE_SCOPE("PostProcess::BlurX");
+            PROFILE_GPU_SCOPE("PostProcess::BlurX");
+            blurShader.use();
+            resourceManager->bindFramebuffer(blurXFramebufferHandle_);
+            blurShader.setBool("uHorizontal", true);
+            drawFullscreenQuad(postProcessTextureHandle_, &blurShader);
+        }
 
-        resourceManager->bindFramebuffer(blurYFramebufferHandle_);
-        blurShader.setBool("uHorizontal", false);
-        drawFullscreenQuad(blurXTexture->handle, &blurShader);
+        {
+            PROFILE_SCOPE("PostProcess::BlurY");
+            PROFILE_GPU_SCOPE("PostProcess::BlurY");
+            resourceManager->bindFramebuffer(blurYFramebufferHandle_);
+            blurShader.setBool("uHorizontal", false);
+            drawFullscreenQuad(blurXTexture->handle, &blurShader);
+        }
 
         postProcessTextureHandle_ = blurYTexture->handle;
     }
@@ -807,14 +966,14 @@ void SceneManager::createFullscreenQuad() {
 
     glGenVertexArrays(1, &VAOFullscreenQuad_);
     glGenBuffers(1, &VBOFullscreenQuad_);
-    glBindVertexArray(VAOFullscreenQuad_);
+    Resources::RenderContext::getInstance()->bindVertexArray(VAOFullscreenQuad_);
     glBindBuffer(GL_ARRAY_BUFFER, VBOFullscreenQuad_);
     glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(1);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
-    glBindVertexArray(0);
+    Resources::RenderContext::getInstance()->bindVertexArray(0);
 
 
     Resources::ShaderDesc shdrDesc;
@@ -832,9 +991,10 @@ void SceneManager::createFullscreenQuad() {
 void SceneManager::drawFullscreenQuad(const Resources::ResourceHandle inputTextureHandle, Resources::Shader* shader) {
     // Assume that proper framebuffer already bound
     auto* resourceManager = Resources::ResourceManager::getInstance();
+    auto* renderContext = Resources::RenderContext::getInstance();
 
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_BLEND);
+    renderContext->disable(GL_DEPTH_TEST);
+    renderContext->disable(GL_BLEND);
 
     if (shader) {
         shader->use();
@@ -844,12 +1004,12 @@ void SceneManager::drawFullscreenQuad(const Resources::ResourceHandle inputTextu
     }
 
     resourceManager->bindTexture(inputTextureHandle);
-    glBindVertexArray(VAOFullscreenQuad_);
+    renderContext->bindVertexArray(VAOFullscreenQuad_);
     glDrawArrays(GL_TRIANGLES, 0, 6);
-    glBindVertexArray(0);
 }
 
 void SceneManager::drawToDefaultFramebuffer(const Resources::ResourceHandle inputTextureHandle) {
+    PROFILE_SCOPE("SceneManager::drawToDefaultFramebuffer");
     auto* resourceManager = Resources::ResourceManager::getInstance();
     if (!resourceManager->hasShader(FULLSCREEN_QUAD_SHADER_NAME)) {
         createFullscreenQuad();
@@ -872,9 +1032,16 @@ void SceneManager::cleanUp() {
     }
 
     rootNode_ = nullptr;
+    transforms_.clear();
+    transformsSceneVersion_ = UINT64_MAX;
+    flatNodes_.clear();
+    bvh_.clear();
+    bvhPrimitives_.clear();
+    bvhBounds_.clear();
 }
 
 bool SceneManager::initializeFreeType(const std::string& fontFilename, const unsigned fontHeight) {
+    PROFILE_SCOPE("SceneManager::initializeFreeType");
 #ifndef __ANDROID__
     FT_Library ft;
     if (FT_Init_FreeType(&ft)) {
@@ -945,13 +1112,13 @@ bool SceneManager::initializeFreeType(const std::string& fontFilename, const uns
 
     glGenVertexArrays(1, &VAOTextQuad_);
     glGenBuffers(1, &VBOTextQuad_);
-    glBindVertexArray(VAOTextQuad_);
+    Resources::RenderContext::getInstance()->bindVertexArray(VAOTextQuad_);
     glBindBuffer(GL_ARRAY_BUFFER, VBOTextQuad_);
     glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 6 * 4, NULL, GL_DYNAMIC_DRAW);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), 0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    Resources::RenderContext::getInstance()->bindVertexArray(0);
 
     auto fileManager = FileSystem::FileManager::getInstance();
 
@@ -981,17 +1148,19 @@ void SceneManager::setTextProjectionMatrix(const glm::mat4 proj) {
 
 void SceneManager::drawText(const std::string& text, float x, float y, float scale, glm::vec3 color) {
 #ifndef __ANDROID__
-    glDisable(GL_DEPTH_TEST);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    PROFILE_SCOPE("SceneManager::drawText");
+    PROFILE_GPU_SCOPE("SceneManager::drawText");
+    auto renderContext = Resources::RenderContext::getInstance();
+    renderContext->disable(GL_DEPTH_TEST);
+    renderContext->enable(GL_BLEND);
+    renderContext->blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     auto resourceManager = Resources::ResourceManager::getInstance();
     auto& shdr = resourceManager->getShader(textRenderingShaderHandle_);
     shdr.use();
     shdr.setVec3("uTextColor", color);
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindVertexArray(VAOTextQuad_);
+    renderContext->bindVertexArray(VAOTextQuad_);
 
     std::string::const_iterator c;
     for (c = text.begin(); c != text.end(); c++) {
@@ -1023,7 +1192,7 @@ void SceneManager::drawText(const std::string& text, float x, float y, float sca
         x += (ch.advance >> 6) * scale;
     }
 
-    glDisable(GL_BLEND);
+    renderContext->disable(GL_BLEND);
 #endif
 }
 
@@ -1034,7 +1203,7 @@ void SceneManager::initializeDefaultCube() {
 
     glGenVertexArrays(1, &VAODefaultCube_);
     glGenBuffers(1, &VBODefaultCube_);
-    glBindVertexArray(VAODefaultCube_);
+    Resources::RenderContext::getInstance()->bindVertexArray(VAODefaultCube_);
 
     const std::vector<float>& vertsCube = defaultCube_.getVertices();
     glBindBuffer(GL_ARRAY_BUFFER, VBODefaultCube_);
@@ -1043,7 +1212,7 @@ void SceneManager::initializeDefaultCube() {
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 
-    glBindVertexArray(0);
+    Resources::RenderContext::getInstance()->bindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
@@ -1052,9 +1221,8 @@ void SceneManager::drawDefaultCube() {
         initializeDefaultCube();
     }
 
-    glBindVertexArray(VAODefaultCube_);
+    Resources::RenderContext::getInstance()->bindVertexArray(VAODefaultCube_);
     glDrawArrays(GL_TRIANGLES, 0, 36);
-    glBindVertexArray(0);
 }
 
 
@@ -1065,7 +1233,7 @@ void SceneManager::initializeDefaultQuad() {
 
     glGenVertexArrays(1, &VAODefaultQuad_);
     glGenBuffers(1, &VBODefaultQuad_);
-    glBindVertexArray(VAODefaultQuad_);
+    Resources::RenderContext::getInstance()->bindVertexArray(VAODefaultQuad_);
 
     const std::vector<float>& vertsQuad = {
         -1.0f,  1.0f, 0.0f,     0.0f, 0.0f,
@@ -1084,7 +1252,7 @@ void SceneManager::initializeDefaultQuad() {
     glEnableVertexAttribArray(1);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
 
-    glBindVertexArray(0);
+    Resources::RenderContext::getInstance()->bindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
@@ -1093,9 +1261,8 @@ void SceneManager::drawDefaultQuad() {
         initializeDefaultQuad();
     }
 
-    glBindVertexArray(VAODefaultQuad_);
+    Resources::RenderContext::getInstance()->bindVertexArray(VAODefaultQuad_);
     glDrawArrays(GL_TRIANGLES, 0, 6);
-    glBindVertexArray(0);
 }
 
 
@@ -0,0 +1,169 @@
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+
+#include "TextureCache.hpp"
+#include "FileManager.hpp"
+#include "Logger.hpp"
+#include "Profiler.hpp"
+#include "ThreadPool.hpp"
+#include "MappedFile.hpp"
+#include "MipChain.hpp"
+#include "Hash.hpp"
+
+
+namespace Resources {
+
+static constexpr uint32_t TEXTURE_CACHE_MAGIC = 0x43584554;   // "TEXC"
+// Bump whenever the layout or the mip filter changes
+static constexpr uint32_t TEXTURE_CACHE_VERSION = 2;
+
+struct TextureCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    int32_t width;
+    int32_t height;
+    int32_t components;
+    int32_t bits;
+    int32_t levels;
+    uint32_t reserved;
+    uint64_t dataSize;
+};
+
+static inline uint64_t makeKey(const std::string& uri, const uint64_t contentHash, const int requiredComponents, const bool isHdr, const bool isSrgb) {
+    const uint64_t options = static_cast<uint64_t>(requiredComponents) | (uint64_t(isHdr) << 8) | (uint64_t(isSrgb) << 9);
+    return Utils::combineHash(Utils::combineHash(Utils::hashBytes(uri.data(), uri.size()), contentHash), options);
+}
+
+
+std::future<TextureCache::DecodedImage> TextureCache::decodeFileAsync(const std::string& filename, const bool isHdr, const bool isSrgb) {
+    return Utils::ThreadPool::getInstance()->submit([this, filename, isHdr, isSrgb]() { return decodeFile(filename, isHdr, isSrgb); });
+}
+
+
+TextureCache::DecodedImage TextureCache::decodeFile(const std::string& filename, const bool isHdr, const bool isSrgb) {
+    PROFILE_SCOPE("TextureCache::decodeFile");
+    DecodedImage image;
+
+    uint64_t key = 0;
+    if (enabled_) {
+        Utils::MappedFile file;
+        if (!file.open(filename)) {
+            return image;
+        }
+
+        key = makeKey(filename, Utils::hashBytes(file.data(), file.size()), 0, isHdr, isSrgb);
+        if (load(key, image)) {
+            return image;
+        }
+    }
+
+    image = Utils::ImageDecoder::getInstance()->decodeFile(filename, isHdr);
+    Utils::generateMipChain(image, isSrgb);
+
+    if (enabled_ && image.isValid()) {
+        store(key, image);
+    }
+    return image;
+}
+
+
+TextureCache::DecodedImage TextureCache::decodeMemory(const unsigned char* bytes, const size_t size, const std::string& uri, const int requiredComponents, const bool isSrgb) {
+    PROFILE_SCOPE("TextureCache::decodeMemory");
+    DecodedImage image;
+
+    const uint64_t key = enabled_ ? makeKey(uri, Utils::hashBytes(bytes, size), requiredComponents, false, isSrgb) : 0;
+    if (enabled_ && load(key, image)) {
+        return image;
+    }
+
+    image = Utils::ImageDecoder::getInstance()->decodeMemory(bytes, size, requiredComponents);
+    Utils::generateMipChain(image, isSrgb);
+
+    if (enabled_ && image.isValid()) {
+        store(key, image);
+    }
+    return image;
+}
+
+
+std::string TextureCache::getEntryPath(const uint64_t key) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.tex", static_cast<unsigned long long>(key));
+    return FileSystem::FileManager::getInstance()->getAbsolutePath("cache://textures/") + name;
+}
+
+
+bool TextureCache::load(const uint64_t key, DecodedImage& image) const {
+    std::ifstream input(getEntryPath(key), std::ios::binary);
+    if (!input.is_open()) {
+        return false;
+    }
+
+    TextureCacheHeader header;
+    if (!input.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        header.magic != TEXTURE_CACHE_MAGIC || header.version != TEXTURE_CACHE_VERSION || header.key != key ||
+        header.width <= 0 || header.height <= 0 || header.components <= 0 || header.levels <= 0 ||
+        header.dataSize != Utils::getMipChainSize(header.width, header.height, header.components * (header.bits / 8), header.levels)) {
+        LOG_W("Texture cache entry %s is outdated or corrupted", getEntryPath(key).c_str());
+        return false;
+    }
+
+    image.pixels.resize(header.dataSize);
+    if (!input.read(reinterpret_cast<char*>(image.pixels.data()), header.dataSize)) {
+        LOG_W("Texture cache entry %s is truncated", getEntryPath(key).c_str());
+        image.pixels.clear();
+        return false;
+    }
+
+    image.width = header.width;
+    image.height = header.height;
+    image.components = header.components;
+    image.bits = header.bits;
+    image.levels = header.levels;
+    return true;
+}
+
+
+void TextureCache::store(const uint64_t key, const DecodedImage& image) const {
+    auto fileManager = FileSystem::FileManager::getInstance();
+    if (!fileManager->createDirectories(fileManager->getAbsolutePath("cache://textures"))) {
+        LOG_W("Failed to create the texture cache directory");
+        return;
+    }
+
+    TextureCacheHeader header;
+    header.magic = TEXTURE_CACHE_MAGIC;
+    header.version = TEXTURE_CACHE_VERSION;
+    header.key = key;
+    header.width = image.width;
+    header.height = image.height;
+    header.components = image.components;
+    header.bits = image.bits;
+    header.levels = image.levels;
+    header.reserved = 0;
+    header.dataSize = image.pixels.size();
+
+    // Images decode on several workers at once, each writes its own temporary file
+    static std::atomic<uint32_t> tempCounter{ 0 };
+    const std::string entryPath = getEntryPath(key);
+    const std::string tempPath = entryPath + ".tmp" + std::to_string(tempCounter++);
+
+    std::ofstream output(tempPath, std::ios::binary | std::ios::trunc);
+    output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    output.write(reinterpret_cast<const char*>(image.pixels.data()), image.pixels.size());
+    output.close();
+
+    if (!output) {
+        LOG_W("Failed to write texture cache entry %s", tempPath.c_str());
+        std::remove(tempPath.c_str());
+        return;
+    }
+
+    if (!fileManager->replaceFile(tempPath, entryPath)) {
+        LOG_W("Failed to write texture cache entry %s", entryPath.c_str());
+    }
+}
+
+}
@@ -0,0 +1,137 @@
+#include "RenderContext.hpp"
+
+
+namespace Resources {
+
+RenderContext* RenderContext::instancePtr = nullptr;
+
+
+void RenderContext::bindTexture(const GLenum target, const GLuint texture) {
+    // Nothing is known about the active unit after invalidate(), pick one to know where the texture goes
+    if (activeUnit_ == UNKNOWN)
+        activeTexture(0);
+
+    bindTexture(activeUnit_, target, texture);
+}
+
+
+void RenderContext::bindTexture(const unsigned unit, const GLenum target, const GLuint texture) {
+    const uint32_t targetIdx = getTargetIndex(target);
+    if (unit >= MAX_TEXTURE_UNITS || targetIdx == TARGET_COUNT) {
+        activeTexture(unit);
+        glBindTexture(target, texture);
+        ++stats_.issuedCalls;
+        return;
+    }
+
+    if (update(textures_[unit][targetIdx], texture)) {
+        activeTexture(unit);
+        glBindTexture(target, texture);
+    }
+}
+
+
+void RenderContext::bindSampler(const unsigned unit, const GLuint sampler) {
+    if (unit >= MAX_TEXTURE_UNITS) {
+        glBindSampler(unit, sampler);
+        ++stats_.issuedCalls;
+        return;
+    }
+
+    if (update(samplers_[unit], sampler))
+        glBindSampler(unit, sampler);
+}
+
+
+void RenderContext::setEnabled(const GLenum capability, const bool enabled) {
+    const uint32_t capabilityIdx = getCapabilityIndex(capability);
+    if (capabilityIdx == CAP_COUNT)
+        ++stats_.issuedCalls;
+    else if (!update(capabilities_[capabilityIdx], enabled ? 1 : 0))
+        return;
+
+    if (enabled)
+        glEnable(capability);
+    else
+        glDisable(capability);
+}
+
+
+void RenderContext::blendFunc(const GLenum sfactor, const GLenum dfactor) {
+    if (cachingEnabled_ && blendSrc_ == sfactor && blendDst_ == dfactor) {
+        ++stats_.elidedCalls;
+        return;
+    }
+
+    blendSrc_ = sfactor;
+    blendDst_ = dfactor;
+    ++stats_.issuedCalls;
+    glBlendFunc(sfactor, dfactor);
+}
+
+
+void RenderContext::invalidate() {
+    program_ = UNKNOWN;
+    vertexArray_ = UNKNOWN;
+    framebuffer_ = UNKNOWN;
+    activeUnit_ = UNKNOWN;
+    for (auto& unit : textures_) {
+        for (auto& texture : unit)
+            texture = UNKNOWN;
+    }
+    for (auto& sampler : samplers_)
+        sampler = UNKNOWN;
+    for (auto& capability : capabilities_)
+        capability = UNKNOWN;
+    cullFace_ = UNKNOWN;
+    frontFace_ = UNKNOWN;
+    depthFunc_ = UNKNOWN;
+    blendSrc_ = UNKNOWN;
+    blendDst_ = UNKNOWN;
+}
+
+
+void RenderContext::onTextureDeleted(const GLuint texture) {
+    for (auto& unit : textures_) {
+        for (auto& bound : unit) {
+            if (bound == texture)
+                bound = UNKNOWN;
+        }
+    }
+}
+
+
+void RenderContext::onSamplerDeleted(const GLuint sampler) {
+    for (auto& bound : samplers_) {
+        if (bound == sampler)
+            bound = UNKNOWN;
+    }
+}
+
+
+uint32_t RenderContext::getTargetIndex(const GLenum target) {
+    switch (target) {
+    case GL_TEXTURE_2D:
+        return TARGET_2D;
+    case GL_TEXTURE_CUBE_MAP:
+        return TARGET_CUBE_MAP;
+    default:
+        return TARGET_COUNT;
+    }
+}
+
+
+uint32_t RenderContext::getCapabilityIndex(const GLenum capability) {
+    switch (capability) {
+    case GL_DEPTH_TEST:
+        return CAP_DEPTH_TEST;
+    case GL_CULL_FACE:
+        return CAP_CULL_FACE;
+    case GL_BLEND:
+        return CAP_BLEND;
+    default:
+        return CAP_COUNT;
+    }
+}
+
+}
@@ -5,5 +5,6 @@ std::string Resources::defaultSamplersNames[Sampler::DefaultSamplers::COUNT] = {
 	"DEFAULT_SAMPLER_NEAREST_REPEAT",
 	"DEFAULT_SAMPLER_LINEAR_REPEAT",
 	"DEFAULT_SAMPLER_LINEAR_CLAMP",
-	"DEFAULT_SAMPLER_LINEAR_MIPMAP_LINEAR_CLAMP"
+	"DEFAULT_SAMPLER_LINEAR_MIPMAP_LINEAR_CLAMP",
+	"DEFAULT_SAMPLER_TRILINEAR_ANISOTROPIC_REPEAT"
 };
\ No newline at end of file
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <regex>
 #include <sstream>
 
@@ -6,7 +7,7 @@
 
 namespace Resources {
 
-Shader::Shader(const char* vertexPath, const char* fragmentPath) {
+Shader::Shader(const char* vertexPath, const char* fragmentPath, const std::vector<std::string>& defines) {
     std::string vertexCode;
     std::string fragmentCode;
 
@@ -36,6 +37,8 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath) {
 
     vertexCode = PreprocessIncludes(vertexCode, vertexPath);
     fragmentCode = PreprocessIncludes(fragmentCode, fragmentPath);
+    vertexCode = insertDefines(vertexCode, defines);
+    fragmentCode = insertDefines(fragmentCode, defines);
 
     const char* vShaderCode = vertexCode.c_str();
     const char* fShaderCode = fragmentCode.c_str();
@@ -62,6 +65,7 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath) {
     glLinkProgram(GL_id);
 
     checkCompileErrors(GL_id, "PROGRAM");
+    reflect();
 
     glDeleteShader(vertex);
     glDeleteShader(fragment);
@@ -87,6 +91,77 @@ void Shader::checkCompileErrors(const GLuint& shader, const std::string& type) {
     }
 }
 
+void Shader::reflect() {
+    uniformLocations_.clear();
+    uniformBlocks_.clear();
+
+    GLint uniformCount = 0;
+    GLint maxNameLength = 0;
+    glGetProgramiv(GL_id, GL_ACTIVE_UNIFORMS, &uniformCount);
+    glGetProgramiv(GL_id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+    std::string name(std::max(maxNameLength, 1), '\0');
+    for (GLint i = 0; i < uniformCount; ++i) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(GL_id, i, static_cast<GLsizei>(name.size()), &length, &size, &type, name.data());
+
+        // Members of uniform blocks have no location
+        const GLint location = glGetUniformLocation(GL_id, name.c_str());
+        if (location < 0)
+            continue;
+
+        uniformLocations_[Utils::hashString(name.data(), length)] = location;
+        if (length > 3 && name.compare(length - 3, 3, "[0]") == 0)
+            uniformLocations_[Utils::hashString(name.data(), length - 3)] = location;
+    }
+
+    GLint blockCount = 0;
+    GLint maxBlockNameLength = 0;
+    glGetProgramiv(GL_id, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+    glGetProgramiv(GL_id, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxBlockNameLength);
+
+    name.assign(std::max(maxBlockNameLength, 1), '\0');
+    for (GLint i = 0; i < blockCount; ++i) {
+        GLsizei length = 0;
+        glGetActiveUniformBlockName(GL_id, i, static_cast<GLsizei>(name.size()), &length, name.data());
+        uniformBlocks_[Utils::hashString(name.data(), length)] = static_cast<GLuint>(i);
+    }
+}
+
+UniformLocation Shader::queryUniformLocation(const UniformName& name) const {
+    // Elements of arrays and inactive uniforms are not reflected, they cost a query on the first use only
+    const GLint location = glGetUniformLocation(GL_id, name.str);
+    uniformLocations_[name.hash] = location;
+    return UniformLocation{ location };
+}
+
+GLuint Shader::getUniformBlockIndex(const UniformName& name) const {
+    auto it = uniformBlocks_.find(name.hash);
+    return it != uniformBlocks_.end() ? it->second : GL_INVALID_INDEX;
+}
+
+std::string Shader::insertDefines(const std::string& source, const std::vector<std::string>& defines) {
+    if (defines.empty())
+        return source;
+
+    std::string defineLines;
+    for (const auto& define : defines)
+        defineLines += "#define " + define + "\n";
+
+    // Nothing but comments may precede the version directive
+    const size_t version = source.find("#version");
+    if (version == std::string::npos)
+        return defineLines + source;
+
+    const size_t lineEnd = source.find('\n', version);
+    if (lineEnd == std::string::npos)
+        return source + "\n" + defineLines;
+    return source.substr(0, lineEnd + 1) + defineLines + source.substr(lineEnd + 1);
+}
+
+
 std::string Shader::PreprocessIncludes(const std::string& source, const std::string& filename, int level)
 {
     if (level > 32) {
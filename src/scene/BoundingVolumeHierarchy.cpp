@@ -0,0 +1,407 @@
+#include "BoundingVolumeHierarchy.hpp"
+#include "Profiler.hpp"
+
+#include <algorithm>
+
+
+namespace SceneResources {
+
+// Splitting is stopped before reaching MAX_LEAF_SIZE only while the heuristic prefers a leaf and the leaf stays small
+static constexpr uint32_t MAX_SAH_LEAF_SIZE = 16;
+
+static inline float getSurfaceArea(const AABB& box) {
+    if (!box.isValid())
+        return 0.0f;
+
+    const glm::vec3 size = box.maxCorner - box.minCorner;
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+// Slab test, the entry distance is clamped to the start of the ray
+static inline bool intersectRay(const AABB& box, const glm::vec3& origin, const glm::vec3& invDirection, const float maxDistance, float& entry) {
+    const glm::vec3 t0 = (box.minCorner - origin) * invDirection;
+    const glm::vec3 t1 = (box.maxCorner - origin) * invDirection;
+    const glm::vec3 tNear = glm::min(t0, t1);
+    const glm::vec3 tFar = glm::max(t0, t1);
+
+    entry = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+    const float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+    return entry <= exit;
+}
+
+static inline bool intersectSphere(const AABB& box, const glm::vec3& center, const float radiusSquared) {
+    const glm::vec3 delta = glm::max(glm::max(box.minCorner - center, center - box.maxCorner), glm::vec3(0.0f));
+    return glm::dot(delta, delta) <= radiusSquared;
+}
+
+enum FrustumOverlap : uint32_t {
+    OUTSIDE = 0,
+    INTERSECTING = 1,
+    INSIDE = 2
+};
+
+// Tests the corners furthest along and against each plane normal. Unlike a center and extent test this only moves
+// these corners inwards for a box inside another one, so no primitive is rejected below an accepted node
+static inline FrustumOverlap classifyBox(const GeneralApp::Frustum& frustum, const AABB& box) {
+    FrustumOverlap overlap = INSIDE;
+    for (const auto& plane : frustum.planes) {
+        const glm::vec3 normal = glm::vec3(plane);
+        const glm::bvec3 positive = glm::greaterThanEqual(normal, glm::vec3(0.0f));
+        const glm::vec3 furthest = glm::mix(box.minCorner, box.maxCorner, positive);
+        const glm::vec3 nearest = glm::mix(box.maxCorner, box.minCorner, positive);
+        if (glm::dot(normal, furthest) + plane.w < 0.0f)
+            return OUTSIDE;
+        if (glm::dot(normal, nearest) + plane.w < 0.0f)
+            overlap = INTERSECTING;
+    }
+
+    return overlap;
+}
+
+
+void BoundingVolumeHierarchy::clear() {
+    nodes_.clear();
+    primitives_.clear();
+    primitiveBounds_.clear();
+}
+
+
+// Primitives are partitioned together with their bounds, so the build reads them sequentially
+struct BoundingVolumeHierarchy::BuildPrimitive {
+    AABB bounds;
+    glm::vec3 centroid;
+    uint32_t index;
+};
+
+
+void BoundingVolumeHierarchy::build(const std::vector<AABB>& bounds) {
+    PROFILE_SCOPE("BoundingVolumeHierarchy::build");
+    clear();
+    if (bounds.empty())
+        return;
+
+    const uint32_t count = static_cast<uint32_t>(bounds.size());
+    std::vector<BuildPrimitive> buildPrimitives(count);
+    for (uint32_t i = 0; i < count; ++i)
+        buildPrimitives[i] = { bounds[i], bounds[i].isValid() ? bounds[i].getCenter() : glm::vec3(0.0f), i };
+
+    // A binary tree with one primitive per leaf at most has 2n - 1 nodes, node references stay valid
+    nodes_.reserve(2 * count - 1);
+    nodes_.push_back({ AABB(), 0, count });
+
+    std::vector<std::pair<uint32_t, uint32_t>> stack = { { 0, 1 } };
+    while (!stack.empty()) {
+        const auto [nodeIdx, depth] = stack.back();
+        stack.pop_back();
+        if (subdivide(nodeIdx, depth, buildPrimitives)) {
+            stack.push_back({ nodes_[nodeIdx].leftOrFirst, depth + 1 });
+            stack.push_back({ nodes_[nodeIdx].leftOrFirst + 1, depth + 1 });
+        }
+    }
+
+    primitives_.resize(count);
+    primitiveBounds_.resize(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        primitives_[i] = buildPrimitives[i].index;
+        primitiveBounds_[i] = buildPrimitives[i].bounds;
+    }
+}
+
+
+bool BoundingVolumeHierarchy::subdivide(const uint32_t nodeIdx, const uint32_t depth, std::vector<BuildPrimitive>& buildPrimitives) {
+    Node& node = nodes_[nodeIdx];
+    const uint32_t first = node.leftOrFirst;
+    const uint32_t count = node.count;
+    const auto begin = buildPrimitives.begin() + first;
+    const auto end = begin + count;
+
+    AABB centroidBounds;
+    for (auto it = begin; it != end; ++it) {
+        node.bounds.expand(it->bounds);
+        centroidBounds.expand(it->centroid);
+    }
+
+    // Past the depth limit the traversal stack could overflow, such leaves are just larger
+    if (count <= MAX_LEAF_SIZE || depth >= MAX_DEPTH)
+        return false;
+
+    struct Bin {
+        AABB bounds;
+        uint32_t count = 0;
+    };
+
+    // Binned SAH, cost of a split is the sum of child areas weighted by their primitive counts
+    const glm::vec3 centroidExtent = centroidBounds.maxCorner - centroidBounds.minCorner;
+    float bestCost = FLT_MAX;
+    int bestAxis = -1;
+    uint32_t bestBin = 0;
+
+    for (int axis = 0; axis < 3; ++axis) {
+        if (centroidExtent[axis] <= 0.0f)
+            continue;
+
+        Bin bins[BIN_COUNT];
+        const float scale = BIN_COUNT / centroidExtent[axis];
+        for (auto it = begin; it != end; ++it) {
+            const uint32_t binIdx = std::min(BIN_COUNT - 1, static_cast<uint32_t>((it->centroid[axis] - centroidBounds.minCorner[axis]) * scale));
+            bins[binIdx].bounds.expand(it->bounds);
+            ++bins[binIdx].count;
+        }
+
+        float leftArea[BIN_COUNT - 1];
+        uint32_t leftCount[BIN_COUNT - 1];
+        AABB accumulated;
+        uint32_t accumulatedCount = 0;
+        for (uint32_t i = 0; i < BIN_COUNT - 1; ++i) {
+            accumulated.expand(bins[i].bounds);
+            accumulatedCount += bins[i].count;
+            leftArea[i] = getSurfaceArea(accumulated);
+            leftCount[i] = accumulatedCount;
+        }
+
+        accumulated = AABB();
+        accumulatedCount = 0;
+        for (uint32_t i = BIN_COUNT - 1; i > 0; --i) {
+            accumulated.expand(bins[i].bounds);
+            accumulatedCount += bins[i].count;
+            if (leftCount[i - 1] == 0 || accumulatedCount == 0)
+                continue;
+
+            const float cost = leftArea[i - 1] * leftCount[i - 1] + getSurfaceArea(accumulated) * accumulatedCount;
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestBin = i;
+            }
+        }
+    }
+
+    if (bestAxis >= 0 && bestCost >= getSurfaceArea(node.bounds) * count && count <= MAX_SAH_LEAF_SIZE)
+        return false;
+
+    auto middle = begin;
+    if (bestAxis >= 0) {
+        const float scale = BIN_COUNT / centroidExtent[bestAxis];
+        middle = std::partition(begin, end, [&](const BuildPrimitive& primitive) {
+            return std::min(BIN_COUNT - 1, static_cast<uint32_t>((primitive.centroid[bestAxis] - centroidBounds.minCorner[bestAxis]) * scale)) < bestBin;
+        });
+    }
+
+    // Coincident centroids, split in half to keep the depth bounded
+    if (middle == begin || middle == end)
+        middle = begin + count / 2;
+
+    const uint32_t leftIdx = static_cast<uint32_t>(nodes_.size());
+    const uint32_t leftCount = static_cast<uint32_t>(middle - begin);
+    node.leftOrFirst = leftIdx;
+    node.count = 0;
+
+    nodes_.push_back({ AABB(), first, leftCount });
+    nodes_.push_back({ AABB(), first + leftCount, count - leftCount });
+    return true;
+}
+
+
+void BoundingVolumeHierarchy::refit(const std::vector<AABB>& bounds) {
+    PROFILE_SCOPE("BoundingVolumeHierarchy::refit");
+    // Children are always stored after their parent
+    for (size_t i = nodes_.size(); i-- > 0;) {
+        Node& node = nodes_[i];
+        node.bounds = AABB();
+        if (node.isLeaf()) {
+            for (uint32_t p = node.leftOrFirst; p < node.leftOrFirst + node.count; ++p) {
+                primitiveBounds_[p] = bounds[primitives_[p]];
+                node.bounds.expand(primitiveBounds_[p]);
+            }
+        }
+        else {
+            node.bounds.expand(nodes_[node.leftOrFirst].bounds);
+            node.bounds.expand(nodes_[node.leftOrFirst + 1].bounds);
+        }
+    }
+}
+
+
+bool BoundingVolumeHierarchy::raycastClosest(const glm::vec3& origin, const glm::vec3& direction, const float maxDistance, RayHit& hit) const {
+    if (nodes_.empty())
+        return false;
+
+    const glm::vec3 invDirection = 1.0f / direction;
+    float closest = maxDistance;
+    bool found = false;
+
+    uint32_t stack[TRAVERSAL_STACK_SIZE];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const Node& node = nodes_[stack[--stackSize]];
+
+        // The closest hit may have moved closer since the node was pushed
+        float entry;
+        if (!intersectRay(node.bounds, origin, invDirection, closest, entry))
+            continue;
+
+        if (node.isLeaf()) {
+            for (uint32_t p = node.leftOrFirst; p < node.leftOrFirst + node.count; ++p) {
+                if (intersectRay(primitiveBounds_[p], origin, invDirection, closest, entry)) {
+                    hit = { primitives_[p], entry };
+                    closest = entry;
+                    found = true;
+                }
+            }
+            continue;
+        }
+
+        // The nearer child is popped first, so the farther one is often skipped
+        float leftEntry, rightEntry;
+        const bool hitLeft = intersectRay(nodes_[node.leftOrFirst].bounds, origin, invDirection, closest, leftEntry);
+        const bool hitRight = intersectRay(nodes_[node.leftOrFirst + 1].bounds, origin, invDirection, closest, rightEntry);
+
+        if (hitLeft && hitRight) {
+            const bool leftFirst = leftEntry <= rightEntry;
+            stack[stackSize++] = leftFirst ? node.leftOrFirst + 1 : node.leftOrFirst;
+            stack[stackSize++] = leftFirst ? node.leftOrFirst : node.leftOrFirst + 1;
+        }
+        else if (hitLeft) {
+            stack[stackSize++] = node.leftOrFirst;
+        }
+        else if (hitRight) {
+            stack[stackSize++] = node.leftOrFirst + 1;
+        }
+    }
+
+    return found;
+}
+
+
+bool BoundingVolumeHierarchy::raycastAny(const glm::vec3& origin, const glm::vec3& direction, const float maxDistance) const {
+    if (nodes_.empty())
+        return false;
+
+    const glm::vec3 invDirection = 1.0f / direction;
+
+    uint32_t stack[TRAVERSAL_STACK_SIZE];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const Node& node = nodes_[stack[--stackSize]];
+
+        float entry;
+        if (!intersectRay(node.bounds, origin, invDirection, maxDistance, entry))
+            continue;
+
+        if (!node.isLeaf()) {
+            stack[stackSize++] = node.leftOrFirst + 1;
+            stack[stackSize++] = node.leftOrFirst;
+            continue;
+        }
+
+        for (uint32_t p = node.leftOrFirst; p < node.leftOrFirst + node.count; ++p) {
+            if (intersectRay(primitiveBounds_[p], origin, invDirection, maxDistance, entry))
+                return true;
+        }
+    }
+
+    return false;
+}
+
+
+void BoundingVolumeHierarchy::queryFrustum(const GeneralApp::Frustum& frustum, std::vector<uint32_t>& result) const {
+    if (nodes_.empty())
+        return;
+
+    uint32_t stack[TRAVERSAL_STACK_SIZE];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const uint32_t nodeIdx = stack[--stackSize];
+        const Node& node = nodes_[nodeIdx];
+
+        const FrustumOverlap overlap = classifyBox(frustum, node.bounds);
+        if (overlap == OUTSIDE)
+            continue;
+
+        // Nothing below a node which is completely inside needs testing
+        if (overlap == INSIDE) {
+            appendSubtree(nodeIdx, result);
+        }
+        else if (node.isLeaf()) {
+            for (uint32_t p = node.leftOrFirst; p < node.leftOrFirst + node.count; ++p) {
+                if (classifyBox(frustum, primitiveBounds_[p]) != OUTSIDE)
+                    result.push_back(primitives_[p]);
+            }
+        }
+        else {
+            stack[stackSize++] = node.leftOrFirst + 1;
+            stack[stackSize++] = node.leftOrFirst;
+        }
+    }
+}
+
+
+void BoundingVolumeHierarchy::querySphere(const glm::vec3& center, const float radius, std::vector<uint32_t>& result) const {
+    if (nodes_.empty())
+        return;
+
+    const float radiusSquared = radius * radius;
+
+    uint32_t stack[TRAVERSAL_STACK_SIZE];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const Node& node = nodes_[stack[--stackSize]];
+
+        if (!intersectSphere(node.bounds, center, radiusSquared))
+            continue;
+
+        if (!node.isLeaf()) {
+            stack[stackSize++] = node.leftOrFirst + 1;
+            stack[stackSize++] = node.leftOrFirst;
+            continue;
+        }
+
+        for (uint32_t p = node.leftOrFirst; p < node.leftOrFirst + node.count; ++p) {
+            if (intersectSphere(primitiveBounds_[p], center, radiusSquared))
+                result.push_back(primitives_[p]);
+        }
+    }
+}
+
+
+void BoundingVolumeHierarchy::appendSubtree(const uint32_t nodeIdx, std::vector<uint32_t>& result) const {
+    // Leaves of a subtree cover one consecutive range of primitives, it starts at the leftmost and ends at the rightmost leaf
+    uint32_t first = nodeIdx;
+    while (!nodes_[first].isLeaf())
+        first = nodes_[first].leftOrFirst;
+
+    uint32_t last = nodeIdx;
+    while (!nodes_[last].isLeaf())
+        last = nodes_[last].leftOrFirst + 1;
+
+    const uint32_t begin = nodes_[first].leftOrFirst;
+    const uint32_t end = nodes_[last].leftOrFirst + nodes_[last].count;
+    result.insert(result.end(), primitives_.begin() + begin, primitives_.begin() + end);
+}
+
+
+uint32_t BoundingVolumeHierarchy::getDepth() const {
+    if (nodes_.empty())
+        return 0;
+
+    uint32_t depth = 0;
+    std::vector<std::pair<uint32_t, uint32_t>> stack = { { 0, 1 } };
+    while (!stack.empty()) {
+        const auto [nodeIdx, nodeDepth] = stack.back();
+        stack.pop_back();
+
+        depth = std::max(depth, nodeDepth);
+        if (!nodes_[nodeIdx].isLeaf()) {
+            stack.push_back({ nodes_[nodeIdx].leftOrFirst, nodeDepth + 1 });
+            stack.push_back({ nodes_[nodeIdx].leftOrFirst + 1, nodeDepth + 1 });
+        }
+    }
+
+    return depth;
+}
+
+}
@@ -18,6 +18,18 @@ void Camera::updateMatrices() {
     View_ = glm::lookAt(Position_, Position_ + Direction_, Up_);
     Proj_ = glm::perspective(glm::radians(Fov_), Aspect_, ZNear_, ZFar_);
     Model_ = glm::mat4(1.0f);
+
+    // Rows of the view-projection matrix combined as in Gribb and Hartmann
+    const glm::mat4 viewProj = glm::transpose(Proj_ * View_);
+    Frustum_.planes[Frustum::PLANE_LEFT] = viewProj[3] + viewProj[0];
+    Frustum_.planes[Frustum::PLANE_RIGHT] = viewProj[3] - viewProj[0];
+    Frustum_.planes[Frustum::PLANE_BOTTOM] = viewProj[3] + viewProj[1];
+    Frustum_.planes[Frustum::PLANE_TOP] = viewProj[3] - viewProj[1];
+    Frustum_.planes[Frustum::PLANE_NEAR] = viewProj[3] + viewProj[2];
+    Frustum_.planes[Frustum::PLANE_FAR] = viewProj[3] - viewProj[2];
+
+    for (auto& plane : Frustum_.planes)
+        plane /= glm::length(glm::vec3(plane));
 }
 
 
@@ -0,0 +1,62 @@
+#include "CameraPath.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace GeneralApp {
+
+void CameraPath::addKeyframe(const Keyframe& keyframe) {
+    keyframes_.push_back(keyframe);
+}
+
+
+void CameraPath::addKeyframe(const Camera& camera, const float time) {
+    keyframes_.push_back({ time, camera.getPosition(), camera.getYaw(), camera.getPitch(), camera.getFov() });
+}
+
+
+float CameraPath::getDuration() const {
+    if (keyframes_.empty()) {
+        return 0.0f;
+    }
+    return keyframes_.back().time - keyframes_.front().time;
+}
+
+
+void CameraPath::apply(Camera& camera, float time) const {
+    if (keyframes_.empty()) {
+        return;
+    }
+
+    const float duration = getDuration();
+    time = duration > 0.0f ? std::fmod(time, duration) : 0.0f;
+    time += keyframes_.front().time;
+
+    auto next = std::upper_bound(keyframes_.begin(), keyframes_.end(), time,
+        [](const float t, const Keyframe& keyframe) { return t < keyframe.time; });
+
+    Keyframe pose = keyframes_.back();
+    if (next == keyframes_.begin()) {
+        pose = keyframes_.front();
+    }
+    else if (next != keyframes_.end()) {
+        const Keyframe& a = *(next - 1);
+        const Keyframe& b = *next;
+        const float span = b.time - a.time;
+        const float t = span > 0.0f ? (time - a.time) / span : 0.0f;
+
+        pose.position = glm::mix(a.position, b.position, t);
+        pose.yaw = glm::mix(a.yaw, b.yaw, t);
+        pose.pitch = glm::mix(a.pitch, b.pitch, t);
+        pose.fov = glm::mix(a.fov, b.fov, t);
+    }
+
+    camera.setPosition(pose.position);
+    camera.setYaw(pose.yaw);
+    camera.setPitch(pose.pitch);
+    camera.setFov(pose.fov);
+    camera.updateVectors();
+}
+
+}
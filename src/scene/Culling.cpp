@@ -0,0 +1,108 @@
+#include "Culling.hpp"
+#include "Profiler.hpp"
+
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define CULLING_SSE
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define CULLING_NEON
+#endif
+
+
+namespace SceneResources {
+
+// Large enough to stay visible, small enough to keep the plane distances finite
+static constexpr float UNBOUNDED_EXTENT = 1.0e30f;
+
+
+void BoundsSoA::resize(const size_t count) {
+    count_ = count;
+    const size_t padded = (count + GROUP_SIZE - 1) / GROUP_SIZE * GROUP_SIZE;
+    for (auto component : { &centerX_, &centerY_, &centerZ_, &extentX_, &extentY_, &extentZ_ })
+        component->assign(padded, 0.0f);
+}
+
+
+void BoundsSoA::set(const size_t index, const AABB& box) {
+    const glm::vec3 center = box.isValid() ? box.getCenter() : glm::vec3(0.0f);
+    const glm::vec3 extent = box.isValid() ? box.getExtent() : glm::vec3(UNBOUNDED_EXTENT);
+
+    centerX_[index] = center.x;
+    centerY_[index] = center.y;
+    centerZ_[index] = center.z;
+    extentX_[index] = extent.x;
+    extentY_[index] = extent.y;
+    extentZ_[index] = extent.z;
+}
+
+
+void cullBoxes(const GeneralApp::Frustum& frustum, const BoundsSoA& bounds, std::vector<uint8_t>& visible) {
+    PROFILE_SCOPE("cullBoxes");
+    visible.resize(bounds.paddedSize());
+
+    // Distance of the box corner furthest along the plane normal is dot(n, c) + dot(|n|, e) + w
+    for (size_t i = 0; i < bounds.paddedSize(); i += BoundsSoA::GROUP_SIZE) {
+#if defined(CULLING_SSE)
+        const __m128 cx = _mm_loadu_ps(&bounds.centerX_[i]);
+        const __m128 cy = _mm_loadu_ps(&bounds.centerY_[i]);
+        const __m128 cz = _mm_loadu_ps(&bounds.centerZ_[i]);
+        const __m128 ex = _mm_loadu_ps(&bounds.extentX_[i]);
+        const __m128 ey = _mm_loadu_ps(&bounds.extentY_[i]);
+        const __m128 ez = _mm_loadu_ps(&bounds.extentZ_[i]);
+
+        __m128 outside = _mm_setzero_ps();
+        for (const auto& plane : frustum.planes) {
+            __m128 distance = _mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(plane.x)), _mm_mul_ps(cy, _mm_set1_ps(plane.y)));
+            distance = _mm_add_ps(distance, _mm_mul_ps(cz, _mm_set1_ps(plane.z)));
+            distance = _mm_add_ps(distance, _mm_mul_ps(ex, _mm_set1_ps(std::abs(plane.x))));
+            distance = _mm_add_ps(distance, _mm_mul_ps(ey, _mm_set1_ps(std::abs(plane.y))));
+            distance = _mm_add_ps(distance, _mm_mul_ps(ez, _mm_set1_ps(std::abs(plane.z))));
+            distance = _mm_add_ps(distance, _mm_set1_ps(plane.w));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, _mm_setzero_ps()));
+        }
+
+        const int mask = _mm_movemask_ps(outside);
+        for (size_t lane = 0; lane < BoundsSoA::GROUP_SIZE; ++lane)
+            visible[i + lane] = !(mask & (1 << lane));
+#elif defined(CULLING_NEON)
+        const float32x4_t cx = vld1q_f32(&bounds.centerX_[i]);
+        const float32x4_t cy = vld1q_f32(&bounds.centerY_[i]);
+        const float32x4_t cz = vld1q_f32(&bounds.centerZ_[i]);
+        const float32x4_t ex = vld1q_f32(&bounds.extentX_[i]);
+        const float32x4_t ey = vld1q_f32(&bounds.extentY_[i]);
+        const float32x4_t ez = vld1q_f32(&bounds.extentZ_[i]);
+
+        uint32x4_t outside = vdupq_n_u32(0);
+        for (const auto& plane : frustum.planes) {
+            float32x4_t distance = vaddq_f32(vmulq_n_f32(cx, plane.x), vmulq_n_f32(cy, plane.y));
+            distance = vaddq_f32(distance, vmulq_n_f32(cz, plane.z));
+            distance = vaddq_f32(distance, vmulq_n_f32(ex, std::abs(plane.x)));
+            distance = vaddq_f32(distance, vmulq_n_f32(ey, std::abs(plane.y)));
+            distance = vaddq_f32(distance, vmulq_n_f32(ez, std::abs(plane.z)));
+            distance = vaddq_f32(distance, vdupq_n_f32(plane.w));
+            outside = vorrq_u32(outside, vcltq_f32(distance, vdupq_n_f32(0.0f)));
+        }
+
+        uint32_t lanes[BoundsSoA::GROUP_SIZE];
+        vst1q_u32(lanes, outside);
+        for (size_t lane = 0; lane < BoundsSoA::GROUP_SIZE; ++lane)
+            visible[i + lane] = !lanes[lane];
+#else
+        for (size_t lane = i; lane < i + BoundsSoA::GROUP_SIZE; ++lane) {
+            bool outside = false;
+            for (const auto& plane : frustum.planes) {
+                const float distance = plane.x * bounds.centerX_[lane] + plane.y * bounds.centerY_[lane] + plane.z * bounds.centerZ_[lane] +
+                                       std::abs(plane.x) * bounds.extentX_[lane] + std::abs(plane.y) * bounds.extentY_[lane] +
+                                       std::abs(plane.z) * bounds.extentZ_[lane] + plane.w;
+                outside |= distance < 0.0f;
+            }
+            visible[lane] = !outside;
+        }
+#endif
+    }
+}
+
+}
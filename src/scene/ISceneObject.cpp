@@ -3,6 +3,18 @@
 
 namespace SceneResources {
 
+AABB AABB::transformed(const glm::mat4& matrix) const {
+	if (!isValid())
+		return AABB();
+
+	// Center moves with the matrix, the extent along each axis is the sum of the absolute projections
+	const glm::vec3 center = glm::vec3(matrix * glm::vec4(getCenter(), 1.0f));
+	const glm::mat3 absolute = glm::mat3(glm::abs(glm::vec3(matrix[0])), glm::abs(glm::vec3(matrix[1])), glm::abs(glm::vec3(matrix[2])));
+	const glm::vec3 extent = absolute * getExtent();
+
+	return { center - extent, center + extent };
+}
+
 ISceneObject::~ISceneObject() {}
 
 void ISceneObject::calculateLocalModelMatrix() {
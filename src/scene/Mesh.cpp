@@ -1,19 +1,37 @@
 #include "Mesh.hpp"
 #include "ResourceManager.hpp"
+#include "RenderContext.hpp"
 #include "SceneManager.hpp"
 #include "GLTFLoader.hpp"
+#include "Profiler.hpp"
+#include "Logger.hpp"
+#include "MipChain.hpp"
+
+// Hashed at compile time, setting them per primitive does no string work
+static constexpr Resources::UniformName UNIFORM_MATERIAL_TEXTURES("uMaterialTextures");
+static constexpr Resources::UniformName UNIFORM_IRRADIANCE_MAP("uIrradianceMap");
+static constexpr Resources::UniformName UNIFORM_PREFILTER_MAP("uPrefilterMap");
+static constexpr Resources::UniformName UNIFORM_BRDF_LUT("uBrdfLUT");
+static constexpr Resources::UniformName UNIFORM_ENVIRONMENT_TYPE("uEnvironmentType");
+static constexpr Resources::UniformName UNIFORM_MATERIAL_TEXTURES_FACTORS("uMaterialTexturesFactors");
+static constexpr Resources::UniformName UNIFORM_MATERIAL_FLAGS("uMaterialFlags");
+
+// Images embedded in buffer views have no URI, they get one that is unique within the model
+static inline std::string getImageUri(const tinygltf::Image& image, const std::string& baseDir, const int imageIdx) {
+    return image.uri.empty() ? baseDir + "/images/" + std::to_string(imageIdx) : image.uri;
+}
 
-void Geometry::Mesh::draw(Resources::Shader& shader)
-{
-    if (!meshPtr_ || !modelPtr_)
-        return;
-
-    auto& modelRef = *modelPtr_;
-    auto& meshRef = *meshPtr_;
+// Images decoded through TextureCache carry their whole mip chain after level 0
+static inline int getImageLevels(const tinygltf::Image& image) {
+    const int pixelSize = image.component * (image.bits / 8);
+    if (image.image.size() > static_cast<size_t>(image.width) * image.height * pixelSize)
+        return Utils::getMipLevelCount(image.width, image.height);
 
-    auto resourceManager = Resources::ResourceManager::getInstance();
-    auto sceneManager = SceneResources::SceneManager::getInstance();
+    return 1;
+}
 
+void Geometry::Mesh::setTextureUnits(Resources::Shader& shader)
+{
     const int materialTextures[Resources::Material::TextureIdx::IDX_COUNT] = {
         Resources::Material::BASE_COLOR,
         Resources::Material::METALLIC_ROUGHNESS,
@@ -23,73 +41,86 @@ void Geometry::Mesh::draw(Resources::Shader& shader)
     };
 
     shader.use();
-    shader.setIntArray("uMaterialTextures", materialTextures, Resources::Material::TextureIdx::IDX_COUNT);
-    shader.setInt("uIrradianceMap", Resources::Material::TextureIdx::IDX_COUNT);
-    shader.setInt("uPrefilterMap", Resources::Material::TextureIdx::IDX_COUNT + 1);
-    shader.setInt("uBrdfLUT", Resources::Material::TextureIdx::IDX_COUNT + 2);
-    shader.setUint("uEnvironmentType", (uint32_t)sceneManager->getEnvironmentType());
+    shader.setIntArray(UNIFORM_MATERIAL_TEXTURES, materialTextures, Resources::Material::TextureIdx::IDX_COUNT);
+    shader.setInt(UNIFORM_IRRADIANCE_MAP, Resources::Material::TextureIdx::IDX_COUNT);
+    shader.setInt(UNIFORM_PREFILTER_MAP, Resources::Material::TextureIdx::IDX_COUNT + 1);
+    shader.setInt(UNIFORM_BRDF_LUT, Resources::Material::TextureIdx::IDX_COUNT + 2);
+}
 
-    for (size_t i = 0; i < meshRef.primitives.size(); ++i) {
-        glBindVertexArray(VAOs_[i]);
+void Geometry::Mesh::bindEnvironment(Resources::Shader& shader)
+{
+    auto resourceManager = Resources::ResourceManager::getInstance();
+    auto sceneManager = SceneResources::SceneManager::getInstance();
 
-        const tinygltf::Primitive& primitive = meshRef.primitives[i];
-        const tinygltf::Accessor& indexAccessor = modelRef.accessors[primitive.indices];
-        const tinygltf::BufferView& bufView = modelRef.bufferViews[indexAccessor.bufferView];
+    auto envType = sceneManager->getEnvironmentType();
+    Resources::ResourceHandle irradianceHandle;
+    Resources::ResourceHandle prefilterHandle;
+    Resources::ResourceHandle brdfLUTHandle;
 
-        auto& primitiveMaterial = resourceManager->getMaterial(primitiveMaterial_[i]);
+    if (envType == SceneResources::SceneManager::EnvironmentType::SKYBOX) {
+        irradianceHandle = sceneManager->getIrradianceMapSkyboxTextureHandle();
+        prefilterHandle = sceneManager->getPrefilterHDRMapSkyboxTextureHandle();
+        brdfLUTHandle = sceneManager->getBRDFLUTSkyboxTextureHandle();
+    }
+    else if (envType == SceneResources::SceneManager::EnvironmentType::EQUIRECTANGULAR) {
+        irradianceHandle = sceneManager->getIrradianceMapEquirectTextureHandle();
+        prefilterHandle = sceneManager->getPrefilterHDRMapEquirectTextureHandle();
+        brdfLUTHandle = sceneManager->getBRDFLUTEquirectTextureHandle();
+    }
 
-        glm::vec4 materialTexturesFactors[Resources::Material::TextureIdx::IDX_COUNT];
-        for (int i = 0; i < Resources::Material::TextureIdx::IDX_COUNT; ++i) {
-            auto tex = primitiveMaterial.textures[i];
-            materialTexturesFactors[i] = tex->factor;
-            resourceManager->bindTexture(tex->handle, i);
-        }
+    if (irradianceHandle.isValid() && prefilterHandle.isValid() && brdfLUTHandle.isValid()) {
+        resourceManager->bindTexture(irradianceHandle, Resources::Material::TextureIdx::IDX_COUNT);
+        resourceManager->bindTexture(prefilterHandle, Resources::Material::TextureIdx::IDX_COUNT + 1);
+        resourceManager->bindTexture(brdfLUTHandle, Resources::Material::TextureIdx::IDX_COUNT + 2);
+    }
+    else {
+        resourceManager->bindTexture(Resources::defaultTexturesNames[Resources::Texture::DefaultTextures::DEFAULT_TEXTURE_CUBEMAP_BLACK], Resources::Material::TextureIdx::IDX_COUNT);
+        resourceManager->bindTexture(Resources::defaultTexturesNames[Resources::Texture::DefaultTextures::DEFAULT_TEXTURE_CUBEMAP_BLACK], Resources::Material::TextureIdx::IDX_COUNT + 1);
+        resourceManager->bindTexture(Resources::defaultTexturesNames[Resources::Texture::DefaultTextures::DEFAULT_TEXTURE_BLACK], Resources::Material::TextureIdx::IDX_COUNT + 2);
+    }
 
-        auto envType = sceneManager->getEnvironmentType();
-        Resources::ResourceHandle irradianceHandle;
-        Resources::ResourceHandle prefilterHandle;
-        Resources::ResourceHandle brdfLUTHandle;
+    shader.setUint(UNIFORM_ENVIRONMENT_TYPE, (uint32_t)envType);
+}
 
-        if (envType == SceneResources::SceneManager::EnvironmentType::SKYBOX) {
-            irradianceHandle = sceneManager->getIrradianceMapSkyboxTextureHandle();
-            prefilterHandle = sceneManager->getPrefilterHDRMapSkyboxTextureHandle();
-            brdfLUTHandle = sceneManager->getBRDFLUTSkyboxTextureHandle();
-        }
-        else if (envType == SceneResources::SceneManager::EnvironmentType::EQUIRECTANGULAR) {
-            irradianceHandle = sceneManager->getIrradianceMapEquirectTextureHandle();
-            prefilterHandle = sceneManager->getPrefilterHDRMapEquirectTextureHandle();
-            brdfLUTHandle = sceneManager->getBRDFLUTEquirectTextureHandle();
-        }
+void Geometry::Mesh::bindMaterialTextures(const size_t primitiveIdx) const
+{
+    auto resourceManager = Resources::ResourceManager::getInstance();
+    auto& primitiveMaterial = resourceManager->getMaterial(primitiveMaterial_[primitiveIdx]);
 
-        if (irradianceHandle.isValid() && prefilterHandle.isValid() && brdfLUTHandle.isValid()) {
-            resourceManager->bindTexture(irradianceHandle, Resources::Material::TextureIdx::IDX_COUNT);
-            resourceManager->bindTexture(prefilterHandle, Resources::Material::TextureIdx::IDX_COUNT + 1);
-            resourceManager->bindTexture(brdfLUTHandle, Resources::Material::TextureIdx::IDX_COUNT + 2);
-        }
-        else {
-            resourceManager->bindTexture(Resources::defaultTexturesNames[Resources::Texture::DefaultTextures::DEFAULT_TEXTURE_CUBEMAP_BLACK], Resources::Material::TextureIdx::IDX_COUNT);
-            resourceManager->bindTexture(Resources::defaultTexturesNames[Resources::Texture::DefaultTextures::DEFAULT_TEXTURE_CUBEMAP_BLACK], Resources::Material::TextureIdx::IDX_COUNT + 1);
-            resourceManager->bindTexture(Resources::defaultTexturesNames[Resources::Texture::DefaultTextures::DEFAULT_TEXTURE_BLACK], Resources::Material::TextureIdx::IDX_COUNT + 2);
-        }
+    for (int i = 0; i < Resources::Material::TextureIdx::IDX_COUNT; ++i)
+        resourceManager->bindTexture(primitiveMaterial.textures[i]->handle, i);
+}
 
-        shader.setVec4Array("uMaterialTexturesFactors", &materialTexturesFactors[0][0], Resources::Material::TextureIdx::IDX_COUNT);
-        shader.setUint("uMaterialFlags", primitiveMaterial.materialFlags);
+void Geometry::Mesh::bindMaterial(Resources::Shader& shader, const size_t primitiveIdx) const
+{
+    PROFILE_SCOPE("Mesh::bindMaterial");
+    auto resourceManager = Resources::ResourceManager::getInstance();
+    auto& primitiveMaterial = resourceManager->getMaterial(primitiveMaterial_[primitiveIdx]);
 
-        glBindBuffer(bufView.target, VBOs_.at(indexAccessor.bufferView));
-        if (primitive.indices >= 0) {
-            glDrawElements(primitive.mode, indexAccessor.count, indexAccessor.componentType, (void*)BUFFER_OFFSET(indexAccessor.byteOffset));
-        }
-        else {
-            const auto accessorIdx = std::begin(primitive.attributes)->second;
-            const auto& accessor = modelRef.accessors[accessorIdx];
-            glDrawArrays(primitive.mode, 0, accessor.count);
-        }
-    }
-    glBindVertexArray(0);
+    glm::vec4 materialTexturesFactors[Resources::Material::TextureIdx::IDX_COUNT];
+    for (int i = 0; i < Resources::Material::TextureIdx::IDX_COUNT; ++i)
+        materialTexturesFactors[i] = primitiveMaterial.textures[i]->factor;
+
+    bindMaterialTextures(primitiveIdx);
+
+    shader.setVec4Array(UNIFORM_MATERIAL_TEXTURES_FACTORS, &materialTexturesFactors[0][0], Resources::Material::TextureIdx::IDX_COUNT);
+    shader.setUint(UNIFORM_MATERIAL_FLAGS, primitiveMaterial.materialFlags);
+}
+
+void Geometry::Mesh::drawPrimitive(const size_t primitiveIdx, const uint32_t lod) const
+{
+    PROFILE_SCOPE("Mesh::drawPrimitive");
+    const auto& range = primitiveRanges_[primitiveIdx];
+    const uint32_t indexCount = lod < range.lodCount ? range.lods[lod].indexCount : range.indexCount;
+    const uint32_t firstIndex = lod < range.lodCount ? range.lods[lod].firstIndex : range.firstIndex;
+    const size_t indexSize = range.indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+    // The element buffer binding is a part of the VAO state
+    glDrawElementsBaseVertex(range.mode, indexCount, range.indexType, (void*)BUFFER_OFFSET(firstIndex * indexSize), range.baseVertex);
 }
 
 void Geometry::Mesh::init()
 {
+    PROFILE_SCOPE("Mesh::init");
     if (!meshPtr_ || !modelPtr_)
         return;
 
@@ -98,70 +129,34 @@ void Geometry::Mesh::init()
 
     name = meshRef.name;
 
-    for (size_t i = 0; i < modelRef.bufferViews.size(); ++i) {
-        const tinygltf::BufferView& bufferView = modelRef.bufferViews[i];
-        if (bufferView.target == 0)
-            continue;
-
-        const tinygltf::Buffer& buffer = modelRef.buffers[bufferView.buffer];
+    auto gltfLoader = GLTF::GLTFLoader::getInstance();
 
-        unsigned int vbo;
-        glGenBuffers(1, &vbo);
-        VBOs_[i] = vbo;
+    const Geometry::Model* ownerModel = nullptr;
+    for (auto it : gltfLoader->loadedModels) {
+        if (modelPtr_ == &(it.second->getModelRef()))
+            ownerModel = it.second;
+    }
 
-        glBindBuffer(bufferView.target, vbo);
-        glBufferData(bufferView.target, bufferView.byteLength, &buffer.data.at(0) + bufferView.byteOffset, GL_STATIC_DRAW);
+    // Vertex and index data are packed and uploaded once per model into the geometry arena, primitives only reference it
+    if (!ownerModel) {
+        LOG_E("Mesh \'%s\' does not belong to a loaded model", name.c_str());
+        return;
     }
 
+    const int meshIdx = static_cast<int>(meshPtr_ - modelRef.meshes.data());
+    primitiveRanges_.assign(meshRef.primitives.size(), {});
+    primitiveMaterial_.assign(meshRef.primitives.size(), {});
+    positionTransform_ = ownerModel->getPositionTransform(meshIdx);
 
     for (size_t i = 0; i < meshRef.primitives.size(); ++i) {
-        unsigned int vao;
-
-        glGenVertexArrays(1, &vao);
-        glBindVertexArray(vao);
-        VAOs_[i] = vao;
+        primitiveRanges_[i] = ownerModel->getPrimitiveRange(meshIdx, static_cast<int>(i));
+        bounds_.expand(primitiveRanges_[i].bounds);
 
         const tinygltf::Primitive& primitive = meshRef.primitives[i];
-        const tinygltf::Accessor& indexAccessor = modelRef.accessors[primitive.indices];
-
-        for (auto& attrib : primitive.attributes) {
-            tinygltf::Accessor accessor = modelRef.accessors[attrib.second];
-            const tinygltf::BufferView& bufView = modelRef.bufferViews[accessor.bufferView];
-            int byteStride = accessor.ByteStride(bufView);
-            glBindBuffer(bufView.target, VBOs_[accessor.bufferView]);
-
-            int size = 1;
-            if (accessor.type != TINYGLTF_TYPE_SCALAR)
-                size = accessor.type;
-
-
-            int vaa = -1;
-            if (!attrib.first.compare("POSITION"))
-                vaa = 0;
-
-            if (!attrib.first.compare("NORMAL"))
-                vaa = 1;
-
-            if (!attrib.first.compare("TEXCOORD_0"))
-                vaa = 2;
-
-            if (vaa > -1) {
-                glEnableVertexAttribArray(vaa);
-                glVertexAttribPointer(vaa, size, accessor.componentType,
-                    accessor.normalized ? GL_TRUE : GL_FALSE,
-                    byteStride, (void*)BUFFER_OFFSET(accessor.byteOffset));
-            }
-        }
 
         auto resourceManager = Resources::ResourceManager::getInstance();
-        auto gltfLoader = GLTF::GLTFLoader::getInstance();
-
 
-        std::string baseDir = "/";
-        for (auto it : gltfLoader->loadedModels) {
-            if (modelPtr_ == &(it.second->getModelRef()))
-                baseDir = it.second->getFilename();
-        }
+        std::string baseDir = ownerModel ? ownerModel->getFilename() : "/";
 
         Resources::Image& defaultWhiteImage = resourceManager->getImage(Resources::Image::DEFAULT_IMAGE_WHITE);
         Resources::Texture& defaultWhiteTexture = resourceManager->getTexture(Resources::Texture::DEFAULT_TEXTURE_WHITE);
@@ -194,13 +189,14 @@ void Geometry::Mesh::init()
 
                     Resources::ImageDesc imDesc = {
                         image.name, 
-                        image.uri,
+                        getImageUri(image, baseDir, tex.source),
                         image.width,
                         image.height,
                         image.component,
                         image.bits,
                         format,
-                        image.image.data()
+                        image.image.data(),
+                        getImageLevels(image)
                     };
                     auto& baseColorImage = resourceManager->createImage(imDesc);
                     texDesc.name = baseColorImage.name;
@@ -234,13 +230,14 @@ void Geometry::Mesh::init()
 
                     Resources::ImageDesc imDesc = {
                         image.name,
-                        image.uri,
+                        getImageUri(image, baseDir, tex.source),
                         image.width,
                         image.height,
                         image.component,
                         image.bits,
                         GL_RGBA,
-                        image.image.data()
+                        image.image.data(),
+                        getImageLevels(image)
                     };
                     auto& metallicRoughnessImage = resourceManager->createImage(imDesc);
                     texDesc.name = metallicRoughnessImage.name;
@@ -272,13 +269,14 @@ void Geometry::Mesh::init()
 
                     Resources::ImageDesc imDesc = {
                         image.name,
-                        image.uri,
+                        getImageUri(image, baseDir, tex.source),
                         image.width,
                         image.height,
                         image.component,
                         image.bits,
                         GL_RGBA,
-                        image.image.data()
+                        image.image.data(),
+                        getImageLevels(image)
                     };
                     auto& emissiveImage = resourceManager->createImage(imDesc);
                     texDesc.name = emissiveImage.name;
@@ -309,13 +307,14 @@ void Geometry::Mesh::init()
 
                     Resources::ImageDesc imDesc = {
                         image.name,
-                        image.uri,
+                        getImageUri(image, baseDir, tex.source),
                         image.width,
                         image.height,
                         image.component,
                         image.bits,
                         GL_RGBA,
-                        image.image.data()
+                        image.image.data(),
+                        getImageLevels(image)
                     };
                     auto& normalImage = resourceManager->createImage(imDesc);
                     texDesc.name = normalImage.name;
@@ -346,13 +345,14 @@ void Geometry::Mesh::init()
 
                     Resources::ImageDesc imDesc = {
                         image.name,
-                        image.uri,
+                        getImageUri(image, baseDir, tex.source),
                         image.width,
                         image.height,
                         image.component,
                         image.bits,
                         GL_RGBA,
-                        image.image.data()
+                        image.image.data(),
+                        getImageLevels(image)
                     };
                     auto& occlusionImage = resourceManager->createImage(imDesc);
                     texDesc.name = occlusionImage.name;
@@ -372,5 +372,4 @@ void Geometry::Mesh::init()
             newMat.materialFlags |= Resources::Material::MATERIAL_FLAG_NORMAL_MAP_BIT;
         }
     }
-    glBindVertexArray(0);
 }
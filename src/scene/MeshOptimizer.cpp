@@ -0,0 +1,484 @@
+#include "MeshOptimizer.hpp"
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+
+namespace SceneResources {
+
+// Border edges are kept by planes through them perpendicular to their triangle, weighted much higher than the surface
+static constexpr double BORDER_WEIGHT = 10.0;
+// Collapses rotating a triangle normal further than about 75 degrees are rejected
+static constexpr float MIN_NORMAL_COSINE = 0.25f;
+
+// Seam positions have several vertices split by other attributes, they only move along the seam with all of their vertices
+enum PositionKind : uint8_t {
+    KIND_MANIFOLD = 0,
+    KIND_BORDER = 1,
+    KIND_SEAM = 2,
+    KIND_LOCKED = 3
+};
+
+// Sum of squared distances to area weighted planes, kept in double to stay precise far from the origin
+struct Quadric {
+    double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+    double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+    double c = 0.0;
+    double weight = 0.0;
+
+    void addPlane(const glm::vec3& normal, const float distance, const double planeWeight) {
+        const double nx = normal.x, ny = normal.y, nz = normal.z, d = distance;
+        a00 += planeWeight * nx * nx; a01 += planeWeight * nx * ny; a02 += planeWeight * nx * nz;
+        a11 += planeWeight * ny * ny; a12 += planeWeight * ny * nz; a22 += planeWeight * nz * nz;
+        b0 += planeWeight * nx * d; b1 += planeWeight * ny * d; b2 += planeWeight * nz * d;
+        c += planeWeight * d * d;
+        weight += planeWeight;
+    }
+
+    void add(const Quadric& other) {
+        a00 += other.a00; a01 += other.a01; a02 += other.a02;
+        a11 += other.a11; a12 += other.a12; a22 += other.a22;
+        b0 += other.b0; b1 += other.b1; b2 += other.b2;
+        c += other.c;
+        weight += other.weight;
+    }
+
+    double evaluate(const glm::vec3& point) const {
+        const double x = point.x, y = point.y, z = point.z;
+        const double value = a00 * x * x + a11 * y * y + a22 * z * z + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+                             2.0 * (b0 * x + b1 * y + b2 * z) + c;
+        return std::max(value, 0.0);
+    }
+};
+
+static inline uint64_t getEdgeKey(const uint32_t a, const uint32_t b) {
+    return a < b ? (static_cast<uint64_t>(a) << 32) | b : (static_cast<uint64_t>(b) << 32) | a;
+}
+
+
+float simplifyMesh(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, const size_t targetIndexCount,
+                   const float targetError, std::vector<uint32_t>& result) {
+    PROFILE_SCOPE("simplifyMesh");
+    result = indices;
+    const size_t vertexCount = positions.size();
+    for (const auto index : indices) {
+        if (index >= vertexCount)
+            return 0.0f;
+    }
+
+    // Referenced vertices grouped by position
+    std::vector<uint32_t> positionIds(vertexCount);
+    std::vector<uint32_t> wedgeOffsets, wedges;
+    {
+        struct PositionHash {
+            size_t operator()(const glm::vec3& p) const {
+                uint32_t bits[3];
+                std::memcpy(bits, &p, sizeof(bits));
+                return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+            }
+        };
+
+        std::unordered_map<glm::vec3, uint32_t, PositionHash> ids;
+        std::vector<uint8_t> referenced(vertexCount, 0);
+        for (const auto index : indices)
+            referenced[index] = 1;
+
+        for (uint32_t v = 0; v < vertexCount; ++v)
+            positionIds[v] = ids.emplace(positions[v], static_cast<uint32_t>(ids.size())).first->second;
+
+        wedgeOffsets.assign(ids.size() + 1, 0);
+        for (uint32_t v = 0; v < vertexCount; ++v)
+            wedgeOffsets[positionIds[v] + 1] += referenced[v];
+        for (size_t p = 0; p < ids.size(); ++p)
+            wedgeOffsets[p + 1] += wedgeOffsets[p];
+
+        wedges.resize(wedgeOffsets.back());
+        std::vector<uint32_t> fill(wedgeOffsets.begin(), wedgeOffsets.end() - 1);
+        for (uint32_t v = 0; v < vertexCount; ++v) {
+            if (referenced[v])
+                wedges[fill[positionIds[v]]++] = v;
+        }
+    }
+    const size_t positionCount = wedgeOffsets.size() - 1;
+
+    // Edges are counted between positions, so seams do not look like borders
+    std::unordered_map<uint64_t, uint32_t> edgeCounts;
+    auto countEdges = [&]() {
+        edgeCounts.clear();
+        for (size_t t = 0; t < result.size(); t += 3) {
+            for (int k = 0; k < 3; ++k)
+                ++edgeCounts[getEdgeKey(positionIds[result[t + k]], positionIds[result[t + (k + 1) % 3]])];
+        }
+    };
+    edgeCounts.reserve(indices.size());
+    countEdges();
+
+    std::vector<uint8_t> kinds(positionCount, KIND_MANIFOLD);
+    for (const auto& [key, count] : edgeCounts) {
+        for (const auto p : { static_cast<uint32_t>(key >> 32), static_cast<uint32_t>(key) }) {
+            if (count > 2)
+                kinds[p] = KIND_LOCKED;
+            else if (count == 1 && kinds[p] == KIND_MANIFOLD)
+                kinds[p] = KIND_BORDER;
+        }
+    }
+    for (size_t p = 0; p < positionCount; ++p) {
+        if (wedgeOffsets[p + 1] - wedgeOffsets[p] > 1)
+            kinds[p] = kinds[p] == KIND_MANIFOLD ? KIND_SEAM : KIND_LOCKED;
+    }
+
+    std::vector<Quadric> quadrics(positionCount);
+    for (size_t t = 0; t < indices.size(); t += 3) {
+        const glm::vec3& p0 = positions[indices[t]];
+        const glm::vec3 normal = glm::cross(positions[indices[t + 1]] - p0, positions[indices[t + 2]] - p0);
+        const float length = glm::length(normal);
+        if (length <= 0.0f)
+            continue;
+
+        const glm::vec3 unitNormal = normal / length;
+        for (int k = 0; k < 3; ++k)
+            quadrics[positionIds[indices[t + k]]].addPlane(unitNormal, -glm::dot(unitNormal, p0), 0.5 * length);
+
+        for (int k = 0; k < 3; ++k) {
+            const uint32_t a = indices[t + k], b = indices[t + (k + 1) % 3];
+            if (edgeCounts[getEdgeKey(positionIds[a], positionIds[b])] != 1)
+                continue;
+
+            const glm::vec3 edge = positions[b] - positions[a];
+            const glm::vec3 borderNormal = glm::cross(edge, unitNormal);
+            const float borderLength = glm::length(borderNormal);
+            if (borderLength <= 0.0f)
+                continue;
+
+            const glm::vec3 unitBorderNormal = borderNormal / borderLength;
+            const double borderWeight = BORDER_WEIGHT * glm::dot(edge, edge);
+            quadrics[positionIds[a]].addPlane(unitBorderNormal, -glm::dot(unitBorderNormal, positions[a]), borderWeight);
+            quadrics[positionIds[b]].addPlane(unitBorderNormal, -glm::dot(unitBorderNormal, positions[a]), borderWeight);
+        }
+    }
+
+    struct Collapse {
+        double cost;
+        uint32_t source;
+        uint32_t target;
+    };
+
+    const double maxCost = static_cast<double>(targetError) * targetError;
+    double largestCost = 0.0;
+    std::vector<uint32_t> triangleOffsets(vertexCount + 1), vertexTriangles;
+    std::vector<Collapse> collapses;
+    std::vector<uint32_t> collapseTargets(vertexCount);
+    std::vector<uint8_t> touched(positionCount);
+
+    // Vertex of the target position sharing a triangle with the vertex, every vertex of a seam needs one
+    auto findTarget = [&](const uint32_t vertex, const uint32_t targetPosition) -> uint32_t {
+        for (uint32_t i = triangleOffsets[vertex]; i < triangleOffsets[vertex + 1]; ++i) {
+            const uint32_t t = vertexTriangles[i] * 3;
+            for (int k = 0; k < 3; ++k) {
+                if (positionIds[result[t + k]] == targetPosition)
+                    return result[t + k];
+            }
+        }
+        return UINT32_MAX;
+    };
+
+    // Every pass collapses a set of edges whose neighbourhoods do not overlap, costs stay exact within a pass
+    while (result.size() > targetIndexCount) {
+        std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+        for (const auto index : result)
+            ++triangleOffsets[index + 1];
+        for (size_t v = 0; v < vertexCount; ++v)
+            triangleOffsets[v + 1] += triangleOffsets[v];
+        vertexTriangles.resize(result.size());
+        {
+            std::vector<uint32_t> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+            for (uint32_t i = 0; i < result.size(); ++i)
+                vertexTriangles[fill[result[i]]++] = i / 3;
+        }
+        countEdges();
+
+        // Cheapest collapse of every position that may move, made from its first vertex
+        collapses.clear();
+        for (uint32_t p = 0; p < positionCount; ++p) {
+            if (kinds[p] == KIND_LOCKED || wedgeOffsets[p] == wedgeOffsets[p + 1])
+                continue;
+
+            const uint32_t v = wedges[wedgeOffsets[p]];
+            Collapse best = { DBL_MAX, v, v };
+            for (uint32_t i = triangleOffsets[v]; i < triangleOffsets[v + 1]; ++i) {
+                const uint32_t t = vertexTriangles[i] * 3;
+                for (int k = 0; k < 3; ++k) {
+                    const uint32_t u = result[t + k];
+                    if (positionIds[u] == p)
+                        continue;
+                    if (kinds[p] == KIND_BORDER && edgeCounts[getEdgeKey(p, positionIds[u])] != 1)
+                        continue;
+                    if (kinds[p] == KIND_SEAM && edgeCounts[getEdgeKey(p, positionIds[u])] != 2)
+                        continue;
+
+                    Quadric quadric = quadrics[p];
+                    quadric.add(quadrics[positionIds[u]]);
+                    const double cost = quadric.weight > 0.0 ? quadric.evaluate(positions[u]) / quadric.weight : 0.0;
+                    if (cost < best.cost)
+                        best = { cost, v, u };
+                }
+            }
+
+            if (best.target != v && best.cost <= maxCost)
+                collapses.push_back(best);
+        }
+
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+        for (uint32_t v = 0; v < vertexCount; ++v)
+            collapseTargets[v] = v;
+        std::fill(touched.begin(), touched.end(), 0);
+
+        // Manifold collapses remove two triangles, border ones one
+        size_t removedIndices = 0;
+        const size_t excessIndices = result.size() - targetIndexCount;
+        size_t collapseCount = 0;
+
+        for (const auto& collapse : collapses) {
+            if (removedIndices >= excessIndices)
+                break;
+
+            const uint32_t source = positionIds[collapse.source], target = positionIds[collapse.target];
+            if (touched[source] || touched[target])
+                continue;
+
+            bool valid = true;
+            size_t removedTriangles = 0;
+            for (uint32_t w = wedgeOffsets[source]; w < wedgeOffsets[source + 1] && valid; ++w) {
+                const uint32_t v = wedges[w];
+                const uint32_t u = findTarget(v, target);
+                valid = u != UINT32_MAX || triangleOffsets[v] == triangleOffsets[v + 1];
+
+                for (uint32_t i = triangleOffsets[v]; i < triangleOffsets[v + 1] && valid; ++i) {
+                    const uint32_t t = vertexTriangles[i] * 3;
+                    const uint32_t a = result[t], b = result[t + 1], c = result[t + 2];
+                    if (positionIds[a] == target || positionIds[b] == target || positionIds[c] == target) {
+                        ++removedTriangles;
+                        continue;
+                    }
+
+                    const glm::vec3 oldNormal = glm::cross(positions[b] - positions[a], positions[c] - positions[a]);
+                    const glm::vec3 pa = positions[a == v ? u : a], pb = positions[b == v ? u : b], pc = positions[c == v ? u : c];
+                    const glm::vec3 newNormal = glm::cross(pb - pa, pc - pa);
+                    valid = glm::dot(oldNormal, newNormal) >= MIN_NORMAL_COSINE * glm::length(oldNormal) * glm::length(newNormal);
+                }
+                if (u != UINT32_MAX)
+                    collapseTargets[v] = u;
+            }
+            if (!valid) {
+                for (uint32_t w = wedgeOffsets[source]; w < wedgeOffsets[source + 1]; ++w)
+                    collapseTargets[wedges[w]] = wedges[w];
+                continue;
+            }
+
+            quadrics[target].add(quadrics[source]);
+            largestCost = std::max(largestCost, collapse.cost);
+            removedIndices += removedTriangles * 3;
+            ++collapseCount;
+
+            touched[target] = 1;
+            for (uint32_t w = wedgeOffsets[source]; w < wedgeOffsets[source + 1]; ++w) {
+                const uint32_t v = wedges[w];
+                for (uint32_t i = triangleOffsets[v]; i < triangleOffsets[v + 1]; ++i) {
+                    const uint32_t t = vertexTriangles[i] * 3;
+                    for (int k = 0; k < 3; ++k)
+                        touched[positionIds[result[t + k]]] = 1;
+                }
+            }
+        }
+
+        if (collapseCount == 0)
+            break;
+
+        size_t write = 0;
+        for (size_t t = 0; t < result.size(); t += 3) {
+            const uint32_t a = collapseTargets[result[t]], b = collapseTargets[result[t + 1]], c = collapseTargets[result[t + 2]];
+            if (positionIds[a] == positionIds[b] || positionIds[b] == positionIds[c] || positionIds[a] == positionIds[c])
+                continue;
+
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        result.resize(write);
+    }
+
+    return static_cast<float>(std::sqrt(largestCost));
+}
+
+
+
+VertexCacheStatistics analyzeVertexCache(const std::vector<uint32_t>& indices, const size_t vertexCount, const uint32_t cacheSize) {
+    VertexCacheStatistics statistics;
+    statistics.triangles = indices.size() / 3;
+    statistics.vertices = vertexCount;
+
+    // A vertex is still cached while fewer than cacheSize misses have happened since its own
+    std::vector<size_t> timestamps(vertexCount, 0);
+    size_t time = cacheSize + 1;
+    for (const auto index : indices) {
+        if (index >= vertexCount)
+            continue;
+
+        if (time - timestamps[index] > cacheSize) {
+            timestamps[index] = time++;
+            ++statistics.transformedVertices;
+        }
+    }
+    return statistics;
+}
+
+
+size_t generateVertexRemap(const void* vertices, const size_t vertexCount, const size_t vertexSize, std::vector<uint32_t>& remap) {
+    PROFILE_SCOPE("generateVertexRemap");
+    const unsigned char* bytes = static_cast<const unsigned char*>(vertices);
+    remap.assign(vertexCount, UINT32_MAX);
+
+    struct VertexHash {
+        const unsigned char* bytes;
+        size_t size;
+
+        size_t operator()(const uint32_t vertex) const {
+            // FNV-1a over the whole vertex
+            size_t hash = 14695981039346656037ull;
+            for (size_t i = 0; i < size; ++i)
+                hash = (hash ^ bytes[vertex * size + i]) * 1099511628211ull;
+            return hash;
+        }
+    };
+
+    struct VertexEqual {
+        const unsigned char* bytes;
+        size_t size;
+
+        bool operator()(const uint32_t a, const uint32_t b) const {
+            return std::memcmp(bytes + a * size, bytes + b * size, size) == 0;
+        }
+    };
+
+    std::unordered_map<uint32_t, uint32_t, VertexHash, VertexEqual> uniqueVertices(vertexCount, VertexHash{ bytes, vertexSize },
+                                                                                    VertexEqual{ bytes, vertexSize });
+    for (uint32_t v = 0; v < vertexCount; ++v)
+        remap[v] = uniqueVertices.emplace(v, static_cast<uint32_t>(uniqueVertices.size())).first->second;
+
+    return uniqueVertices.size();
+}
+
+
+void optimizeVertexCache(std::vector<uint32_t>& indices, const size_t vertexCount, const uint32_t cacheSize) {
+    PROFILE_SCOPE("optimizeVertexCache");
+    const size_t triangleCount = indices.size() / 3;
+    if (indices.size() % 3 != 0)
+        return;
+    for (const auto index : indices) {
+        if (index >= vertexCount)
+            return;
+    }
+
+    std::vector<uint32_t> triangleOffsets(vertexCount + 1, 0);
+    for (const auto index : indices)
+        ++triangleOffsets[index + 1];
+    for (size_t v = 0; v < vertexCount; ++v)
+        triangleOffsets[v + 1] += triangleOffsets[v];
+
+    std::vector<uint32_t> vertexTriangles(indices.size());
+    {
+        std::vector<uint32_t> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+        for (uint32_t i = 0; i < indices.size(); ++i)
+            vertexTriangles[fill[indices[i]]++] = i / 3;
+    }
+
+    // Triangles not emitted yet around every vertex
+    std::vector<uint32_t> liveTriangles(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+        liveTriangles[v] = triangleOffsets[v + 1] - triangleOffsets[v];
+
+    std::vector<size_t> timestamps(vertexCount, 0);
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    std::vector<uint32_t> deadEnd;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> result;
+    result.reserve(triangleCount * 3);
+
+    size_t time = cacheSize + 1;
+    uint32_t cursor = 0;
+
+    // Vertices of the fans emitted last, then the remaining vertices in order, once the fan has nowhere to go
+    auto skipDeadEnd = [&]() -> uint32_t {
+        while (!deadEnd.empty()) {
+            const uint32_t vertex = deadEnd.back();
+            deadEnd.pop_back();
+            if (liveTriangles[vertex] > 0)
+                return vertex;
+        }
+        while (cursor < vertexCount) {
+            if (liveTriangles[cursor] > 0)
+                return cursor;
+            ++cursor;
+        }
+        return UINT32_MAX;
+    };
+
+    uint32_t fanVertex = skipDeadEnd();
+    while (fanVertex != UINT32_MAX) {
+        candidates.clear();
+        for (uint32_t i = triangleOffsets[fanVertex]; i < triangleOffsets[fanVertex + 1]; ++i) {
+            const uint32_t triangle = vertexTriangles[i];
+            if (emitted[triangle])
+                continue;
+
+            for (int k = 0; k < 3; ++k) {
+                const uint32_t vertex = indices[triangle * 3 + k];
+                result.push_back(vertex);
+                deadEnd.push_back(vertex);
+                candidates.push_back(vertex);
+                --liveTriangles[vertex];
+                if (time - timestamps[vertex] > cacheSize)
+                    timestamps[vertex] = time++;
+            }
+            emitted[triangle] = 1;
+        }
+
+        // The candidate which stays in the cache the longest while its remaining triangles are emitted
+        uint32_t nextVertex = UINT32_MAX;
+        size_t bestPriority = 0;
+        for (const auto vertex : candidates) {
+            if (liveTriangles[vertex] == 0)
+                continue;
+
+            size_t priority = 0;
+            if (time - timestamps[vertex] + 2 * liveTriangles[vertex] <= cacheSize)
+                priority = time - timestamps[vertex];
+            if (nextVertex == UINT32_MAX || priority > bestPriority) {
+                bestPriority = priority;
+                nextVertex = vertex;
+            }
+        }
+
+        fanVertex = nextVertex != UINT32_MAX ? nextVertex : skipDeadEnd();
+    }
+
+    indices.swap(result);
+}
+
+
+size_t optimizeVertexFetchRemap(const std::vector<uint32_t>& indices, const size_t vertexCount, std::vector<uint32_t>& remap) {
+    remap.assign(vertexCount, UINT32_MAX);
+    uint32_t nextVertex = 0;
+    for (const auto index : indices) {
+        if (index < vertexCount && remap[index] == UINT32_MAX)
+            remap[index] = nextVertex++;
+    }
+    return nextVertex;
+}
+
+}
@@ -1,8 +1,15 @@
 #include "ResourceManager.hpp"
 #include "SceneManager.hpp"
 #include "Model.hpp"
+#include "Profiler.hpp"
+#include "Logger.hpp"
 
 #include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
 
 namespace Geometry {
 
@@ -18,16 +25,539 @@ static inline void collectChildNodes(std::vector<SceneResources::SceneNode*>& pr
 	}
 }
 
-static inline bool nodeIsParentIdx(const tinygltf::Model& model, const int idx) {
-	for (auto& node : model.nodes)
-		if (std::find(node.children.begin(), node.children.end(), idx) != node.children.end())
-			return false;
 
+void Model::addMappedBuffer(const int bufferIdx, const std::shared_ptr<Utils::MappedFile>& file, const size_t offset, const size_t size) {
+	if (std::find(mappedFiles_.begin(), mappedFiles_.end(), file) == mappedFiles_.end())
+		mappedFiles_.push_back(file);
+
+	if (bufferIdx >= mappedBuffers_.size())
+		mappedBuffers_.resize(bufferIdx + 1);
+
+	mappedBuffers_[bufferIdx] = { file->data() + offset, size };
+}
+
+const unsigned char* Model::getBufferData(const int bufferIdx) const {
+	if (bufferIdx < mappedBuffers_.size() && mappedBuffers_[bufferIdx].data)
+		return mappedBuffers_[bufferIdx].data;
+
+	return model_.buffers[bufferIdx].data.data();
+}
+
+size_t Model::getBufferSize(const int bufferIdx) const {
+	if (bufferIdx < mappedBuffers_.size() && mappedBuffers_[bufferIdx].data)
+		return mappedBuffers_[bufferIdx].size;
+
+	return model_.buffers[bufferIdx].data.size();
+}
+
+
+// Elements of an accessor as floats, normalized integers are converted the way GL does it
+static bool readAccessor(const Model& model, const int accessorIdx, const int components, float* dst, const size_t dstStride) {
+	const auto& modelRef = model.getModelRef();
+	if (accessorIdx < 0 || accessorIdx >= modelRef.accessors.size())
+		return false;
+
+	const tinygltf::Accessor& accessor = modelRef.accessors[accessorIdx];
+	if (accessor.bufferView < 0 || accessor.bufferView >= modelRef.bufferViews.size())
+		return false;
+
+	const tinygltf::BufferView& bufferView = modelRef.bufferViews[accessor.bufferView];
+	const int accessorComponents = accessor.type == TINYGLTF_TYPE_SCALAR ? 1 : accessor.type;
+	const int componentSize = tinygltf::GetComponentSizeInBytes(accessor.componentType);
+	const int stride = accessor.ByteStride(bufferView);
+	const unsigned char* data = model.getBufferData(bufferView.buffer);
+	if (!data || componentSize <= 0 || stride <= 0 || accessor.count == 0 ||
+		bufferView.byteOffset + accessor.byteOffset + (accessor.count - 1) * stride + accessorComponents * componentSize > model.getBufferSize(bufferView.buffer))
+		return false;
+
+	data += bufferView.byteOffset + accessor.byteOffset;
+	const int count = std::min(components, accessorComponents);
+	for (size_t i = 0; i < accessor.count; ++i, data += stride, dst += dstStride) {
+		for (int c = 0; c < count; ++c) {
+			const unsigned char* src = data + c * componentSize;
+			float value = 0.0f;
+			switch (accessor.componentType) {
+			case TINYGLTF_COMPONENT_TYPE_FLOAT:
+				std::memcpy(&value, src, sizeof(float));
+				break;
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+				value = accessor.normalized ? *src / 255.0f : *src;
+				break;
+			case TINYGLTF_COMPONENT_TYPE_BYTE:
+				value = accessor.normalized ? std::max(*reinterpret_cast<const int8_t*>(src) / 127.0f, -1.0f) : *reinterpret_cast<const int8_t*>(src);
+				break;
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+				uint16_t v;
+				std::memcpy(&v, src, sizeof(v));
+				value = accessor.normalized ? v / 65535.0f : v;
+				break;
+			}
+			case TINYGLTF_COMPONENT_TYPE_SHORT: {
+				int16_t v;
+				std::memcpy(&v, src, sizeof(v));
+				value = accessor.normalized ? std::max(v / 32767.0f, -1.0f) : v;
+				break;
+			}
+			default:
+				return false;
+			}
+			dst[c] = value;
+		}
+	}
 	return true;
 }
 
+static bool readIndices(const Model& model, const int accessorIdx, const uint32_t baseIndex, std::vector<uint32_t>& dst) {
+	const auto& modelRef = model.getModelRef();
+	const tinygltf::Accessor& accessor = modelRef.accessors[accessorIdx];
+	if (accessor.bufferView < 0 || accessor.bufferView >= modelRef.bufferViews.size())
+		return false;
+
+	const tinygltf::BufferView& bufferView = modelRef.bufferViews[accessor.bufferView];
+	const int componentSize = tinygltf::GetComponentSizeInBytes(accessor.componentType);
+	const unsigned char* data = model.getBufferData(bufferView.buffer);
+	if (!data || componentSize <= 0 ||
+		bufferView.byteOffset + accessor.byteOffset + accessor.count * componentSize > model.getBufferSize(bufferView.buffer))
+		return false;
+
+	data += bufferView.byteOffset + accessor.byteOffset;
+	dst.reserve(dst.size() + accessor.count);
+	for (size_t i = 0; i < accessor.count; ++i) {
+		uint32_t index = 0;
+		switch (accessor.componentType) {
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+			index = data[i];
+			break;
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+			uint16_t v;
+			std::memcpy(&v, data + i * 2, sizeof(v));
+			index = v;
+			break;
+		}
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+			std::memcpy(&index, data + i * 4, sizeof(index));
+			break;
+		default:
+			return false;
+		}
+		dst.push_back(baseIndex + index);
+	}
+	return true;
+}
+
+
+const glm::mat4& Model::getPositionTransform(const int meshIdx) const {
+	static const glm::mat4 identity(1.0f);
+	if (meshIdx < 0 || meshIdx >= positionTransforms_.size())
+		return identity;
+
+	return positionTransforms_[meshIdx];
+}
+
+
+const PrimitiveRange& Model::getPrimitiveRange(const int meshIdx, const int primitiveIdx) const {
+	static const PrimitiveRange emptyRange;
+	if (meshIdx < 0 || meshIdx >= primitiveRanges_.size() || primitiveIdx < 0 || primitiveIdx >= primitiveRanges_[meshIdx].size())
+		return emptyRange;
+
+	return primitiveRanges_[meshIdx][primitiveIdx];
+}
+
+
+void Model::packGeometry() {
+	PROFILE_SCOPE("Model::packGeometry");
+	packedVertices_.clear();
+	packedIndices_.clear();
+	primitiveRanges_.assign(model_.meshes.size(), {});
+	authoredCacheStatistics_ = {};
+	optimizedCacheStatistics_ = {};
+
+	for (size_t m = 0; m < model_.meshes.size(); ++m) {
+		const auto& mesh = model_.meshes[m];
+		primitiveRanges_[m].resize(mesh.primitives.size());
+
+		for (size_t p = 0; p < mesh.primitives.size(); ++p) {
+			const auto& primitive = mesh.primitives[p];
+			auto& range = primitiveRanges_[m][p];
+			range.mode = primitive.mode >= 0 ? primitive.mode : TINYGLTF_MODE_TRIANGLES;
+
+			auto position = primitive.attributes.find("POSITION");
+			if (position == primitive.attributes.end() || position->second < 0 || position->second >= model_.accessors.size())
+				continue;
+
+			const size_t vertexCount = model_.accessors[position->second].count;
+			const size_t firstVertex = packedVertices_.size();
+			const size_t firstIndex = packedIndices_.size();
+			packedVertices_.resize(firstVertex + vertexCount, Resources::GeometryArena::Vertex{});
+
+			constexpr size_t vertexFloats = sizeof(Resources::GeometryArena::Vertex) / sizeof(float);
+			auto readAttribute = [&](const char* name, const int components, float* dst) {
+				auto attrib = primitive.attributes.find(name);
+				if (attrib != primitive.attributes.end() && model_.accessors[attrib->second].count == vertexCount)
+					readAccessor(*this, attrib->second, components, dst, vertexFloats);
+			};
+			if (!readAccessor(*this, position->second, 3, packedVertices_[firstVertex].position, vertexFloats)) {
+				packedVertices_.resize(firstVertex);
+				continue;
+			}
+			readAttribute("NORMAL", 3, packedVertices_[firstVertex].normal);
+			readAttribute("TEXCOORD_0", 2, packedVertices_[firstVertex].uv);
+
+			// Min and max of float positions are mandatory in glTF, quantized ones would have to be dequantized
+			const auto& positionAccessor = model_.accessors[position->second];
+			if (positionAccessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT && positionAccessor.minValues.size() == 3 && positionAccessor.maxValues.size() == 3) {
+				range.bounds.minCorner = glm::vec3(positionAccessor.minValues[0], positionAccessor.minValues[1], positionAccessor.minValues[2]);
+				range.bounds.maxCorner = glm::vec3(positionAccessor.maxValues[0], positionAccessor.maxValues[1], positionAccessor.maxValues[2]);
+			}
+			else {
+				for (size_t v = firstVertex; v < packedVertices_.size(); ++v)
+					range.bounds.expand(glm::make_vec3(packedVertices_[v].position));
+			}
+
+			// Indices stay relative to the primitive, its vertices are addressed by baseVertex
+			bool hasIndices = primitive.indices >= 0 && primitive.indices < model_.accessors.size();
+			if (hasIndices && !readIndices(*this, primitive.indices, 0, packedIndices_)) {
+				packedIndices_.resize(firstIndex);
+				hasIndices = false;
+			}
+			if (!hasIndices) {
+				for (uint32_t i = 0; i < vertexCount; ++i)
+					packedIndices_.push_back(i);
+			}
+
+			range.indexCount = static_cast<uint32_t>(packedIndices_.size() - firstIndex);
+			range.firstIndex = static_cast<uint32_t>(firstIndex);
+			range.baseVertex = static_cast<int32_t>(firstVertex);
+			optimizePrimitive(range);
+			range.vertexCount = static_cast<uint32_t>(packedVertices_.size() - firstVertex);
+			range.lods[0] = { range.indexCount, range.firstIndex, 0.0f };
+			range.lodCount = 1;
+		}
+	}
+
+	if (authoredCacheStatistics_.triangles > 0) {
+		LOG_I("%s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, %zu -> %zu vertices", name_.c_str(),
+			  authoredCacheStatistics_.getAcmr(), optimizedCacheStatistics_.getAcmr(), authoredCacheStatistics_.getAtvr(),
+			  optimizedCacheStatistics_.getAtvr(), authoredCacheStatistics_.vertices, optimizedCacheStatistics_.vertices);
+	}
+}
+
+
+void Model::restorePackedGeometry(PackedGeometry&& geometry) {
+	packedVertices_ = std::move(geometry.vertices);
+	packedIndices_ = std::move(geometry.indices);
+	primitiveRanges_ = std::move(geometry.primitiveRanges);
+	occluders_ = std::move(geometry.occluders);
+	authoredCacheStatistics_ = geometry.authoredCacheStatistics;
+	optimizedCacheStatistics_ = geometry.optimizedCacheStatistics;
+	geometryRestored_ = true;
+}
+
+
+void Model::optimizePrimitive(PrimitiveRange& range) {
+	PROFILE_SCOPE("Model::optimizePrimitive");
+	// The primitive is the last one packed, so its vertices may shrink in place
+	const size_t vertexCount = packedVertices_.size() - range.baseVertex;
+	std::vector<uint32_t> indices(packedIndices_.begin() + range.firstIndex, packedIndices_.begin() + range.firstIndex + range.indexCount);
+	if (indices.empty() || *std::max_element(indices.begin(), indices.end()) >= vertexCount)
+		return;
+
+	const bool isTriangleList = range.mode == GL_TRIANGLES && indices.size() % 3 == 0;
+	if (isTriangleList)
+		authoredCacheStatistics_.add(SceneResources::analyzeVertexCache(indices, vertexCount));
+
+	// Welding first lets the triangle order see the real connectivity
+	Resources::GeometryArena::Vertex* vertices = packedVertices_.data() + range.baseVertex;
+	std::vector<uint32_t> weldRemap;
+	const size_t uniqueCount = SceneResources::generateVertexRemap(vertices, vertexCount, sizeof(Resources::GeometryArena::Vertex), weldRemap);
+	for (auto& index : indices)
+		index = weldRemap[index];
+
+	if (isTriangleList)
+		SceneResources::optimizeVertexCache(indices, uniqueCount);
+
+	std::vector<uint32_t> fetchRemap;
+	const size_t referencedCount = SceneResources::optimizeVertexFetchRemap(indices, uniqueCount, fetchRemap);
+	for (auto& index : indices)
+		index = fetchRemap[index];
+
+	std::vector<Resources::GeometryArena::Vertex> optimizedVertices(referencedCount);
+	for (size_t v = 0; v < vertexCount; ++v) {
+		const uint32_t target = fetchRemap[weldRemap[v]];
+		if (target != UINT32_MAX)
+			optimizedVertices[target] = vertices[v];
+	}
+
+	std::copy(optimizedVertices.begin(), optimizedVertices.end(), packedVertices_.begin() + range.baseVertex);
+	packedVertices_.resize(range.baseVertex + referencedCount);
+	std::copy(indices.begin(), indices.end(), packedIndices_.begin() + range.firstIndex);
+
+	if (isTriangleList)
+		optimizedCacheStatistics_.add(SceneResources::analyzeVertexCache(indices, referencedCount));
+}
+
+
+void Model::createLods() {
+	PROFILE_SCOPE("Model::createLods");
+	std::vector<glm::vec3> positions;
+	std::vector<uint32_t> indices;
+	std::vector<uint32_t> lodIndices;
+
+	for (auto& meshRanges : primitiveRanges_) {
+		for (auto& range : meshRanges) {
+			if (range.mode != GL_TRIANGLES || range.indexCount < 3 * PrimitiveRange::MIN_LOD_TRIANGLES || !range.bounds.isValid())
+				continue;
+
+			indices.assign(packedIndices_.begin() + range.firstIndex, packedIndices_.begin() + range.firstIndex + range.indexCount);
+			const uint32_t vertexCount = *std::max_element(indices.begin(), indices.end()) + 1;
+			if (range.baseVertex + vertexCount > packedVertices_.size())
+				continue;
+
+			positions.resize(vertexCount);
+			for (uint32_t v = 0; v < vertexCount; ++v)
+				positions[v] = glm::make_vec3(packedVertices_[range.baseVertex + v].position);
+
+			// Every level halves the previous one, errors add up as each level is simplified from the last
+			const float maxError = PrimitiveRange::MAX_LOD_ERROR_FRACTION * 0.5f * glm::length(range.bounds.maxCorner - range.bounds.minCorner);
+			float error = 0.0f;
+			for (uint32_t lod = 1; lod < PrimitiveRange::MAX_LODS; ++lod) {
+				const size_t targetIndexCount = indices.size() / 6 * 3;
+				error += SceneResources::simplifyMesh(positions, indices, targetIndexCount, maxError - error, lodIndices);
+
+				// Levels which barely remove anything are not worth their memory
+				if (lodIndices.empty() || lodIndices.size() * 5 > indices.size() * 4)
+					break;
+
+				SceneResources::optimizeVertexCache(lodIndices, vertexCount);
+				range.lods[lod] = { static_cast<uint32_t>(lodIndices.size()), static_cast<uint32_t>(packedIndices_.size()), error };
+				range.lodCount = lod + 1;
+				packedIndices_.insert(packedIndices_.end(), lodIndices.begin(), lodIndices.end());
+				indices.swap(lodIndices);
+			}
+		}
+	}
+}
+
+
+void Model::createOccluders() {
+	PROFILE_SCOPE("Model::createOccluders");
+	occluders_.clear();
+
+	// Node transforms are not known yet, the size of a primitive is compared in object space
+	SceneResources::AABB modelBounds;
+	for (const auto& meshRanges : primitiveRanges_)
+		for (const auto& range : meshRanges)
+			modelBounds.expand(range.bounds);
+	if (!modelBounds.isValid())
+		return;
+
+	const float minSize = SceneResources::OccluderMesh::MIN_SIZE_FRACTION * glm::length(modelBounds.maxCorner - modelBounds.minCorner);
+	std::vector<std::pair<size_t, size_t>> owners;
+	std::vector<glm::vec3> positions;
+	std::vector<uint32_t> indices;
+
+	for (size_t m = 0; m < primitiveRanges_.size(); ++m) {
+		for (size_t p = 0; p < primitiveRanges_[m].size(); ++p) {
+			const auto& range = primitiveRanges_[m][p];
+			const float size = glm::length(range.bounds.maxCorner - range.bounds.minCorner);
+			if (range.mode != GL_TRIANGLES || range.indexCount == 0 || !range.bounds.isValid() || size < minSize)
+				continue;
+
+			indices.assign(packedIndices_.begin() + range.firstIndex, packedIndices_.begin() + range.firstIndex + range.indexCount);
+			const uint32_t vertexCount = *std::max_element(indices.begin(), indices.end()) + 1;
+			if (range.baseVertex + vertexCount > packedVertices_.size())
+				continue;
+
+			positions.resize(vertexCount);
+			for (uint32_t v = 0; v < vertexCount; ++v)
+				positions[v] = glm::make_vec3(packedVertices_[range.baseVertex + v].position);
+
+			auto occluder = SceneResources::createOccluderMesh(positions, indices, SceneResources::OccluderMesh::MAX_TRIANGLES,
+															   SceneResources::OccluderMesh::MIN_TRIANGLE_AREA_FRACTION * size * size);
+			if (occluder.isEmpty())
+				continue;
+
+			occluders_.push_back(std::move(occluder));
+			owners.push_back({ m, p });
+		}
+	}
+
+	// Pointers are only taken once the vector has stopped growing
+	for (size_t i = 0; i < occluders_.size(); ++i)
+		primitiveRanges_[owners[i].first][owners[i].second].occluder = &occluders_[i];
+}
+
+
+// Octahedral mapping of a unit vector to signed normalized values, decoded by VertexInput.h
+static inline void encodeOctahedral(const glm::vec3& normal, int16_t* encoded) {
+	const float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+	glm::vec2 e = length > 0.0f ? glm::vec2(normal) / length : glm::vec2(0.0f);
+	if (normal.z < 0.0f)
+		e = (1.0f - glm::abs(glm::vec2(e.y, e.x))) * glm::vec2(e.x >= 0.0f ? 1.0f : -1.0f, e.y >= 0.0f ? 1.0f : -1.0f);
+
+	encoded[0] = static_cast<int16_t>(std::round(glm::clamp(e.x, -1.0f, 1.0f) * 32767.0f));
+	encoded[1] = static_cast<int16_t>(std::round(glm::clamp(e.y, -1.0f, 1.0f) * 32767.0f));
+}
+
+
+void Model::quantizeVertices(std::vector<Resources::GeometryArena::QuantizedVertex>& vertices) {
+	PROFILE_SCOPE("Model::quantizeVertices");
+	vertices.assign(packedVertices_.size(), {});
+
+	for (size_t m = 0; m < primitiveRanges_.size(); ++m) {
+		// One grid per mesh, so vertices its primitives share stay in the same place
+		SceneResources::AABB bounds;
+		for (const auto& range : primitiveRanges_[m])
+			for (uint32_t v = 0; v < range.vertexCount; ++v)
+				bounds.expand(glm::make_vec3(packedVertices_[range.baseVertex + v].position));
+		if (!bounds.isValid())
+			continue;
+
+		const glm::vec3 extent = glm::max(bounds.maxCorner - bounds.minCorner, glm::vec3(FLT_MIN));
+		positionTransforms_[m] = glm::scale(glm::translate(glm::mat4(1.0f), bounds.minCorner), extent);
+
+		for (const auto& range : primitiveRanges_[m]) {
+			for (uint32_t v = range.baseVertex; v < range.baseVertex + range.vertexCount; ++v) {
+				const auto& vertex = packedVertices_[v];
+				auto& quantized = vertices[v];
+
+				const glm::vec3 position = glm::clamp((glm::make_vec3(vertex.position) - bounds.minCorner) / extent, 0.0f, 1.0f);
+				for (int k = 0; k < 3; ++k)
+					quantized.position[k] = static_cast<uint16_t>(std::round(position[k] * 65535.0f));
+
+				encodeOctahedral(glm::make_vec3(vertex.normal), quantized.normal);
+				quantized.uv[0] = glm::packHalf1x16(vertex.uv[0]);
+				quantized.uv[1] = glm::packHalf1x16(vertex.uv[1]);
+			}
+		}
+	}
+}
+
+
+void Model::packIndices(std::vector<uint8_t>& indices) {
+	PROFILE_SCOPE("Model::packIndices");
+	indices.clear();
+
+	// Every level of detail is copied in the index type of its primitive and aligned to it
+	for (auto& meshRanges : primitiveRanges_) {
+		for (auto& range : meshRanges) {
+			if (range.indexCount == 0)
+				continue;
+
+			range.indexType = range.vertexCount <= UINT16_MAX + 1 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+			const size_t indexSize = range.indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+
+			for (uint32_t lod = 0; lod < range.lodCount; ++lod) {
+				auto& lodRange = range.lods[lod];
+				const size_t offset = (indices.size() + indexSize - 1) / indexSize * indexSize;
+				indices.resize(offset + lodRange.indexCount * indexSize);
+
+				const uint32_t* source = packedIndices_.data() + lodRange.firstIndex;
+				if (range.indexType == GL_UNSIGNED_SHORT) {
+					uint16_t* destination = reinterpret_cast<uint16_t*>(indices.data() + offset);
+					for (uint32_t i = 0; i < lodRange.indexCount; ++i)
+						destination[i] = static_cast<uint16_t>(source[i]);
+				}
+				else {
+					std::memcpy(indices.data() + offset, source, lodRange.indexCount * sizeof(uint32_t));
+				}
+				lodRange.firstIndex = static_cast<uint32_t>(offset / indexSize);
+			}
+			range.firstIndex = range.lods[0].firstIndex;
+		}
+	}
+}
+
+
+void Model::uploadGeometry() {
+	PROFILE_SCOPE("Model::uploadGeometry");
+	positionTransforms_.assign(model_.meshes.size(), glm::mat4(1.0f));
+	if (packedVertices_.empty() || packedIndices_.empty())
+		return;
+
+	auto geometryArena = Resources::GeometryArena::getInstance();
+	std::vector<Resources::GeometryArena::QuantizedVertex> quantizedVertices;
+	const void* vertexData = packedVertices_.data();
+	if (geometryArena->getVertexFormat() == Resources::GeometryArena::VertexFormat::QUANTIZED) {
+		quantizeVertices(quantizedVertices);
+		vertexData = quantizedVertices.data();
+	}
+
+	// Index ranges are relative to the packed data until the allocation is known
+	std::vector<uint8_t> indexData;
+	packIndices(indexData);
+
+	const size_t vertexSize = geometryArena->getVertexSize();
+	const size_t vertexBytes = packedVertices_.size() * vertexSize;
+
+	// Offsets of both allocations are whole elements, so they turn into baseVertex and firstIndex
+	vertexRange_ = geometryArena->allocate(vertexBytes, vertexSize);
+	indexRange_ = geometryArena->allocate(indexData.size(), sizeof(uint32_t));
+	if (!vertexRange_.isValid() || !indexRange_.isValid()) {
+		primitiveRanges_.assign(model_.meshes.size(), {});
+		return;
+	}
+
+	geometryArena->upload(vertexRange_, vertexData, vertexBytes);
+	geometryArena->upload(indexRange_, indexData.data(), indexData.size());
+
+	const unsigned vertexArray = geometryArena->getVertexArray(vertexRange_, indexRange_);
+	const int32_t baseVertex = static_cast<int32_t>(vertexRange_.offset / vertexSize);
+	for (auto& meshRanges : primitiveRanges_) {
+		for (auto& range : meshRanges) {
+			if (range.indexCount == 0)
+				continue;
+
+			const size_t indexSize = range.indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+			const uint32_t firstIndex = static_cast<uint32_t>(indexRange_.offset / indexSize);
+			range.baseVertex += baseVertex;
+			range.firstIndex += firstIndex;
+			for (uint32_t lod = 0; lod < range.lodCount; ++lod)
+				range.lods[lod].firstIndex += firstIndex;
+			range.vertexArray = vertexArray;
+		}
+	}
+
+	auto resourceManager = Resources::ResourceManager::getInstance();
+	if (resourceManager->getResidencyPolicy() == Resources::ResourceManager::ResidencyPolicy::RELEASE_AFTER_UPLOAD) {
+		std::vector<Resources::GeometryArena::Vertex>().swap(packedVertices_);
+		std::vector<uint32_t>().swap(packedIndices_);
+	}
+}
+
+
+void Model::prepare() {
+	PROFILE_SCOPE("Model::prepare");
+	if (prepared_)
+		return;
+
+	std::vector<bool> isChild(model_.nodes.size(), false);
+	for (auto& node : model_.nodes)
+		for (int child : node.children)
+			if (child >= 0 && child < isChild.size())
+				isChild[child] = true;
+
+	rootNodesIndices_.clear();
+	for (int i = 0; i < model_.nodes.size(); ++i) {
+		if (!isChild[i])
+			rootNodesIndices_.push_back(i);
+	}
+
+	if (!geometryRestored_) {
+		packGeometry();
+		createLods();
+		createOccluders();
+	}
+
+	prepared_ = true;
+}
+
 
 void Model::init() {
+	PROFILE_SCOPE("Model::init");
+	if (!prepared_)
+		prepare();
+
 	auto resourceManager = Resources::ResourceManager::getInstance();
 	auto sceneManager = SceneResources::SceneManager::getInstance();
 	rootNode_ = &sceneManager->createSceneNode(name_);
@@ -35,16 +565,12 @@ void Model::init() {
 	rootNode_->setRotation(Rotation_);
 	rootNode_->setScale(Scale_);
 
-	std::vector<int> parentNodesIndices;
-	std::vector<SceneResources::SceneNode*> nodes;
+	uploadGeometry();
 
-	for (int i = 0; i < model_.nodes.size(); ++i) {
-		if (nodeIsParentIdx(model_, i))
-			parentNodesIndices.push_back(i);
-	}
+	std::vector<SceneResources::SceneNode*> nodes;
 
-	for (int i = 0; i < parentNodesIndices.size(); ++i) {
-		auto& gltfNode = model_.nodes[parentNodesIndices[i]];
+	for (int i = 0; i < rootNodesIndices_.size(); ++i) {
+		auto& gltfNode = model_.nodes[rootNodesIndices_[i]];
 		auto& newNode = sceneManager->createSceneNode(gltfNode.name);
 		
 		newNode.init(model_, gltfNode);
@@ -53,24 +579,20 @@ void Model::init() {
 			collectChildNodes(nodes, &newNode);
 	}
 
+	// World matrices are computed by the scene manager once the model is attached to the scene
 	for (int i = 0; i < nodes.size(); ++i) {
 		auto& node = nodes[i];
 		if (!node->parent) {
 			node->setParent(rootNode_);
 		}
 	}
-	for (auto& node : nodes) {
-		node->calculateGlobalModelMatrix();
-	}
-}
 
-void Model::draw(Resources::Shader& shader) {
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_CULL_FACE);
-	glDisable(GL_BLEND);
-	glCullFace(GL_BACK);
-	glFrontFace(GL_CCW);
-	rootNode_->draw(shader);
+	// Meshes have created their images from the decoded pixels, the resource manager holds them if they are needed
+	if (resourceManager->getResidencyPolicy() == Resources::ResourceManager::ResidencyPolicy::RELEASE_AFTER_UPLOAD) {
+		for (auto& image : model_.images) {
+			std::vector<unsigned char>().swap(image.image);
+		}
+	}
 }
 
 }
@@ -0,0 +1,282 @@
+#include "OcclusionCulling.hpp"
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define OCCLUSION_SSE
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define OCCLUSION_NEON
+#endif
+
+
+namespace SceneResources {
+
+// Pixels are written in groups of this many along a row
+static constexpr uint32_t PIXEL_GROUP_SIZE = 4;
+
+
+OccluderMesh createOccluderMesh(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, const uint32_t maxTriangles, const float minTriangleArea) {
+    struct Triangle {
+        float area;
+        size_t first;
+    };
+
+    std::vector<Triangle> triangles;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        if (indices[i] >= positions.size() || indices[i + 1] >= positions.size() || indices[i + 2] >= positions.size())
+            continue;
+
+        const glm::vec3& a = positions[indices[i]];
+        const float area = 0.5f * glm::length(glm::cross(positions[indices[i + 1]] - a, positions[indices[i + 2]] - a));
+        if (area >= minTriangleArea)
+            triangles.push_back({ area, i });
+    }
+
+    if (triangles.size() > maxTriangles) {
+        std::nth_element(triangles.begin(), triangles.begin() + maxTriangles, triangles.end(),
+            [](const Triangle& a, const Triangle& b) { return a.area > b.area; });
+        triangles.resize(maxTriangles);
+    }
+
+    // Vertices of the dropped triangles are dropped as well
+    OccluderMesh occluder;
+    std::vector<uint32_t> remap(positions.size(), UINT32_MAX);
+    occluder.indices.reserve(triangles.size() * 3);
+    for (const auto& triangle : triangles) {
+        for (size_t k = triangle.first; k < triangle.first + 3; ++k) {
+            if (remap[indices[k]] == UINT32_MAX) {
+                remap[indices[k]] = static_cast<uint32_t>(occluder.positions.size());
+                occluder.positions.push_back(positions[indices[k]]);
+            }
+            occluder.indices.push_back(remap[indices[k]]);
+        }
+    }
+
+    return occluder;
+}
+
+
+void OcclusionBuffer::clear(const glm::mat4& viewProjection) {
+    viewProjection_ = viewProjection;
+    depth_.assign(WIDTH * HEIGHT, 0.0f);
+    tileDepth_.assign(TILES_X * TILES_Y, 0.0f);
+    triangleCount_ = 0;
+}
+
+
+void OcclusionBuffer::rasterize(const OccluderMesh& occluder, const glm::mat4& modelMatrix) {
+    const glm::mat4 modelViewProjection = viewProjection_ * modelMatrix;
+    clipPositions_.resize(occluder.positions.size());
+    for (size_t i = 0; i < occluder.positions.size(); ++i)
+        clipPositions_[i] = modelViewProjection * glm::vec4(occluder.positions[i], 1.0f);
+
+    for (size_t i = 0; i + 2 < occluder.indices.size(); i += 3) {
+        const glm::vec4* clip[3] = { &clipPositions_[occluder.indices[i]], &clipPositions_[occluder.indices[i + 1]], &clipPositions_[occluder.indices[i + 2]] };
+
+        // Completely outside of one of the side or far planes
+        bool outside = false;
+        for (int axis = 0; axis < 3 && !outside; ++axis) {
+            outside |= (*clip[0])[axis] > clip[0]->w && (*clip[1])[axis] > clip[1]->w && (*clip[2])[axis] > clip[2]->w;
+            if (axis < 2)
+                outside |= (*clip[0])[axis] < -clip[0]->w && (*clip[1])[axis] < -clip[1]->w && (*clip[2])[axis] < -clip[2]->w;
+        }
+        if (outside)
+            continue;
+
+        // Clipped against the near plane z = -w only, the others are handled by the screen bounds
+        float distances[3];
+        uint32_t behindCount = 0;
+        for (int k = 0; k < 3; ++k) {
+            distances[k] = clip[k]->z + clip[k]->w;
+            behindCount += distances[k] < 0.0f;
+        }
+
+        if (behindCount == 0) {
+            rasterizeTriangle(*clip[0], *clip[1], *clip[2]);
+            continue;
+        }
+        if (behindCount == 3)
+            continue;
+
+        glm::vec4 polygon[4];
+        uint32_t polygonSize = 0;
+        for (int k = 0; k < 3; ++k) {
+            const int next = (k + 1) % 3;
+            if (distances[k] >= 0.0f)
+                polygon[polygonSize++] = *clip[k];
+            if ((distances[k] >= 0.0f) != (distances[next] >= 0.0f))
+                polygon[polygonSize++] = glm::mix(*clip[k], *clip[next], distances[k] / (distances[k] - distances[next]));
+        }
+
+        for (uint32_t k = 2; k < polygonSize; ++k)
+            rasterizeTriangle(polygon[0], polygon[k - 1], polygon[k]);
+    }
+}
+
+
+void OcclusionBuffer::rasterizeTriangle(const glm::vec4& clip0, const glm::vec4& clip1, const glm::vec4& clip2) {
+    // Pixel coordinates and reciprocal w of the vertices
+    glm::vec3 v[3];
+    const glm::vec4* clip[3] = { &clip0, &clip1, &clip2 };
+    for (int k = 0; k < 3; ++k) {
+        const float invW = 1.0f / clip[k]->w;
+        v[k] = glm::vec3((clip[k]->x * invW * 0.5f + 0.5f) * WIDTH, (clip[k]->y * invW * 0.5f + 0.5f) * HEIGHT, invW);
+    }
+
+    float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x);
+    if (std::abs(area) < 1.0e-6f)
+        return;
+
+    // Both windings occlude, clockwise ones are flipped so the inside is where all edge functions are positive
+    if (area < 0.0f) {
+        std::swap(v[1], v[2]);
+        area = -area;
+    }
+
+    const int minX = std::max(0, static_cast<int>(std::floor(std::min({ v[0].x, v[1].x, v[2].x }))));
+    const int maxX = std::min(static_cast<int>(WIDTH) - 1, static_cast<int>(std::floor(std::max({ v[0].x, v[1].x, v[2].x }))));
+    const int minY = std::max(0, static_cast<int>(std::floor(std::min({ v[0].y, v[1].y, v[2].y }))));
+    const int maxY = std::min(static_cast<int>(HEIGHT) - 1, static_cast<int>(std::floor(std::max({ v[0].y, v[1].y, v[2].y }))));
+    if (minX > maxX || minY > maxY)
+        return;
+
+    ++triangleCount_;
+
+    // Edge k is opposite of vertex k, E(x, y) = A * x + B * y + C
+    float edgeA[3], edgeB[3], edgeC[3];
+    for (int k = 0; k < 3; ++k) {
+        const glm::vec3& a = v[(k + 1) % 3];
+        const glm::vec3& b = v[(k + 2) % 3];
+        edgeA[k] = a.y - b.y;
+        edgeB[k] = b.x - a.x;
+        edgeC[k] = -(edgeA[k] * a.x + edgeB[k] * a.y);
+    }
+
+    // Depth plane from the barycentric weights E_k / area
+    const float invArea = 1.0f / area;
+    const float depthA = (edgeA[0] * v[0].z + edgeA[1] * v[1].z + edgeA[2] * v[2].z) * invArea;
+    const float depthB = (edgeB[0] * v[0].z + edgeB[1] * v[1].z + edgeB[2] * v[2].z) * invArea;
+    // Farthest depth anywhere in the pixel, so an occluder never reaches in front of itself
+    const float depthC = (edgeC[0] * v[0].z + edgeC[1] * v[1].z + edgeC[2] * v[2].z) * invArea - 0.5f * (std::abs(depthA) + std::abs(depthB));
+    const float minDepth = std::min({ v[0].z, v[1].z, v[2].z });
+
+    const int firstX = minX & ~static_cast<int>(PIXEL_GROUP_SIZE - 1);
+    for (int y = minY; y <= maxY; ++y) {
+        const float py = y + 0.5f;
+        float* row = &depth_[y * WIDTH];
+        const float rowEdge0 = edgeB[0] * py + edgeC[0];
+        const float rowEdge1 = edgeB[1] * py + edgeC[1];
+        const float rowEdge2 = edgeB[2] * py + edgeC[2];
+        const float rowDepth = depthB * py + depthC;
+
+        for (int x = firstX; x <= maxX; x += PIXEL_GROUP_SIZE) {
+#if defined(OCCLUSION_SSE)
+            const __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f));
+            const __m128 edge0 = _mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(edgeA[0])), _mm_set1_ps(rowEdge0));
+            const __m128 edge1 = _mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(edgeA[1])), _mm_set1_ps(rowEdge1));
+            const __m128 edge2 = _mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(edgeA[2])), _mm_set1_ps(rowEdge2));
+            const __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(edge0, _mm_setzero_ps()), _mm_cmpge_ps(edge1, _mm_setzero_ps())),
+                                             _mm_cmpge_ps(edge2, _mm_setzero_ps()));
+            if (_mm_movemask_ps(inside) == 0)
+                continue;
+
+            const __m128 depth = _mm_max_ps(_mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(depthA)), _mm_set1_ps(rowDepth)), _mm_set1_ps(minDepth));
+            // Stored depths are never negative, so the pixels outside of the triangle keep theirs
+            _mm_storeu_ps(row + x, _mm_max_ps(_mm_loadu_ps(row + x), _mm_and_ps(inside, depth)));
+#elif defined(OCCLUSION_NEON)
+            const float offsets[PIXEL_GROUP_SIZE] = { 0.5f, 1.5f, 2.5f, 3.5f };
+            const float32x4_t px = vaddq_f32(vdupq_n_f32(static_cast<float>(x)), vld1q_f32(offsets));
+            const float32x4_t edge0 = vmlaq_n_f32(vdupq_n_f32(rowEdge0), px, edgeA[0]);
+            const float32x4_t edge1 = vmlaq_n_f32(vdupq_n_f32(rowEdge1), px, edgeA[1]);
+            const float32x4_t edge2 = vmlaq_n_f32(vdupq_n_f32(rowEdge2), px, edgeA[2]);
+            const uint32x4_t inside = vandq_u32(vandq_u32(vcgeq_f32(edge0, vdupq_n_f32(0.0f)), vcgeq_f32(edge1, vdupq_n_f32(0.0f))),
+                                                vcgeq_f32(edge2, vdupq_n_f32(0.0f)));
+
+            const float32x4_t depth = vmaxq_f32(vmlaq_n_f32(vdupq_n_f32(rowDepth), px, depthA), vdupq_n_f32(minDepth));
+            const float32x4_t masked = vreinterpretq_f32_u32(vandq_u32(inside, vreinterpretq_u32_f32(depth)));
+            vst1q_f32(row + x, vmaxq_f32(vld1q_f32(row + x), masked));
+#else
+            for (int lane = x; lane < x + static_cast<int>(PIXEL_GROUP_SIZE); ++lane) {
+                const float px = lane + 0.5f;
+                if (edgeA[0] * px + rowEdge0 >= 0.0f && edgeA[1] * px + rowEdge1 >= 0.0f && edgeA[2] * px + rowEdge2 >= 0.0f)
+                    row[lane] = std::max(row[lane], std::max(depthA * px + rowDepth, minDepth));
+            }
+#endif
+        }
+    }
+}
+
+
+void OcclusionBuffer::updateHierarchy() {
+    PROFILE_SCOPE("OcclusionBuffer::updateHierarchy");
+    for (uint32_t tileY = 0; tileY < TILES_Y; ++tileY) {
+        for (uint32_t tileX = 0; tileX < TILES_X; ++tileX) {
+            float farthest = FLT_MAX;
+            for (uint32_t y = tileY * TILE_SIZE; y < (tileY + 1) * TILE_SIZE; ++y) {
+                const float* row = &depth_[y * WIDTH + tileX * TILE_SIZE];
+                farthest = std::min(farthest, *std::min_element(row, row + TILE_SIZE));
+            }
+            tileDepth_[tileY * TILES_X + tileX] = farthest;
+        }
+    }
+}
+
+
+bool OcclusionBuffer::isVisible(const AABB& box) const {
+    if (!box.isValid())
+        return true;
+
+    glm::vec2 minScreen = glm::vec2(FLT_MAX);
+    glm::vec2 maxScreen = glm::vec2(-FLT_MAX);
+    float nearestDepth = 0.0f;
+    for (int corner = 0; corner < 8; ++corner) {
+        const glm::vec3 position = glm::vec3(corner & 1 ? box.maxCorner.x : box.minCorner.x,
+                                             corner & 2 ? box.maxCorner.y : box.minCorner.y,
+                                             corner & 4 ? box.maxCorner.z : box.minCorner.z);
+        const glm::vec4 clip = viewProjection_ * glm::vec4(position, 1.0f);
+        if (clip.z < -clip.w)
+            return true;
+
+        const float invW = 1.0f / clip.w;
+        const glm::vec2 screen = (glm::vec2(clip) * invW * 0.5f + 0.5f) * glm::vec2(WIDTH, HEIGHT);
+        minScreen = glm::min(minScreen, screen);
+        maxScreen = glm::max(maxScreen, screen);
+        nearestDepth = std::max(nearestDepth, invW);
+    }
+
+    // Boxes off the screen are left to the frustum culling
+    if (maxScreen.x < 0.0f || maxScreen.y < 0.0f || minScreen.x >= WIDTH || minScreen.y >= HEIGHT)
+        return true;
+
+    const uint32_t minX = static_cast<uint32_t>(std::max(0.0f, std::floor(minScreen.x)));
+    const uint32_t maxX = static_cast<uint32_t>(std::min(WIDTH - 1.0f, std::floor(maxScreen.x)));
+    const uint32_t minY = static_cast<uint32_t>(std::max(0.0f, std::floor(minScreen.y)));
+    const uint32_t maxY = static_cast<uint32_t>(std::min(HEIGHT - 1.0f, std::floor(maxScreen.y)));
+
+    for (uint32_t tileY = minY / TILE_SIZE; tileY <= maxY / TILE_SIZE; ++tileY) {
+        for (uint32_t tileX = minX / TILE_SIZE; tileX <= maxX / TILE_SIZE; ++tileX) {
+            // The whole tile is in front of the box
+            if (tileDepth_[tileY * TILES_X + tileX] > nearestDepth)
+                continue;
+
+            const uint32_t firstX = std::max(minX, tileX * TILE_SIZE);
+            const uint32_t lastX = std::min(maxX, (tileX + 1) * TILE_SIZE - 1);
+            const uint32_t firstY = std::max(minY, tileY * TILE_SIZE);
+            const uint32_t lastY = std::min(maxY, (tileY + 1) * TILE_SIZE - 1);
+            for (uint32_t y = firstY; y <= lastY; ++y) {
+                for (uint32_t x = firstX; x <= lastX; ++x) {
+                    if (depth_[y * WIDTH + x] <= nearestDepth)
+                        return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+}
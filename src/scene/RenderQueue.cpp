@@ -0,0 +1,561 @@
+#include "RenderQueue.hpp"
+#include "ResourceManager.hpp"
+#include "SceneManager.hpp"
+#include "RenderContext.hpp"
+#include "Profiler.hpp"
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <unordered_map>
+
+
+namespace SceneResources {
+
+static constexpr uint32_t DEPTH_SHIFT = 0;
+static constexpr uint32_t VERTEX_ARRAY_SHIFT = DEPTH_SHIFT + RenderQueue::DEPTH_BITS;
+static constexpr uint32_t MATERIAL_SHIFT = VERTEX_ARRAY_SHIFT + RenderQueue::VERTEX_ARRAY_BITS;
+static constexpr uint32_t PROGRAM_SHIFT = MATERIAL_SHIFT + RenderQueue::MATERIAL_BITS;
+static_assert(PROGRAM_SHIFT + RenderQueue::PROGRAM_BITS == 64, "Sort key fields must fill 64 bits");
+
+static constexpr uint64_t DEPTH_MASK = (1ull << RenderQueue::DEPTH_BITS) - 1;
+
+// SSBO bindings of ObjectData.h and DrawData.h
+static constexpr GLuint OBJECT_DATA_BINDING = 2;
+static constexpr GLuint DRAW_DATA_BINDING = 3;
+static constexpr GLuint MATERIAL_DATA_BINDING = 4;
+
+static constexpr Resources::UniformName UNIFORM_OBJECT_INDEX("uObjectIndex");
+static constexpr Resources::UniformName UNIFORM_OBJECT_MODEL("uObjectModel");
+static constexpr Resources::UniformName UNIFORM_OBJECT_NORMAL_MATRIX("uObjectNormalMatrix");
+static constexpr Resources::UniformName UNIFORM_DRAW_OFFSET("uDrawOffset");
+
+// Dense index of a state object in the order of first use, indices out of the field range share its last value
+static inline uint64_t getStateIndex(std::unordered_map<uint64_t, uint32_t>& indices, const uint64_t state, const uint32_t bits) {
+    auto it = indices.emplace(state, static_cast<uint32_t>(indices.size())).first;
+    return std::min<uint64_t>(it->second, (1ull << bits) - 1);
+}
+
+// Grows the buffer to hold the data and uploads it, the storage is only reallocated when it is too small
+static void uploadBuffer(const GLenum target, unsigned& buffer, size_t& capacity, const void* data, const size_t size) {
+    if (!buffer)
+        glGenBuffers(1, &buffer);
+
+    glBindBuffer(target, buffer);
+    if (size > capacity) {
+        capacity = std::max(size, capacity * 2);
+        glBufferData(target, capacity, nullptr, GL_DYNAMIC_DRAW);
+    }
+    if (size > 0)
+        glBufferSubData(target, 0, size, data);
+}
+
+static void deleteBuffer(unsigned& buffer, size_t& capacity) {
+    if (buffer)
+        glDeleteBuffers(1, &buffer);
+
+    buffer = 0;
+    capacity = 0;
+}
+
+
+bool RenderQueue::isMultiDrawIndirectSupported() {
+#ifdef __ANDROID__
+    // Neither glMultiDrawElementsIndirect nor gl_DrawID are a part of GLES 3.2
+    return false;
+#else
+    // ModelIndirect.vert reads its draw and object data from storage blocks
+    return GLAD_GL_VERSION_4_6 != 0 && isVertexStorageSupported();
+#endif
+}
+
+
+bool RenderQueue::isVertexStorageSupported() {
+    GLint maxBlocks = 0;
+    glGetIntegerv(GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS, &maxBlocks);
+    return maxBlocks > 0;
+}
+
+
+void RenderQueue::setSubmissionMode(const SubmissionMode mode, Resources::Shader* indirectShader) {
+    if (mode == MULTI_DRAW_INDIRECT && (!indirectShader || !isMultiDrawIndirectSupported())) {
+        LOG_W("Multi-draw-indirect submission is not available, drawing directly");
+        submissionMode_ = DIRECT;
+    }
+    else {
+        submissionMode_ = mode;
+    }
+    indirectShader_ = indirectShader;
+
+    // Items carry the shader they are drawn with
+    builtSceneVersion_ = UINT64_MAX;
+}
+
+
+void RenderQueue::update(SceneNode& root, Resources::Shader& shader) {
+    const uint64_t sceneVersion = SceneManager::getInstance()->getSceneVersion();
+    if (sceneVersion == builtSceneVersion_ && &shader == builtShader_)
+        return;
+
+    build(root, shader);
+    builtSceneVersion_ = sceneVersion;
+    builtShader_ = &shader;
+}
+
+
+void RenderQueue::build(SceneNode& root, Resources::Shader& shader) {
+    PROFILE_SCOPE("RenderQueue::build");
+    items_.clear();
+    objectNodes_.clear();
+    uploadedTransformsVersion_ = UINT64_MAX;
+    collectItems(root, submissionMode_ == MULTI_DRAW_INDIRECT ? *indirectShader_ : shader);
+
+    std::unordered_map<uint64_t, uint32_t> programs;
+    std::unordered_map<uint64_t, uint32_t> materials;
+    std::unordered_map<uint64_t, uint32_t> vertexArrays;
+
+    for (auto& item : items_) {
+        item.sortKey = getStateIndex(programs, item.shader->GL_id, PROGRAM_BITS) << PROGRAM_SHIFT |
+                       getStateIndex(materials, item.material.nativeHandle, MATERIAL_BITS) << MATERIAL_SHIFT |
+                       getStateIndex(vertexArrays, item.vertexArray, VERTEX_ARRAY_BITS) << VERTEX_ARRAY_SHIFT;
+        item.materialIndex = materials[item.material.nativeHandle];
+    }
+    isSorted_ = false;
+    commandsDirty_ = true;
+    boundsDirty_ = true;
+    lodsValid_ = false;
+
+    if (submissionMode_ != MULTI_DRAW_INDIRECT)
+        return;
+
+    // Materials are only referenced by index from the draw data, they are uploaded once per build
+    auto resourceManager = Resources::ResourceManager::getInstance();
+    materialData_.assign(materials.size(), MaterialData());
+    for (const auto& item : items_) {
+        const auto& material = resourceManager->getMaterial(item.material);
+        auto& data = materialData_[item.materialIndex];
+        for (int i = 0; i < Resources::Material::TextureIdx::IDX_COUNT; ++i)
+            data.texturesFactors[i] = material.textures[i]->factor;
+        data.flags = material.materialFlags;
+    }
+    uploadBuffer(GL_SHADER_STORAGE_BUFFER, materialBuffer_, materialBufferSize_, materialData_.data(), materialData_.size() * sizeof(MaterialData));
+}
+
+
+void RenderQueue::collectItems(const SceneNode& node, Resources::Shader& shader) {
+    if (!node.isEnabled())
+        return;
+
+    const auto& mesh = node.getMesh();
+    if (mesh.getPrimitiveCount() > 0)
+        objectNodes_.push_back(&node);
+
+    for (uint32_t i = 0; i < mesh.getPrimitiveCount(); ++i) {
+        DrawItem item;
+        item.shader = &shader;
+        item.mesh = &mesh;
+        item.node = &node;
+        item.primitive = i;
+        item.objectIndex = static_cast<uint32_t>(objectNodes_.size() - 1);
+        item.material = mesh.getMaterial(i);
+        item.vertexArray = mesh.getVertexArray(i);
+        item.mode = mesh.getPrimitiveRange(i).mode;
+        item.indexType = mesh.getPrimitiveRange(i).indexType;
+        items_.push_back(item);
+    }
+
+    for (const auto child : node.children)
+        collectItems(*child, shader);
+}
+
+
+void RenderQueue::sort(const glm::vec3& cameraPosition) {
+    PROFILE_SCOPE("RenderQueue::sort");
+    if (isSorted_ && cameraPosition == sortedCameraPosition_)
+        return;
+
+    float maxDistance = 0.0f;
+    for (const auto& item : items_)
+        maxDistance = std::max(maxDistance, glm::distance(cameraPosition, glm::vec3(item.node->getGlobalModelMatrix()[3])));
+
+    // Front to back among draws with the same state
+    const float depthScale = maxDistance > 0.0f ? DEPTH_MASK / maxDistance : 0.0f;
+    for (auto& item : items_) {
+        const float distance = glm::distance(cameraPosition, glm::vec3(item.node->getGlobalModelMatrix()[3]));
+        item.sortKey = (item.sortKey & ~DEPTH_MASK) | std::min<uint64_t>(static_cast<uint64_t>(distance * depthScale), DEPTH_MASK) << DEPTH_SHIFT;
+    }
+
+    std::sort(items_.begin(), items_.end(), [](const DrawItem& a, const DrawItem& b) { return a.sortKey < b.sortKey; });
+    sortedCameraPosition_ = cameraPosition;
+    isSorted_ = true;
+    commandsDirty_ = true;
+    boundsDirty_ = true;
+    lodsValid_ = false;
+}
+
+
+void RenderQueue::cull(const GeneralApp::Frustum& frustum) {
+    PROFILE_SCOPE("RenderQueue::cull");
+    occludedCount_ = 0;
+    occluderCount_ = 0;
+    if (!cullingEnabled_) {
+        visible_.assign(items_.size(), 1);
+        return;
+    }
+
+    updateBounds();
+    cullBoxes(frustum, bounds_, visible_);
+}
+
+
+void RenderQueue::updateBounds() {
+    const uint64_t transformsVersion = SceneManager::getInstance()->getTransforms().getVersion();
+    if (!boundsDirty_ && transformsVersion == boundsTransformsVersion_)
+        return;
+
+    bounds_.resize(items_.size());
+    worldBounds_.resize(items_.size());
+    for (size_t i = 0; i < items_.size(); ++i) {
+        const auto& item = items_[i];
+        worldBounds_[i] = item.mesh->getPrimitiveRange(item.primitive).bounds.transformed(item.node->getGlobalModelMatrix());
+        bounds_.set(i, worldBounds_[i]);
+    }
+    boundsTransformsVersion_ = transformsVersion;
+    boundsDirty_ = false;
+}
+
+
+void RenderQueue::cullOccluded(const glm::mat4& viewProjection, const glm::vec3& cameraPosition) {
+    PROFILE_SCOPE("RenderQueue::cullOccluded");
+    occludedCount_ = 0;
+    occluderCount_ = 0;
+    if (!cullingEnabled_ || !occlusionCullingEnabled_ || boundsDirty_ || visible_.size() < items_.size())
+        return;
+
+    // Size over distance ranks the occluders by how much of the screen they may cover
+    occluderCandidates_.clear();
+    for (uint32_t i = 0; i < items_.size(); ++i) {
+        const auto& item = items_[i];
+        if (!visible_[i] || !item.mesh->getPrimitiveRange(item.primitive).occluder)
+            continue;
+
+        const AABB& box = worldBounds_[i];
+        const glm::vec3 offset = glm::max(glm::max(box.minCorner - cameraPosition, cameraPosition - box.maxCorner), glm::vec3(0.0f));
+        const float distanceSquared = glm::dot(offset, offset);
+        const float sizeSquared = glm::dot(box.maxCorner - box.minCorner, box.maxCorner - box.minCorner);
+        occluderCandidates_.push_back({ distanceSquared > 0.0f ? sizeSquared / distanceSquared : FLT_MAX, i });
+    }
+
+    if (occluderCandidates_.empty())
+        return;
+
+    std::sort(occluderCandidates_.begin(), occluderCandidates_.end(), std::greater<>());
+
+    occlusionBuffer_.clear(viewProjection);
+    for (const auto& [score, itemIdx] : occluderCandidates_) {
+        if (occlusionBuffer_.getTriangleCount() >= OCCLUDER_TRIANGLE_BUDGET)
+            break;
+
+        const auto& item = items_[itemIdx];
+        occlusionBuffer_.rasterize(*item.mesh->getPrimitiveRange(item.primitive).occluder, item.node->getGlobalModelMatrix());
+        ++occluderCount_;
+    }
+    occlusionBuffer_.updateHierarchy();
+
+    // Occluders are tested too, a box always reaches in front of the surface inside of it
+    for (size_t i = 0; i < items_.size(); ++i) {
+        if (visible_[i] && !occlusionBuffer_.isVisible(worldBounds_[i])) {
+            visible_[i] = 0;
+            ++occludedCount_;
+        }
+    }
+}
+
+
+void RenderQueue::selectLods(const GeneralApp::Camera& camera, const float viewportHeight) {
+    PROFILE_SCOPE("RenderQueue::selectLods");
+    lods_.assign(items_.size(), 0);
+    lodsValid_ = true;
+    if (!lodEnabled_ || viewportHeight <= 0.0f)
+        return;
+
+    updateBounds();
+
+    // Pixels covered by a unit length at unit distance
+    const float projectionScale = 0.5f * viewportHeight / std::tan(0.5f * glm::radians(camera.getFov()));
+    const glm::vec3 cameraPosition = camera.getPosition();
+
+    for (size_t i = 0; i < items_.size(); ++i) {
+        const auto& item = items_[i];
+        const auto& range = item.mesh->getPrimitiveRange(item.primitive);
+        if (range.lodCount < 2)
+            continue;
+
+        const AABB& box = worldBounds_[i];
+        const float radius = 0.5f * glm::length(box.maxCorner - box.minCorner);
+        const float distance = glm::distance(0.5f * (box.minCorner + box.maxCorner), cameraPosition) - radius;
+        if (distance <= 0.0f)
+            continue;
+
+        // Object space errors grow with the largest scale of the node
+        const glm::mat4& model = item.node->getGlobalModelMatrix();
+        const float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+        const float pixelsPerError = scale * projectionScale / distance;
+
+        uint32_t lod = 0;
+        while (lod + 1 < range.lodCount && range.lods[lod + 1].error * pixelsPerError <= LOD_PIXEL_ERROR)
+            ++lod;
+        lods_[i] = static_cast<uint8_t>(lod);
+    }
+}
+
+
+void RenderQueue::draw() {
+    PROFILE_SCOPE("RenderQueue::draw");
+    auto renderContext = Resources::RenderContext::getInstance();
+
+    renderContext->enable(GL_DEPTH_TEST);
+    renderContext->enable(GL_CULL_FACE);
+    renderContext->disable(GL_BLEND);
+    renderContext->cullFace(GL_BACK);
+    renderContext->frontFace(GL_CCW);
+
+    stats_ = Stats();
+    updateObjects();
+
+    // Everything is visible when the queue has not been culled since the last change
+    if (visible_.size() < items_.size() || boundsDirty_) {
+        visible_.assign(items_.size(), 1);
+        occludedCount_ = 0;
+        occluderCount_ = 0;
+    }
+    if (!lodsValid_ || lods_.size() < items_.size()) {
+        lods_.assign(items_.size(), 0);
+        lodsValid_ = true;
+    }
+
+    if (submissionMode_ == MULTI_DRAW_INDIRECT)
+        drawIndirect();
+    else
+        drawDirect();
+
+    stats_.culled = static_cast<uint32_t>(items_.size()) - stats_.draws;
+    stats_.occluded = occludedCount_;
+    stats_.occluders = occluderCount_;
+}
+
+
+void RenderQueue::updateObjects() {
+    PROFILE_SCOPE("RenderQueue::updateObjects");
+    const uint64_t transformsVersion = SceneManager::getInstance()->getTransforms().getVersion();
+    if (transformsVersion == uploadedTransformsVersion_) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECT_DATA_BINDING, objectBuffer_);
+        return;
+    }
+
+    objectData_.resize(objectNodes_.size());
+    for (size_t i = 0; i < objectNodes_.size(); ++i) {
+        const auto& model = objectNodes_[i]->getGlobalModelMatrix();
+        // Quantized positions are mapped back by the same matrix, normals only see the node transform
+        objectData_[i].model = model * objectNodes_[i]->getMesh().getPositionTransform();
+        objectData_[i].normalMatrix = glm::mat3x4(glm::transpose(glm::inverse(glm::mat3(model))));
+    }
+
+    uploadBuffer(GL_SHADER_STORAGE_BUFFER, objectBuffer_, objectBufferSize_, objectData_.data(), objectData_.size() * sizeof(ObjectData));
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECT_DATA_BINDING, objectBuffer_);
+    uploadedTransformsVersion_ = transformsVersion;
+}
+
+
+void RenderQueue::drawDirect() {
+    auto renderContext = Resources::RenderContext::getInstance();
+
+    Resources::Shader* currentShader = nullptr;
+    Resources::UniformLocation objectModelLocation;
+    Resources::UniformLocation objectNormalMatrixLocation;
+    const SceneNode* currentNode = nullptr;
+    Resources::ResourceHandle currentMaterial;
+    unsigned currentVertexArray = 0;
+
+    for (size_t i = 0; i < items_.size(); ++i) {
+        if (!visible_[i])
+            continue;
+
+        const auto& item = items_[i];
+        if (item.shader != currentShader) {
+            currentShader = item.shader;
+            currentShader->use();
+            Geometry::Mesh::bindEnvironment(*currentShader);
+            // Only shaders built with OBJECT_UNIFORMS have these, the others index the object buffer
+            objectModelLocation = currentShader->getUniformLocation(UNIFORM_OBJECT_MODEL);
+            objectNormalMatrixLocation = currentShader->getUniformLocation(UNIFORM_OBJECT_NORMAL_MATRIX);
+            // Material and object uniforms belong to the program
+            currentMaterial = Resources::ResourceHandle();
+            currentNode = nullptr;
+            ++stats_.programChanges;
+        }
+
+        if (item.node != currentNode) {
+            currentNode = item.node;
+            if (objectModelLocation.isValid()) {
+                const auto& object = objectData_[item.objectIndex];
+                currentShader->setMat4(objectModelLocation, object.model);
+                currentShader->setMat3(objectNormalMatrixLocation, glm::mat3(object.normalMatrix));
+            }
+            else {
+                currentShader->setUint(UNIFORM_OBJECT_INDEX, item.objectIndex);
+            }
+            ++stats_.transformChanges;
+        }
+
+        if (!(item.material == currentMaterial)) {
+            currentMaterial = item.material;
+            item.mesh->bindMaterial(*currentShader, item.primitive);
+            ++stats_.materialChanges;
+        }
+
+        if (item.vertexArray != currentVertexArray) {
+            currentVertexArray = item.vertexArray;
+            renderContext->bindVertexArray(currentVertexArray);
+            ++stats_.vertexArrayChanges;
+        }
+
+        item.mesh->drawPrimitive(item.primitive, lods_[i]);
+        if (item.mode == GL_TRIANGLES)
+            stats_.triangles += item.mesh->getPrimitiveRange(item.primitive).lods[lods_[i]].indexCount / 3;
+        ++stats_.draws;
+        ++stats_.drawCalls;
+    }
+}
+
+
+void RenderQueue::buildCommands() {
+    PROFILE_SCOPE("RenderQueue::buildCommands");
+    commands_.resize(items_.size());
+    batches_.clear();
+    drawData_.resize(items_.size());
+
+    for (uint32_t i = 0; i < items_.size(); ++i) {
+        const auto& item = items_[i];
+        const auto& range = item.mesh->getPrimitiveRange(item.primitive);
+        const auto& lod = range.lods[lods_[i]];
+        commands_[i] = { lod.indexCount, visible_[i], lod.firstIndex, range.baseVertex, 0 };
+        drawData_[i] = { item.objectIndex, item.materialIndex };
+
+        // Textures are still bound per material, so a batch ends wherever any binding changes
+        const bool sameBatch = i > 0 && item.shader == items_[i - 1].shader && item.material == items_[i - 1].material &&
+                               item.vertexArray == items_[i - 1].vertexArray && item.mode == items_[i - 1].mode &&
+                               item.indexType == items_[i - 1].indexType;
+        if (sameBatch)
+            ++batches_.back().itemCount;
+        else
+            batches_.push_back({ i, 1 });
+    }
+
+    uploadBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer_, commandBufferSize_, commands_.data(), commands_.size() * sizeof(DrawElementsIndirectCommand));
+    uploadBuffer(GL_SHADER_STORAGE_BUFFER, drawDataBuffer_, drawDataBufferSize_, drawData_.data(), drawData_.size() * sizeof(DrawData));
+    commandsDirty_ = false;
+}
+
+
+void RenderQueue::drawIndirect() {
+#ifndef __ANDROID__
+    auto renderContext = Resources::RenderContext::getInstance();
+
+    if (commandsDirty_) {
+        buildCommands();
+    }
+    else {
+        // Only the instance counts and index ranges follow the visibility and the levels of detail
+        bool commandsChanged = false;
+        for (size_t i = 0; i < items_.size(); ++i) {
+            const auto& item = items_[i];
+            const auto& lod = item.mesh->getPrimitiveRange(item.primitive).lods[lods_[i]];
+            auto& command = commands_[i];
+            commandsChanged |= command.instanceCount != visible_[i] || command.count != lod.indexCount || command.firstIndex != lod.firstIndex;
+            command.instanceCount = visible_[i];
+            command.count = lod.indexCount;
+            command.firstIndex = lod.firstIndex;
+        }
+        if (commandsChanged)
+            uploadBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer_, commandBufferSize_, commands_.data(), commands_.size() * sizeof(DrawElementsIndirectCommand));
+    }
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING, drawDataBuffer_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIAL_DATA_BINDING, materialBuffer_);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer_);
+
+    Resources::Shader* currentShader = nullptr;
+    Resources::ResourceHandle currentMaterial;
+    unsigned currentVertexArray = 0;
+
+    for (const auto& batch : batches_) {
+        uint32_t visibleCount = 0;
+        uint32_t indexCount = 0;
+        for (uint32_t i = batch.firstItem; i < batch.firstItem + batch.itemCount; ++i) {
+            visibleCount += visible_[i];
+            indexCount += visible_[i] * commands_[i].count;
+        }
+        if (visibleCount == 0)
+            continue;
+
+        const auto& item = items_[batch.firstItem];
+        if (item.mode == GL_TRIANGLES)
+            stats_.triangles += indexCount / 3;
+        if (item.shader != currentShader) {
+            currentShader = item.shader;
+            currentShader->use();
+            Geometry::Mesh::bindEnvironment(*currentShader);
+            ++stats_.programChanges;
+        }
+
+        if (!(item.material == currentMaterial)) {
+            currentMaterial = item.material;
+            item.mesh->bindMaterialTextures(item.primitive);
+            ++stats_.materialChanges;
+        }
+
+        if (item.vertexArray != currentVertexArray) {
+            currentVertexArray = item.vertexArray;
+            renderContext->bindVertexArray(currentVertexArray);
+            ++stats_.vertexArrayChanges;
+        }
+
+        currentShader->setUint(UNIFORM_DRAW_OFFSET, batch.firstItem);
+        glMultiDrawElementsIndirect(item.mode, item.indexType, (void*)BUFFER_OFFSET(batch.firstItem * sizeof(DrawElementsIndirectCommand)), batch.itemCount, 0);
+
+        stats_.draws += visibleCount;
+        ++stats_.drawCalls;
+    }
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+#endif
+}
+
+
+void RenderQueue::clear() {
+    items_.clear();
+    objectNodes_.clear();
+    objectData_.clear();
+    visible_.clear();
+    worldBounds_.clear();
+    lods_.clear();
+    lodsValid_ = false;
+    commands_.clear();
+    boundsDirty_ = true;
+    uploadedTransformsVersion_ = UINT64_MAX;
+    batches_.clear();
+    drawData_.clear();
+    materialData_.clear();
+    deleteBuffer(objectBuffer_, objectBufferSize_);
+    deleteBuffer(commandBuffer_, commandBufferSize_);
+    deleteBuffer(drawDataBuffer_, drawDataBufferSize_);
+    deleteBuffer(materialBuffer_, materialBufferSize_);
+    commandsDirty_ = true;
+    builtShader_ = nullptr;
+    builtSceneVersion_ = UINT64_MAX;
+    isSorted_ = false;
+}
+
+}
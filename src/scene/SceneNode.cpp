@@ -1,6 +1,7 @@
 #include "ResourceManager.hpp"
 #include "SceneManager.hpp"
 #include "SceneNode.hpp"
+#include "Profiler.hpp"
 
 #include <algorithm>
 
@@ -40,37 +41,43 @@ void SceneResources::SceneNode::init(const tinygltf::Model& model, const tinyglt
 		this->setScale(glm::vec3(scale[0], scale[1], scale[2]));
 }
 
-void SceneResources::SceneNode::calculateGlobalModelMatrix() {
-	this->calculateLocalModelMatrix();
-	globalMatrix_ = this->getLocalModelMatrix();
-	
-	if (parent) {
-		parent->calculateGlobalModelMatrix();
-		globalMatrix_ = parent->getGlobalModelMatrix() * globalMatrix_;
-	}
+void SceneResources::SceneNode::setPosition(glm::vec3 pos) {
+	Position_ = pos;
+	if (transformIndex_ != TransformHierarchy::INVALID_INDEX)
+		SceneResources::SceneManager::getInstance()->getTransforms().setPosition(transformIndex_, pos);
 }
 
+void SceneResources::SceneNode::setRotation(glm::quat rot) {
+	Rotation_ = rot;
+	if (transformIndex_ != TransformHierarchy::INVALID_INDEX)
+		SceneResources::SceneManager::getInstance()->getTransforms().setRotation(transformIndex_, rot);
+}
 
+void SceneResources::SceneNode::setScale(glm::vec3 scl) {
+	Scale_ = scl;
+	if (transformIndex_ != TransformHierarchy::INVALID_INDEX)
+		SceneResources::SceneManager::getInstance()->getTransforms().setScale(transformIndex_, scl);
+}
 
-void SceneResources::SceneNode::draw(Resources::Shader& shader) {
-	if (isEnabled_) {
-		if (!isRoot()) {
-			auto resourceManager = Resources::ResourceManager::getInstance();
-			glm::mat4 transform = this->getGlobalModelMatrix();
-			resourceManager->updateBuffer("Matrices", (const unsigned char*)&transform, sizeof(transform), 2 * sizeof(glm::mat4));
-			mesh_.draw(shader);
-		}
-		for (auto& child : children) {
-			child->draw(shader);
-		}
-	}
+const glm::mat4& SceneResources::SceneNode::getGlobalModelMatrix() const {
+	return SceneResources::SceneManager::getInstance()->getTransforms().getWorldMatrix(transformIndex_);
 }
 
 
+
+void SceneResources::SceneNode::setEnabled(bool value) {
+	if (isEnabled_ != value)
+		SceneResources::SceneManager::getInstance()->markSceneChanged();
+
+	isEnabled_ = value;
+}
+
 void SceneResources::SceneNode::setParent(SceneNode* par) {
 	parent = par;
 	if (par && std::find(par->children.begin(), par->children.end(), this) == par->children.end())
 		par->children.push_back(this);
+
+	SceneResources::SceneManager::getInstance()->markSceneChanged();
 }
 
 
@@ -0,0 +1,164 @@
+#include "TransformHierarchy.hpp"
+#include "Profiler.hpp"
+
+#include <algorithm>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define TRANSFORM_HIERARCHY_SSE
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define TRANSFORM_HIERARCHY_NEON
+#endif
+
+
+namespace SceneResources {
+
+// Same as translate * toMat4 * scale, without the multiplies by mostly zero matrices
+static inline void composeMatrix(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale, glm::mat4& result) {
+    result = glm::mat4_cast(rotation);
+    result[0] *= scale.x;
+    result[1] *= scale.y;
+    result[2] *= scale.z;
+    result[3] = glm::vec4(position, 1.0f);
+}
+
+// Column by column with the same order of operations as glm, so the results do not depend on the path taken
+static inline void multiplyMatrices(const glm::mat4& a, const glm::mat4& b, glm::mat4& result) {
+#if defined(TRANSFORM_HIERARCHY_SSE)
+    const __m128 a0 = _mm_loadu_ps(&a[0][0]);
+    const __m128 a1 = _mm_loadu_ps(&a[1][0]);
+    const __m128 a2 = _mm_loadu_ps(&a[2][0]);
+    const __m128 a3 = _mm_loadu_ps(&a[3][0]);
+    for (int i = 0; i < 4; ++i) {
+        __m128 column = _mm_mul_ps(a0, _mm_set1_ps(b[i][0]));
+        column = _mm_add_ps(column, _mm_mul_ps(a1, _mm_set1_ps(b[i][1])));
+        column = _mm_add_ps(column, _mm_mul_ps(a2, _mm_set1_ps(b[i][2])));
+        column = _mm_add_ps(column, _mm_mul_ps(a3, _mm_set1_ps(b[i][3])));
+        _mm_storeu_ps(&result[i][0], column);
+    }
+#elif defined(TRANSFORM_HIERARCHY_NEON)
+    const float32x4_t a0 = vld1q_f32(&a[0][0]);
+    const float32x4_t a1 = vld1q_f32(&a[1][0]);
+    const float32x4_t a2 = vld1q_f32(&a[2][0]);
+    const float32x4_t a3 = vld1q_f32(&a[3][0]);
+    for (int i = 0; i < 4; ++i) {
+        float32x4_t column = vmulq_n_f32(a0, b[i][0]);
+        column = vaddq_f32(column, vmulq_n_f32(a1, b[i][1]));
+        column = vaddq_f32(column, vmulq_n_f32(a2, b[i][2]));
+        column = vaddq_f32(column, vmulq_n_f32(a3, b[i][3]));
+        vst1q_f32(&result[i][0], column);
+    }
+#else
+    result = a * b;
+#endif
+}
+
+
+void TransformHierarchy::clear() {
+    parents_.clear();
+    positions_.clear();
+    rotations_.clear();
+    scales_.clear();
+    localMatrices_.clear();
+    worldMatrices_.clear();
+    flags_.clear();
+    firstDirty_ = INVALID_INDEX;
+    ++version_;
+}
+
+
+void TransformHierarchy::reserve(const size_t count) {
+    parents_.reserve(count);
+    positions_.reserve(count);
+    rotations_.reserve(count);
+    scales_.reserve(count);
+    localMatrices_.reserve(count);
+    worldMatrices_.reserve(count);
+    flags_.reserve(count);
+}
+
+
+uint32_t TransformHierarchy::add(const uint32_t parent, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+    const uint32_t index = static_cast<uint32_t>(parents_.size());
+
+    parents_.push_back(parent < index ? parent : INVALID_INDEX);
+    positions_.push_back(position);
+    rotations_.push_back(rotation);
+    scales_.push_back(scale);
+    localMatrices_.emplace_back(1.0f);
+    worldMatrices_.emplace_back(1.0f);
+    flags_.push_back(0);
+
+    markDirty(index);
+    return index;
+}
+
+
+void TransformHierarchy::setPosition(const uint32_t index, const glm::vec3& position) {
+    positions_[index] = position;
+    markDirty(index);
+}
+
+
+void TransformHierarchy::setRotation(const uint32_t index, const glm::quat& rotation) {
+    rotations_[index] = rotation;
+    markDirty(index);
+}
+
+
+void TransformHierarchy::setScale(const uint32_t index, const glm::vec3& scale) {
+    scales_[index] = scale;
+    markDirty(index);
+}
+
+
+void TransformHierarchy::markDirty(const uint32_t index) {
+    flags_[index] |= LOCAL_DIRTY;
+    firstDirty_ = std::min(firstDirty_, index);
+}
+
+
+bool TransformHierarchy::update() {
+    PROFILE_SCOPE("TransformHierarchy::update");
+    updatedCount_ = 0;
+    if (firstDirty_ == INVALID_INDEX)
+        return false;
+
+    const uint32_t count = static_cast<uint32_t>(parents_.size());
+
+    // Local matrices do not depend on each other
+    for (uint32_t i = firstDirty_; i < count; ++i) {
+        if (flags_[i] & LOCAL_DIRTY)
+            composeMatrix(positions_[i], rotations_[i], scales_[i], localMatrices_[i]);
+    }
+
+    // Parents are visited first, so their world matrices are final when the children read them
+    for (uint32_t i = firstDirty_; i < count; ++i) {
+        const uint32_t parent = parents_[i];
+        const bool parentChanged = parent != INVALID_INDEX && (flags_[parent] & WORLD_CHANGED);
+        if (!(flags_[i] & LOCAL_DIRTY) && !parentChanged)
+            continue;
+
+        if (parent == INVALID_INDEX)
+            worldMatrices_[i] = localMatrices_[i];
+        else
+            multiplyMatrices(worldMatrices_[parent], localMatrices_[i], worldMatrices_[i]);
+
+        flags_[i] = WORLD_CHANGED;
+        ++updatedCount_;
+    }
+
+    std::fill(flags_.begin() + firstDirty_, flags_.end(), 0);
+    firstDirty_ = INVALID_INDEX;
+    ++version_;
+    return true;
+}
+
+
+const glm::mat4& TransformHierarchy::getWorldMatrix(const uint32_t index) const {
+    static const glm::mat4 identity = glm::mat4(1.0f);
+    return index < worldMatrices_.size() ? worldMatrices_[index] : identity;
+}
+
+}
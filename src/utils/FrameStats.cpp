@@ -0,0 +1,89 @@
+#include "FrameStats.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+
+namespace Utils {
+
+static double percentile(const std::vector<double>& sorted, const double p) {
+    // Nearest-rank percentile
+    size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * sorted.size()));
+    rank = std::clamp<size_t>(rank, 1, sorted.size());
+    return sorted[rank - 1];
+}
+
+
+void FrameStats::addSample(const std::string& series, const double value) {
+    series_[series].push_back(value);
+}
+
+
+bool FrameStats::hasSeries(const std::string& series) const {
+    return series_.find(series) != series_.end();
+}
+
+
+const std::vector<double>& FrameStats::getSamples(const std::string& series) const {
+    static const std::vector<double> empty;
+
+    auto it = series_.find(series);
+    return it != series_.end() ? it->second : empty;
+}
+
+
+std::vector<std::string> FrameStats::getSeriesNames() const {
+    std::vector<std::string> names;
+    names.reserve(series_.size());
+    for (const auto& [name, samples] : series_) {
+        names.push_back(name);
+    }
+    return names;
+}
+
+
+FrameStats::Summary FrameStats::getSummary(const std::string& series) const {
+    Summary summary;
+
+    const auto& samples = getSamples(series);
+    if (samples.empty()) {
+        return summary;
+    }
+
+    std::vector<double> sorted = samples;
+    std::sort(sorted.begin(), sorted.end());
+
+    summary.count = sorted.size();
+    summary.mean = std::accumulate(sorted.begin(), sorted.end(), 0.0) / sorted.size();
+    summary.p50 = percentile(sorted, 50.0);
+    summary.p95 = percentile(sorted, 95.0);
+    summary.p99 = percentile(sorted, 99.0);
+    summary.max = sorted.back();
+
+    return summary;
+}
+
+
+nlohmann::json FrameStats::toJson(const bool withSamples) const {
+    nlohmann::json result = nlohmann::json::object();
+
+    for (const auto& [name, samples] : series_) {
+        const Summary summary = getSummary(name);
+
+        auto& entry = result[name];
+        entry["count"] = summary.count;
+        entry["mean"] = summary.mean;
+        entry["p50"] = summary.p50;
+        entry["p95"] = summary.p95;
+        entry["p99"] = summary.p99;
+        entry["max"] = summary.max;
+        if (withSamples) {
+            entry["samples"] = samples;
+        }
+    }
+
+    return result;
+}
+
+}
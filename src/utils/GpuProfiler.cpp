@@ -0,0 +1,221 @@
+#include "GpuProfiler.hpp"
+#include "Profiler.hpp"
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+
+namespace Utils {
+
+GpuProfiler* GpuProfiler::instancePtr = nullptr;
+
+void GpuProfiler::setEnabled(const bool enabled) {
+#ifdef __ANDROID__
+    if (enabled) {
+        LOG_W("GPU profiler is not supported on GLES, it stays disabled");
+    }
+#else
+    enabled_ = enabled;
+#endif
+}
+
+
+void GpuProfiler::beginFrame() {
+    if (!enabled_ || frameOpen_) {
+        return;
+    }
+
+#ifndef __ANDROID__
+    if (!calibrated_) {
+        GLint64 gpuNowNs = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpuNowNs);
+        gpuToCpuOffsetUs_ = Profiler::getInstance()->nowUs() - gpuNowNs / 1000.0;
+        calibrated_ = true;
+    }
+#endif
+
+    resolvePending(false);
+
+    auto& slot = slots_[frameIndex_ % FRAME_LATENCY];
+    if (slot.pending) {
+        // The GPU is FRAME_LATENCY frames behind, results of that frame are given up instead of waiting
+        ++droppedFrames_;
+        slot.pending = false;
+    }
+
+    slot.usedQueries = 0;
+    slot.scopes.clear();
+    slot.frameIndex = frameIndex_;
+
+    scopeStack_.clear();
+    frameOpen_ = true;
+
+    writeTimestamp(slot);
+}
+
+
+void GpuProfiler::endFrame() {
+    if (!frameOpen_) {
+        return;
+    }
+
+    auto& slot = slots_[frameIndex_ % FRAME_LATENCY];
+    while (!scopeStack_.empty()) {
+        endScope();
+    }
+    writeTimestamp(slot);
+
+    slot.pending = true;
+    frameOpen_ = false;
+    ++frameIndex_;
+
+    resolvePending(false);
+}
+
+
+void GpuProfiler::beginScope(const char* name) {
+    if (!frameOpen_) {
+        return;
+    }
+
+    auto& slot = slots_[frameIndex_ % FRAME_LATENCY];
+    scopeStack_.push_back(static_cast<uint32_t>(slot.scopes.size()));
+    slot.scopes.push_back({ name, writeTimestamp(slot), 0 });
+}
+
+
+void GpuProfiler::endScope() {
+    if (!frameOpen_ || scopeStack_.empty()) {
+        return;
+    }
+
+    auto& slot = slots_[frameIndex_ % FRAME_LATENCY];
+    slot.scopes[scopeStack_.back()].endQuery = writeTimestamp(slot);
+    scopeStack_.pop_back();
+}
+
+
+bool GpuProfiler::popFrameResult(FrameResult& result) {
+    if (resolved_.empty()) {
+        return false;
+    }
+
+    result = std::move(resolved_.front());
+    resolved_.pop_front();
+    return true;
+}
+
+
+void GpuProfiler::flush() {
+    resolvePending(true);
+}
+
+
+void GpuProfiler::release() {
+    for (auto& slot : slots_) {
+#ifndef __ANDROID__
+        if (!slot.queries.empty()) {
+            glDeleteQueries(static_cast<GLsizei>(slot.queries.size()), slot.queries.data());
+        }
+#endif
+        slot = FrameSlot{};
+    }
+
+    scopeStack_.clear();
+    resolved_.clear();
+    frameOpen_ = false;
+    calibrated_ = false;
+}
+
+
+uint32_t GpuProfiler::writeTimestamp(FrameSlot& slot) {
+    if (slot.usedQueries == slot.queries.size()) {
+        // Queries are allocated in batches and reused by the following frames in the slot
+        size_t oldSize = slot.queries.size();
+        slot.queries.resize(oldSize == 0 ? 32 : oldSize * 2);
+#ifndef __ANDROID__
+        glGenQueries(static_cast<GLsizei>(slot.queries.size() - oldSize), slot.queries.data() + oldSize);
+#endif
+    }
+
+#ifndef __ANDROID__
+    glQueryCounter(slot.queries[slot.usedQueries], GL_TIMESTAMP);
+#endif
+    return slot.usedQueries++;
+}
+
+
+void GpuProfiler::resolvePending(const bool wait) {
+    // Frames are read back in issue order, stopping at the first one the GPU has not finished yet
+    for (uint64_t frame = frameIndex_ >= FRAME_LATENCY ? frameIndex_ - FRAME_LATENCY : 0; frame < frameIndex_; ++frame) {
+        auto& slot = slots_[frame % FRAME_LATENCY];
+        if (!slot.pending || slot.frameIndex != frame) {
+            continue;
+        }
+        if (!resolveSlot(slot, wait)) {
+            return;
+        }
+    }
+}
+
+
+bool GpuProfiler::resolveSlot(FrameSlot& slot, const bool wait) {
+#ifdef __ANDROID__
+    slot.pending = false;
+    return true;
+#else
+    if (!wait) {
+        // Timestamps are written in order, so the last one being available means the whole frame is
+        GLint available = 0;
+        glGetQueryObjectiv(slot.queries[slot.usedQueries - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            return false;
+        }
+    }
+
+    std::vector<GLuint64> timestamps(slot.usedQueries);
+    for (uint32_t i = 0; i < slot.usedQueries; ++i) {
+        glGetQueryObjectui64v(slot.queries[i], GL_QUERY_RESULT, &timestamps[i]);
+    }
+    slot.pending = false;
+
+    FrameResult result;
+    result.frameIndex = slot.frameIndex;
+    result.frameMs = (timestamps.back() - timestamps.front()) / 1.0e6;
+
+    auto profiler = Profiler::getInstance();
+    const bool traced = profiler->isEnabled();
+    if (traced) {
+        if (!hasGpuTrack_) {
+            gpuTrack_ = profiler->registerTrack("GPU");
+            hasGpuTrack_ = true;
+        }
+        profiler->addEvent("GPU Frame", timestamps.front() / 1000.0 + gpuToCpuOffsetUs_, result.frameMs * 1000.0, "gpu", gpuTrack_);
+    }
+
+    for (const auto& scope : slot.scopes) {
+        double ms = (timestamps[scope.endQuery] - timestamps[scope.beginQuery]) / 1.0e6;
+
+        auto it = std::find_if(result.passMs.begin(), result.passMs.end(), [&](const auto& pass) { return std::strcmp(pass.first, scope.name) == 0; });
+        if (it == result.passMs.end()) {
+            result.passMs.emplace_back(scope.name, ms);
+        }
+        else {
+            it->second += ms;
+        }
+
+        if (traced) {
+            profiler->addEvent(scope.name, timestamps[scope.beginQuery] / 1000.0 + gpuToCpuOffsetUs_, ms * 1000.0, "gpu", gpuTrack_);
+        }
+    }
+
+    resolved_.push_back(std::move(result));
+    if (resolved_.size() > MAX_RESOLVED_FRAMES) {
+        resolved_.pop_front();
+    }
+    return true;
+#endif
+}
+
+}
@@ -0,0 +1,68 @@
+#include "ImageDecoder.hpp"
+#include "Profiler.hpp"
+#include "stb_image.h"
+
+
+namespace Utils {
+
+ImageDecoder::ImageDecoder() {
+    // stb_image keeps conversion settings in globals, they are set once here before the first decode
+    stbi_hdr_to_ldr_gamma(1.0f);
+}
+
+
+ImageDecoder::DecodedImage ImageDecoder::decodeFile(const std::string& filename, const bool isHdr) const {
+    PROFILE_SCOPE("ImageDecoder::decodeFile");
+    DecodedImage decoded;
+
+    unsigned char* data = nullptr;
+    if (isHdr) {
+        data = reinterpret_cast<unsigned char*>(stbi_loadf(filename.c_str(), &decoded.width, &decoded.height, &decoded.components, 0));
+        decoded.bits = 8 * sizeof(float);
+    }
+    else {
+        data = stbi_load(filename.c_str(), &decoded.width, &decoded.height, &decoded.components, 0);
+        decoded.bits = 8;                   // stb_image automatically converts
+    }
+
+    if (data) {
+        size_t bytesize = static_cast<size_t>(decoded.width) * decoded.height * decoded.components * (decoded.bits / 8);
+        decoded.pixels.assign(data, data + bytesize);
+    }
+    stbi_image_free(data);
+
+    return decoded;
+}
+
+
+ImageDecoder::DecodedImage ImageDecoder::decodeMemory(const unsigned char* bytes, const size_t size, const int requiredComponents) const {
+    PROFILE_SCOPE("ImageDecoder::decodeMemory");
+    DecodedImage decoded;
+
+    unsigned char* data = nullptr;
+    const int length = static_cast<int>(size);
+
+    // 16 bit images keep their precision, everything else is decoded as 8 bit
+    if (stbi_is_16_bit_from_memory(bytes, length)) {
+        data = reinterpret_cast<unsigned char*>(stbi_load_16_from_memory(bytes, length, &decoded.width, &decoded.height, &decoded.components, requiredComponents));
+        decoded.bits = 16;
+    }
+    if (!data) {
+        data = stbi_load_from_memory(bytes, length, &decoded.width, &decoded.height, &decoded.components, requiredComponents);
+        decoded.bits = 8;
+    }
+
+    if (data && decoded.width > 0 && decoded.height > 0) {
+        if (requiredComponents != 0) {
+            decoded.components = requiredComponents;
+        }
+
+        size_t bytesize = static_cast<size_t>(decoded.width) * decoded.height * decoded.components * (decoded.bits / 8);
+        decoded.pixels.assign(data, data + bytesize);
+    }
+    stbi_image_free(data);
+
+    return decoded;
+}
+
+}
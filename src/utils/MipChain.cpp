@@ -0,0 +1,244 @@
+#include "MipChain.hpp"
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// SSE2 is part of every x86-64 target, other architectures take the scalar paths
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIP_CHAIN_SSE2
+#include <emmintrin.h>
+#endif
+
+
+namespace Utils {
+
+// sRGB colors are averaged as 14 bit linear values, so four of them still fit into 16 bit lanes
+static constexpr int LINEAR_BITS = 14;
+static constexpr int LINEAR_MAX = (1 << LINEAR_BITS) - 1;
+
+struct SrgbTables {
+    uint16_t toLinear[256];
+    uint8_t fromLinear[LINEAR_MAX + 1];
+
+    SrgbTables() {
+        for (int i = 0; i < 256; ++i) {
+            const float c = i / 255.0f;
+            const float l = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+            toLinear[i] = static_cast<uint16_t>(l * LINEAR_MAX + 0.5f);
+        }
+
+        for (int i = 0; i <= LINEAR_MAX; ++i) {
+            const float l = i / float(LINEAR_MAX);
+            const float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+            fromLinear[i] = static_cast<uint8_t>(std::clamp(c * 255.0f + 0.5f, 0.0f, 255.0f));
+        }
+    }
+};
+
+static const SrgbTables& getSrgbTables() {
+    static const SrgbTables tables;
+    return tables;
+}
+
+
+int getMipLevelCount(const int width, const int height) {
+    int levels = 1;
+    for (int size = std::max(width, height); size > 1; size >>= 1)
+        ++levels;
+
+    return levels;
+}
+
+size_t getMipLevelSize(const int width, const int height, const int pixelSize, const int level) {
+    return static_cast<size_t>(std::max(1, width >> level)) * std::max(1, height >> level) * pixelSize;
+}
+
+size_t getMipLevelOffset(const int width, const int height, const int pixelSize, const int level) {
+    size_t offset = 0;
+    for (int i = 0; i < level; ++i)
+        offset += getMipLevelSize(width, height, pixelSize, i);
+
+    return offset;
+}
+
+size_t getMipChainSize(const int width, const int height, const int pixelSize, const int levels) {
+    return getMipLevelOffset(width, height, pixelSize, levels);
+}
+
+
+// 2x2 box filter, the last row and column of odd sized levels are clamped
+template<typename T, typename Average>
+static void downsample(const T* src, const int srcWidth, const int srcHeight, T* dst, const int components, Average average) {
+    const int dstWidth = std::max(1, srcWidth >> 1);
+    const int dstHeight = std::max(1, srcHeight >> 1);
+
+    for (int y = 0; y < dstHeight; ++y) {
+        const T* row0 = src + static_cast<size_t>(std::min(2 * y, srcHeight - 1)) * srcWidth * components;
+        const T* row1 = src + static_cast<size_t>(std::min(2 * y + 1, srcHeight - 1)) * srcWidth * components;
+        T* out = dst + static_cast<size_t>(y) * dstWidth * components;
+
+        for (int x = 0; x < dstWidth; ++x) {
+            const int x0 = std::min(2 * x, srcWidth - 1) * components;
+            const int x1 = std::min(2 * x + 1, srcWidth - 1) * components;
+            for (int c = 0; c < components; ++c)
+                out[x * components + c] = average(c, row0[x0 + c], row0[x1 + c], row1[x0 + c], row1[x1 + c]);
+        }
+    }
+}
+
+
+// Box filter of two RGBA rows into one, T is uint8_t for linear images or uint16_t for linearized sRGB rows
+template<typename T>
+static void filterRowsRGBA(const T* row0, const T* row1, const int srcWidth, T* dst) {
+    const int dstWidth = std::max(1, srcWidth >> 1);
+    int x = 0;
+
+#ifdef MIP_CHAIN_SSE2
+    // Two output pixels per step, sums of four 14 bit or 8 bit values never overflow 16 bit lanes
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i two = _mm_set1_epi16(2);
+    const int pairs = srcWidth >= 2 ? dstWidth : 0;
+
+    for (; x + 2 <= pairs; x += 2) {
+        __m128i top0, top1, bottom0, bottom1;
+        if constexpr (sizeof(T) == 1) {
+            const __m128i top = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8));
+            const __m128i bottom = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8));
+            top0 = _mm_unpacklo_epi8(top, zero);
+            top1 = _mm_unpackhi_epi8(top, zero);
+            bottom0 = _mm_unpacklo_epi8(bottom, zero);
+            bottom1 = _mm_unpackhi_epi8(bottom, zero);
+        }
+        else {
+            top0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8));
+            top1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8 + 8));
+            bottom0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8));
+            bottom1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8 + 8));
+        }
+
+        // Vertical sums hold source pixels [0, 1] and [2, 3], regrouping their halves adds neighbours
+        const __m128i vertical0 = _mm_add_epi16(top0, bottom0);
+        const __m128i vertical1 = _mm_add_epi16(top1, bottom1);
+        const __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(vertical0, vertical1), _mm_unpackhi_epi64(vertical0, vertical1));
+        const __m128i average = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+
+        if constexpr (sizeof(T) == 1)
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + x * 4), _mm_packus_epi16(average, zero));
+        else
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), average);
+    }
+#endif
+
+    for (; x < dstWidth; ++x) {
+        const int x0 = std::min(2 * x, srcWidth - 1) * 4;
+        const int x1 = std::min(2 * x + 1, srcWidth - 1) * 4;
+        for (int c = 0; c < 4; ++c)
+            dst[x * 4 + c] = static_cast<T>((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+    }
+}
+
+
+static void downsampleRGBA8(const uint8_t* src, const int srcWidth, const int srcHeight, uint8_t* dst) {
+    const int dstWidth = std::max(1, srcWidth >> 1);
+    const int dstHeight = std::max(1, srcHeight >> 1);
+
+    for (int y = 0; y < dstHeight; ++y) {
+        const uint8_t* row0 = src + static_cast<size_t>(std::min(2 * y, srcHeight - 1)) * srcWidth * 4;
+        const uint8_t* row1 = src + static_cast<size_t>(std::min(2 * y + 1, srcHeight - 1)) * srcWidth * 4;
+        filterRowsRGBA(row0, row1, srcWidth, dst + static_cast<size_t>(y) * dstWidth * 4);
+    }
+}
+
+
+static void linearizeRowSrgbRGBA8(const uint8_t* src, const int width, uint16_t* dst) {
+    const auto& srgb = getSrgbTables();
+    for (int x = 0; x < width * 4; x += 4) {
+        dst[x + 0] = srgb.toLinear[src[x + 0]];
+        dst[x + 1] = srgb.toLinear[src[x + 1]];
+        dst[x + 2] = srgb.toLinear[src[x + 2]];
+        dst[x + 3] = static_cast<uint16_t>(src[x + 3] << (LINEAR_BITS - 8));
+    }
+}
+
+
+static void downsampleSrgbRGBA8(const uint8_t* src, const int srcWidth, const int srcHeight, uint8_t* dst) {
+    const auto& srgb = getSrgbTables();
+    const int dstWidth = std::max(1, srcWidth >> 1);
+    const int dstHeight = std::max(1, srcHeight >> 1);
+
+    std::vector<uint16_t> row0(static_cast<size_t>(srcWidth) * 4);
+    std::vector<uint16_t> row1(row0.size());
+    std::vector<uint16_t> filtered(static_cast<size_t>(dstWidth) * 4);
+
+    for (int y = 0; y < dstHeight; ++y) {
+        linearizeRowSrgbRGBA8(src + static_cast<size_t>(std::min(2 * y, srcHeight - 1)) * srcWidth * 4, srcWidth, row0.data());
+        linearizeRowSrgbRGBA8(src + static_cast<size_t>(std::min(2 * y + 1, srcHeight - 1)) * srcWidth * 4, srcWidth, row1.data());
+        filterRowsRGBA(row0.data(), row1.data(), srcWidth, filtered.data());
+
+        uint8_t* out = dst + static_cast<size_t>(y) * dstWidth * 4;
+        for (int x = 0; x < dstWidth * 4; x += 4) {
+            out[x + 0] = srgb.fromLinear[filtered[x + 0]];
+            out[x + 1] = srgb.fromLinear[filtered[x + 1]];
+            out[x + 2] = srgb.fromLinear[filtered[x + 2]];
+            out[x + 3] = static_cast<uint8_t>((filtered[x + 3] + (1 << (LINEAR_BITS - 9))) >> (LINEAR_BITS - 8));
+        }
+    }
+}
+
+
+void generateMipChain(ImageDecoder::DecodedImage& image, const bool isSrgb) {
+    PROFILE_SCOPE("Utils::generateMipChain");
+    if (!image.isValid() || image.levels != 1)
+        return;
+
+    const int pixelSize = image.components * (image.bits / 8);
+    const int levels = getMipLevelCount(image.width, image.height);
+    image.pixels.resize(getMipChainSize(image.width, image.height, pixelSize, levels));
+
+    const auto& srgb = getSrgbTables();
+    // Alpha is always linear
+    const int colorComponents = image.components == 4 || image.components == 2 ? image.components - 1 : image.components;
+
+    for (int level = 1; level < levels; ++level) {
+        const int srcWidth = std::max(1, image.width >> (level - 1));
+        const int srcHeight = std::max(1, image.height >> (level - 1));
+        unsigned char* src = image.pixels.data() + getMipLevelOffset(image.width, image.height, pixelSize, level - 1);
+        unsigned char* dst = image.pixels.data() + getMipLevelOffset(image.width, image.height, pixelSize, level);
+
+        if (image.bits == 32) {
+            downsample(reinterpret_cast<const float*>(src), srcWidth, srcHeight, reinterpret_cast<float*>(dst), image.components,
+                [](int, float a, float b, float c, float d) { return (a + b + c + d) * 0.25f; });
+        }
+        else if (image.bits == 16) {
+            downsample(reinterpret_cast<const uint16_t*>(src), srcWidth, srcHeight, reinterpret_cast<uint16_t*>(dst), image.components,
+                [](int, uint16_t a, uint16_t b, uint16_t c, uint16_t d) { return static_cast<uint16_t>((a + b + c + d + 2) >> 2); });
+        }
+        else if (image.components == 4) {
+            // glTF images are always decoded to RGBA, they take the vectorized paths
+            if (isSrgb)
+                downsampleSrgbRGBA8(src, srcWidth, srcHeight, dst);
+            else
+                downsampleRGBA8(src, srcWidth, srcHeight, dst);
+        }
+        else if (isSrgb) {
+            downsample(src, srcWidth, srcHeight, dst, image.components,
+                [&srgb, colorComponents](int channel, uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+                    if (channel >= colorComponents)
+                        return static_cast<uint8_t>((a + b + c + d + 2) >> 2);
+
+                    return srgb.fromLinear[(srgb.toLinear[a] + srgb.toLinear[b] + srgb.toLinear[c] + srgb.toLinear[d] + 2) >> 2];
+                });
+        }
+        else {
+            downsample(src, srcWidth, srcHeight, dst, image.components,
+                [](int, uint8_t a, uint8_t b, uint8_t c, uint8_t d) { return static_cast<uint8_t>((a + b + c + d + 2) >> 2); });
+        }
+    }
+
+    image.levels = levels;
+}
+
+}
@@ -0,0 +1,95 @@
+#include "Profiler.hpp"
+#include "Logger.hpp"
+
+#include <fstream>
+
+#include <nlohmann/json.hpp>
+
+
+namespace Utils {
+
+Profiler* Profiler::instancePtr = nullptr;
+
+Profiler::Profiler() : epoch_{ std::chrono::steady_clock::now() } {
+    events_.reserve(1 << 16);
+}
+
+
+void Profiler::addEvent(const char* name, const double startUs, const double durationUs, const char* category) {
+    addEvent(name, startUs, durationUs, category, getCurrentThreadId());
+}
+
+
+void Profiler::addEvent(const char* name, const double startUs, const double durationUs, const char* category, const uint32_t threadId) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    events_.push_back({ name, category, startUs, durationUs, threadId });
+}
+
+
+uint32_t Profiler::getCurrentThreadId() {
+    thread_local uint32_t threadId = nextThreadId_.fetch_add(1, std::memory_order_relaxed);
+    return threadId;
+}
+
+
+void Profiler::setThreadName(const uint32_t threadId, const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    threadNames_[threadId] = name;
+}
+
+
+uint32_t Profiler::registerTrack(const std::string& name) {
+    uint32_t trackId = nextThreadId_.fetch_add(1, std::memory_order_relaxed);
+    setThreadName(trackId, name);
+    return trackId;
+}
+
+
+bool Profiler::writeChromeTrace(const std::string& filename) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    nlohmann::json traceEvents = nlohmann::json::array();
+    for (const auto& [threadId, name] : threadNames_) {
+        traceEvents.push_back({
+            { "name", "thread_name" },
+            { "ph", "M" },
+            { "pid", 0 },
+            { "tid", threadId },
+            { "args", { { "name", name } } }
+        });
+    }
+
+    for (const auto& event : events_) {
+        traceEvents.push_back({
+            { "name", event.name },
+            { "cat", event.category },
+            { "ph", "X" },
+            { "ts", event.startUs },
+            { "dur", event.durationUs },
+            { "pid", 0 },
+            { "tid", event.threadId }
+        });
+    }
+
+    nlohmann::json trace;
+    trace["traceEvents"] = std::move(traceEvents);
+    trace["displayTimeUnit"] = "ms";
+
+    std::ofstream output { filename };
+    if (!output) {
+        LOG_E("Failed to write trace to \'%s\'", filename.c_str());
+        return false;
+    }
+    output << trace.dump();
+
+    LOG_I("Written %zu trace events to \'%s\'", events_.size(), filename.c_str());
+    return true;
+}
+
+
+void Profiler::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    events_.clear();
+}
+
+}
@@ -0,0 +1,88 @@
+#include "ThreadPool.hpp"
+#include "Profiler.hpp"
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <string>
+
+
+namespace Utils {
+
+ThreadPool* ThreadPool::instancePtr = nullptr;
+
+ThreadPool::ThreadPool() {
+    // One core is left to the main thread which keeps drawing while workers are busy
+    const size_t workersCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+
+    // Created here so workers never race on the lazy singleton
+    Profiler::getInstance();
+
+    workers_.reserve(workersCount);
+    for (size_t i = 0; i < workersCount; ++i) {
+        workers_.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+
+    LOG_I("Thread pool started with %zu workers", workersCount);
+}
+
+
+bool ThreadPool::runPendingTask() {
+    std::function<void()> task;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (tasks_.empty()) {
+            return false;
+        }
+
+        task = std::move(tasks_.front());
+        tasks_.pop_front();
+    }
+
+    task();
+    return true;
+}
+
+
+void ThreadPool::workerLoop(const size_t workerIdx) {
+    auto profiler = Profiler::getInstance();
+    profiler->setThreadName(profiler->getCurrentThreadId(), "Worker " + std::to_string(workerIdx));
+
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait(lock, [this]() { return stop_ || !tasks_.empty(); });
+
+            // The queue is drained before stopping, so every returned future still gets its result
+            if (tasks_.empty()) {
+                return;
+            }
+
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+
+        task();
+    }
+}
+
+
+void ThreadPool::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stop_) {
+            return;
+        }
+        stop_ = true;
+    }
+    condition_.notify_all();
+
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+    workers_.clear();
+
+    LOG_I("Thread pool stopped");
+}
+
+}